@@ -18,11 +18,13 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 #include "config.h"
 #include "timing.h"
 #include "machine.h"
+#include "ports.h"
 #include "cpu/cpu.h"
 #include "chipset/i8259.h"
 #include "chipset/i8253.h"
@@ -43,6 +45,14 @@
 #include "modules/video/cga.h"
 #include "modules/video/vga.h"
 #include "debuglog.h"
+#include "replay.h"
+#include "batch.h"
+#include "script.h"
+#include "capture.h"
+#include "modules/video/vncserver.h"
+#include "modules/video/shmframe.h"
+#include "bench.h"
+#include "cputest.h"
 
 double speedarg = 0;
 
@@ -77,10 +87,11 @@ void args_showHelp() {
 	printf("Machine options:\r\n");
 	printf("  -machine <id>          Emulate machine definition defined by <id>. (Default is generic_xt)\r\n");
 	printf("                         Use -machine list to display <id> options.\r\n");
+	printf("  -cpu <model>           Emulate a <model> CPU: 8088, 8086, V20 or 186. (Default is machine-dependent)\r\n");
 	printf("  -speed <mhz>           Run the emulated CPU at approximately <mhz> MHz. (Default is as fast as possible)\r\n");
 	printf("                         There is currently no clock ticks counted per instruction, so the emulator is just going\r\n");
 	printf("                         to estimate how many instructions would come out to approximately the desired speed.\r\n");
-	printf("                         There will be more accurate speed-throttling at some point in the future.\r\n\r\n");
+	printf("                         The host thread sleeps whenever the guest gets ahead, -mips shows how close it keeps.\r\n\r\n");
 
 	printf("Disk options:\r\n");
 	printf("  -fd0 <file>            Insert <file> disk image as floppy 0.\r\n");
@@ -92,7 +103,14 @@ void args_showHelp() {
 	printf("Video options:\r\n");
 	printf("  -video <type>          Use <type> (CGA or VGA) video card emulation. (Default is machine-dependent)\r\n");
 	printf("  -fpslock <FPS>         Attempt to lock video refresh to <FPS> frames per second.\r\n");
-	printf("                         (Default is to base FPS on video adapter timings and is dynamic)\r\n\r\n");
+	printf("                         (Default is to base FPS on video adapter timings and is dynamic)\r\n");
+	printf("  -console <type>        Show the guest in an SDL window (sdl), as text in this terminal (ansi) or not\r\n");
+	printf("                         at all (none). ansi only shows text modes, Ctrl-] quits. (Default is sdl)\r\n");
+	printf("  -vnc <port>            Serve the screen to a VNC viewer on 127.0.0.1:<port>, e.g. 5900. Works with\r\n");
+	printf("                         any -console type, tunnel the port to watch a guest on another machine.\r\n");
+	printf("  -shm <name>            Publish every frame to shared memory <name> for other programs to read.\r\n");
+	printf("                         See modules/video/shmframe.c for the layout. Works with any -console type.\r\n");
+	printf("  -capture <name>        Record video to <name>.avi and audio to <name>.wav, in guest time.\r\n\r\n");
 
 	printf("Serial options:\r\n");
 #ifdef ENABLE_TCP_MODEM
@@ -128,12 +146,46 @@ void args_showHelp() {
 	printf("                         available to guest system at base port 0x300, IRQ 2.\r\n\r\n");
 #endif
 
+	printf("Record/replay options:\r\n");
+	printf("  -record <file>         Record all outside input (keyboard, mouse, network, RTC) to <file>. Guest time\r\n");
+	printf("                         is driven by the instruction count so the session can be reproduced exactly.\r\n");
+	printf("  -replay <file>         Replay a session recorded with -record. Use the same machine, video, memory and\r\n");
+	printf("                         disk options, and disk images in the same state as when recording started.\r\n");
+	printf("                         Replays run as fast as possible, live input takes over when the log ends.\r\n\r\n");
+
+	printf("Automation options:\r\n");
+	printf("  -script <file>         Type keys and wait for screen text as told by <file>, then exit. Commands are\r\n");
+	printf("                         type <text>, key <name>[+<name>...], wait <seconds> <text>, sleep <ms> and quit.\r\n");
+	printf("                         The exit code is nonzero if a wait times out or the script has an error.\r\n\r\n");
+
+	printf("Batch options:\r\n");
+	printf("  -batch <file>          Run every guest listed in <file> headless, all in this one process, then exit.\r\n");
+	printf("                         Each line is: <machine id> <instructions> [fd0=<image>] [fd1=<image>]\r\n");
+	printf("                         [hd0=<image>] [hd1=<image>] [boot=<disk>] [video=<type>] [cpu=<model>]\r\n");
+	printf("  -threads <count>       Spread batch guests over <count> worker threads. (Default is one per host CPU)\r\n\r\n");
+
+	printf("Benchmark options:\r\n");
+	printf("  -bench <file>          Run the built-in guest workloads headless on the selected -machine, write the\r\n");
+	printf("                         results to <file> as JSON, then exit.\r\n");
+	printf("  -benchcount <count>    Guest instructions to run each workload for. (Default is %u)\r\n\r\n", (uint32_t)BENCH_DEFAULT_COUNT);
+
+	printf("CPU test options:\r\n");
+	printf("  -cputest <file>        Run the single instruction test vectors in JSON <file> and report any that fail.\r\n");
+	printf("  -cpubackend <name>     CPU backend to run -cputest vectors on. (Default is 8088)\r\n");
+	printf("  -cputestmask <hex>     Only compare these flag bits. Use it to leave out undefined flags. (Default is %04X)\r\n", CPUTEST_DEFAULT_FLAGMASK);
+	printf("  -lockstep <a> <b> <file>\r\n");
+	printf("                         Run the .COM style image <file> on CPU backends <a> and <b> side by side and\r\n");
+	printf("                         stop at the first instruction where their registers or memory writes differ.\r\n");
+	printf("                         8088 and 8086 share one core, so <a> and <b> can't be those two.\r\n");
+	printf("  -lockstepcount <count> Maximum instructions to run in lockstep. (Default is %u)\r\n\r\n", (uint32_t)CPUTEST_DEFAULT_LOCKSTEP);
+
 	printf("Miscellaneous options:\r\n");
 	printf("  -mem <size>            Initialize emulator with only <size> KB of base memory. (Default is 640)\r\n");
 	printf("                         The maximum size is 736 KB, but this can only work with CGA video and a\r\n");
 	printf("                         system BIOS that will test beyond 640 KB.\r\n");
 	printf("  -debug <level>         <level> can be: NONE, ERROR, INFO, DETAIL. (Default is INFO)\r\n");
-	printf("  -mips                  Display live MIPS being emulated.\r\n");
+	printf("  -mips                  Display live MIPS being emulated, and the speed accuracy when throttled.\r\n");
+	printf("  -postcodes             Log BIOS POST codes written to diagnostic port 80h.\r\n");
 	printf("  -h                     Show this help screen.\r\n");
 }
 
@@ -164,6 +216,18 @@ int args_parse(MACHINE_t* machine, int argc, char* argv[]) {
 			}
 			usemachine = argv[i];
 		}
+		else if (args_isMatch(argv[i], "-cpu")) {
+			if ((i + 1) == argc) {
+				printf("Parameter required for -cpu. Use -h for help.\r\n");
+				return -1;
+			}
+			machine->CPU.model = cpu_findModel(argv[i + 1]);
+			if (machine->CPU.model == CPU_MODEL_DEFAULT) {
+				printf("%s is an invalid CPU model\r\n", argv[i + 1]);
+				return -1;
+			}
+			i++;
+		}
 		else if (args_isMatch(argv[i], "-speed")) {
 			if ((i + 1) == argc) {
 				printf("Parameter required for -speed. Use -h for help.\r\n");
@@ -204,10 +268,10 @@ int args_parse(MACHINE_t* machine, int argc, char* argv[]) {
 				printf("Parameter required for -boot. Use -h for help.\r\n");
 				return -1;
 			}
-			if (args_isMatch(argv[i + 1], "fd0")) bootdrive = 0x00;
-			else if (args_isMatch(argv[i + 1], "fd1")) bootdrive = 0x01;
-			else if (args_isMatch(argv[i + 1], "hd0")) bootdrive = 0x80;
-			else if (args_isMatch(argv[i + 1], "hd1")) bootdrive = 0x81;
+			if (args_isMatch(argv[i + 1], "fd0")) machine->biosdisk.bootdrive = 0x00;
+			else if (args_isMatch(argv[i + 1], "fd1")) machine->biosdisk.bootdrive = 0x01;
+			else if (args_isMatch(argv[i + 1], "hd0")) machine->biosdisk.bootdrive = 0x80;
+			else if (args_isMatch(argv[i + 1], "hd1")) machine->biosdisk.bootdrive = 0x81;
 			else {
 				printf("%s is an invalid boot option\r\n", argv[i + 1]);
 				return -1;
@@ -219,8 +283,8 @@ int args_parse(MACHINE_t* machine, int argc, char* argv[]) {
 				printf("Parameter required for -video. Use -h for help.\r\n");
 				return -1;
 			}
-			if (args_isMatch(argv[i + 1], "vga")) videocard = VIDEO_CARD_VGA;
-			else if (args_isMatch(argv[i + 1], "cga")) videocard = VIDEO_CARD_CGA;
+			if (args_isMatch(argv[i + 1], "vga")) machine->videocard = VIDEO_CARD_VGA;
+			else if (args_isMatch(argv[i + 1], "cga")) machine->videocard = VIDEO_CARD_CGA;
 			else {
 				printf("%s is an invalid video card option\r\n", argv[i + 1]);
 				return -1;
@@ -264,9 +328,26 @@ int args_parse(MACHINE_t* machine, int argc, char* argv[]) {
 			}
 			i++;
 		}
+		else if (args_isMatch(argv[i], "-record") || args_isMatch(argv[i], "-replay")) {
+			if ((i + 1) == argc) {
+				printf("Parameter required for %s. Use -h for help.\r\n", argv[i]);
+				return -1;
+			}
+			if (replay_mode != REPLAY_MODE_OFF) {
+				printf("Only one of -record or -replay can be used.\r\n");
+				return -1;
+			}
+			if (replay_open(machine, args_isMatch(argv[i], "-record") ? REPLAY_MODE_RECORD : REPLAY_MODE_PLAY, argv[i + 1])) {
+				return -1;
+			}
+			i++;
+		}
 		else if (args_isMatch(argv[i], "-mips")) {
 			showMIPS = 1;
 		}
+		else if (args_isMatch(argv[i], "-postcodes")) {
+			ports_setTrace(0x80, 1, ports_tracePOST, NULL);
+		}
 		else if (args_isMatch(argv[i], "-baud")) {
 			if ((i + 1) == argc) {
 				printf("Parameter required for -baud. Use -h for help.\r\n");
@@ -308,14 +389,12 @@ int args_parse(MACHINE_t* machine, int argc, char* argv[]) {
 				}
 				uart_init(&machine->UART[uartnum], &machine->i8259, base, irq, (void*)tcpmodem_tx, &machine->tcpmodem[uartnum], NULL, NULL);
 				tcpmodem_init(&machine->tcpmodem[uartnum], &machine->UART[uartnum], port);
-				timing_addTimer(tcpmodem_rxpoll, &machine->tcpmodem[uartnum], baudrate / 9, TIMING_ENABLED);
 			} else
 #endif
 				if (args_isMatch(argv[i + 1], "mouse")) {
 				i++;
 				uart_init(&machine->UART[uartnum], &machine->i8259, base, irq, NULL, NULL, (void*)mouse_togglereset, NULL);
 				mouse_init(&machine->UART[uartnum]);
-				timing_addTimer(mouse_rxpoll, NULL, baudrate / 9, TIMING_ENABLED);
 			}
 			else if (args_isMatch(argv[i + 1], "none")) {
 				i++;
@@ -326,6 +405,125 @@ int args_parse(MACHINE_t* machine, int argc, char* argv[]) {
 				return -1;
 			}
 		}
+		else if (args_isMatch(argv[i], "-console")) {
+			if ((i + 1) == argc) {
+				printf("Parameter required for -console. Use -h for help.\r\n");
+				return -1;
+			}
+			i++;
+			if (args_isMatch(argv[i], "sdl")) useconsole = CONSOLE_SDL;
+			else if (args_isMatch(argv[i], "ansi")) useconsole = CONSOLE_ANSI;
+			else if (args_isMatch(argv[i], "none")) useconsole = CONSOLE_NONE;
+			else {
+				printf("%s is an invalid console type\r\n", argv[i]);
+				return -1;
+			}
+		}
+		else if (args_isMatch(argv[i], "-vnc")) {
+			if ((i + 1) == argc) {
+				printf("Parameter required for -vnc. Use -h for help.\r\n");
+				return -1;
+			}
+			vncserver_port = (uint16_t)atol(argv[++i]);
+			if (vncserver_port == 0) {
+				printf("%s is an invalid port\r\n", argv[i]);
+				return -1;
+			}
+		}
+		else if (args_isMatch(argv[i], "-shm")) {
+			if ((i + 1) == argc) {
+				printf("Parameter required for -shm. Use -h for help.\r\n");
+				return -1;
+			}
+			shmframe_name = argv[++i];
+		}
+		else if (args_isMatch(argv[i], "-capture")) {
+			if ((i + 1) == argc) {
+				printf("Parameter required for -capture. Use -h for help.\r\n");
+				return -1;
+			}
+			capture_file = argv[++i];
+		}
+		else if (args_isMatch(argv[i], "-script")) {
+			if ((i + 1) == argc) {
+				printf("Parameter required for -script. Use -h for help.\r\n");
+				return -1;
+			}
+			script_file = argv[++i];
+		}
+		else if (args_isMatch(argv[i], "-batch")) {
+			if ((i + 1) == argc) {
+				printf("Parameter required for -batch. Use -h for help.\r\n");
+				return -1;
+			}
+			batch_file = argv[++i];
+		}
+		else if (args_isMatch(argv[i], "-threads")) {
+			if ((i + 1) == argc) {
+				printf("Parameter required for -threads. Use -h for help.\r\n");
+				return -1;
+			}
+			batch_threads = (uint32_t)atol(argv[++i]);
+			if ((batch_threads < 1) || (batch_threads > BATCH_MAXTHREADS)) {
+				printf("%s is an invalid thread count, valid range is 1 to %u\r\n", argv[i], BATCH_MAXTHREADS);
+				return -1;
+			}
+		}
+		else if (args_isMatch(argv[i], "-bench")) {
+			if ((i + 1) == argc) {
+				printf("Parameter required for -bench. Use -h for help.\r\n");
+				return -1;
+			}
+			bench_file = argv[++i];
+		}
+		else if (args_isMatch(argv[i], "-benchcount")) {
+			if ((i + 1) == argc) {
+				printf("Parameter required for -benchcount. Use -h for help.\r\n");
+				return -1;
+			}
+			bench_count = strtoull(argv[++i], NULL, 10);
+			if (bench_count < 1) {
+				printf("%s is an invalid instruction count\r\n", argv[i]);
+				return -1;
+			}
+		}
+		else if (args_isMatch(argv[i], "-cputest")) {
+			if ((i + 1) == argc) {
+				printf("Parameter required for -cputest. Use -h for help.\r\n");
+				return -1;
+			}
+			cputest_file = argv[++i];
+		}
+		else if (args_isMatch(argv[i], "-cpubackend")) {
+			if ((i + 1) == argc) {
+				printf("Parameter required for -cpubackend. Use -h for help.\r\n");
+				return -1;
+			}
+			cputest_backend = argv[++i];
+		}
+		else if (args_isMatch(argv[i], "-cputestmask")) {
+			if ((i + 1) == argc) {
+				printf("Parameter required for -cputestmask. Use -h for help.\r\n");
+				return -1;
+			}
+			cputest_flagmask = (uint16_t)strtoul(argv[++i], NULL, 16);
+		}
+		else if (args_isMatch(argv[i], "-lockstep")) {
+			if ((i + 3) >= argc) {
+				printf("Three parameters required for -lockstep. Use -h for help.\r\n");
+				return -1;
+			}
+			cputest_lockstep[0] = argv[++i];
+			cputest_lockstep[1] = argv[++i];
+			cputest_lockstep[2] = argv[++i];
+		}
+		else if (args_isMatch(argv[i], "-lockstepcount")) {
+			if ((i + 1) == argc) {
+				printf("Parameter required for -lockstepcount. Use -h for help.\r\n");
+				return -1;
+			}
+			cputest_lockstepCount = strtoull(argv[++i], NULL, 10);
+		}
 		else if (args_isMatch(argv[i], "-hw")) {
 			if ((i + 1) == argc) {
 				printf("Parameter required for -hw. Use -h for help.\r\n");
@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include "machine.h"
 
+int args_isMatch(char* s1, char* s2);
 int args_parse(MACHINE_t* machine, int argc, char* argv[]);
 void args_showHelp();
 
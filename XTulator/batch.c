@@ -0,0 +1,313 @@
+/*
+  XTulator: A portable, open-source 80186 PC emulator.
+  Copyright (C)2020 Mike Chambers
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+	Batch runner
+
+	Runs any number of headless machines in this one process, spread over a pool of worker
+	threads. Every machine carries its own memory map, port handlers, timers and disks (see
+	MACHINE_t), ROM images are loaded once and shared, and each guest runs on its own
+	instruction count clock so the result doesn't depend on how busy the host is.
+
+	The job file has one guest per line:
+
+	  <machine id> <instructions> [fd0=<image>] [fd1=<image>] [hd0=<image>] [hd1=<image>] [boot=<disk>] [video=<type>] [cpu=<model>]
+
+	Blank lines and anything after a # are ignored. Jobs are dealt out to the workers round
+	robin up front, so the workers never have to share anything with each other.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <Windows.h>
+#include <process.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#include "config.h"
+#include "args.h"
+#include "batch.h"
+#include "machine.h"
+#include "timing.h"
+#include "debuglog.h"
+#include "cpu/cpu.h"
+#include "chipset/i8259.h"
+#include "modules/disk/biosdisk.h"
+
+char* batch_file = NULL;
+uint32_t batch_threads = 0; //0 = one per host CPU
+
+BATCHJOB_t* batch_jobs = NULL;
+uint32_t batch_count = 0;
+
+//splits off the next whitespace separated word, returns NULL at the end of the line or a comment
+char* batch_token(char** pos) {
+	char* start;
+
+	while ((**pos == ' ') || (**pos == '\t')) {
+		(*pos)++;
+	}
+	if ((**pos == 0) || (**pos == '#') || (**pos == '\r') || (**pos == '\n')) {
+		return NULL;
+	}
+	start = *pos;
+	while ((**pos != 0) && (**pos != ' ') && (**pos != '\t') && (**pos != '\r') && (**pos != '\n')) {
+		(*pos)++;
+	}
+	if (**pos != 0) {
+		**pos = 0;
+		(*pos)++;
+	}
+	return start;
+}
+
+//returns 1 if the line has no job on it, -1 on error
+int batch_create(BATCHJOB_t* job, char* text) {
+	MACHINE_t* machine;
+	char *pos, *token, *value;
+	uint8_t drive;
+
+	pos = text;
+	job->id = batch_token(&pos);
+	if (job->id == NULL) {
+		return 1;
+	}
+	token = batch_token(&pos);
+	if (token == NULL) {
+		debug_log(DEBUG_ERROR, "[BATCH] Line %lu: instruction count missing\r\n", job->line);
+		return -1;
+	}
+	job->limit = strtoull(token, NULL, 10);
+
+	machine = (MACHINE_t*)calloc(1, sizeof(MACHINE_t));
+	if (machine == NULL) {
+		debug_log(DEBUG_ERROR, "[BATCH] Line %lu: unable to allocate machine\r\n", job->line);
+		return -1;
+	}
+	job->machine = machine;
+	machine->pcap_if = -1;
+	machine->headless = 1;
+	machine->hwflags = MACHINE_HW_SKIP_UART0 | MACHINE_HW_SKIP_UART1; //the serial mouse and modems belong to the host UI
+	machine_setup(machine);
+
+	//switch clocks before any device reads the time, so they all start out at zero
+	timing_setInstructionClock(&machine->CPU.clock);
+	timing_setInstructionRate(BATCH_IPS);
+
+	while ((token = batch_token(&pos)) != NULL) {
+		value = strchr(token, '=');
+		if (value == NULL) {
+			debug_log(DEBUG_ERROR, "[BATCH] Line %lu: expected option=value, got %s\r\n", job->line, token);
+			return -1;
+		}
+		*value++ = 0;
+		drive = 0xFF;
+		if (args_isMatch(token, "fd0")) drive = 0;
+		else if (args_isMatch(token, "fd1")) drive = 1;
+		else if (args_isMatch(token, "hd0")) drive = 2;
+		else if (args_isMatch(token, "hd1")) drive = 3;
+		else if (args_isMatch(token, "boot")) {
+			if (args_isMatch(value, "fd0")) machine->biosdisk.bootdrive = 0x00;
+			else if (args_isMatch(value, "fd1")) machine->biosdisk.bootdrive = 0x01;
+			else if (args_isMatch(value, "hd0")) machine->biosdisk.bootdrive = 0x80;
+			else if (args_isMatch(value, "hd1")) machine->biosdisk.bootdrive = 0x81;
+			else {
+				debug_log(DEBUG_ERROR, "[BATCH] Line %lu: %s is an invalid boot option\r\n", job->line, value);
+				return -1;
+			}
+		}
+		else if (args_isMatch(token, "video")) {
+			if (args_isMatch(value, "vga")) machine->videocard = VIDEO_CARD_VGA;
+			else if (args_isMatch(value, "cga")) machine->videocard = VIDEO_CARD_CGA;
+			else {
+				debug_log(DEBUG_ERROR, "[BATCH] Line %lu: %s is an invalid video option\r\n", job->line, value);
+				return -1;
+			}
+		}
+		else if (args_isMatch(token, "cpu")) {
+			machine->CPU.model = cpu_findModel(value);
+			if (machine->CPU.model == CPU_MODEL_DEFAULT) {
+				debug_log(DEBUG_ERROR, "[BATCH] Line %lu: %s is an invalid CPU model\r\n", job->line, value);
+				return -1;
+			}
+		}
+		else {
+			debug_log(DEBUG_ERROR, "[BATCH] Line %lu: unknown option %s\r\n", job->line, token);
+			return -1;
+		}
+		if ((drive != 0xFF) && biosdisk_insert(&machine->CPU, drive, value)) {
+			return -1;
+		}
+	}
+
+	if (machine_init(machine, job->id) < 0) {
+		return -1;
+	}
+
+	return 0;
+}
+
+#ifdef _WIN32
+unsigned __stdcall batch_worker(void* udata) {
+#else
+void* batch_worker(void* udata) {
+#endif
+	BATCHWORKER_t* worker = (BATCHWORKER_t*)udata;
+	BATCHJOB_t* job;
+	MACHINE_t* machine;
+	uint64_t start, left;
+	uint32_t i;
+
+	for (i = worker->first; i < batch_count; i += worker->stride) {
+		job = &batch_jobs[i];
+		machine = job->machine;
+		machine_select(machine);
+		start = timing_getHostCur();
+		while (running && (machine->CPU.clock < job->limit)) {
+			if (cpu_idle(&machine->CPU)) {
+				timing_idle(job->limit); //an idle guest skips straight to its next timer event
+			}
+			else {
+				left = job->limit - machine->CPU.clock;
+				cpu_exec(&machine->CPU, timing_budget((left < TIMING_BATCH_MAX) ? (uint32_t)left : TIMING_BATCH_MAX));
+			}
+			timing_loop();
+		}
+		job->hosttime = timing_getHostCur() - start;
+		job->done = (machine->CPU.clock >= job->limit) ? 1 : 0;
+	}
+
+#ifdef _WIN32
+	return 0;
+#else
+	return NULL;
+#endif
+}
+
+uint32_t batch_hostThreads() {
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (uint32_t)info.dwNumberOfProcessors;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return (count < 1) ? 1 : (uint32_t)count;
+#endif
+}
+
+int batch_run(char* filename, uint32_t threads) {
+	FILE* file;
+	BATCHJOB_t* temp;
+	BATCHWORKER_t worker[BATCH_MAXTHREADS];
+#ifdef _WIN32
+	HANDLE handle[BATCH_MAXTHREADS];
+#else
+	pthread_t handle[BATCH_MAXTHREADS];
+#endif
+	char line[BATCH_LINELEN], *text;
+	uint32_t lineno = 0, i, failed = 0;
+	int ret;
+
+	file = fopen(filename, "r");
+	if (file == NULL) {
+		debug_log(DEBUG_ERROR, "[BATCH] Unable to open job file %s\r\n", filename);
+		return -1;
+	}
+
+	//machines are all built here on the main thread, before any worker starts
+	while (fgets(line, sizeof(line), file) != NULL) {
+		lineno++;
+		text = (char*)malloc(strlen(line) + 1); //the job keeps pointers into its line
+		temp = (BATCHJOB_t*)realloc(batch_jobs, sizeof(BATCHJOB_t) * ((size_t)batch_count + 1));
+		if ((text == NULL) || (temp == NULL)) {
+			debug_log(DEBUG_ERROR, "[BATCH] Out of memory reading job file\r\n");
+			fclose(file);
+			return -1;
+		}
+		strcpy(text, line);
+		batch_jobs = temp;
+		memset(&batch_jobs[batch_count], 0, sizeof(BATCHJOB_t));
+		batch_jobs[batch_count].line = lineno;
+		ret = batch_create(&batch_jobs[batch_count], text);
+		if (ret < 0) {
+			debug_log(DEBUG_ERROR, "[BATCH] Could not set up the guest on line %lu\r\n", lineno);
+			fclose(file);
+			return -1;
+		}
+		if (ret > 0) {
+			free(text);
+			continue;
+		}
+		batch_count++;
+	}
+	fclose(file);
+
+	if (batch_count == 0) {
+		debug_log(DEBUG_ERROR, "[BATCH] No jobs in %s\r\n", filename);
+		return -1;
+	}
+
+	if (threads == 0) {
+		threads = batch_hostThreads();
+	}
+	if (threads > batch_count) {
+		threads = batch_count;
+	}
+	if (threads > BATCH_MAXTHREADS) {
+		threads = BATCH_MAXTHREADS;
+	}
+
+	debug_log(DEBUG_INFO, "[BATCH] Running %lu guests on %lu worker threads\r\n", batch_count, threads);
+
+	for (i = 0; i < threads; i++) {
+		worker[i].first = i;
+		worker[i].stride = threads;
+#ifdef _WIN32
+		handle[i] = (HANDLE)_beginthreadex(NULL, 0, batch_worker, &worker[i], 0, NULL);
+#else
+		pthread_create(&handle[i], NULL, batch_worker, &worker[i]);
+#endif
+	}
+	for (i = 0; i < threads; i++) {
+#ifdef _WIN32
+		WaitForSingleObject(handle[i], INFINITE);
+		CloseHandle(handle[i]);
+#else
+		pthread_join(handle[i], NULL);
+#endif
+	}
+
+	for (i = 0; i < batch_count; i++) {
+		double seconds;
+		seconds = (double)batch_jobs[i].hosttime / (double)timing_getHostFreq();
+		debug_log(DEBUG_INFO, "[BATCH] Line %lu (%s): %s, %llu instructions in %.02f s (%.02f MIPS)\r\n",
+			batch_jobs[i].line, batch_jobs[i].id, batch_jobs[i].done ? "done" : "stopped",
+			batch_jobs[i].machine->CPU.totalexec, seconds,
+			(seconds > 0) ? (double)batch_jobs[i].machine->CPU.totalexec / seconds / 1000000.0 : 0);
+		if (!batch_jobs[i].done) {
+			failed++;
+		}
+	}
+
+	return failed ? -1 : 0;
+}
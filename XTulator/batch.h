@@ -0,0 +1,30 @@
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+#include <stdint.h>
+#include "machine.h"
+
+#define BATCH_IPS			10000000 //virtual instructions per second each guest runs at
+#define BATCH_MAXTHREADS	64
+#define BATCH_LINELEN		1024
+
+typedef struct {
+	MACHINE_t* machine;
+	char* id;
+	uint64_t limit; //guest instructions to run before the job is done
+	uint64_t hosttime; //host clock ticks it took
+	uint32_t line;
+	uint8_t done;
+} BATCHJOB_t;
+
+typedef struct {
+	uint32_t first;
+	uint32_t stride;
+} BATCHWORKER_t;
+
+int batch_run(char* filename, uint32_t threads);
+
+extern char* batch_file;
+extern uint32_t batch_threads;
+
+#endif
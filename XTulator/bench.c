@@ -0,0 +1,454 @@
+/*
+  XTulator: A portable, open-source 80186 PC emulator.
+  Copyright (C)2020 Mike Chambers
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+	Throughput benchmark
+
+	Runs a fixed set of small guest workloads, each on a fresh headless machine for the
+	same number of guest instructions, and writes the results out as JSON. The guest
+	clock is the instruction count (see timing_setInstructionClock) so every run does
+	exactly the same guest work, only the host time changes between builds. That makes
+	the numbers comparable across commits on the same host.
+
+	Frames are rendered and audio samples are mixed the same as an interactive session
+	would do, just without anything to show or play them on, so that cost is measured too.
+
+	The workloads are raw .COM style images loaded at BENCH_SEGMENT:0100 with the CPU
+	started right there, the BIOS ROM is mapped but never runs. Interrupts stay off.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "config.h"
+#include "bench.h"
+#include "batch.h"
+#include "machine.h"
+#include "timing.h"
+#include "debuglog.h"
+#include "cpu/cpu.h"
+#include "modules/audio/sdlaudio.h"
+#include "modules/disk/biosdisk.h"
+#include "modules/video/cga.h"
+#include "modules/video/vga.h"
+
+char* bench_file = NULL;
+uint64_t bench_count = BENCH_DEFAULT_COUNT;
+
+uint64_t bench_samples;
+volatile int32_t bench_sink; //keeps the mixed samples from being thrown away
+
+//ALU loop: adds, logic, memory load/store, a call, MUL and DIV. A rough stand-in for Dhrystone.
+const uint8_t bench_alu[] = {
+	0xFA, //cli
+	0xBE, 0x00, 0x04, //mov si,0x0400
+	0x31, 0xC0, //xor ax,ax
+	0xBB, 0x34, 0x12, //mov bx,0x1234
+	//top:
+	0x40, //inc ax
+	0x01, 0xC3, //add bx,ax
+	0x89, 0xD9, //mov cx,bx
+	0x81, 0xE1, 0xFF, 0x00, //and cx,0x00FF
+	0x89, 0x1C, //mov [si],bx
+	0x33, 0x1C, //xor bx,[si]
+	0x01, 0xCB, //add bx,cx
+	0xE8, 0x09, 0x00, //call sub1
+	0x3D, 0x00, 0x40, //cmp ax,0x4000
+	0x72, 0xE9, //jb top
+	0x31, 0xC0, //xor ax,ax
+	0xEB, 0xE5, //jmp top
+	//sub1:
+	0x50, //push ax
+	0x31, 0xD2, //xor dx,dx
+	0xBF, 0x07, 0x00, //mov di,7
+	0xF7, 0xE7, //mul di
+	0xF7, 0xF7, //div di
+	0x89, 0x44, 0x02, //mov [si+2],ax
+	0x58, //pop ax
+	0xC3, //ret
+};
+
+//Block memory copy: REP MOVSW of 32 KB between two segments, over and over
+const uint8_t bench_movs[] = {
+	0xFA, //cli
+	0xFC, //cld
+	0x8C, 0xC8, //mov ax,cs
+	0x05, 0x00, 0x10, //add ax,0x1000
+	0x8E, 0xC0, //mov es,ax
+	//top:
+	0x31, 0xF6, //xor si,si
+	0x31, 0xFF, //xor di,di
+	0xB9, 0x00, 0x40, //mov cx,0x4000
+	0xF3, 0xA5, //rep movsw
+	0xEB, 0xF5, //jmp top
+};
+
+//VGA mode 13h set up by hand through the ports, then the whole screen filled with REP STOSW
+const uint8_t bench_mode13h[] = {
+	0xFA, //cli
+	0xFC, //cld
+	0xBA, 0xC2, 0x03, //mov dx,0x3C2
+	0xB0, 0x63, //mov al,0x63
+	0xEE, //out dx,al
+	0xBA, 0xC4, 0x03, //mov dx,0x3C4
+	0xBE, 0x80, 0x01, //mov si,seqtab
+	0xB9, 0x05, 0x00, //mov cx,5
+	0xE8, 0x60, 0x00, //call outregs
+	0xBA, 0xD4, 0x03, //mov dx,0x3D4
+	0xB8, 0x11, 0x0E, //mov ax,0x0E11
+	0xEF, //out dx,ax
+	0xBE, 0x85, 0x01, //mov si,crtctab
+	0xB9, 0x19, 0x00, //mov cx,25
+	0xE8, 0x50, 0x00, //call outregs
+	0xBA, 0xCE, 0x03, //mov dx,0x3CE
+	0xBE, 0x9E, 0x01, //mov si,gfxtab
+	0xB9, 0x09, 0x00, //mov cx,9
+	0xE8, 0x44, 0x00, //call outregs
+	0xBA, 0xDA, 0x03, //mov dx,0x3DA
+	0xEC, //in al,dx
+	0xBA, 0xC0, 0x03, //mov dx,0x3C0
+	0xBE, 0xA7, 0x01, //mov si,attrtab
+	0x31, 0xDB, //xor bx,bx
+	0xB9, 0x15, 0x00, //mov cx,21
+	//attr:
+	0x88, 0xD8, //mov al,bl
+	0xEE, //out dx,al
+	0xAC, //lodsb
+	0xEE, //out dx,al
+	0x43, //inc bx
+	0xE2, 0xF8, //loop attr
+	0xB0, 0x20, //mov al,0x20
+	0xEE, //out dx,al
+	0xBA, 0xC8, 0x03, //mov dx,0x3C8
+	0x30, 0xC0, //xor al,al
+	0xEE, //out dx,al
+	0x42, //inc dx
+	0x31, 0xDB, //xor bx,bx
+	//pal:
+	0x88, 0xD8, //mov al,bl
+	0xD0, 0xE8, //shr al,1
+	0xD0, 0xE8, //shr al,1
+	0xEE, //out dx,al
+	0xEE, //out dx,al
+	0xEE, //out dx,al
+	0xFE, 0xC3, //inc bl
+	0x75, 0xF3, //jnz pal
+	0xB8, 0x00, 0xA0, //mov ax,0xA000
+	0x8E, 0xC0, //mov es,ax
+	0x30, 0xC0, //xor al,al
+	//fill:
+	0x31, 0xFF, //xor di,di
+	0xB9, 0x00, 0x7D, //mov cx,32000
+	0x88, 0xC4, //mov ah,al
+	0xF3, 0xAB, //rep stosw
+	0xFE, 0xC0, //inc al
+	0xEB, 0xF3, //jmp fill
+	//outregs:
+	0x31, 0xDB, //xor bx,bx
+	//outregs_next:
+	0x88, 0xD8, //mov al,bl
+	0x8A, 0x24, //mov ah,[si]
+	0xEF, //out dx,ax
+	0x46, //inc si
+	0x43, //inc bx
+	0xE2, 0xF7, //loop outregs_next
+	0xC3, //ret
+	//seqtab:
+	0x03, 0x01, 0x0F, 0x00, 0x0E,
+	//crtctab:
+	0x5F, 0x4F, 0x50, 0x82, 0x54, 0x80, 0xBF, 0x1F, 0x00, 0x41, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x9C, 0x0E, 0x8F, 0x28, 0x40, 0x96, 0xB9, 0xA3, 0xFF,
+	//gfxtab:
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x05, 0x0F, 0xFF,
+	//attrtab:
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F,
+	0x41, 0x00, 0x0F, 0x00, 0x00,
+};
+
+//CGA 80x25 text, scrolls the screen up a line with REP MOVSW and fills in the bottom line
+const uint8_t bench_scroll[] = {
+	0xFA, //cli
+	0xFC, //cld
+	0xBA, 0xD4, 0x03, //mov dx,0x3D4
+	0xBE, 0x3D, 0x01, //mov si,crtctab
+	0xB9, 0x10, 0x00, //mov cx,16
+	0xE8, 0x23, 0x00, //call outregs
+	0xBA, 0xD8, 0x03, //mov dx,0x3D8
+	0xB0, 0x09, //mov al,0x09
+	0xEE, //out dx,al
+	0xB8, 0x00, 0xB8, //mov ax,0xB800
+	0x8E, 0xD8, //mov ds,ax
+	0x8E, 0xC0, //mov es,ax
+	0xB8, 0x41, 0x07, //mov ax,0x0741
+	//scroll:
+	0xBE, 0xA0, 0x00, //mov si,160
+	0x31, 0xFF, //xor di,di
+	0xB9, 0x80, 0x07, //mov cx,1920
+	0xF3, 0xA5, //rep movsw
+	0xB9, 0x50, 0x00, //mov cx,80
+	0xF3, 0xAB, //rep stosw
+	0xFE, 0xC0, //inc al
+	0xEB, 0xED, //jmp scroll
+	//outregs:
+	0x31, 0xDB, //xor bx,bx
+	//outregs_next:
+	0x88, 0xD8, //mov al,bl
+	0x8A, 0x24, //mov ah,[si]
+	0xEF, //out dx,ax
+	0x46, //inc si
+	0x43, //inc bx
+	0xE2, 0xF7, //loop outregs_next
+	0xC3, //ret
+	//crtctab:
+	0x71, 0x50, 0x5A, 0x0A, 0x1F, 0x06, 0x19, 0x1C, 0x02, 0x07, 0x06, 0x07, 0x00, 0x00, 0x00, 0x00,
+};
+
+//OPL2 music: programs a voice on channel 0 and keeps keying notes on and off
+const uint8_t bench_opl[] = {
+	0xFA, //cli
+	0xFC, //cld
+	0xBA, 0x88, 0x03, //mov dx,0x388
+	0xBE, 0x3E, 0x01, //mov si,opltab
+	0xB9, 0x0A, 0x00, //mov cx,10
+	//init:
+	0xAD, //lodsw
+	0xE8, 0x22, 0x00, //call oplw
+	0xE2, 0xFA, //loop init
+	0x31, 0xDB, //xor bx,bx
+	//note:
+	0xB0, 0xA0, //mov al,0xA0
+	0x88, 0xDC, //mov ah,bl
+	0xE8, 0x17, 0x00, //call oplw
+	0xB8, 0xB0, 0x31, //mov ax,0x31B0
+	0xE8, 0x11, 0x00, //call oplw
+	0xE8, 0x15, 0x00, //call delay
+	0xB8, 0xB0, 0x11, //mov ax,0x11B0
+	0xE8, 0x08, 0x00, //call oplw
+	0xE8, 0x0C, 0x00, //call delay
+	0x80, 0xC3, 0x07, //add bl,7
+	0xEB, 0xE2, //jmp note
+	//oplw:
+	0xEE, //out dx,al
+	0x42, //inc dx
+	0x86, 0xC4, //xchg al,ah
+	0xEE, //out dx,al
+	0x4A, //dec dx
+	0xC3, //ret
+	//delay:
+	0xB9, 0x88, 0x13, //mov cx,5000
+	//delay_next:
+	0xE2, 0xFE, //loop delay_next
+	0xC3, //ret
+	//opltab:
+	0x01, 0x20, 0x20, 0x01, 0x40, 0x10, 0x60, 0xF0, 0x80, 0x77, 0x23, 0x01, 0x43, 0x00, 0x63, 0xF0, 0x83, 0x77, 0xC0, 0x00,
+};
+
+//Disk read: INT 13h reads of 16 sectors from the scratch hard disk, then a checksum of what was read
+const uint8_t bench_disk[] = {
+	0xFA, //cli
+	0xFC, //cld
+	//top:
+	0xB8, 0x10, 0x02, //mov ax,0x0210
+	0xBB, 0x00, 0x10, //mov bx,0x1000
+	0xB9, 0x01, 0x00, //mov cx,0x0001
+	0xBA, 0x80, 0x00, //mov dx,0x0080
+	0xCD, 0x13, //int 0x13
+	0xBE, 0x00, 0x10, //mov si,0x1000
+	0xB9, 0x00, 0x10, //mov cx,4096
+	0x31, 0xD2, //xor dx,dx
+	//sum:
+	0xAD, //lodsw
+	0x01, 0xC2, //add dx,ax
+	0xE2, 0xFB, //loop sum
+	0xEB, 0xE3, //jmp top
+};
+
+const BENCHLOAD_t bench_loads[] = {
+	{ "alu", bench_alu, sizeof(bench_alu), 0xFF, 0 },
+	{ "movs", bench_movs, sizeof(bench_movs), 0xFF, 0 },
+	{ "mode13h", bench_mode13h, sizeof(bench_mode13h), VIDEO_CARD_VGA, 0 },
+	{ "textscroll", bench_scroll, sizeof(bench_scroll), VIDEO_CARD_CGA, 0 },
+	{ "opl", bench_opl, sizeof(bench_opl), 0xFF, 0 },
+	{ "disk", bench_disk, sizeof(bench_disk), 0xFF, 1 },
+	{ NULL, NULL, 0, 0, 0 }
+};
+
+void bench_sample(MACHINE_t* machine) {
+	bench_sink += sdlaudio_mixSample(machine);
+	bench_samples++;
+}
+
+//fills a scratch hard disk image, every sector tagged with its own number
+FILE* bench_makeDisk() {
+	FILE* disk;
+	uint8_t sector[512];
+	uint32_t i;
+
+	disk = tmpfile(); //deleted by itself once it's closed
+	if (disk == NULL) {
+		return NULL;
+	}
+	for (i = 0; i < BENCH_DISK_SECTORS; i++) {
+		memset(sector, (uint8_t)i, sizeof(sector));
+		if (fwrite(sector, 1, sizeof(sector), disk) < sizeof(sector)) {
+			fclose(disk);
+			return NULL;
+		}
+	}
+	return disk;
+}
+
+int bench_workload(char* machineid, uint8_t cpumodel, const BENCHLOAD_t* load, uint64_t count, BENCHRESULT_t* result) {
+	MACHINE_t* machine;
+	FILE* disk;
+	CPU_t* cpu;
+	uint32_t i, base;
+	uint64_t start;
+
+	machine = (MACHINE_t*)calloc(1, sizeof(MACHINE_t));
+	if (machine == NULL) {
+		debug_log(DEBUG_ERROR, "[BENCH] Unable to allocate machine\r\n");
+		return -1;
+	}
+	machine->pcap_if = -1;
+	machine->headless = 1;
+	machine->hwflags = MACHINE_HW_SKIP_UART0 | MACHINE_HW_SKIP_UART1;
+	machine_setup(machine);
+	machine->CPU.model = cpumodel;
+	if (load->videocard != 0xFF) {
+		machine->videocard = load->videocard;
+	}
+	timing_setInstructionClock(&machine->CPU.clock);
+	timing_setInstructionRate(BATCH_IPS);
+	if (machine_init(machine, machineid) < 0) {
+		return -1;
+	}
+	cpu = &machine->CPU;
+	result->cpumodel = cpu->model;
+
+	if (load->disk) {
+		disk = bench_makeDisk();
+		if (disk == NULL) {
+			debug_log(DEBUG_ERROR, "[BENCH] Unable to create scratch disk image\r\n");
+			return -1;
+		}
+		biosdisk_insertFile(cpu, 2, disk);
+	}
+
+	base = ((uint32_t)BENCH_SEGMENT << 4) + 0x100;
+	for (i = 0; i < load->len; i++) {
+		cpu_write(cpu, base + i, load->code[i]);
+	}
+	cpu->segregs[regcs] = BENCH_SEGMENT;
+	cpu->segregs[regds] = BENCH_SEGMENT;
+	cpu->segregs[reges] = BENCH_SEGMENT;
+	cpu->segregs[regss] = BENCH_SEGMENT;
+	cpu->regs.wordregs[regsp] = 0xFFFE;
+	cpu->ip = 0x100;
+
+	timing_addTimer(bench_sample, machine, SAMPLE_RATE, TIMING_ENABLED);
+	bench_samples = 0;
+	result->frames = 0;
+
+	start = timing_getHostCur();
+	while (cpu->clock < count) {
+		cpu_exec(cpu, timing_budget(TIMING_BATCH_MAX));
+		timing_loop();
+		//no render threads on a headless machine, so draw right here whenever a frame is due
+		if ((machine->videocard == VIDEO_CARD_VGA) && machine->vga.doBlit) {
+			vga_update(&machine->vga, 0, 0, machine->vga.w - 1, machine->vga.h - 1);
+			machine->vga.doRender = 0;
+			machine->vga.doBlit = 0;
+			result->frames++;
+		}
+		else if ((machine->videocard == VIDEO_CARD_CGA) && machine->cga.doDraw) {
+			cga_update(&machine->cga, 0, 0, 639, 399);
+			machine->cga.doDraw = 0;
+			result->frames++;
+		}
+	}
+	result->hosttime = timing_getHostCur() - start;
+	result->instructions = cpu->totalexec;
+	result->samples = bench_samples;
+
+	if (load->disk) {
+		biosdisk_eject(cpu, 2);
+	}
+
+	return 0;
+}
+
+int bench_run(char* machineid, uint8_t cpumodel, char* filename, uint64_t count) {
+	FILE* out;
+	BENCHRESULT_t result[sizeof(bench_loads) / sizeof(BENCHLOAD_t)];
+	double seconds, mips, logsum = 0;
+	int i, num;
+
+	for (num = 0; bench_loads[num].name != NULL; num++) {
+		debug_log(DEBUG_INFO, "[BENCH] Running workload \"%s\" for %llu instructions\r\n", bench_loads[num].name, count);
+		if (bench_workload(machineid, cpumodel, &bench_loads[num], count, &result[num])) {
+			debug_log(DEBUG_ERROR, "[BENCH] Workload \"%s\" failed to start\r\n", bench_loads[num].name);
+			return -1;
+		}
+	}
+
+	out = fopen(filename, "w");
+	if (out == NULL) {
+		debug_log(DEBUG_ERROR, "[BENCH] Unable to open %s for writing\r\n", filename);
+		return -1;
+	}
+
+	fprintf(out, "{\n");
+	fprintf(out, "\t\"version\": \"%s\",\n", STR_VERSION);
+	fprintf(out, "\t\"machine\": \"%s\",\n", machineid);
+	fprintf(out, "\t\"cpu\": \"%s\",\n", cpu_modelName(result[0].cpumodel));
+	fprintf(out, "\t\"instructions\": %llu,\n", (unsigned long long)count);
+	fprintf(out, "\t\"guest_ips\": %u,\n", (uint32_t)BATCH_IPS);
+	fprintf(out, "\t\"workloads\": [\n");
+	for (i = 0; i < num; i++) {
+		seconds = (double)result[i].hosttime / (double)timing_getHostFreq();
+		if (seconds <= 0) {
+			seconds = 1.0 / (double)timing_getHostFreq();
+		}
+		mips = (double)result[i].instructions / seconds / 1000000.0;
+		logsum += log(mips);
+		fprintf(out, "\t\t{\n");
+		fprintf(out, "\t\t\t\"name\": \"%s\",\n", bench_loads[i].name);
+		fprintf(out, "\t\t\t\"instructions\": %llu,\n", (unsigned long long)result[i].instructions);
+		fprintf(out, "\t\t\t\"seconds\": %.6f,\n", seconds);
+		fprintf(out, "\t\t\t\"mips\": %.3f,\n", mips);
+		fprintf(out, "\t\t\t\"ns_per_instruction\": %.3f,\n", seconds * 1000000000.0 / (double)result[i].instructions);
+		fprintf(out, "\t\t\t\"frames\": %llu,\n", (unsigned long long)result[i].frames);
+		fprintf(out, "\t\t\t\"frames_per_second\": %.3f,\n", (double)result[i].frames / seconds);
+		fprintf(out, "\t\t\t\"samples\": %llu,\n", (unsigned long long)result[i].samples);
+		fprintf(out, "\t\t\t\"samples_per_second\": %.1f\n", (double)result[i].samples / seconds);
+		fprintf(out, "\t\t}%s\n", (i < (num - 1)) ? "," : "");
+		debug_log(DEBUG_INFO, "[BENCH] %-10s %8.2f MIPS %8.2f ns/instruction %8.1f frames/s %10.0f samples/s\r\n",
+			bench_loads[i].name, mips, seconds * 1000000000.0 / (double)result[i].instructions,
+			(double)result[i].frames / seconds, (double)result[i].samples / seconds);
+	}
+	fprintf(out, "\t],\n");
+	fprintf(out, "\t\"geomean_mips\": %.3f\n", exp(logsum / (double)num));
+	fprintf(out, "}\n");
+	fclose(out);
+
+	return 0;
+}
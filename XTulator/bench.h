@@ -0,0 +1,32 @@
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <stdint.h>
+#include "machine.h"
+
+#define BENCH_DEFAULT_COUNT	50000000 //guest instructions each workload runs for
+#define BENCH_SEGMENT		0x1000 //where workloads are loaded, .COM style at offset 0x100
+#define BENCH_DISK_SECTORS	(63 * 16) //one cylinder of scratch hard disk for the disk workload
+
+typedef struct {
+	char* name;
+	const uint8_t* code;
+	uint16_t len;
+	uint8_t videocard; //0xFF to use the machine's default
+	uint8_t disk; //1 = wants a scratch hard disk as drive 0x80
+} BENCHLOAD_t;
+
+typedef struct {
+	uint64_t instructions;
+	uint64_t hosttime;
+	uint64_t frames;
+	uint64_t samples;
+	uint8_t cpumodel; //what the machine actually ended up with
+} BENCHRESULT_t;
+
+int bench_run(char* machineid, uint8_t cpumodel, char* filename, uint64_t count);
+
+extern char* bench_file;
+extern uint64_t bench_count;
+
+#endif
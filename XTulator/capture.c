@@ -0,0 +1,508 @@
+/*
+  XTulator: A portable, open-source 80186 PC emulator.
+  Copyright (C)2020 Mike Chambers
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+	Video and audio capture
+
+	Records the session to <name>.avi and <name>.wav, which any player or ffmpeg can take
+	straight away. Both run on the guest clock: a timer samples the latest rendered frame
+	CAPTURE_FPS times a second and another mixes audio at SAMPLE_RATE, so the two files
+	line up no matter how fast the emulator is running.
+
+	Nothing gets encoded or written on the emulation thread. The render thread centers each
+	frame on a CAPTURE_W x CAPTURE_H canvas and compares it with the one before, and only
+	a frame that actually changed is handed over, by swapping buffer pointers. When the
+	frame timer finds nothing new it bumps the repeat count of the last queued frame instead,
+	so a static DOS screen costs one compare per rendered frame and one converted frame on
+	the writer side, however long it sits there. If the writer thread falls behind and the
+	queue is full, new frames are dropped (counted, and the previous one repeated so the
+	timing holds).
+
+	The video is uncompressed I420 in a plain AVI. A repeat goes in as an empty chunk, which
+	players and ffmpeg take as "show the last frame again", so on disk it's 8 bytes for the
+	chunk and 16 for its index entry instead of a whole frame. AVI 1.0 keeps sizes in 32 bits,
+	so once the file gets near CAPTURE_AVI_LIMIT every frame after that is written as a repeat.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <Windows.h>
+#include <process.h>
+#include <SDL/SDL.h>
+#else
+#include <pthread.h>
+#include <SDL.h>
+#endif
+#include "config.h"
+#include "capture.h"
+#include "machine.h"
+#include "timing.h"
+#include "utility.h"
+#include "debuglog.h"
+#include "modules/audio/sdlaudio.h"
+
+#ifdef _WIN32
+#define CAPTURE_BARRIER()	MemoryBarrier()
+#else
+#define CAPTURE_BARRIER()	__sync_synchronize()
+#endif
+
+#define CAPTURE_PIXELS		(CAPTURE_W * CAPTURE_H)
+#define CAPTURE_FRAMEBYTES	(CAPTURE_PIXELS * 3 / 2) //I420, full res Y then quarter res U and V
+#define CAPTURE_AVIHEADER	224 //RIFF, hdrl and the start of movi
+
+char* capture_file = NULL;
+volatile uint8_t capture_active = 0;
+
+MACHINE_t* capture_machine = NULL;
+FILE *capture_video = NULL, *capture_audio = NULL;
+SDL_mutex* capture_mutex = NULL;
+volatile uint8_t capture_stop = 0;
+#ifdef _WIN32
+HANDLE capture_thread;
+#else
+pthread_t capture_thread;
+#endif
+
+//render thread only
+uint32_t *capture_back = NULL, *capture_prev = NULL;
+
+//guarded by capture_mutex
+uint32_t* capture_latest = NULL; //newest frame that changed, not queued yet
+uint8_t capture_fresh = 0;
+uint32_t* capture_free[CAPTURE_QUEUE];
+uint32_t capture_freecount = 0;
+CAPTUREFRAME_t capture_queue[CAPTURE_QUEUE];
+uint32_t capture_queuehead = 0, capture_queuecount = 0;
+uint32_t capture_pending = 0; //repeats of the frame the writer already has
+
+//audio, written by the emulation thread and read by the writer
+int16_t capture_samples[CAPTURE_AUDIORING];
+volatile uint32_t capture_audiohead = 0, capture_audiotail = 0;
+
+//writer thread only
+uint8_t* capture_yuv = NULL;
+uint32_t capture_audiobytes = 0;
+uint32_t* capture_index = NULL; //offset and size of every chunk in movi, for idx1
+uint32_t capture_indexsize = 0;
+uint32_t capture_movibytes = 4; //the movi fourcc, then the chunks
+uint8_t capture_full = 0;
+
+uint64_t capture_frames = 0, capture_repeats = 0, capture_dropped = 0, capture_audiodropped = 0;
+
+void capture_blit(uint32_t* pixels, int w, int h, int stride) {
+	uint32_t *src, *dst, *temp;
+	int x0, y0, y, sx, cw, ch;
+
+	if (!capture_active) return;
+
+	//center the frame on the canvas, clipping anything too big
+	cw = (w > CAPTURE_W) ? CAPTURE_W : w;
+	ch = (h > CAPTURE_H) ? CAPTURE_H : h;
+	x0 = (CAPTURE_W - cw) / 2;
+	y0 = (CAPTURE_H - ch) / 2;
+	sx = (w - cw) / 2;
+	for (y = 0; y < CAPTURE_H; y++) {
+		dst = capture_back + y * CAPTURE_W;
+		if ((y < y0) || (y >= (y0 + ch))) {
+			memset(dst, 0, CAPTURE_W * 4);
+			continue;
+		}
+		src = (uint32_t*)((uint8_t*)pixels + (size_t)(y - y0 + (h - ch) / 2) * stride) + sx;
+		memset(dst, 0, (size_t)x0 * 4);
+		memcpy(dst + x0, src, (size_t)cw * 4);
+		memset(dst + x0 + cw, 0, (size_t)(CAPTURE_W - x0 - cw) * 4);
+	}
+
+	if (memcmp(capture_back, capture_prev, CAPTURE_PIXELS * 4) == 0) {
+		return;
+	}
+	memcpy(capture_prev, capture_back, CAPTURE_PIXELS * 4);
+
+	SDL_LockMutex(capture_mutex);
+	temp = capture_latest;
+	capture_latest = capture_back;
+	capture_back = temp;
+	capture_fresh = 1;
+	SDL_UnlockMutex(capture_mutex);
+}
+
+//emulation thread, CAPTURE_FPS times a second of guest time
+void capture_frameTick(void* dummy) {
+	CAPTUREFRAME_t* frame;
+	uint32_t* temp;
+
+	SDL_LockMutex(capture_mutex);
+	if (capture_fresh && (capture_freecount > 0)) {
+		temp = capture_free[--capture_freecount];
+		frame = &capture_queue[(capture_queuehead + capture_queuecount++) % CAPTURE_QUEUE];
+		frame->pixels = capture_latest;
+		frame->count = 1;
+		capture_latest = temp;
+		capture_fresh = 0;
+	}
+	else {
+		if (capture_fresh) { //the writer is behind, this one will have to wait for the next tick
+			capture_dropped++;
+		}
+		if (capture_queuecount > 0) {
+			capture_queue[(capture_queuehead + capture_queuecount - 1) % CAPTURE_QUEUE].count++;
+		}
+		else {
+			capture_pending++;
+		}
+	}
+	SDL_UnlockMutex(capture_mutex);
+}
+
+//emulation thread, SAMPLE_RATE times a second of guest time
+void capture_sampleTick(void* dummy) {
+	int16_t val;
+
+	val = sdlaudio_mixSample(capture_machine);
+	sdlaudio_playSample(val);
+	if ((capture_audiohead - capture_audiotail) == CAPTURE_AUDIORING) {
+		capture_audiodropped++;
+		return;
+	}
+	capture_samples[capture_audiohead & (CAPTURE_AUDIORING - 1)] = val;
+	CAPTURE_BARRIER();
+	capture_audiohead++;
+}
+
+void capture_toYUV(uint32_t* pixels) {
+	uint8_t *py, *pu, *pv;
+	uint32_t x, y, p, i, r, g, b, rsum, gsum, bsum;
+
+	py = capture_yuv;
+	pu = capture_yuv + CAPTURE_PIXELS;
+	pv = pu + CAPTURE_PIXELS / 4;
+	for (y = 0; y < CAPTURE_H; y += 2) {
+		for (x = 0; x < CAPTURE_W; x += 2) {
+			rsum = gsum = bsum = 0;
+			for (i = 0; i < 4; i++) {
+				p = pixels[(y + (i >> 1)) * CAPTURE_W + x + (i & 1)];
+				r = (p >> 16) & 0xFF;
+				g = (p >> 8) & 0xFF;
+				b = p & 0xFF;
+				py[(y + (i >> 1)) * CAPTURE_W + x + (i & 1)] = (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+				rsum += r;
+				gsum += g;
+				bsum += b;
+			}
+			r = rsum >> 2;
+			g = gsum >> 2;
+			b = bsum >> 2;
+			*pu++ = (uint8_t)(((int32_t)(-38 * (int32_t)r - 74 * (int32_t)g + 112 * (int32_t)b + 128) >> 8) + 128);
+			*pv++ = (uint8_t)(((int32_t)(112 * (int32_t)r - 94 * (int32_t)g - 18 * (int32_t)b + 128) >> 8) + 128);
+		}
+	}
+}
+
+void capture_putWord(uint8_t* buf, uint32_t value, uint8_t len) {
+	while (len--) {
+		*buf++ = (uint8_t)value;
+		value >>= 8;
+	}
+}
+
+//a 00dc chunk of len bytes from data, an empty one just repeats the frame before it
+void capture_writeChunk(uint8_t* data, uint32_t len) {
+	uint8_t hdr[8];
+	uint32_t* temp;
+
+	if ((uint32_t)capture_frames == capture_indexsize) {
+		capture_indexsize = capture_indexsize ? capture_indexsize * 2 : 4096;
+		temp = (uint32_t*)realloc(capture_index, (size_t)capture_indexsize * 2 * sizeof(uint32_t));
+		if (temp == NULL) {
+			debug_log(DEBUG_ERROR, "[CAPTURE] Out of memory for the AVI index, stopping the video\r\n");
+			capture_full = 2;
+			return;
+		}
+		capture_index = temp;
+	}
+	memcpy(hdr, "00dc", 4);
+	capture_putWord(hdr + 4, len, 4);
+	fwrite(hdr, 1, 8, capture_video);
+	if (len > 0) {
+		fwrite(data, 1, len, capture_video);
+	}
+	capture_index[capture_frames * 2] = capture_movibytes;
+	capture_index[capture_frames * 2 + 1] = len;
+	capture_movibytes += 8 + len;
+	capture_frames++;
+}
+
+//the frame in capture_yuv once, then count - 1 repeats of it. A count of 0 only repeats the last one
+void capture_writeFrame(uint32_t count, uint8_t changed) {
+	if (capture_full == 2) return;
+	if (changed || (capture_frames == 0)) { //the very first chunk has to be a picture, even if it's the black one
+		if ((capture_movibytes + 8 + CAPTURE_FRAMEBYTES) > CAPTURE_AVI_LIMIT) {
+			if (!capture_full) {
+				debug_log(DEBUG_INFO, "[CAPTURE] The AVI is full, the picture stays as it is from here on\r\n");
+				capture_full = 1;
+			}
+		}
+		else {
+			capture_writeChunk(capture_yuv, CAPTURE_FRAMEBYTES);
+			if (count > 0) count--;
+		}
+	}
+	while (count-- && (capture_full < 2)) {
+		capture_writeChunk(NULL, 0);
+	}
+}
+
+//returns 1 if there was anything to write
+uint8_t capture_writeAudio() {
+	uint32_t head, tail, len;
+
+	head = capture_audiohead;
+	CAPTURE_BARRIER();
+	tail = capture_audiotail;
+	if (head == tail) return 0;
+	while (tail != head) {
+		len = CAPTURE_AUDIORING - (tail & (CAPTURE_AUDIORING - 1));
+		if (len > (head - tail)) len = head - tail;
+		fwrite(&capture_samples[tail & (CAPTURE_AUDIORING - 1)], 2, len, capture_audio); //WAV is little endian, like every host this runs on
+		capture_audiobytes += len * 2;
+		tail += len;
+	}
+	CAPTURE_BARRIER();
+	capture_audiotail = tail;
+	return 1;
+}
+
+//sizes and counts are filled in by capture_close
+void capture_aviHeader() {
+	uint8_t hdr[CAPTURE_AVIHEADER];
+
+	memset(hdr, 0, sizeof(hdr));
+	memcpy(hdr, "RIFF", 4);
+	capture_putWord(hdr + 4, CAPTURE_AVIHEADER - 12 + capture_movibytes + 8 + (uint32_t)capture_frames * 16, 4);
+	memcpy(hdr + 8, "AVI LIST", 8);
+	capture_putWord(hdr + 16, 192, 4);
+	memcpy(hdr + 20, "hdrlavih", 8);
+	capture_putWord(hdr + 28, 56, 4);
+	capture_putWord(hdr + 32, 1000000 / CAPTURE_FPS, 4);
+	capture_putWord(hdr + 36, CAPTURE_FRAMEBYTES * CAPTURE_FPS, 4);
+	capture_putWord(hdr + 44, 0x10, 4); //AVIF_HASINDEX
+	capture_putWord(hdr + 48, (uint32_t)capture_frames, 4);
+	capture_putWord(hdr + 56, 1, 4); //streams
+	capture_putWord(hdr + 60, CAPTURE_FRAMEBYTES + 8, 4);
+	capture_putWord(hdr + 64, CAPTURE_W, 4);
+	capture_putWord(hdr + 68, CAPTURE_H, 4);
+	memcpy(hdr + 88, "LIST", 4);
+	capture_putWord(hdr + 92, 116, 4);
+	memcpy(hdr + 96, "strlstrh", 8);
+	capture_putWord(hdr + 104, 56, 4);
+	memcpy(hdr + 108, "vidsI420", 8);
+	capture_putWord(hdr + 128, 1, 4); //scale
+	capture_putWord(hdr + 132, CAPTURE_FPS, 4); //rate
+	capture_putWord(hdr + 140, (uint32_t)capture_frames, 4);
+	capture_putWord(hdr + 144, CAPTURE_FRAMEBYTES + 8, 4);
+	capture_putWord(hdr + 148, 0xFFFFFFFF, 4); //quality, default
+	capture_putWord(hdr + 160, CAPTURE_W, 2);
+	capture_putWord(hdr + 162, CAPTURE_H, 2);
+	memcpy(hdr + 164, "strf", 4);
+	capture_putWord(hdr + 168, 40, 4);
+	capture_putWord(hdr + 172, 40, 4);
+	capture_putWord(hdr + 176, CAPTURE_W, 4);
+	capture_putWord(hdr + 180, CAPTURE_H, 4);
+	capture_putWord(hdr + 184, 1, 2); //planes
+	capture_putWord(hdr + 186, 12, 2); //bits per pixel
+	memcpy(hdr + 188, "I420", 4);
+	capture_putWord(hdr + 192, CAPTURE_FRAMEBYTES, 4);
+	memcpy(hdr + 212, "LIST", 4);
+	capture_putWord(hdr + 216, capture_movibytes, 4);
+	memcpy(hdr + 220, "movi", 4);
+	fseek(capture_video, 0, SEEK_SET);
+	fwrite(hdr, 1, sizeof(hdr), capture_video);
+	fseek(capture_video, 0, SEEK_END);
+}
+
+//idx1 goes after movi, only once nothing else is going to be written
+void capture_aviIndex() {
+	uint8_t entry[16];
+	uint32_t i;
+
+	memcpy(entry, "idx1", 4);
+	capture_putWord(entry + 4, (uint32_t)capture_frames * 16, 4);
+	fwrite(entry, 1, 8, capture_video);
+	memcpy(entry, "00dc", 4);
+	for (i = 0; i < (uint32_t)capture_frames; i++) {
+		capture_putWord(entry + 4, capture_index[i * 2 + 1] ? 0x10 : 0, 4); //AVIIF_KEYFRAME, every picture is one
+		capture_putWord(entry + 8, capture_index[i * 2], 4);
+		capture_putWord(entry + 12, capture_index[i * 2 + 1], 4);
+		fwrite(entry, 1, 16, capture_video);
+	}
+}
+
+void capture_wavHeader() {
+	uint8_t hdr[44];
+
+	memcpy(hdr, "RIFF", 4);
+	capture_putWord(hdr + 4, 36 + capture_audiobytes, 4);
+	memcpy(hdr + 8, "WAVEfmt ", 8);
+	capture_putWord(hdr + 16, 16, 4);
+	capture_putWord(hdr + 20, 1, 2); //PCM
+	capture_putWord(hdr + 22, 1, 2); //mono
+	capture_putWord(hdr + 24, SAMPLE_RATE, 4);
+	capture_putWord(hdr + 28, SAMPLE_RATE * 2, 4);
+	capture_putWord(hdr + 32, 2, 2);
+	capture_putWord(hdr + 34, 16, 2);
+	memcpy(hdr + 36, "data", 4);
+	capture_putWord(hdr + 40, capture_audiobytes, 4);
+	fseek(capture_audio, 0, SEEK_SET);
+	fwrite(hdr, 1, 44, capture_audio);
+	fseek(capture_audio, 0, SEEK_END);
+}
+
+#ifdef _WIN32
+unsigned __stdcall capture_writer(void* dummy) {
+#else
+void* capture_writer(void* dummy) {
+#endif
+	CAPTUREFRAME_t frame;
+	uint32_t repeats;
+	uint8_t busy, stop;
+
+	while (1) {
+		stop = capture_stop; //one last pass after this is set to empty the queues
+		frame.pixels = NULL;
+		SDL_LockMutex(capture_mutex);
+		repeats = capture_pending;
+		capture_pending = 0;
+		if (capture_queuecount > 0) {
+			frame = capture_queue[capture_queuehead];
+			capture_queuehead = (capture_queuehead + 1) % CAPTURE_QUEUE;
+			capture_queuecount--;
+		}
+		SDL_UnlockMutex(capture_mutex);
+
+		busy = capture_writeAudio();
+		if (repeats > 0) {
+			capture_writeFrame(repeats, 0);
+			capture_repeats += repeats;
+			busy = 1;
+		}
+		if (frame.pixels != NULL) {
+			capture_toYUV(frame.pixels);
+			capture_writeFrame(frame.count, 1);
+			capture_repeats += frame.count - 1;
+			SDL_LockMutex(capture_mutex);
+			capture_free[capture_freecount++] = frame.pixels;
+			SDL_UnlockMutex(capture_mutex);
+			busy = 1;
+		}
+		if (stop && !busy) break;
+		if (!busy) {
+			utility_sleep(CAPTURE_WAIT_MS);
+		}
+	}
+
+#ifdef _WIN32
+	return 0;
+#else
+	return NULL;
+#endif
+}
+
+int capture_begin(MACHINE_t* machine, char* basename) {
+	char* filename;
+	uint32_t i;
+
+	filename = (char*)malloc(strlen(basename) + 5);
+	capture_back = (uint32_t*)calloc(CAPTURE_PIXELS, 4);
+	capture_prev = (uint32_t*)calloc(CAPTURE_PIXELS, 4);
+	capture_latest = (uint32_t*)calloc(CAPTURE_PIXELS, 4);
+	capture_yuv = (uint8_t*)malloc(CAPTURE_FRAMEBYTES);
+	capture_mutex = SDL_CreateMutex();
+	if ((filename == NULL) || (capture_back == NULL) || (capture_prev == NULL) || (capture_latest == NULL) || (capture_yuv == NULL) || (capture_mutex == NULL)) {
+		debug_log(DEBUG_ERROR, "[CAPTURE] Unable to allocate buffers\r\n");
+		return -1;
+	}
+	for (i = 0; i < CAPTURE_QUEUE; i++) {
+		capture_free[i] = (uint32_t*)malloc(CAPTURE_PIXELS * 4);
+		if (capture_free[i] == NULL) {
+			debug_log(DEBUG_ERROR, "[CAPTURE] Unable to allocate buffers\r\n");
+			return -1;
+		}
+	}
+	capture_freecount = CAPTURE_QUEUE;
+
+	//until the first frame comes in the video is black
+	memset(capture_yuv, 16, CAPTURE_PIXELS);
+	memset(capture_yuv + CAPTURE_PIXELS, 128, CAPTURE_PIXELS / 2);
+
+	sprintf(filename, "%s.avi", basename);
+	capture_video = fopen(filename, "wb");
+	if (capture_video == NULL) {
+		debug_log(DEBUG_ERROR, "[CAPTURE] Unable to create %s\r\n", filename);
+		return -1;
+	}
+	capture_aviHeader(); //sizes are filled in by capture_close
+
+	sprintf(filename, "%s.wav", basename);
+	capture_audio = fopen(filename, "wb");
+	if (capture_audio == NULL) {
+		debug_log(DEBUG_ERROR, "[CAPTURE] Unable to create %s\r\n", filename);
+		fclose(capture_video);
+		return -1;
+	}
+	capture_wavHeader(); //sizes are filled in by capture_close
+	free(filename);
+
+	capture_machine = machine;
+	capture_active = 1;
+	timing_addTimer(capture_frameTick, NULL, CAPTURE_FPS, TIMING_ENABLED);
+	timing_addTimer(capture_sampleTick, NULL, SAMPLE_RATE, TIMING_ENABLED);
+#ifdef _WIN32
+	capture_thread = (HANDLE)_beginthreadex(NULL, 0, capture_writer, NULL, 0, NULL);
+#else
+	pthread_create(&capture_thread, NULL, capture_writer, NULL);
+#endif
+
+	debug_log(DEBUG_INFO, "[CAPTURE] Recording to %s.avi and %s.wav\r\n", basename, basename);
+	return 0;
+}
+
+//call once the emulation thread is done, the buffers stay around in case a render thread is still in capture_blit
+void capture_close() {
+	if (!capture_active) return;
+	capture_active = 0;
+	capture_stop = 1;
+#ifdef _WIN32
+	WaitForSingleObject(capture_thread, INFINITE);
+	CloseHandle(capture_thread);
+#else
+	pthread_join(capture_thread, NULL);
+#endif
+
+	capture_wavHeader();
+	fclose(capture_audio);
+	capture_aviIndex();
+	capture_aviHeader();
+	fclose(capture_video);
+	debug_log(DEBUG_INFO, "[CAPTURE] %llu frames written, %llu of them repeats, %llu dropped, %llu audio samples dropped\r\n",
+		capture_frames, capture_repeats, capture_dropped, capture_audiodropped);
+}
@@ -0,0 +1,27 @@
+#ifndef _CAPTURE_H_
+#define _CAPTURE_H_
+
+#include <stdint.h>
+#include "machine.h"
+
+#define CAPTURE_FPS			30 //frames a second in guest time, the AVI is constant rate
+#define CAPTURE_W			720 //every mode fits in here, smaller ones get centered on black
+#define CAPTURE_H			480
+#define CAPTURE_QUEUE		8 //frames waiting for the writer before new ones get dropped
+#define CAPTURE_AUDIORING	131072 //samples waiting for the writer, about 2.7 seconds at 48 KHz. Power of two
+#define CAPTURE_WAIT_MS		10 //longest the writer sleeps before checking for audio
+#define CAPTURE_AVI_LIMIT	0x7F000000 //most movi bytes, AVI 1.0 readers take sizes as signed 32-bit
+
+typedef struct {
+	uint32_t* pixels; //CAPTURE_W x CAPTURE_H
+	uint32_t count; //times the frame is written, identical frames that follow just add to this
+} CAPTUREFRAME_t;
+
+int capture_begin(MACHINE_t* machine, char* basename);
+void capture_blit(uint32_t* pixels, int w, int h, int stride);
+void capture_close();
+
+extern char* capture_file;
+extern volatile uint8_t capture_active;
+
+#endif
@@ -28,6 +28,7 @@
 #include "i8237.h"
 #include "../cpu/cpu.h"
 #include "../ports.h"
+#include "../memory.h"
 #include "../timing.h"
 #include "../debuglog.h"
 
@@ -157,8 +158,13 @@ uint8_t i8237_readport(I8237_t* i8237, uint16_t addr) {
 		}
 		i8237->flipflop ^= 1;
 		break;
-	case 0x08: //status register
-		ret = 0x0F;
+	case 0x08: //status register, terminal count bits clear once read
+		ret = 0;
+		for (ch = 0; ch < 4; ch++) {
+			ret |= i8237->chan[ch].terminal << ch;
+			ret |= i8237->chan[ch].dreq << (ch + 4);
+			i8237->chan[ch].terminal = 0;
+		}
 	}
 	return ret;
 }
@@ -188,47 +194,96 @@ uint8_t i8237_readpage(I8237_t* i8237, uint16_t addr) {
 	return (uint8_t)(i8237->chan[ch].page >> 16);
 }
 
-uint8_t i8237_read(I8237_t* i8237, uint8_t ch) {
-	uint8_t ret = 0xFF;
-
-	//TODO: fix commented out stuff
-	//if (i8237->chan[ch].enable && !i8237->chan[ch].terminal) {
-		ret = cpu_read(i8237->cpu, i8237->chan[ch].page + i8237->chan[ch].addr);
-		i8237->chan[ch].addr += i8237->chan[ch].addrinc;
-		i8237->chan[ch].count--;
-		if (i8237->chan[ch].count == 0xFFFF) {
-			if (i8237->chan[ch].autoinit) {
-				i8237->chan[ch].count = i8237->chan[ch].reloadcount;
-				i8237->chan[ch].addr = i8237->chan[ch].reloadaddr;
-			} else {
-				i8237->chan[ch].terminal = 1; //TODO: does this also happen in autoinit mode?
-			}
-		}
-	//}
+/*
+	Works out how much of a transfer can go in one straight run: up to the end of the
+	current count, the end of the 64 KB page (the address counter wraps inside it) and
+	"len". Only called on an unmasked channel.
+*/
+uint32_t i8237_run(I8237_t* i8237, uint8_t ch, uint32_t len) {
+	uint32_t run, left;
 
-	return ret;
+	left = (uint32_t)i8237->chan[ch].count + 1;
+	run = (len < left) ? len : left;
+	if (i8237->chan[ch].addrinc == 1) {
+		left = 0x10000 - (i8237->chan[ch].addr & 0xFFFF);
+	}
+	else {
+		left = (i8237->chan[ch].addr & 0xFFFF) + 1;
+	}
+	return (run < left) ? run : left;
 }
 
-void i8237_write(I8237_t* i8237, uint8_t ch, uint8_t value) {
-	//TODO: fix commented out stuff
-	//if (i8237->chan[ch].enable && !i8237->chan[ch].terminal) {
-	cpu_write(i8237->cpu, i8237->chan[ch].page + i8237->chan[ch].addr, value);
-	printf("Write to %05X\r\n", i8237->chan[ch].page + i8237->chan[ch].addr);
-	i8237->chan[ch].addr += i8237->chan[ch].addrinc;
-	i8237->chan[ch].count--;
-	if (i8237->chan[ch].count == 0xFFFF) {
+//Moves the channel along by "run" bytes, handling terminal count and auto-init
+void i8237_advance(I8237_t* i8237, uint8_t ch, uint32_t run) {
+	uint8_t tc;
+
+	tc = (run == ((uint32_t)i8237->chan[ch].count + 1)) ? 1 : 0;
+	i8237->chan[ch].addr = (i8237->chan[ch].addr + run * i8237->chan[ch].addrinc) & 0xFFFF;
+	i8237->chan[ch].count -= (uint16_t)run;
+	if (tc) {
+		i8237->chan[ch].terminal = 1; //latched for the status register either way
 		if (i8237->chan[ch].autoinit) {
 			i8237->chan[ch].count = i8237->chan[ch].reloadcount;
 			i8237->chan[ch].addr = i8237->chan[ch].reloadaddr;
 		}
 		else {
-			i8237->chan[ch].terminal = 1; //TODO: does this also happen in autoinit mode?
+			i8237->chan[ch].masked = 1; //the channel stops itself at terminal count
+		}
+	}
+}
+
+/*
+	Block transfers for devices. i8237_readBlock reads guest memory into "dst" (a DMA read
+	feeds a device), i8237_writeBlock writes "src" to guest memory. Both go a whole run at
+	a time through memory_readBlock/writeBlock, so plain RAM is just a memcpy.
+
+	They return how many bytes were moved. Less than asked for means the channel reached
+	terminal count and isn't in auto-init mode, or it's masked. Terminal count is also
+	latched in chan[ch].terminal for the status register, auto-init or not.
+*/
+uint32_t i8237_readBlock(I8237_t* i8237, uint8_t ch, uint8_t* dst, uint32_t len) {
+	uint32_t done = 0, run, i;
+
+	while ((done < len) && !i8237->chan[ch].masked) {
+		run = i8237_run(i8237, ch, len - done);
+		if (i8237->chan[ch].addrinc == 1) {
+			memory_readBlock(i8237->chan[ch].page + i8237->chan[ch].addr, dst + done, run);
+		}
+		else {
+			for (i = 0; i < run; i++) {
+				dst[done + i] = cpu_read(i8237->cpu, i8237->chan[ch].page + ((i8237->chan[ch].addr - i) & 0xFFFF));
+			}
 		}
+		i8237_advance(i8237, ch, run);
+		done += run;
 	}
+
+	return done;
+}
+
+uint32_t i8237_writeBlock(I8237_t* i8237, uint8_t ch, const uint8_t* src, uint32_t len) {
+	uint32_t done = 0, run, i;
+
+	while ((done < len) && !i8237->chan[ch].masked) {
+		run = i8237_run(i8237, ch, len - done);
+		if (i8237->chan[ch].addrinc == 1) {
+			memory_writeBlock(i8237->chan[ch].page + i8237->chan[ch].addr, src + done, run);
+		}
+		else {
+			for (i = 0; i < run; i++) {
+				cpu_write(i8237->cpu, i8237->chan[ch].page + ((i8237->chan[ch].addr - i) & 0xFFFF), src[done + i]);
+			}
+		}
+		i8237_advance(i8237, ch, run);
+		done += run;
+	}
+
+	return done;
 }
 
 void i8237_init(I8237_t* i8237, CPU_t* cpu) {
 	i8237_reset(i8237);
+	i8237->cpu = cpu;
 
 	ports_cbRegister(0x00, 16, (void*)i8237_readport, NULL, (void*)i8237_writeport, NULL, i8237);
 	ports_cbRegister(0x80, 16, (void*)i8237_readpage, NULL, (void*)i8237_writepage, NULL, i8237);
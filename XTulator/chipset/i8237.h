@@ -37,8 +37,8 @@ typedef struct I8237_s {
 
 void i8237_writeport(I8237_t* i8237, uint16_t addr, uint8_t value);
 uint8_t i8237_readport(I8237_t* i8237, uint16_t addr);
-uint8_t i8237_read(I8237_t* i8237, uint8_t ch);
-void i8237_write(I8237_t* i8237, uint8_t ch, uint8_t value);
+uint32_t i8237_readBlock(I8237_t* i8237, uint8_t ch, uint8_t* dst, uint32_t len);
+uint32_t i8237_writeBlock(I8237_t* i8237, uint8_t ch, const uint8_t* src, uint32_t len);
 void i8237_init(I8237_t* i8237, CPU_t* cpu);
 
 #endif
@@ -19,6 +19,12 @@
 
 /*
 	Intel 8253 timer
+
+	Counters aren't stepped by a host timer. Each one remembers when it started counting
+	and from what value, and the current count and output level are worked out from the
+	elapsed 1.193182 MHz clocks whenever something needs them. IRQ 0 is raised from a
+	one-shot timing event scheduled for the exact time of the next rising edge on OUT0,
+	and the speaker pulls OUT2 edges up to "now" each time it generates a sample.
 */
 
 #include <stdio.h>
@@ -32,26 +38,286 @@
 #include "../ports.h"
 #include "../debuglog.h"
 
-uint32_t i8253_timers[3];
+uint64_t i8253_timeToTicks(uint64_t time) {
+	uint64_t freq = timing_getFreq();
+	return (time / freq) * I8253_CLOCK + ((time % freq) * I8253_CLOCK) / freq;
+}
+
+uint64_t i8253_ticksToTime(uint64_t ticks) {
+	uint64_t freq = timing_getFreq();
+	return (ticks / I8253_CLOCK) * freq + ((ticks % I8253_CLOCK) * freq + I8253_CLOCK - 1) / I8253_CLOCK;
+}
+
+uint64_t i8253_elapsed(I8253_t* i8253, uint8_t ch, uint64_t now) {
+	if (now <= i8253->start[ch]) return 0;
+	return i8253_timeToTicks(now - i8253->start[ch]);
+}
+
+//output level k clocks after the counter started
+uint8_t i8253_outAt(I8253_t* i8253, uint8_t ch, uint64_t k) {
+	uint64_t n;
+
+	if (!i8253->counting[ch]) return i8253->out[ch];
+	n = i8253->base[ch];
+	switch (i8253->mode[ch]) {
+	case 0: //interrupt on terminal count
+	case 1: //hardware retriggerable one-shot
+		return (i8253->fired[ch] || (k >= n)) ? 1 : 0;
+	case 2: //rate generator
+		if (n < 2) return 1;
+		return ((k % n) == (n - 1)) ? 0 : 1;
+	case 3: //square wave generator
+		if (n < 2) return 1;
+		return ((k % n) < ((n + 1) >> 1)) ? 1 : 0;
+	case 4: //software triggered strobe
+	case 5: //hardware triggered strobe
+		return (i8253->fired[ch] || (k != n)) ? 1 : 0;
+	}
+	return 1;
+}
+
+//first clock after k at which the output changes level
+uint64_t i8253_nextEdge(I8253_t* i8253, uint8_t ch, uint64_t k) {
+	uint64_t n, p, h;
+
+	if (!i8253->counting[ch]) return I8253_NEVER;
+	n = i8253->base[ch];
+	switch (i8253->mode[ch]) {
+	case 0:
+	case 1:
+		if (i8253->fired[ch] || (k >= n)) return I8253_NEVER;
+		return n;
+	case 2:
+		if (n < 2) return I8253_NEVER;
+		p = k % n;
+		return (p < (n - 1)) ? (k + (n - 1 - p)) : (k + 1);
+	case 3:
+		if (n < 2) return I8253_NEVER;
+		p = k % n;
+		h = (n + 1) >> 1;
+		return (p < h) ? (k + (h - p)) : (k + (n - p));
+	case 4:
+	case 5:
+		if (i8253->fired[ch] || (k > n)) return I8253_NEVER;
+		return (k < n) ? n : (n + 1);
+	}
+	return I8253_NEVER;
+}
+
+uint16_t i8253_countAt(I8253_t* i8253, uint8_t ch, uint64_t k) {
+	uint64_t n, p, h;
+
+	if (!i8253->counting[ch]) return (uint16_t)i8253->counter[ch];
+	n = i8253->base[ch];
+	switch (i8253->mode[ch]) {
+	case 2:
+		return (uint16_t)(n - (k % n));
+	case 3: //counts down by two, twice per period
+		p = k % n;
+		h = (n + 1) >> 1;
+		if (p >= h) p -= h;
+		return (uint16_t)((n & ~(uint64_t)1) - (p << 1));
+	default: //one-shot modes keep wrapping through zero after terminal count, like the real thing
+		return (uint16_t)(n - k);
+	}
+}
+
+uint16_t i8253_getCount(I8253_t* i8253, uint8_t ch) {
+	return i8253_countAt(i8253, ch, i8253_elapsed(i8253, ch, timing_getCur()));
+}
+
+uint8_t i8253_getOut(I8253_t* i8253, uint8_t ch) {
+	return i8253_outAt(i8253, ch, i8253_elapsed(i8253, ch, timing_getCur()));
+}
+
+void i8253_startCount(I8253_t* i8253, uint8_t ch, uint32_t value, uint64_t now) {
+	i8253->base[ch] = value;
+	i8253->start[ch] = now;
+	i8253->counting[ch] = 1;
+	if (ch == 2) i8253->spktick = 0;
+}
+
+void i8253_stopCount(I8253_t* i8253, uint8_t ch, uint64_t now) {
+	uint64_t k;
+
+	if (!i8253->counting[ch]) return;
+	k = i8253_elapsed(i8253, ch, now);
+	i8253->counter[ch] = i8253_countAt(i8253, ch, k);
+	i8253->out[ch] = i8253_outAt(i8253, ch, k);
+	switch (i8253->mode[ch]) {
+	case 0:
+	case 1:
+		if (k >= i8253->base[ch]) i8253->fired[ch] = 1;
+		break;
+	case 4:
+	case 5:
+		if (k > i8253->base[ch]) i8253->fired[ch] = 1;
+		break;
+	}
+	i8253->counting[ch] = 0;
+}
+
+uint8_t i8253_speakerMuted(I8253_t* i8253) {
+	//anything above ~24 KHz is inaudible, and just makes noise by aliasing against the sample rate
+	return i8253->counting[2] && ((i8253->mode[2] == 2) || (i8253->mode[2] == 3)) && (i8253->base[2] < I8253_SPEAKER_MIN);
+}
+
+//hands the speaker every OUT2 transition that has happened up to "now"
+void i8253_speakerSync(I8253_t* i8253, uint64_t now) {
+	uint64_t k, t;
+
+	if (!i8253->counting[2] || i8253_speakerMuted(i8253)) return;
+	k = i8253_elapsed(i8253, 2, now);
+	if (k <= i8253->spktick) return;
+	if ((k - i8253->spktick) > I8253_SPEAKER_MAXLAG) { //nobody asked for a while, don't bother replaying ancient history
+		i8253->spktick = k - I8253_SPEAKER_MAXLAG;
+	}
+
+	t = i8253->spktick;
+	while ((t = i8253_nextEdge(i8253, 2, t)) <= k) {
+		pcspeaker_setGateState(i8253->cbdata.pcspeaker, PC_SPEAKER_GATE_TIMER2, i8253_outAt(i8253, 2, t), i8253->start[2] + i8253_ticksToTime(t));
+	}
+	i8253->spktick = k;
+}
+
+void i8253_scheduleIRQ(I8253_t* i8253, uint64_t k) {
+	uint64_t t;
+
+	t = k;
+	do { //edges alternate, so this never takes more than two steps
+		t = i8253_nextEdge(i8253, 0, t);
+	} while ((t != I8253_NEVER) && !i8253_outAt(i8253, 0, t));
+
+	if (t == I8253_NEVER) {
+		timing_timerDisable(i8253->irqtimer);
+		return;
+	}
+	i8253->irqtick = t;
+	timing_timerSchedule(i8253->irqtimer, i8253->start[0] + i8253_ticksToTime(t));
+}
+
+void i8253_irqCallback(I8253CB_t* i8253cb) {
+	I8253_t* i8253;
+	uint64_t k;
+
+	i8253 = i8253cb->i8253;
+	i8259_doirq(i8253cb->i8259, 0);
+
+	//schedule from the edge we just fired rather than from now, so the long-term rate is exact
+	k = i8253_elapsed(i8253, 0, timing_getCur());
+	if ((k - i8253->irqtick) > I8253_SPEAKER_MAXLAG) { //host stalled, don't try to catch up a huge backlog of IRQs
+		i8253_scheduleIRQ(i8253, k);
+	}
+	else {
+		i8253_scheduleIRQ(i8253, i8253->irqtick);
+	}
+}
+
+//re-evaluates whatever is hooked to a counter's output after its state was changed
+void i8253_update(I8253_t* i8253, uint8_t ch, uint64_t now) {
+	if (ch == 0) {
+		i8253_scheduleIRQ(i8253, i8253_elapsed(i8253, 0, now));
+	}
+	else if (ch == 2) {
+		pcspeaker_setGateState(i8253->cbdata.pcspeaker, PC_SPEAKER_GATE_TIMER2, i8253_speakerMuted(i8253) ? 0 : i8253_outAt(i8253, 2, i8253_elapsed(i8253, 2, now)), now);
+	}
+}
+
+void i8253_load(I8253_t* i8253, uint8_t ch, uint64_t now) {
+	i8253->fired[ch] = 0;
+	switch (i8253->mode[ch]) {
+	case 0:
+	case 4:
+		i8253->out[ch] = (i8253->mode[ch] == 0) ? 0 : 1;
+		if (i8253->gate[ch]) {
+			i8253_startCount(i8253, ch, i8253->reload[ch], now);
+		}
+		else {
+			i8253->counting[ch] = 0;
+			i8253->counter[ch] = i8253->reload[ch];
+		}
+		break;
+	case 1:
+	case 5: //wait for a gate trigger
+		i8253->counting[ch] = 0;
+		i8253->counter[ch] = i8253->reload[ch];
+		i8253->out[ch] = 1;
+		break;
+	case 2:
+	case 3:
+		i8253->out[ch] = 1;
+		if (i8253->gate[ch]) {
+			i8253_startCount(i8253, ch, i8253->reload[ch], now);
+		}
+		else {
+			i8253->counting[ch] = 0;
+			i8253->counter[ch] = i8253->reload[ch];
+		}
+		break;
+	}
+}
+
+void i8253_setGate(I8253_t* i8253, uint8_t ch, uint8_t value) {
+	uint64_t now;
+
+	value = value ? 1 : 0;
+	if (i8253->gate[ch] == value) return;
+	now = timing_getCur();
+	if (ch == 2) i8253_speakerSync(i8253, now);
+	i8253->gate[ch] = value;
+	if (!i8253->active[ch]) return;
+
+	if (value) { //rising edge
+		switch (i8253->mode[ch]) {
+		case 0:
+		case 4: //resume counting where it was paused
+			if (!i8253->counting[ch]) {
+				i8253_startCount(i8253, ch, (i8253->counter[ch] == 0) ? 65536 : i8253->counter[ch], now);
+			}
+			break;
+		case 1:
+		case 5:
+		case 2:
+		case 3: //trigger, restart from the reload value
+			i8253->fired[ch] = 0;
+			i8253_startCount(i8253, ch, i8253->reload[ch], now);
+			break;
+		}
+	}
+	else {
+		switch (i8253->mode[ch]) {
+		case 0:
+		case 4:
+			i8253_stopCount(i8253, ch, now);
+			break;
+		case 2:
+		case 3: //counting stops and output is forced high
+			i8253_stopCount(i8253, ch, now);
+			i8253->out[ch] = 1;
+			break;
+		}
+	}
+	i8253_update(i8253, ch, now);
+}
 
 void i8253_write(I8253_t* i8253, uint16_t portnum, uint8_t value) {
 	uint8_t sel, rl, loaded;
+	uint64_t now;
 	portnum &= 3;
 
+	now = timing_getCur();
 	loaded = 0;
 	switch (portnum) {
 	case 0: //load counters
 	case 1:
 	case 2:
 		switch (i8253->rlmode[portnum]) {
-		case 1: //MSB only
-			i8253->reload[portnum] = (int32_t)value << 8;
-			i8253->active[portnum] = 1;
+		case 1: //LSB only
+			i8253->reload[portnum] = value;
 			loaded = 1;
 			break;
-		case 2: //LSB only
-			i8253->reload[portnum] = value;
-			i8253->active[portnum] = 1;
+		case 2: //MSB only
+			i8253->reload[portnum] = (int32_t)value << 8;
 			loaded = 1;
 			break;
 		case 3: //LSB, then MSB
@@ -59,28 +325,22 @@ void i8253_write(I8253_t* i8253, uint16_t portnum, uint8_t value) {
 				i8253->reload[portnum] = (i8253->reload[portnum] & 0xFF00) | value;
 			} else { //MSB
 				i8253->reload[portnum] = (i8253->reload[portnum] & 0x00FF) | ((int32_t)value << 8);
-				i8253->counter[portnum] = i8253->reload[portnum];
-				if (i8253->reload[portnum] == 0) {
-					i8253->reload[portnum] = 65536;
-				}
-				i8253->active[portnum] = 1;
 				loaded = 1;
-#ifdef DEBUG_PIT
-				debug_log(DEBUG_DETAIL, "I8253: Counter %u reload = %d\r\n", portnum, i8253->reload[portnum]);
-#endif
 			}
 			i8253->dataflipflop[portnum] ^= 1;
 			break;
 		}
-		if (loaded) switch (i8253->mode[portnum]) {
-		case 0:
-		case 1:
-			i8253->out[portnum] = 0;
-			break;
-		case 2:
-		case 3:
-			i8253->out[portnum] = 1;
-			break;
+		if (loaded) {
+			if (i8253->reload[portnum] == 0) {
+				i8253->reload[portnum] = 65536;
+			}
+#ifdef DEBUG_PIT
+			debug_log(DEBUG_DETAIL, "I8253: Counter %u reload = %d\r\n", portnum, i8253->reload[portnum]);
+#endif
+			if (portnum == 2) i8253_speakerSync(i8253, now);
+			i8253->active[portnum] = 1;
+			i8253_load(i8253, (uint8_t)portnum, now);
+			i8253_update(i8253, (uint8_t)portnum, now);
 		}
 		break;
 	case 3: //control word
@@ -90,14 +350,23 @@ void i8253_write(I8253_t* i8253, uint16_t portnum, uint8_t value) {
 		}
 		rl = (value >> 4) & 3; //read/load mode
 		if (rl == 0) { //counter latching operation
-			i8253->latch[sel] = i8253->counter[sel];
+			if (!i8253->latched[sel]) {
+				i8253->latch[sel] = i8253_countAt(i8253, sel, i8253_elapsed(i8253, sel, now));
+				i8253->latched[sel] = 1;
+			}
 		} else { //set mode
+			if (sel == 2) i8253_speakerSync(i8253, now);
 			i8253->rlmode[sel] = rl;
 			i8253->mode[sel] = (value >> 1) & 7;
 			if (i8253->mode[sel] & 0x02) {
 				i8253->mode[sel] &= 3; //MSB is "don't care" if bit 1 is set
 			}
 			i8253->bcd[sel] = value & 1;
+			i8253->active[sel] = 0;
+			i8253->counting[sel] = 0;
+			i8253->latched[sel] = 0;
+			i8253->out[sel] = (i8253->mode[sel] == 0) ? 0 : 1;
+			i8253_update(i8253, sel, now);
 #ifdef DEBUG_PIT
 			debug_log(DEBUG_DETAIL, "I8253: Counter %u mode = %u\r\n", sel, i8253->mode[sel]);
 #endif
@@ -115,88 +384,49 @@ uint8_t i8253_read(I8253_t* i8253, uint16_t portnum) {
 		return 0xFF; //no read of control word possible
 	}
 
+	//without a latch command the live count is read, LSB/MSB pairs are taken from a single snapshot
+	if (!i8253->latched[portnum] && ((i8253->rlmode[portnum] != 3) || (i8253->dataflipflop[portnum] == 0))) {
+		i8253->latch[portnum] = i8253_getCount(i8253, (uint8_t)portnum);
+	}
+
 	switch (i8253->rlmode[portnum]) {
-	case 1: //MSB only
-		return i8253->latch[portnum] >> 8;
-	case 2: //LSB only
+	case 1: //LSB only
+		i8253->latched[portnum] = 0;
 		return (uint8_t)i8253->latch[portnum];
+	case 2: //MSB only
+		i8253->latched[portnum] = 0;
+		return i8253->latch[portnum] >> 8;
 	default: //LSB, then MSB (case 3, but say default so MSVC stops warning me about control paths not all returning a value)
 		if (i8253->dataflipflop[portnum] == 0) { //LSB
 			ret = (uint8_t)i8253->latch[portnum];
 		} else { //MSB
 			ret = i8253->latch[portnum] >> 8;
+			i8253->latched[portnum] = 0;
 		}
 		i8253->dataflipflop[portnum] ^= 1;
 		return ret;
 	}
 }
 
-void i8253_timerCallback0(I8259_t* i8259) {
-	i8259_doirq(i8259, 0);
-}
-
-void i8253_timerCallback1(I8259_t* i8259) {
-}
-
-void i8253_timerCallback2(I8259_t* i8259) {
-}
-
-void i8253_tickCallback(I8253CB_t* i8253cb) {
-	I8253_t* i8253;
-	I8259_t* i8259;
+void i8253_init(I8253_t* i8253, I8259_t* i8259, PCSPEAKER_t* pcspeaker) {
 	uint8_t i;
 
-	i8253 = i8253cb->i8253;
-	i8259 = i8253cb->i8259;
-	for (i = 0; i < 3; i++) {
-		if ((i == 2) && (i8253->mode[2] != 3)) pcspeaker_setGateState(i8253->cbdata.pcspeaker, PC_SPEAKER_GATE_TIMER2, 0);
-		if (i8253->active[i]) switch (i8253->mode[i]) {
-		case 0: //interrupt on terminal count
-			i8253->counter[i] -= 25;
-			if (i8253->counter[i] <= 0) {
-				i8253->counter[i] = 0;
-				i8253->out[i] = 1;
-				if (i == 0) i8253_timerCallback0(i8259);
-			}
-			break;
-		case 2: //rate generator
-			i8253->counter[i] -= 25;
-			if (i8253->counter[i] <= 0) {
-				i8253->out[i] ^= 1;
-				//if (i8253->out[i] == 0) {
-					if (i == 0) i8253_timerCallback0(i8259);
-				//}
-				i8253->counter[i] += i8253->reload[i];
-			}
-			break;
-		case 3: //square wave generator
-			i8253->counter[i] -= 50;
-			if (i8253->counter[i] <= 0) {
-				i8253->out[i] ^= 1;
-				if (i8253->out[i] == 0) {
-					if (i == 0) i8253_timerCallback0(i8259);
-				}
-				if (i == 2) pcspeaker_setGateState(i8253->cbdata.pcspeaker, PC_SPEAKER_GATE_TIMER2, (i8253->reload[i] < 50) ? 0 : i8253->out[i]);
-				i8253->counter[i] += i8253->reload[i];
-			}
-			break;
-		default:
-#ifdef DEBUG_PIT
-			debug_log(DEBUG_DETAIL, "I8253: Unknown mode %u on counter %u\r\n", i8253->mode[i], i);
-#endif
-			break;
-		}
-	}
-}
-
-void i8253_init(I8253_t* i8253, I8259_t* i8259, PCSPEAKER_t* pcspeaker) {
 	memset(i8253, 0, sizeof(I8253_t));
 
 	i8253->cbdata.i8253 = i8253;
 	i8253->cbdata.i8259 = i8259;
 	i8253->cbdata.pcspeaker = pcspeaker;
 
-	timing_addTimer(i8253_tickCallback, (void*)(&i8253->cbdata), 48000, TIMING_ENABLED); //79545.47
+	for (i = 0; i < 3; i++) {
+		i8253->out[i] = 1;
+	}
+	i8253->gate[0] = 1; //channels 0 and 1 are always gated on, channel 2 is controlled through port 61h
+	i8253->gate[1] = 1;
+
+	i8253->irqtimer = timing_addTimerUsingInterval(i8253_irqCallback, (void*)(&i8253->cbdata), 0, TIMING_DISABLED);
+	pcspeaker->sync = (void*)i8253_speakerSync;
+	pcspeaker->syncudata = i8253;
 
 	ports_cbRegister(0x40, 4, (void*)i8253_read, NULL, (void*)i8253_write, NULL, i8253);
+	ports_setTimed(0x40, 3); //counts are worked out from the time they're read at
 }
@@ -29,6 +29,11 @@
 #define PIT_MODE_HIBYTE	2
 #define PIT_MODE_TOGGLE	3
 
+#define I8253_CLOCK	1193182
+#define I8253_NEVER	0xFFFFFFFFFFFFFFFFULL
+#define I8253_SPEAKER_MIN	50 //shortest periodic count that still gets sent to the speaker
+#define I8253_SPEAKER_MAXLAG	(I8253_CLOCK / 10)
+
 typedef struct {
 	void* i8253;
 	I8259_t* i8259;
@@ -36,12 +41,6 @@ typedef struct {
 } I8253CB_t;
 
 typedef struct {
-	uint16_t chandata[3];
-	uint8_t accessmode[3];
-	uint8_t bytetoggle[3];
-	uint32_t effectivedata[3];
-	float chanfreq[3];
-
 	uint8_t active[3];
 	int32_t counter[3];
 	int32_t reload[3];
@@ -51,11 +50,23 @@ typedef struct {
 	uint8_t rlmode[3];
 	uint16_t latch[3];
 	uint8_t out[3];
+	uint64_t start[3];
+	uint32_t base[3];
+	uint8_t counting[3];
+	uint8_t fired[3];
+	uint8_t gate[3];
+	uint8_t latched[3];
+	uint64_t irqtick;
+	uint64_t spktick;
+	uint32_t irqtimer;
 	I8253CB_t cbdata;
 } I8253_t;
 
 void i8253_write(I8253_t* i8253, uint16_t portnum, uint8_t value);
 uint8_t i8253_read(I8253_t* i8253, uint16_t portnum);
+void i8253_setGate(I8253_t* i8253, uint8_t ch, uint8_t value);
+uint16_t i8253_getCount(I8253_t* i8253, uint8_t ch);
+uint8_t i8253_getOut(I8253_t* i8253, uint8_t ch);
 void i8253_init(I8253_t* i8253, I8259_t* i8259, PCSPEAKER_t* pcspeaker);
 
 #endif
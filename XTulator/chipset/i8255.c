@@ -29,7 +29,9 @@
 #include "../config.h"
 #include "../timing.h"
 #include "../modules/audio/pcspeaker.h"
+#include "i8253.h"
 #include "i8255.h"
+#include "i8259.h"
 #include "../ports.h"
 #include "../debuglog.h"
 
@@ -40,15 +42,16 @@ uint8_t i8255_readport(I8255_t* i8255, uint16_t portnum) {
 	portnum &= 7;
 	switch (portnum) {
 	case 0:
+		i8255_keyTaken(i8255);
 		return i8255->keystate->scancode;
 	case 1:
-		return i8255->portB;
+		return i8255->portB | i8255_refreshBit();
 	case 2:
 		//debug_log(DEBUG_DETAIL, "read 0x62\r\n");
 		if (i8255->portB & 8) {
-			return i8255->sw2 >> 4;
+			return (i8255->sw2 >> 4) | (i8253_getOut(i8255->i8253, 2) << 5);
 		} else {
-			return i8255->sw2 & 0x0F;
+			return (i8255->sw2 & 0x0F) | (i8253_getOut(i8255->i8253, 2) << 5);
 		}
 	}
 	return 0xFF;
@@ -64,40 +67,93 @@ void i8255_writeport(I8255_t* i8255, uint16_t portnum, uint8_t value) {
 		i8255->keystate->scancode = 0xAA;
 		break;
 	case 1:
+		i8253_setGate(i8255->i8253, 2, value & 0x01);
 		if (value & 0x01) {
-			pcspeaker_selectGate(i8255->pcspeaker, PC_SPEAKER_USE_TIMER2);
+			pcspeaker_selectGate(i8255->pcspeaker, PC_SPEAKER_USE_TIMER2, timing_getCur());
 #ifdef DEBUG_PPI
 			debug_log(DEBUG_DETAIL, "[I8255] Speaker take input from timer 2\r\n");
 #endif
 		} else {
-			pcspeaker_selectGate(i8255->pcspeaker, PC_SPEAKER_USE_DIRECT);
+			pcspeaker_selectGate(i8255->pcspeaker, PC_SPEAKER_USE_DIRECT, timing_getCur());
 #ifdef DEBUG_PPI
 			debug_log(DEBUG_DETAIL, "[I8255] Speaker take input from direct\r\n");
 #endif
 		}
-		pcspeaker_setGateState(i8255->pcspeaker, PC_SPEAKER_GATE_DIRECT, (value >> 1) & 1);
+		pcspeaker_setGateState(i8255->pcspeaker, PC_SPEAKER_GATE_DIRECT, (value >> 1) & 1, timing_getCur());
 #ifdef DEBUG_PPI
 		debug_log(DEBUG_DETAIL, "[I8255] Speaker direct value = %u\r\n", (value >> 1) & 1);
 #endif
+		if ((value & 0x80) && !(i8255->portB & 0x80)) { //keyboard clear, the BIOS acknowledges each scancode this way
+			i8255_keyTaken(i8255);
+		}
 		if ((value & 0x40) && !(i8255->portB & 0x40)) {
 			i8255->keystate->scancode = 0xAA;
+			i8255->keystate->fifolen = 0;
 #ifdef DEBUG_PPI
 			debug_log(DEBUG_DETAIL, "[I8255] Keyboard reset\r\n");
 #endif
 		}
-		i8255->portB = (value & 0xEF) | (i8255->portB & 0x10);
+		i8255->portB = value & 0xEF;
 		break;
 	}
 }
 
-void i8255_refreshToggle(I8255_t* i8255) {
-	i8255->portB ^= 0x10; //simulate DRAM refresh toggle, many BIOSes require this...
+//DRAM refresh toggle, many BIOSes require this... worked out from the time instead of running a timer to flip it
+uint8_t i8255_refreshBit() {
+	return (uint8_t)((timing_getCur() / (timing_getFreq() / I8255_REFRESH_RATE)) & 1) << 4;
+}
+
+/*
+	Keyboard side of port 60h. Scancodes queue up in the keyboard's FIFO and go out one at a
+	time: each raises IRQ1, and the next one follows a scancode time after the guest has read
+	port 60h or pulsed the clear bit in port 61h. Typing faster than the guest drains the port
+	no longer overwrites keys it hasn't seen yet.
+*/
+void i8255_keySend(I8255_t* i8255) {
+	KEYSTATE_t* keystate = i8255->keystate;
+
+	i8255->keyarmed = 0;
+	if (keystate->isNew || (keystate->fifolen == 0)) return;
+	keystate->scancode = keystate->fifo[keystate->fifohead];
+	keystate->fifohead = (keystate->fifohead + 1) % KEY_FIFO_SIZE;
+	keystate->fifolen--;
+	keystate->isNew = 1;
+	i8259_doirq(i8255->i8259, 1);
+}
+
+void i8255_keySchedule(I8255_t* i8255) {
+	if (i8255->keyarmed || (i8255->keystate->fifolen == 0)) return;
+	timing_timerSchedule(i8255->keytimer, timing_getCur() + timing_getFreq() / I8255_KEY_RATE);
+	i8255->keyarmed = 1;
+}
+
+void i8255_keyTaken(I8255_t* i8255) {
+	if (!i8255->keystate->isNew) return;
+	i8255->keystate->isNew = 0;
+	i8255_keySchedule(i8255);
+}
+
+void i8255_keyPush(I8255_t* i8255, uint8_t scancode) {
+	KEYSTATE_t* keystate = i8255->keystate;
+
+	if (keystate->fifolen == KEY_FIFO_SIZE) {
+		debug_log(DEBUG_DETAIL, "[I8255] Keyboard FIFO full, scancode %02X dropped\r\n", scancode);
+		return;
+	}
+	keystate->fifo[(keystate->fifohead + keystate->fifolen) % KEY_FIFO_SIZE] = scancode;
+	keystate->fifolen++;
+	if (!keystate->isNew && !i8255->keyarmed) {
+		i8255_keySend(i8255);
+	}
 }
 
-void i8255_init(I8255_t* i8255, KEYSTATE_t* keystate, PCSPEAKER_t* pcspeaker) {
+void i8255_init(I8255_t* i8255, KEYSTATE_t* keystate, PCSPEAKER_t* pcspeaker, I8253_t* i8253, I8259_t* i8259, uint8_t videocard) {
 	memset(i8255, 0, sizeof(I8255_t));
 	i8255->keystate = keystate;
 	i8255->pcspeaker = pcspeaker;
+	i8255->i8253 = i8253;
+	i8255->i8259 = i8259;
+	i8255->keytimer = timing_addTimerUsingInterval(i8255_keySend, i8255, 0, TIMING_DISABLED);
 
 	if (videocard == VIDEO_CARD_VGA) {
 		i8255->sw2 = 0x46;
@@ -107,5 +163,5 @@ void i8255_init(I8255_t* i8255, KEYSTATE_t* keystate, PCSPEAKER_t* pcspeaker) {
 	}
 
 	ports_cbRegister(0x60, 6, (void*)i8255_readport, NULL, (void*)i8255_writeport, NULL, i8255);
-	timing_addTimer(i8255_refreshToggle, i8255, 66667, TIMING_ENABLED);
+	ports_setTimed(0x61, 2); //refresh bit and timer 2 output
 }
@@ -4,6 +4,11 @@
 #include <stdint.h>
 #include "../modules/audio/pcspeaker.h"
 #include "../modules/input/input.h"
+#include "i8253.h"
+#include "i8259.h"
+
+#define I8255_REFRESH_RATE		66667 //port 61h bit 4 toggles this many times a second
+#define I8255_KEY_RATE			1000 //scancodes a second the keyboard can clock out, roughly 11 bits each at 10 kbit/s
 
 typedef struct {
 	uint8_t sw2;
@@ -12,10 +17,19 @@ typedef struct {
 	uint8_t portC;
 	KEYSTATE_t* keystate;
 	PCSPEAKER_t* pcspeaker;
+	I8253_t* i8253;
+	I8259_t* i8259;
+	uint32_t keytimer;
+	uint8_t keyarmed;
 } I8255_t;
 
+uint8_t i8255_refreshBit();
+void i8255_keySend(I8255_t* i8255);
+void i8255_keySchedule(I8255_t* i8255);
+void i8255_keyTaken(I8255_t* i8255);
+void i8255_keyPush(I8255_t* i8255, uint8_t scancode);
 uint8_t i8255_readport(I8255_t* i8255, uint16_t portnum);
 void i8255_writeport(I8255_t* i8255, uint16_t portnum, uint8_t value);
-void i8255_init(I8255_t* i8255, KEYSTATE_t* keystate, PCSPEAKER_t* pcspeaker);
+void i8255_init(I8255_t* i8255, KEYSTATE_t* keystate, PCSPEAKER_t* pcspeaker, I8253_t* i8253, I8259_t* i8259, uint8_t videocard);
 
 #endif
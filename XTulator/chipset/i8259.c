@@ -28,6 +28,11 @@
 #include "i8259.h"
 #include "../ports.h"
 
+//Call after anything touches irr or imr
+void i8259_update(I8259_t* i8259) {
+	i8259->pending = (i8259->irr & (~i8259->imr)) ? 1 : 0;
+}
+
 uint8_t i8259_read(I8259_t* i8259, uint16_t portnum) {
 #ifdef DEBUG_PIC
 	debug_log(DEBUG_DETAIL, "[I8259] Read port 0x%X\n", portnum);
@@ -128,6 +133,7 @@ void i8259_write(I8259_t* i8259, uint16_t portnum, uint8_t value) {
 		}
 		break;
 	}
+	i8259_update(i8259);
 }
 
 uint8_t i8259_nextintr(I8259_t* i8259) {
@@ -137,6 +143,7 @@ uint8_t i8259_nextintr(I8259_t* i8259) {
 		if ((tmpirr >> i) & 1) {
 			i8259->irr &= ~(1 << i);
 			i8259->isr |= (1 << i);
+			i8259_update(i8259);
 			return(i8259->icw[2] + i);
 		}
 	return 0;
@@ -147,6 +154,7 @@ void i8259_doirq(I8259_t* i8259, uint8_t irqnum) {
 	debug_log(DEBUG_DETAIL, "[I8259] IRQ %u raised\r\n", irqnum);
 #endif
 	i8259->irr |= (1 << irqnum) & (~i8259->imr);
+	i8259_update(i8259);
 }
 
 void i8259_init(I8259_t* i8259) {
@@ -103,6 +103,9 @@ uint8_t uart_readport(UART_t* uart, uint16_t addr) {
 				uart->pendirq |= UART_PENDING_LSR;
 				i8259_doirq(uart->i8259, uart->irq);
 			}
+			if (uart->rxreadCb != NULL) {
+				(*uart->rxreadCb)(uart->udata3);
+			}
 		} else {
 			ret = (uint8_t)uart->divisor;
 		}
@@ -170,6 +173,11 @@ void uart_rxdata(UART_t* uart, uint8_t value) {
 	}
 }
 
+void uart_setRxReadCallback(UART_t* uart, void (*rxread)(void*), void* udata3) {
+	uart->rxreadCb = rxread;
+	uart->udata3 = udata3;
+}
+
 void uart_init(UART_t* uart, I8259_t* i8259, uint16_t base, uint8_t irq, void (*tx)(void*, uint8_t), void* udata, void (*mcr)(void*, uint8_t), void* udata2) {
 	debug_log(DEBUG_INFO, "[UART] Initializing 8250 UART at base port 0x%03X, IRQ %u\r\n", base, irq);
 	memset(uart, 0, sizeof(UART_t));
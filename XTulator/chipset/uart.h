@@ -32,14 +32,17 @@ typedef struct {
 	uint8_t pendirq;
 	void* udata;
 	void* udata2;
+	void* udata3;
 	void (*txCb)(void*, uint8_t);
 	void (*mcrCb)(void*, uint8_t);
+	void (*rxreadCb)(void*); //the guest took the received byte, room for the next one
 	I8259_t* i8259;
 } UART_t;
 
 void uart_writeport(UART_t* uart, uint16_t addr, uint8_t value);
 uint8_t uart_readport(UART_t* uart, uint16_t addr);
 void uart_rxdata(UART_t* uart, uint8_t value);
+void uart_setRxReadCallback(UART_t* uart, void (*rxread)(void*), void* udata3);
 void uart_init(UART_t* uart, I8259_t* i8259, uint16_t base, uint8_t irq, void (*tx)(void*, uint8_t), void* udata, void (*mcr)(void*, uint8_t), void* udata2);
 
 #endif
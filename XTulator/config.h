@@ -23,6 +23,7 @@
 //#define DEBUG_FDC
 //#define DEBUG_NE2000
 //#define DEBUG_PCAP
+//#define DEBUG_INPUT
 
 #define USE_DISK_HLE
 #define USE_NUKED_OPL
@@ -32,6 +33,10 @@
 #define ENABLE_TCP_MODEM
 #endif
 
+#define CONSOLE_SDL			0
+#define CONSOLE_ANSI		1
+#define CONSOLE_NONE		2
+
 #define VIDEO_CARD_MDA		0
 #define VIDEO_CARD_CGA		1
 #define VIDEO_CARD_EGA		2
@@ -46,17 +51,23 @@
 #define FUNC_INLINE __attribute__((always_inline))
 #endif
 
+#ifdef _WIN32
+#define THREADLOCAL __declspec(thread)
+#else
+#define THREADLOCAL __thread
+#endif
+
 #ifndef _WIN32
 #define _stricmp strcasecmp
 #endif
 
 extern volatile uint8_t running;
-extern uint8_t videocard, showMIPS;
+extern uint8_t showMIPS;
 extern double speedarg;
 extern volatile double speed;
 extern uint32_t baudrate, ramsize;
 extern char* usemachine;
-extern uint8_t bootdrive;
+extern uint8_t useconsole;
 
 void setspeed(double mhz);
 
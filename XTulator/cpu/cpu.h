@@ -21,9 +21,16 @@
 #define _CPU_H_
 
 #include <stdint.h>
-#include "cpuconf.h"
 #include "../chipset/i8259.h"
 
+#define CPU_MODEL_DEFAULT	0 //whatever the machine definition asks for
+#define CPU_MODEL_8086		1 //also the 8088, they only differ in bus width
+#define CPU_MODEL_V20		2
+#define CPU_MODEL_186		3
+
+#define CPU_IDLE_POLLS		256 //status polls in a row that get the guest treated as idle
+#define CPU_PORT_BLOCK		256 //most words a REP INSW/OUTSW moves per device call
+
 union _bytewordregs_ {
 	uint16_t wordregs[8];
 	uint8_t byteregs[8];
@@ -39,10 +46,20 @@ typedef struct {
 	uint32_t temp1, temp2, temp3, temp4, temp5, temp32, tempaddr32, ea;
 	int32_t	result;
 	uint16_t trap_toggle;
-	uint64_t totalexec;
+	uint64_t totalexec; //instructions actually run
+	uint64_t clock; //instruction slots, halted ones too, the instruction count clock runs off this
 	void (*int_callback[256])(void*, uint8_t); //Want to pass a CPU object in first param, but it's not defined at this point so use a void*
+	uint8_t model;
+	void (*exec)(void*, uint32_t); //the copy of the core built for this model, see cpucore.h
+	uint32_t idlepolls; //status polls in a row without anything changing, see cpu_idle
+	uint16_t pollcs, pollip, pollport, pollvalue; //last IN that counted as a poll
+	I8259_t* i8259; //checked for pending IRQs before every instruction, can be NULL
+	uint8_t intshadow; //the last instruction was STI, MOV SS or POP SS, hold off IRQs for one more
 } CPU_t;
 
+extern const uint8_t byteregtable[8];
+extern const uint8_t parity[0x100];
+
 #define regax 0
 #define regcx 1
 #define regdx 2
@@ -158,12 +175,21 @@ void cpu_write(CPU_t* cpu, uint32_t addr32, uint8_t value);
 void cpu_writew(CPU_t* cpu, uint32_t addr32, uint16_t value);
 void cpu_intcall(CPU_t* cpu, uint8_t intnum);
 void cpu_reset(CPU_t* cpu);
-void cpu_interruptCheck(CPU_t* cpu, I8259_t* i8259);
+int cpu_setModel(CPU_t* cpu, uint8_t model);
+uint8_t cpu_findModel(char* name);
+char* cpu_modelName(uint8_t model);
+uint8_t cpu_idle(CPU_t* cpu);
+void cpu_pollCheck(CPU_t* cpu, uint16_t portnum, uint16_t value);
 void cpu_exec(CPU_t* cpu, uint32_t execloops);
+void cpu_exec_8086(CPU_t* cpu, uint32_t execloops);
+void cpu_exec_v20(CPU_t* cpu, uint32_t execloops);
+void cpu_exec_186(CPU_t* cpu, uint32_t execloops);
 void port_write(CPU_t* cpu, uint16_t portnum, uint8_t value);
 void port_writew(CPU_t* cpu, uint16_t portnum, uint16_t value);
 uint8_t port_read(CPU_t* cpu, uint16_t portnum);
 uint16_t port_readw(CPU_t* cpu, uint16_t portnum);
+void port_readsw(CPU_t* cpu, uint16_t portnum, uint16_t* data, uint32_t count);
+void port_writesw(CPU_t* cpu, uint16_t portnum, const uint16_t* data, uint32_t count);
 void cpu_registerIntCallback(CPU_t* cpu, uint8_t interrupt, void (*cb)(CPU_t*, uint8_t));
 
 #endif
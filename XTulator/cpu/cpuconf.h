@@ -17,12 +17,8 @@
   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 */
 
-//Be sure to only define ONE of the CPU_* options at any given time, or you will likely get some unexpected/bad results!
-
-//#define CPU_8086
-//#define CPU_186
-#define CPU_V20
-//#define CPU_286
+//Behavior switches for each CPU model. The model's own file (cpu8086.c, cpuv20.c, cpu186.c)
+//defines ONE of the CPU_* options and includes this right before cpucore.h.
 
 #if defined(CPU_8086)
 #define CPU_CLEAR_ZF_ON_MUL
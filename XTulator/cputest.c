@@ -0,0 +1,568 @@
+/*
+  XTulator: A portable, open-source 80186 PC emulator.
+  Copyright (C)2020 Mike Chambers
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+	CPU conformance testing
+
+	Two ways of checking the CPU core, neither of which needs a machine or any ROMs:
+
+	-cputest <file> runs single instruction test vectors in the JSON format used by the
+	public 8088 single step test suites (one uncompressed file, an array of objects with
+	"name", "initial" and "final", each having "regs" and "ram"). Final states only list
+	registers that changed. Flags are compared through a mask so undefined flags can be
+	left out with -cputestmask.
+
+	-lockstep <a> <b> <image> runs a raw .COM style image on two CPU backends side by side,
+	each with its own 1 MB of RAM, and stops at the first instruction after which the
+	registers or the memory writes differ. The two backends have to be different cores.
+
+	A backend is a CPU model plus anything that can run one whole instruction on a CPU_t of
+	that model, see cputest_backends. Running -lockstep 8088 v20 is a quick way to find
+	where the model specific cores part ways.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "cputest.h"
+#include "memory.h"
+#include "ports.h"
+#include "timing.h"
+#include "debuglog.h"
+#include "cpu/cpu.h"
+
+char* cputest_file = NULL;
+char* cputest_backend = "8088";
+uint16_t cputest_flagmask = CPUTEST_DEFAULT_FLAGMASK;
+char* cputest_lockstep[3] = { NULL, NULL, NULL }; //backend A, backend B, image
+uint64_t cputest_lockstepCount = CPUTEST_DEFAULT_LOCKSTEP;
+
+CPUTEST_SIDE_t cputest_side[2];
+CPUTEST_VECTOR_t cputest_vector;
+
+const char* cputest_regNames[CPUTEST_REGS] = {
+	"ax", "bx", "cx", "dx", "cs", "ss", "ds", "es", "sp", "bp", "si", "di", "ip", "flags"
+};
+
+void cputest_stepInterpreter(CPU_t* cpu) {
+	uint16_t cs, ip;
+	uint32_t steps = 0;
+
+	//cpu_exec hands back control between REP iterations with IP still on the prefix
+	cs = cpu->segregs[regcs];
+	ip = cpu->ip;
+	do {
+		cpu_exec(cpu, 1);
+	} while (cpu->reptype && (cpu->segregs[regcs] == cs) && (cpu->ip == ip) && (++steps < CPUTEST_MAXREPEAT));
+}
+
+const CPUTEST_BACKEND_t cputest_backends[] = {
+	{ "8088", CPU_MODEL_8086, cputest_stepInterpreter },
+	{ "8086", CPU_MODEL_8086, cputest_stepInterpreter },
+	{ "v20", CPU_MODEL_V20, cputest_stepInterpreter },
+	{ "186", CPU_MODEL_186, cputest_stepInterpreter },
+	{ NULL, 0, NULL }
+};
+
+const CPUTEST_BACKEND_t* cputest_findBackend(char* name) {
+	int i;
+	for (i = 0; cputest_backends[i].name != NULL; i++) {
+		if (_stricmp(name, cputest_backends[i].name) == 0) {
+			return &cputest_backends[i];
+		}
+	}
+	debug_log(DEBUG_ERROR, "[CPUTEST] Unknown CPU backend: %s\r\n", name);
+	return NULL;
+}
+
+void cputest_logWrite(CPUTEST_SIDE_t* side, uint32_t addr, uint8_t value) {
+	side->RAM[addr] = value;
+	if (side->writes < CPUTEST_MAXWRITES) {
+		side->writeaddr[side->writes] = addr;
+		side->writeval[side->writes] = value;
+	}
+	side->writes++;
+}
+
+void cputest_sideSelect(CPUTEST_SIDE_t* side) {
+	memory_select(&side->memory);
+	ports_select(&side->ports);
+}
+
+//a bare CPU with 1 MB of flat RAM and nothing on the ports, writes go through the log if asked
+int cputest_sideInit(CPUTEST_SIDE_t* side, const CPUTEST_BACKEND_t* backend, uint8_t logwrites) {
+	side->backend = backend;
+	side->RAM = (uint8_t*)calloc(1, MEMORY_RANGE);
+	if (side->RAM == NULL) {
+		debug_log(DEBUG_ERROR, "[CPUTEST] Unable to allocate test memory\r\n");
+		return -1;
+	}
+	memory_init(&side->memory);
+	ports_init(&side->ports);
+	cputest_sideSelect(side);
+	if (logwrites) {
+		memory_mapRegister(0, MEMORY_RANGE, side->RAM, NULL);
+		memory_mapCallbackRegister(0, MEMORY_RANGE, NULL, (void*)cputest_logWrite, side);
+	}
+	else {
+		memory_mapRegister(0, MEMORY_RANGE, side->RAM, side->RAM);
+	}
+	memset(&side->cpu, 0, sizeof(CPU_t));
+	side->cpu.model = backend->model;
+	cpu_reset(&side->cpu);
+	side->writes = 0;
+	return 0;
+}
+
+void cputest_getRegs(CPU_t* cpu, uint16_t* reg) {
+	reg[CPUTEST_REG_AX] = cpu->regs.wordregs[regax];
+	reg[CPUTEST_REG_BX] = cpu->regs.wordregs[regbx];
+	reg[CPUTEST_REG_CX] = cpu->regs.wordregs[regcx];
+	reg[CPUTEST_REG_DX] = cpu->regs.wordregs[regdx];
+	reg[CPUTEST_REG_CS] = cpu->segregs[regcs];
+	reg[CPUTEST_REG_SS] = cpu->segregs[regss];
+	reg[CPUTEST_REG_DS] = cpu->segregs[regds];
+	reg[CPUTEST_REG_ES] = cpu->segregs[reges];
+	reg[CPUTEST_REG_SP] = cpu->regs.wordregs[regsp];
+	reg[CPUTEST_REG_BP] = cpu->regs.wordregs[regbp];
+	reg[CPUTEST_REG_SI] = cpu->regs.wordregs[regsi];
+	reg[CPUTEST_REG_DI] = cpu->regs.wordregs[regdi];
+	reg[CPUTEST_REG_IP] = cpu->ip;
+	reg[CPUTEST_REG_FLAGS] = makeflagsword(cpu);
+}
+
+void cputest_setRegs(CPU_t* cpu, uint16_t* reg) {
+	cpu->regs.wordregs[regax] = reg[CPUTEST_REG_AX];
+	cpu->regs.wordregs[regbx] = reg[CPUTEST_REG_BX];
+	cpu->regs.wordregs[regcx] = reg[CPUTEST_REG_CX];
+	cpu->regs.wordregs[regdx] = reg[CPUTEST_REG_DX];
+	cpu->segregs[regcs] = reg[CPUTEST_REG_CS];
+	cpu->segregs[regss] = reg[CPUTEST_REG_SS];
+	cpu->segregs[regds] = reg[CPUTEST_REG_DS];
+	cpu->segregs[reges] = reg[CPUTEST_REG_ES];
+	cpu->regs.wordregs[regsp] = reg[CPUTEST_REG_SP];
+	cpu->regs.wordregs[regbp] = reg[CPUTEST_REG_BP];
+	cpu->regs.wordregs[regsi] = reg[CPUTEST_REG_SI];
+	cpu->regs.wordregs[regdi] = reg[CPUTEST_REG_DI];
+	cpu->ip = reg[CPUTEST_REG_IP];
+	decodeflagsword(cpu, reg[CPUTEST_REG_FLAGS]);
+	cpu->hltstate = 0;
+	cpu->trap_toggle = 0;
+	cpu->reptype = 0;
+}
+
+uint8_t* cputest_loadFile(char* filename, uint32_t* size) {
+	FILE* file;
+	uint8_t* data;
+	long len;
+
+	file = fopen(filename, "rb");
+	if (file == NULL) {
+		debug_log(DEBUG_ERROR, "[CPUTEST] Unable to open %s\r\n", filename);
+		return NULL;
+	}
+	fseek(file, 0L, SEEK_END);
+	len = ftell(file);
+	fseek(file, 0L, SEEK_SET);
+	data = (uint8_t*)malloc((size_t)len + 1);
+	if ((data == NULL) || (fread(data, 1, (size_t)len, file) < (size_t)len)) {
+		debug_log(DEBUG_ERROR, "[CPUTEST] Unable to read %s\r\n", filename);
+		if (data != NULL) free(data);
+		fclose(file);
+		return NULL;
+	}
+	fclose(file);
+	data[len] = 0;
+	*size = (uint32_t)len;
+	return data;
+}
+
+/*
+	Just enough of a JSON reader for the test vector files. It works in place on the
+	loaded file and skips over anything it doesn't need, like the bus cycle traces.
+*/
+
+void cputest_skipSpace(CPUTEST_JSON_t* json) {
+	while ((json->pos < json->end) && ((*json->pos == ' ') || (*json->pos == '\t') || (*json->pos == '\r') || (*json->pos == '\n'))) {
+		json->pos++;
+	}
+}
+
+int cputest_expect(CPUTEST_JSON_t* json, char c) {
+	cputest_skipSpace(json);
+	if ((json->pos >= json->end) || (*json->pos != c)) {
+		debug_log(DEBUG_ERROR, "[CPUTEST] JSON error at offset %lu, expected '%c'\r\n", (uint32_t)(json->pos - json->start), c);
+		return -1;
+	}
+	json->pos++;
+	return 0;
+}
+
+//returns 1 and eats the character if it's next, for the optional commas and closing brackets
+int cputest_peek(CPUTEST_JSON_t* json, char c) {
+	cputest_skipSpace(json);
+	if ((json->pos < json->end) && (*json->pos == c)) {
+		json->pos++;
+		return 1;
+	}
+	return 0;
+}
+
+int cputest_readString(CPUTEST_JSON_t* json, char* dst, uint32_t size) {
+	uint32_t len = 0;
+
+	if (cputest_expect(json, '"')) {
+		return -1;
+	}
+	while ((json->pos < json->end) && (*json->pos != '"')) {
+		if ((*json->pos == '\\') && ((json->pos + 1) < json->end)) {
+			json->pos++;
+		}
+		if ((dst != NULL) && (len < (size - 1))) {
+			dst[len++] = *json->pos;
+		}
+		json->pos++;
+	}
+	if (dst != NULL) {
+		dst[len] = 0;
+	}
+	return cputest_expect(json, '"');
+}
+
+int cputest_readNumber(CPUTEST_JSON_t* json, uint32_t* val) {
+	cputest_skipSpace(json);
+	if ((json->pos >= json->end) || (*json->pos < '0') || (*json->pos > '9')) {
+		debug_log(DEBUG_ERROR, "[CPUTEST] JSON error at offset %lu, expected a number\r\n", (uint32_t)(json->pos - json->start));
+		return -1;
+	}
+	*val = 0;
+	while ((json->pos < json->end) && (*json->pos >= '0') && (*json->pos <= '9')) {
+		*val = (*val * 10) + (uint32_t)(*json->pos - '0');
+		json->pos++;
+	}
+	return 0;
+}
+
+int cputest_skipValue(CPUTEST_JSON_t* json) {
+	cputest_skipSpace(json);
+	if (json->pos >= json->end) {
+		return -1;
+	}
+	switch (*json->pos) {
+	case '"':
+		return cputest_readString(json, NULL, 0);
+	case '{':
+		json->pos++;
+		if (cputest_peek(json, '}')) return 0;
+		do {
+			if (cputest_readString(json, NULL, 0) || cputest_expect(json, ':') || cputest_skipValue(json)) return -1;
+		} while (cputest_peek(json, ','));
+		return cputest_expect(json, '}');
+	case '[':
+		json->pos++;
+		if (cputest_peek(json, ']')) return 0;
+		do {
+			if (cputest_skipValue(json)) return -1;
+		} while (cputest_peek(json, ','));
+		return cputest_expect(json, ']');
+	default: //numbers, true, false, null
+		while ((json->pos < json->end) && (*json->pos != ',') && (*json->pos != '}') && (*json->pos != ']')) {
+			json->pos++;
+		}
+		return 0;
+	}
+}
+
+int cputest_readRegs(CPUTEST_JSON_t* json, CPUTEST_STATE_t* state) {
+	char key[16];
+	uint32_t val;
+	int i;
+
+	if (cputest_expect(json, '{')) return -1;
+	if (cputest_peek(json, '}')) return 0;
+	do {
+		if (cputest_readString(json, key, sizeof(key)) || cputest_expect(json, ':') || cputest_readNumber(json, &val)) return -1;
+		for (i = 0; i < CPUTEST_REGS; i++) {
+			if (strcmp(key, cputest_regNames[i]) == 0) {
+				state->reg[i] = (uint16_t)val;
+				state->have[i] = 1;
+				break;
+			}
+		}
+	} while (cputest_peek(json, ','));
+	return cputest_expect(json, '}');
+}
+
+int cputest_readRam(CPUTEST_JSON_t* json, CPUTEST_STATE_t* state) {
+	uint32_t addr, val;
+
+	if (cputest_expect(json, '[')) return -1;
+	if (cputest_peek(json, ']')) return 0;
+	do {
+		if (cputest_expect(json, '[') || cputest_readNumber(json, &addr) || cputest_expect(json, ',') ||
+			cputest_readNumber(json, &val) || cputest_expect(json, ']')) return -1;
+		if (state->ramcount == CPUTEST_MAXRAM) {
+			debug_log(DEBUG_ERROR, "[CPUTEST] Too many memory entries in one state, the limit is %u\r\n", CPUTEST_MAXRAM);
+			return -1;
+		}
+		state->ramaddr[state->ramcount] = addr & MEMORY_MASK;
+		state->ramval[state->ramcount++] = (uint8_t)val;
+	} while (cputest_peek(json, ','));
+	return cputest_expect(json, ']');
+}
+
+int cputest_readState(CPUTEST_JSON_t* json, CPUTEST_STATE_t* state) {
+	char key[16];
+
+	memset(state->have, 0, sizeof(state->have));
+	state->ramcount = 0;
+	if (cputest_expect(json, '{')) return -1;
+	if (cputest_peek(json, '}')) return 0;
+	do {
+		if (cputest_readString(json, key, sizeof(key)) || cputest_expect(json, ':')) return -1;
+		if (strcmp(key, "regs") == 0) {
+			if (cputest_readRegs(json, state)) return -1;
+		}
+		else if (strcmp(key, "ram") == 0) {
+			if (cputest_readRam(json, state)) return -1;
+		}
+		else if (cputest_skipValue(json)) {
+			return -1;
+		}
+	} while (cputest_peek(json, ','));
+	return cputest_expect(json, '}');
+}
+
+int cputest_readVector(CPUTEST_JSON_t* json, CPUTEST_VECTOR_t* vector) {
+	char key[16];
+
+	vector->name[0] = 0;
+	if (cputest_expect(json, '{')) return -1;
+	if (cputest_peek(json, '}')) return 0;
+	do {
+		if (cputest_readString(json, key, sizeof(key)) || cputest_expect(json, ':')) return -1;
+		if (strcmp(key, "name") == 0) {
+			if (cputest_readString(json, vector->name, sizeof(vector->name))) return -1;
+		}
+		else if (strcmp(key, "initial") == 0) {
+			if (cputest_readState(json, &vector->initial)) return -1;
+		}
+		else if (strcmp(key, "final") == 0) {
+			if (cputest_readState(json, &vector->final)) return -1;
+		}
+		else if (cputest_skipValue(json)) {
+			return -1;
+		}
+	} while (cputest_peek(json, ','));
+	return cputest_expect(json, '}');
+}
+
+//returns 0 if the CPU ended up in the final state of the vector
+int cputest_check(CPUTEST_SIDE_t* side, CPUTEST_VECTOR_t* vector, uint16_t flagmask, uint32_t num) {
+	uint16_t reg[CPUTEST_REGS], expect, got;
+	uint32_t i;
+	int failed = 0;
+
+	cputest_getRegs(&side->cpu, reg);
+	for (i = 0; i < CPUTEST_REGS; i++) {
+		expect = vector->final.have[i] ? vector->final.reg[i] : vector->initial.reg[i];
+		got = reg[i];
+		if (i == CPUTEST_REG_FLAGS) {
+			expect &= flagmask;
+			got &= flagmask;
+		}
+		if (expect != got) {
+			if (!failed++) debug_log(DEBUG_INFO, "[CPUTEST] FAIL #%lu: %s\r\n", num, vector->name);
+			debug_log(DEBUG_INFO, "  %-5s expected %04X, got %04X\r\n", cputest_regNames[i], expect, got);
+		}
+	}
+	for (i = 0; i < vector->final.ramcount; i++) {
+		if (side->RAM[vector->final.ramaddr[i]] != vector->final.ramval[i]) {
+			if (!failed++) debug_log(DEBUG_INFO, "[CPUTEST] FAIL #%lu: %s\r\n", num, vector->name);
+			debug_log(DEBUG_INFO, "  [%05X] expected %02X, got %02X\r\n", vector->final.ramaddr[i], vector->final.ramval[i], side->RAM[vector->final.ramaddr[i]]);
+		}
+	}
+	return failed;
+}
+
+int cputest_runVectors(char* filename, char* backendname, uint16_t flagmask) {
+	const CPUTEST_BACKEND_t* backend;
+	CPUTEST_SIDE_t* side = &cputest_side[0];
+	CPUTEST_JSON_t json;
+	CPUTEST_VECTOR_t* vector = &cputest_vector;
+	uint8_t* data;
+	uint32_t size, i, count = 0, failed = 0;
+	uint64_t start;
+	double seconds;
+
+	backend = cputest_findBackend(backendname);
+	if (backend == NULL) {
+		return -1;
+	}
+	data = cputest_loadFile(filename, &size);
+	if (data == NULL) {
+		return -1;
+	}
+	if (cputest_sideInit(side, backend, 0)) {
+		free(data);
+		return -1;
+	}
+
+	json.start = json.pos = (char*)data;
+	json.end = json.start + size;
+
+	start = timing_getHostCur();
+	if (cputest_expect(&json, '[')) {
+		free(data);
+		return -1;
+	}
+	if (!cputest_peek(&json, ']')) {
+		do {
+			if (cputest_readVector(&json, vector)) {
+				debug_log(DEBUG_ERROR, "[CPUTEST] Could not read vector #%lu\r\n", count);
+				free(data);
+				return -1;
+			}
+			for (i = 0; i < vector->initial.ramcount; i++) {
+				side->RAM[vector->initial.ramaddr[i]] = vector->initial.ramval[i];
+			}
+			cputest_setRegs(&side->cpu, vector->initial.reg);
+			(*backend->step)(&side->cpu);
+			if (cputest_check(side, vector, flagmask, count)) {
+				failed++;
+			}
+			count++;
+		} while (cputest_peek(&json, ','));
+	}
+	seconds = (double)(timing_getHostCur() - start) / (double)timing_getHostFreq();
+	free(data);
+
+	debug_log(DEBUG_INFO, "[CPUTEST] %s: %lu vectors, %lu passed, %lu failed (%.0f vectors/s)\r\n",
+		filename, count, count - failed, failed, (seconds > 0) ? (double)count / seconds : 0);
+
+	return failed ? -1 : 0;
+}
+
+void cputest_dumpSide(CPUTEST_SIDE_t* side, uint16_t* other) {
+	uint16_t reg[CPUTEST_REGS];
+	uint32_t i;
+
+	cputest_getRegs(&side->cpu, reg);
+	debug_log(DEBUG_INFO, "  %s:", side->backend->name);
+	for (i = 0; i < CPUTEST_REGS; i++) {
+		debug_log(DEBUG_INFO, " %s=%04X%s", cputest_regNames[i], reg[i], (reg[i] != other[i]) ? "*" : "");
+	}
+	debug_log(DEBUG_INFO, "\r\n  %s wrote %lu bytes:", side->backend->name, side->writes);
+	for (i = 0; (i < side->writes) && (i < CPUTEST_MAXWRITES) && (i < 16); i++) {
+		debug_log(DEBUG_INFO, " [%05X]=%02X", side->writeaddr[i], side->writeval[i]);
+	}
+	debug_log(DEBUG_INFO, "%s\r\n", (side->writes > 16) ? " ..." : "");
+}
+
+int cputest_runLockstep(char* backenda, char* backendb, char* filename, uint64_t count) {
+	const CPUTEST_BACKEND_t* backend[2];
+	CPUTEST_SIDE_t* side;
+	uint16_t reg[2][CPUTEST_REGS], cs, ip;
+	uint8_t* data;
+	uint32_t size, i, base;
+	uint64_t num;
+	int s, diverged;
+
+	backend[0] = cputest_findBackend(backenda);
+	backend[1] = cputest_findBackend(backendb);
+	if ((backend[0] == NULL) || (backend[1] == NULL)) {
+		return -1;
+	}
+	//8088 and 8086 are the same core, running them against each other would never diverge
+	if ((backend[0]->model == backend[1]->model) && (backend[0]->step == backend[1]->step)) {
+		debug_log(DEBUG_ERROR, "[CPUTEST] %s and %s run on the same core, there is nothing to compare\r\n", backend[0]->name, backend[1]->name);
+		return -1;
+	}
+	data = cputest_loadFile(filename, &size);
+	if (data == NULL) {
+		return -1;
+	}
+	if (size > 0xFF00) {
+		debug_log(DEBUG_ERROR, "[CPUTEST] %s is too big for a .COM style image\r\n", filename);
+		free(data);
+		return -1;
+	}
+
+	base = ((uint32_t)CPUTEST_LOCKSTEP_SEGMENT << 4) + 0x100;
+	for (s = 0; s < 2; s++) {
+		side = &cputest_side[s];
+		if (cputest_sideInit(side, backend[s], 1)) {
+			free(data);
+			return -1;
+		}
+		memcpy(&side->RAM[base], data, size);
+		side->cpu.segregs[regcs] = CPUTEST_LOCKSTEP_SEGMENT;
+		side->cpu.segregs[regds] = CPUTEST_LOCKSTEP_SEGMENT;
+		side->cpu.segregs[reges] = CPUTEST_LOCKSTEP_SEGMENT;
+		side->cpu.segregs[regss] = CPUTEST_LOCKSTEP_SEGMENT;
+		side->cpu.regs.wordregs[regsp] = 0xFFFE;
+		side->cpu.ip = 0x100;
+	}
+	free(data);
+
+	debug_log(DEBUG_INFO, "[CPUTEST] Running %s in lockstep on %s and %s\r\n", filename, backend[0]->name, backend[1]->name);
+
+	for (num = 0; num < count; num++) {
+		cs = cputest_side[0].cpu.segregs[regcs];
+		ip = cputest_side[0].cpu.ip;
+		for (s = 0; s < 2; s++) {
+			side = &cputest_side[s];
+			cputest_sideSelect(side);
+			side->writes = 0;
+			(*side->backend->step)(&side->cpu);
+			cputest_getRegs(&side->cpu, reg[s]);
+			reg[s][CPUTEST_REG_FLAGS] &= cputest_flagmask;
+		}
+
+		diverged = (memcmp(reg[0], reg[1], sizeof(reg[0])) != 0) || (cputest_side[0].writes != cputest_side[1].writes);
+		for (i = 0; !diverged && (i < cputest_side[0].writes) && (i < CPUTEST_MAXWRITES); i++) {
+			if ((cputest_side[0].writeaddr[i] != cputest_side[1].writeaddr[i]) || (cputest_side[0].writeval[i] != cputest_side[1].writeval[i])) {
+				diverged = 1;
+			}
+		}
+
+		if (diverged) {
+			side = &cputest_side[0];
+			debug_log(DEBUG_INFO, "[CPUTEST] Divergence after %llu instructions, at %04X:%04X:", num + 1, cs, ip);
+			for (i = 0; i < 8; i++) {
+				debug_log(DEBUG_INFO, " %02X", side->RAM[(((uint32_t)cs << 4) + (uint16_t)(ip + i)) & MEMORY_MASK]);
+			}
+			debug_log(DEBUG_INFO, "\r\n");
+			cputest_dumpSide(&cputest_side[0], reg[1]);
+			cputest_dumpSide(&cputest_side[1], reg[0]);
+			return -1;
+		}
+
+		if (cputest_side[0].cpu.hltstate && !cputest_side[0].cpu.ifl) { //nothing can wake it up
+			debug_log(DEBUG_INFO, "[CPUTEST] Both CPUs halted with interrupts off\r\n");
+			num++;
+			break;
+		}
+	}
+
+	debug_log(DEBUG_INFO, "[CPUTEST] %llu instructions in lockstep, no divergence\r\n", num);
+	return 0;
+}
@@ -0,0 +1,78 @@
+#ifndef _CPUTEST_H_
+#define _CPUTEST_H_
+
+#include <stdint.h>
+#include "cpu/cpu.h"
+#include "memory.h"
+#include "ports.h"
+
+#define CPUTEST_REG_AX		0
+#define CPUTEST_REG_BX		1
+#define CPUTEST_REG_CX		2
+#define CPUTEST_REG_DX		3
+#define CPUTEST_REG_CS		4
+#define CPUTEST_REG_SS		5
+#define CPUTEST_REG_DS		6
+#define CPUTEST_REG_ES		7
+#define CPUTEST_REG_SP		8
+#define CPUTEST_REG_BP		9
+#define CPUTEST_REG_SI		10
+#define CPUTEST_REG_DI		11
+#define CPUTEST_REG_IP		12
+#define CPUTEST_REG_FLAGS	13
+#define CPUTEST_REGS		14
+
+#define CPUTEST_DEFAULT_FLAGMASK	0x0FD5 //only the flags that really exist, the test suites have the high bits set
+#define CPUTEST_MAXRAM				4096 //memory bytes listed per state in one vector
+#define CPUTEST_MAXWRITES			4096 //memory writes logged per instruction in lockstep mode
+#define CPUTEST_MAXREPEAT			0x20000 //a REP string instruction can't need more steps than this
+#define CPUTEST_DEFAULT_LOCKSTEP	100000000
+#define CPUTEST_LOCKSTEP_SEGMENT	0x1000 //images are loaded .COM style at offset 0x100
+
+typedef struct {
+	char* start;
+	char* pos;
+	char* end;
+} CPUTEST_JSON_t;
+
+typedef struct {
+	char* name;
+	uint8_t model;
+	void (*step)(CPU_t* cpu); //must run exactly one whole instruction, including all REP iterations
+} CPUTEST_BACKEND_t;
+
+typedef struct {
+	uint16_t reg[CPUTEST_REGS];
+	uint8_t have[CPUTEST_REGS]; //final states only list what changed
+	uint32_t ramcount;
+	uint32_t ramaddr[CPUTEST_MAXRAM];
+	uint8_t ramval[CPUTEST_MAXRAM];
+} CPUTEST_STATE_t;
+
+typedef struct {
+	char name[256];
+	CPUTEST_STATE_t initial;
+	CPUTEST_STATE_t final;
+} CPUTEST_VECTOR_t;
+
+typedef struct {
+	const CPUTEST_BACKEND_t* backend;
+	CPU_t cpu;
+	MEMORY_t memory;
+	PORTS_t ports;
+	uint8_t* RAM;
+	uint32_t writes;
+	uint32_t writeaddr[CPUTEST_MAXWRITES];
+	uint8_t writeval[CPUTEST_MAXWRITES];
+} CPUTEST_SIDE_t;
+
+int cputest_runVectors(char* filename, char* backendname, uint16_t flagmask);
+int cputest_runLockstep(char* backenda, char* backendb, char* filename, uint64_t count);
+
+extern char* cputest_file;
+extern char* cputest_backend;
+extern uint16_t cputest_flagmask;
+extern char* cputest_lockstep[3];
+extern uint64_t cputest_lockstepCount;
+
+#endif
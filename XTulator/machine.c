@@ -54,16 +54,16 @@
 #include "machine.h"
 
 /*
-	ID string, full description, init function, default video, speed in MHz (-1 = unlimited), default hardware flags
+	ID string, full description, init function, default video, CPU model, speed in MHz (-1 = unlimited), default hardware flags
 */
 const MACHINEDEF_t machine_defs[] = {
-	{ "generic_xt", "Generic XT clone with VGA, speed unlimited", machine_init_generic_xt, VIDEO_CARD_VGA, -1, MACHINE_HW_BLASTER | MACHINE_HW_UART1_MOUSE | MACHINE_HW_DISK_HLE | MACHINE_HW_RTC },
-	{ "ibm_xt", "IBM XT", machine_init_generic_xt, VIDEO_CARD_CGA, 4.77, MACHINE_HW_UART1_MOUSE | MACHINE_HW_RTC },
-	{ "ami_xt", "AMI XT clone", machine_init_generic_xt, VIDEO_CARD_CGA, 4.77, MACHINE_HW_UART1_MOUSE | MACHINE_HW_RTC },
-	{ "phoenix_xt", "Pheonix XT clone", machine_init_generic_xt, VIDEO_CARD_CGA, 4.77, MACHINE_HW_UART1_MOUSE | MACHINE_HW_RTC },
-	{ "xi8088", "Xi 8088", machine_init_generic_xt, VIDEO_CARD_CGA, 4.77, MACHINE_HW_UART1_MOUSE | MACHINE_HW_RTC },
-	{ "zenithss", "Zenith SuperSport 8088", machine_init_generic_xt, VIDEO_CARD_CGA, 4.77, MACHINE_HW_UART1_MOUSE | MACHINE_HW_RTC },
-	{ "landmark", "Supersoft/Landmark diagnostic ROM", machine_init_generic_xt, VIDEO_CARD_CGA, 4.77, MACHINE_HW_UART1_MOUSE | MACHINE_HW_RTC },
+	{ "generic_xt", "Generic XT clone with VGA, speed unlimited", machine_init_generic_xt, VIDEO_CARD_VGA, CPU_MODEL_V20, -1, MACHINE_HW_BLASTER | MACHINE_HW_UART1_MOUSE | MACHINE_HW_DISK_HLE | MACHINE_HW_RTC },
+	{ "ibm_xt", "IBM XT", machine_init_generic_xt, VIDEO_CARD_CGA, CPU_MODEL_8086, 4.77, MACHINE_HW_UART1_MOUSE | MACHINE_HW_RTC },
+	{ "ami_xt", "AMI XT clone", machine_init_generic_xt, VIDEO_CARD_CGA, CPU_MODEL_8086, 4.77, MACHINE_HW_UART1_MOUSE | MACHINE_HW_RTC },
+	{ "phoenix_xt", "Pheonix XT clone", machine_init_generic_xt, VIDEO_CARD_CGA, CPU_MODEL_8086, 4.77, MACHINE_HW_UART1_MOUSE | MACHINE_HW_RTC },
+	{ "xi8088", "Xi 8088", machine_init_generic_xt, VIDEO_CARD_CGA, CPU_MODEL_8086, 4.77, MACHINE_HW_UART1_MOUSE | MACHINE_HW_RTC },
+	{ "zenithss", "Zenith SuperSport 8088", machine_init_generic_xt, VIDEO_CARD_CGA, CPU_MODEL_8086, 4.77, MACHINE_HW_UART1_MOUSE | MACHINE_HW_RTC },
+	{ "landmark", "Supersoft/Landmark diagnostic ROM", machine_init_generic_xt, VIDEO_CARD_CGA, CPU_MODEL_8086, 4.77, MACHINE_HW_UART1_MOUSE | MACHINE_HW_RTC },
 	{ NULL }
 };
 
@@ -143,11 +143,12 @@ uint8_t mac[6] = { 0xac, 0xde, 0x48, 0x88, 0xbb, 0xab };
 int machine_init_generic_xt(MACHINE_t* machine) {
 	if (machine == NULL) return -1;
 
+	pcspeaker_init(&machine->pcspeaker); //must come before the PIT, which hooks into it
 	i8259_init(&machine->i8259);
+	machine->CPU.i8259 = &machine->i8259;
 	i8253_init(&machine->i8253, &machine->i8259, &machine->pcspeaker);
 	i8237_init(&machine->i8237, &machine->CPU);
-	i8255_init(&machine->i8255, &machine->KeyState, &machine->pcspeaker);
-	pcspeaker_init(&machine->pcspeaker);
+	i8255_init(&machine->i8255, &machine->KeyState, &machine->pcspeaker, &machine->i8253, &machine->i8259, machine->videocard);
 
 	//check machine HW flags and init devices accordingly
 	if ((machine->hwflags & MACHINE_HW_BLASTER) && !(machine->hwflags & MACHINE_HW_SKIP_BLASTER)) {
@@ -171,13 +172,11 @@ int machine_init_generic_xt(MACHINE_t* machine) {
 	else if ((machine->hwflags & MACHINE_HW_UART0_MOUSE) && !(machine->hwflags & MACHINE_HW_SKIP_UART0)) {
 		uart_init(&machine->UART[0], &machine->i8259, 0x3F8, 4, NULL, NULL, (void*)mouse_togglereset, NULL);
 		mouse_init(&machine->UART[0]);
-		timing_addTimer(mouse_rxpoll, NULL, baudrate / 9, TIMING_ENABLED);
 	}
 #ifdef ENABLE_TCP_MODEM
 	else if ((machine->hwflags & MACHINE_HW_UART0_TCPMODEM) && !(machine->hwflags & MACHINE_HW_SKIP_UART0)) {
 		uart_init(&machine->UART[0], &machine->i8259, 0x3F8, 4, (void*)tcpmodem_tx, &machine->tcpmodem[0], NULL, NULL);
 		tcpmodem_init(&machine->tcpmodem[0], &machine->UART[0], 23);
-		timing_addTimer(tcpmodem_rxpoll, &machine->tcpmodem[0], baudrate / 9, TIMING_ENABLED);
 	}
 #endif
 
@@ -187,13 +186,11 @@ int machine_init_generic_xt(MACHINE_t* machine) {
 	else if ((machine->hwflags & MACHINE_HW_UART1_MOUSE) && !(machine->hwflags & MACHINE_HW_SKIP_UART1)) {
 		uart_init(&machine->UART[1], &machine->i8259, 0x2F8, 3, NULL, NULL, (void*)mouse_togglereset, NULL);
 		mouse_init(&machine->UART[1]);
-		timing_addTimer(mouse_rxpoll, NULL, baudrate / 9, TIMING_ENABLED);
 	}
 #ifdef ENABLE_TCP_MODEM
 	else if ((machine->hwflags & MACHINE_HW_UART1_TCPMODEM) && !(machine->hwflags & MACHINE_HW_SKIP_UART1)) {
 		uart_init(&machine->UART[1], &machine->i8259, 0x2F8, 3, (void*)tcpmodem_tx, &machine->tcpmodem[1], NULL, NULL);
 		tcpmodem_init(&machine->tcpmodem[1], &machine->UART[1], 23);
-		timing_addTimer(tcpmodem_rxpoll, &machine->tcpmodem[1], baudrate / 9, TIMING_ENABLED);
 	}
 #endif
 
@@ -216,12 +213,12 @@ int machine_init_generic_xt(MACHINE_t* machine) {
 	biosdisk_init(&machine->CPU);
 #endif
 
-	switch (videocard) {
+	switch (machine->videocard) {
 	case VIDEO_CARD_CGA:
-		if (cga_init()) return -1;
+		if (cga_init(&machine->cga, machine->headless)) return -1;
 		break;
 	case VIDEO_CARD_VGA:
-		if (vga_init()) return -1;
+		if (vga_init(&machine->vga, machine->headless)) return -1;
 		break;
 	}
 
@@ -247,38 +244,45 @@ int machine_init(MACHINE_t* machine, char* id) {
 
 	debug_log(DEBUG_INFO, "[MACHINE] Initializing machine: \"%s\" (%s)\r\n", machine_defs[num].description, machine_defs[num].id);
 
-	//Initialize machine memory map
+	//Initialize machine memory map, ROM images are shared with any other instances using the same ones
 	while(1) {
 		uint8_t* temp;
 		if (machine_mem[num][i].memtype == MACHINE_MEM_ENDLIST) {
 			break;
 		}
-		temp = (uint8_t*)malloc((size_t)machine_mem[num][i].size);
-		if ((temp == NULL) &&
-			((machine_mem[num][i].required == MACHINE_ROM_REQUIRED) || (machine_mem[num][i].required == MACHINE_ROM_ISNOTROM))) {
-			debug_log(DEBUG_ERROR, "[MACHINE] ERROR: Unable to allocate %lu bytes of memory\r\n", machine_mem[num][i].size);
-			return -1;
-		}
 		if (machine_mem[num][i].memtype == MACHINE_MEM_RAM) {
+			temp = (uint8_t*)malloc((size_t)machine_mem[num][i].size);
+			if (temp == NULL) {
+				debug_log(DEBUG_ERROR, "[MACHINE] ERROR: Unable to allocate %lu bytes of memory\r\n", machine_mem[num][i].size);
+				return -1;
+			}
 			memory_mapRegister(machine_mem[num][i].start, machine_mem[num][i].size, temp, temp);
 		} else if (machine_mem[num][i].memtype == MACHINE_MEM_ROM) {
-			int ret;
-			ret = utility_loadFile(temp, machine_mem[num][i].size, machine_mem[num][i].filename);
-			if ((machine_mem[num][i].required == MACHINE_ROM_REQUIRED) && ret) {
-				debug_log(DEBUG_ERROR, "[MACHINE] Could not open file, or size is less than expected: %s\r\n", machine_mem[num][i].filename);
-				return -1;
+			temp = memory_loadROM(machine_mem[num][i].filename, machine_mem[num][i].size);
+			if (temp == NULL) {
+				if (machine_mem[num][i].required == MACHINE_ROM_REQUIRED) {
+					debug_log(DEBUG_ERROR, "[MACHINE] Could not open file, or size is less than expected: %s\r\n", machine_mem[num][i].filename);
+					return -1;
+				}
+			}
+			else {
+				memory_mapRegister(machine_mem[num][i].start, machine_mem[num][i].size, temp, NULL);
 			}
-			memory_mapRegister(machine_mem[num][i].start, machine_mem[num][i].size, temp, NULL);
 		}
 		i++;
 	}
 
 	machine->hwflags |= machine_defs[num].hwflags;
 
-	if (videocard == 0xFF) {
-		videocard = machine_defs[num].video;
+	if (machine->videocard == 0xFF) {
+		machine->videocard = machine_defs[num].video;
 	}
 
+	if (machine->CPU.model == CPU_MODEL_DEFAULT) {
+		machine->CPU.model = machine_defs[num].cpu;
+	}
+	debug_log(DEBUG_INFO, "[MACHINE] CPU model: %s\r\n", cpu_modelName(machine->CPU.model));
+
 	if (speedarg > 0) {
 		speed = speedarg;
 	} else if (speedarg < 0) {
@@ -294,6 +298,23 @@ int machine_init(MACHINE_t* machine, char* id) {
 	return num;
 }
 
+//Sets up the per-instance tables of a new machine and selects it on the calling thread
+void machine_setup(MACHINE_t* machine) {
+	memory_init(&machine->memory);
+	ports_init(&machine->ports);
+	timing_init(&machine->timing);
+	biosdisk_reset(&machine->biosdisk);
+	machine->videocard = 0xFF; //machine default unless the command line picks one
+	machine_select(machine);
+}
+
+void machine_select(MACHINE_t* machine) {
+	memory_select(&machine->memory);
+	ports_select(&machine->ports);
+	timing_select(&machine->timing);
+	biosdisk_select(&machine->biosdisk);
+}
+
 void machine_list() {
 	int machine = 0;
 
@@ -16,7 +16,13 @@
 #include "modules/audio/blaster.h"
 #include "modules/audio/pcspeaker.h"
 #include "modules/disk/fdc.h"
+#include "modules/disk/biosdisk.h"
 #include "modules/input/input.h"
+#include "modules/video/cga.h"
+#include "modules/video/vga.h"
+#include "memory.h"
+#include "ports.h"
+#include "timing.h"
 
 #define MACHINE_MEM_RAM			0
 #define MACHINE_MEM_ROM			1
@@ -46,7 +52,16 @@
 #define MACHINE_HW_SKIP_DISK			0x0800000000000000ULL
 #define MACHINE_HW_SKIP_RTC				0x0400000000000000ULL
 
+/*
+	Everything one emulated PC needs lives in here, so a process can run more than one of them.
+	The thread running a machine calls machine_select first so that the memory map, port
+	handlers, timers and disks it reaches through the global API are this machine's.
+*/
 typedef struct {
+	MEMORY_t memory;
+	PORTS_t ports;
+	TIMING_t timing;
+	BIOSDISK_t biosdisk;
 	CPU_t CPU;
 	I8259_t i8259;
 	I8253_t i8253;
@@ -67,6 +82,10 @@ typedef struct {
 #endif
 	KEYSTATE_t KeyState;
 	FDC_t fdc;
+	VGA_t vga;
+	CGA_t cga;
+	uint8_t videocard;
+	uint8_t headless;
 	uint64_t hwflags;
 	int pcap_if;
 } MACHINE_t;
@@ -84,12 +103,15 @@ typedef struct {
 	char* description;
 	int (*init)(MACHINE_t* machine);
 	uint8_t video;
+	uint8_t cpu;
 	double speed;
 	uint64_t hwflags;
 } MACHINEDEF_t;
 
 int machine_init_generic_xt(MACHINE_t* machine);
 int machine_init(MACHINE_t* machine, char* id);
+void machine_setup(MACHINE_t* machine);
+void machine_select(MACHINE_t* machine);
 void machine_list();
 
 #endif
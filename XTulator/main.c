@@ -20,6 +20,12 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
+#ifdef _WIN32
+#include <Windows.h>
+#include <process.h>
+#else
+#include <pthread.h>
+#endif
 #include "config.h"
 #include "args.h"
 #include "timing.h"
@@ -29,23 +35,36 @@
 #include "menus.h"
 #include "utility.h"
 #include "debuglog.h"
+#include "replay.h"
+#include "batch.h"
+#include "script.h"
+#include "capture.h"
+#include "bench.h"
+#include "cputest.h"
 #include "cpu/cpu.h"
-#include "chipset/i8259.h"
+#include "chipset/i8255.h"
 #include "modules/disk/biosdisk.h"
+#include "modules/video/vga.h"
 #include "modules/video/sdlconsole.h"
+#include "modules/video/ansiconsole.h"
+#include "modules/video/vncserver.h"
+#include "modules/video/shmframe.h"
+#include "modules/input/input.h"
+#include "modules/input/mouse.h"
 #include "modules/audio/sdlaudio.h"
 #ifdef USE_NE2000
 #include "modules/io/pcap-win32.h"
 #endif
 
 char* usemachine = "generic_xt"; //default
+uint8_t useconsole = CONSOLE_SDL;
 
 char title[64]; //assuming 64 isn't safe if somebody starts messing with STR_TITLE and STR_VERSION
 
 uint64_t ops = 0;
-uint32_t baudrate = 115200, ramsize = 640, instructionsperloop = 100, cpuLimitTimer;
-uint8_t videocard = 0xFF, showMIPS = 0;
-volatile uint8_t goCPU = 1, limitCPU = 0;
+uint32_t baudrate = 115200, ramsize = 640, instructionsperloop = 100;
+uint8_t showMIPS = 0;
+volatile uint8_t limitCPU = 0;
 volatile double speed = 0;
 
 volatile uint8_t running = 1;
@@ -55,41 +74,122 @@ MACHINE_t machine;
 void optimer(void* dummy) {
 	ops /= 10000;
 	if (showMIPS) {
-		debug_log(DEBUG_INFO, "%llu.%llu MIPS          \r", ops / 10, ops % 10);
+		if (limitCPU) {
+			debug_log(DEBUG_INFO, "%llu.%llu MIPS, %.1f%% of target speed          \r", ops / 10, ops % 10, timing_paceRatio() * 100.0);
+		}
+		else {
+			debug_log(DEBUG_INFO, "%llu.%llu MIPS          \r", ops / 10, ops % 10);
+		}
 	}
 	ops = 0;
 }
 
-void cputimer(void* dummy) {
-	goCPU = 1;
-}
-
 void setspeed(double mhz) {
 	if (mhz > 0) {
 		speed = mhz;
 		instructionsperloop = (uint32_t)((speed * 1000000.0) / 140000.0);
 		limitCPU = 1;
 		debug_log(DEBUG_INFO, "[MACHINE] Throttling speed to approximately a %.02f MHz 8088 (%lu instructions/sec)\r\n", speed, instructionsperloop * 10000);
-		timing_timerEnable(cpuLimitTimer);
+		timing_paceStart(&machine.CPU.clock, (uint64_t)instructionsperloop * 10000);
 	}
 	else {
 		speed = 0;
 		instructionsperloop = 100;
 		limitCPU = 0;
-		timing_timerDisable(cpuLimitTimer);
+		timing_paceStart(NULL, 0);
+	}
+}
+
+void main_input(INPUTEVENT_t* input) {
+#ifdef DEBUG_INPUT
+	debug_log(DEBUG_DETAIL, "[INPUT] Type %u code %02X, %llu us after the host saw it\r\n", input->type, input->code,
+		((timing_getHostCur() - input->time) * 1000000) / timing_getHostFreq());
+#endif
+	switch (input->type) {
+	case INPUT_EVENT_KEY:
+		if (replay_mode == REPLAY_MODE_PLAY) { //keyboard input comes from the replay log
+			break;
+		}
+		replay_logKey(input->code);
+		i8255_keyPush(&machine.i8255, input->code);
+		break;
+	case INPUT_EVENT_MOUSE:
+		mouse_action(input->code, input->state, input->xrel, input->yrel);
+		break;
+	case INPUT_EVENT_SPEED:
+		setspeed((double)input->xrel / 1000.0);
+		break;
+	case INPUT_EVENT_DEBUG:
+#ifdef DEBUG_VGA
+		if (input->code == 2) {
+			vga_dumpregs(&machine.vga);
+		}
+#endif
+		break;
+	}
+}
+
+#ifdef _WIN32
+unsigned __stdcall main_emulate(void* dummy) {
+#else
+void* main_emulate(void* dummy) {
+#endif
+	INPUTEVENT_t input;
+	uint32_t curloop = 0, batch;
+	uint64_t executed;
+
+	machine_select(&machine);
+	while (running) {
+		if (cpu_idle(&machine.CPU)) {
+			if (timing_idle(replay_nextEvent())) {
+				curloop = 99; //idle passes can take a while, keep up with the network
+			}
+		}
+		else {
+			batch = timing_budget(TIMING_BATCH_MAX);
+			executed = machine.CPU.totalexec;
+			cpu_exec(&machine.CPU, batch);
+			ops += machine.CPU.totalexec - executed; //halted slots aren't instructions
+		}
+		timing_loop();
+		if (timing_pace()) {
+			curloop = 99; //the guest is ahead and we slept, a good time to look at the network
+		}
+		sdlaudio_updateSampleTiming();
+		if (replay_mode == REPLAY_MODE_PLAY) {
+			replay_poll(&machine);
+		}
+		while (input_pop(&input)) {
+			main_input(&input);
+		}
+		if (++curloop == 100) {
+#ifdef USE_NE2000
+			pcap_rxPacket();
+#endif
+			curloop = 0;
+		}
 	}
+
+#ifdef _WIN32
+	return 0;
+#else
+	return NULL;
+#endif
 }
 
 int main(int argc, char *argv[]) {
+#ifdef _WIN32
+	HANDLE thread;
+#else
+	pthread_t thread;
+#endif
 
 	sprintf(title, "%s v%s pre alpha", STR_TITLE, STR_VERSION);
 
 	printf("%s (c)2020 Mike Chambers\r\n", title);
 	printf("[A portable, open source 80186 PC emulator]\r\n\r\n");
 
-	ports_init();
-	timing_init();
-	memory_init();
+	machine_setup(&machine);
 #ifdef _WIN32
 	menus_setMachine(&machine);
 #endif
@@ -99,8 +199,42 @@ int main(int argc, char *argv[]) {
 		return -1;
 	}
 
-	if (sdlconsole_init(title)) {
-		debug_log(DEBUG_ERROR, "[ERROR] SDL initialization failure\r\n");
+	if (batch_file != NULL) {
+		return batch_run(batch_file, batch_threads);
+	}
+
+	if (bench_file != NULL) {
+		return bench_run(usemachine, machine.CPU.model, bench_file, bench_count);
+	}
+
+	if (cputest_file != NULL) {
+		return cputest_runVectors(cputest_file, cputest_backend, cputest_flagmask);
+	}
+
+	if (cputest_lockstep[0] != NULL) {
+		return cputest_runLockstep(cputest_lockstep[0], cputest_lockstep[1], cputest_lockstep[2], cputest_lockstepCount);
+	}
+
+	switch (useconsole) {
+	case CONSOLE_SDL:
+		if (sdlconsole_init(title)) {
+			debug_log(DEBUG_ERROR, "[ERROR] SDL initialization failure\r\n");
+			return -1;
+		}
+		break;
+	case CONSOLE_ANSI:
+		if (ansiconsole_init(&machine)) {
+			return -1;
+		}
+		//fall through, nothing renders pixels unless a VNC viewer wants them
+	case CONSOLE_NONE:
+		machine.headless = (vncserver_port || (shmframe_name != NULL) || (capture_file != NULL)) ? 0 : 1;
+		break;
+	}
+	if (vncserver_port && vncserver_init(vncserver_port)) {
+		return -1;
+	}
+	if ((shmframe_name != NULL) && shmframe_init(shmframe_name)) {
 		return -1;
 	}
 
@@ -113,56 +247,60 @@ int main(int argc, char *argv[]) {
 		return -1;
 	}
 
-	if (bootdrive == 0xFF) {
-		if (biosdisk[2].inserted) {
-			bootdrive = 0x80;
-		}
-		else {
-			bootdrive = 0x00;
-		}
-	}
-
 	timing_addTimer(optimer, NULL, 10, TIMING_ENABLED);
-	cpuLimitTimer = timing_addTimer(cputimer, NULL, 10000, TIMING_DISABLED);
 	if (speed > 0) {
 		setspeed(speed);
 	}
-	while (running) {
-		static uint32_t curloop = 0;
-		if (limitCPU == 0) {
-			goCPU = 1;
+	if (replay_mode != REPLAY_MODE_OFF) {
+		//the instruction count is the clock now, replay_begin paces against it when recording and runs flat out on replay
+		limitCPU = 0;
+		if (replay_begin(&machine, &instructionsperloop)) {
+			return -1;
 		}
-		if (goCPU) {
-			cpu_interruptCheck(&machine.CPU, &machine.i8259);
-			cpu_exec(&machine.CPU, instructionsperloop);
-			ops += instructionsperloop;
-			goCPU = 0;
+	}
+	if ((script_file != NULL) && script_begin(&machine, script_file)) {
+		return -1;
+	}
+	if ((capture_file != NULL) && capture_begin(&machine, capture_file)) {
+		return -1;
+	}
+	//SDL wants its events pumped on the thread that made the window, so the guest moves out
+#ifdef _WIN32
+	thread = (HANDLE)_beginthreadex(NULL, 0, main_emulate, NULL, 0, NULL);
+#else
+	pthread_create(&thread, NULL, main_emulate, NULL);
+#endif
+	while (running) {
+		switch (useconsole) {
+		case CONSOLE_SDL:
+			sdlconsole_loop();
+			break;
+		case CONSOLE_ANSI:
+			ansiconsole_loop();
+			break;
+		default:
+			utility_sleep(SDLCONSOLE_WAIT_MS);
+			break;
 		}
-		timing_loop();
-		sdlaudio_updateSampleTiming();
-		if (++curloop == 100) {
-			switch (sdlconsole_loop()) {
-			case SDLCONSOLE_EVENT_KEY:
-				machine.KeyState.scancode = sdlconsole_getScancode();
-				machine.KeyState.isNew = 1;
-				i8259_doirq(&machine.i8259, 1);
-				break;
-			case SDLCONSOLE_EVENT_QUIT:
-				running = 0;
-				break;
-			case SDLCONSOLE_EVENT_DEBUG_1:
-				break;
-			case SDLCONSOLE_EVENT_DEBUG_2:
-				break;
-			}
-
+	}
+#ifdef _WIN32
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+#else
+	pthread_join(thread, NULL);
+#endif
 
+	replay_close();
+	capture_close();
+	shmframe_close();
 #ifdef USE_NE2000
-			pcap_rxPacket();
+	if (pcap_drops > 0) {
+		debug_log(DEBUG_INFO, "[PCAP-WIN32] %u received frames were dropped, the receive queue was full or they were too big\r\n", pcap_drops);
+	}
 #endif
-			curloop = 0;
-		}
+	if (useconsole == CONSOLE_ANSI) {
+		ansiconsole_close();
 	}
 
-	return 0;
+	return script_result;
 }
@@ -20,77 +20,183 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include "config.h"
 #include "cpu/cpu.h"
 #include "modules/video/cga.h"
 #include "modules/video/vga.h"
 #include "utility.h"
+#include "debuglog.h"
 #include "memory.h"
 
-uint8_t* memory_mapRead[MEMORY_RANGE];
-uint8_t* memory_mapWrite[MEMORY_RANGE];
-uint8_t (*memory_mapReadCallback[MEMORY_RANGE])(void* udata, uint32_t addr);
-void (*memory_mapWriteCallback[MEMORY_RANGE])(void* udata, uint32_t addr, uint8_t value);
-void* memory_udata[MEMORY_RANGE];
+/*
+	Each machine instance has its own page table. The thread that is running a machine
+	selects its table with memory_select, so the CPU and device code never need to know
+	which instance they belong to.
+*/
+THREADLOCAL MEMORY_t* memory_cur = NULL;
+
+MEMORY_ROM_t* memory_roms = NULL; //images shared between every instance
 
 void cpu_write(CPU_t* cpu, uint32_t addr32, uint8_t value) {
+	MEMORY_PAGE_t* page;
+
 	addr32 &= MEMORY_MASK;
+	page = &memory_cur->page[addr32 >> MEMORY_PAGESHIFT];
 
-	if (memory_mapWrite[addr32] != NULL) {
-		*(memory_mapWrite[addr32]) = value;
+	if (page->write != NULL) {
+		page->write[addr32 & MEMORY_PAGEMASK] = value;
 	}
-	else if (memory_mapWriteCallback[addr32] != NULL) {
-		(*memory_mapWriteCallback[addr32])(memory_udata[addr32], addr32, value);
+	else if (page->writecb != NULL) {
+		(*page->writecb)(page->udata, addr32, value);
 	}
 }
 
 uint8_t cpu_read(CPU_t* cpu, uint32_t addr32) {
+	MEMORY_PAGE_t* page;
+
 	addr32 &= MEMORY_MASK;
+	page = &memory_cur->page[addr32 >> MEMORY_PAGESHIFT];
 
-	if (memory_mapRead[addr32] != NULL) {
-		return *(memory_mapRead[addr32]);
+	if (page->read != NULL) {
+		return page->read[addr32 & MEMORY_PAGEMASK];
 	}
 
-	if (memory_mapReadCallback[addr32] != NULL) {
-		return (*memory_mapReadCallback[addr32])(memory_udata[addr32], addr32);
+	if (page->readcb != NULL) {
+		return (*page->readcb)(page->udata, addr32);
 	}
 
 	return 0xFF;
 }
 
+//Copies guest memory into a host buffer a page at a time, with a plain memcpy wherever a page is backed by a buffer
+void memory_readBlock(uint32_t addr32, uint8_t* dst, uint32_t len) {
+	MEMORY_PAGE_t* page;
+	uint32_t chunk, i;
+
+	while (len > 0) {
+		addr32 &= MEMORY_MASK;
+		page = &memory_cur->page[addr32 >> MEMORY_PAGESHIFT];
+		chunk = MEMORY_PAGESIZE - (addr32 & MEMORY_PAGEMASK);
+		if (chunk > len) {
+			chunk = len;
+		}
+		if (page->read != NULL) {
+			memcpy(dst, &page->read[addr32 & MEMORY_PAGEMASK], chunk);
+		}
+		else {
+			for (i = 0; i < chunk; i++) {
+				dst[i] = cpu_read(NULL, addr32 + i);
+			}
+		}
+		addr32 += chunk;
+		dst += chunk;
+		len -= chunk;
+	}
+}
+
+void memory_writeBlock(uint32_t addr32, const uint8_t* src, uint32_t len) {
+	MEMORY_PAGE_t* page;
+	uint32_t chunk, i;
+
+	while (len > 0) {
+		addr32 &= MEMORY_MASK;
+		page = &memory_cur->page[addr32 >> MEMORY_PAGESHIFT];
+		chunk = MEMORY_PAGESIZE - (addr32 & MEMORY_PAGEMASK);
+		if (chunk > len) {
+			chunk = len;
+		}
+		if (page->write != NULL) {
+			memcpy(&page->write[addr32 & MEMORY_PAGEMASK], src, chunk);
+		}
+		else {
+			for (i = 0; i < chunk; i++) {
+				cpu_write(NULL, addr32 + i, src[i]);
+			}
+		}
+		addr32 += chunk;
+		src += chunk;
+		len -= chunk;
+	}
+}
+
 void memory_mapRegister(uint32_t start, uint32_t len, uint8_t* readb, uint8_t* writeb) {
 	uint32_t i;
-	for (i = 0; i < len; i++) {
+
+	if ((start & MEMORY_PAGEMASK) || (len & MEMORY_PAGEMASK)) {
+		debug_log(DEBUG_ERROR, "[MEMORY] Mapping at %05X (%lu bytes) is not aligned to %u byte pages\r\n", start, len, MEMORY_PAGESIZE);
+		return;
+	}
+
+	for (i = 0; i < len; i += MEMORY_PAGESIZE) {
 		if ((start + i) >= MEMORY_RANGE) {
 			break;
 		}
-		memory_mapRead[start + i] = (readb == NULL) ? NULL : readb + i;
-		memory_mapWrite[start + i] = (writeb == NULL) ? NULL : writeb + i;
+		memory_cur->page[(start + i) >> MEMORY_PAGESHIFT].read = (readb == NULL) ? NULL : readb + i;
+		memory_cur->page[(start + i) >> MEMORY_PAGESHIFT].write = (writeb == NULL) ? NULL : writeb + i;
 	}
 }
 
 void memory_mapCallbackRegister(uint32_t start, uint32_t count, uint8_t(*readb)(void*, uint32_t), void (*writeb)(void*, uint32_t, uint8_t), void* udata) {
 	uint32_t i;
-	for (i = 0; i < count; i++) {
+
+	if ((start & MEMORY_PAGEMASK) || (count & MEMORY_PAGEMASK)) {
+		debug_log(DEBUG_ERROR, "[MEMORY] Callback mapping at %05X (%lu bytes) is not aligned to %u byte pages\r\n", start, count, MEMORY_PAGESIZE);
+		return;
+	}
+
+	for (i = 0; i < count; i += MEMORY_PAGESIZE) {
 		if ((start + i) >= MEMORY_RANGE) {
 			break;
 		}
-		memory_mapReadCallback[start + i] = readb;
-		memory_mapWriteCallback[start + i] = writeb;
-		memory_udata[start + i] = udata;
+		memory_cur->page[(start + i) >> MEMORY_PAGESHIFT].readcb = readb;
+		memory_cur->page[(start + i) >> MEMORY_PAGESHIFT].writecb = writeb;
+		memory_cur->page[(start + i) >> MEMORY_PAGESHIFT].udata = udata;
 	}
 }
 
-int memory_init() {
-	uint32_t i;
+/*
+	Loads a ROM image once per process and hands every caller the same buffer, so any
+	number of machine instances can map it read-only. Machines are created from a single
+	thread, so there's no locking here.
+*/
+uint8_t* memory_loadROM(char* filename, uint32_t size) {
+	MEMORY_ROM_t* rom;
+
+	for (rom = memory_roms; rom != NULL; rom = rom->next) {
+		if ((rom->size == size) && (strcmp(rom->filename, filename) == 0)) {
+			return rom->data;
+		}
+	}
 
-	for (i = 0; i < MEMORY_RANGE; i++) {
-		memory_mapRead[i] = NULL;
-		memory_mapWrite[i] = NULL;
-		memory_mapReadCallback[i] = NULL;
-		memory_mapWriteCallback[i] = NULL;
-		memory_udata[i] = NULL;
+	rom = (MEMORY_ROM_t*)malloc(sizeof(MEMORY_ROM_t));
+	if (rom == NULL) {
+		return NULL;
+	}
+	rom->data = (uint8_t*)malloc((size_t)size);
+	if (rom->data == NULL) {
+		free(rom);
+		return NULL;
 	}
+	if (utility_loadFile(rom->data, size, filename)) {
+		free(rom->data);
+		free(rom);
+		return NULL;
+	}
+	rom->filename = filename;
+	rom->size = size;
+	rom->next = memory_roms;
+	memory_roms = rom;
+
+	return rom->data;
+}
+
+void memory_select(MEMORY_t* memory) {
+	memory_cur = memory;
+}
+
+int memory_init(MEMORY_t* memory) {
+	memset(memory, 0, sizeof(MEMORY_t));
 
 	return 0;
 }
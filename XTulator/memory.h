@@ -6,8 +6,36 @@
 #define MEMORY_RANGE		0x100000
 #define MEMORY_MASK			0x0FFFFF
 
+#define MEMORY_PAGESHIFT	11 //2 KB pages, same granularity as the BIOS option ROM scan
+#define MEMORY_PAGESIZE		(1 << MEMORY_PAGESHIFT)
+#define MEMORY_PAGEMASK		(MEMORY_PAGESIZE - 1)
+#define MEMORY_PAGES		(MEMORY_RANGE >> MEMORY_PAGESHIFT)
+
+typedef struct {
+	uint8_t* read; //points at the first byte of the page when it's backed directly by a buffer
+	uint8_t* write;
+	uint8_t (*readcb)(void* udata, uint32_t addr);
+	void (*writecb)(void* udata, uint32_t addr, uint8_t value);
+	void* udata;
+} MEMORY_PAGE_t;
+
+typedef struct {
+	MEMORY_PAGE_t page[MEMORY_PAGES];
+} MEMORY_t;
+
+typedef struct MEMORY_ROM_s {
+	char* filename;
+	uint32_t size;
+	uint8_t* data;
+	struct MEMORY_ROM_s* next;
+} MEMORY_ROM_t;
+
+void memory_readBlock(uint32_t addr32, uint8_t* dst, uint32_t len);
+void memory_writeBlock(uint32_t addr32, const uint8_t* src, uint32_t len);
 void memory_mapRegister(uint32_t start, uint32_t len, uint8_t* readb, uint8_t* writeb);
 void memory_mapCallbackRegister(uint32_t start, uint32_t count, uint8_t(*readb)(void*, uint32_t), void (*writeb)(void*, uint32_t, uint8_t), void* udata);
-int memory_init();
+uint8_t* memory_loadROM(char* filename, uint32_t size);
+void memory_select(MEMORY_t* memory);
+int memory_init(MEMORY_t* memory);
 
 #endif
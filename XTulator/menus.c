@@ -30,12 +30,12 @@
 #include "timing.h"
 #include "utility.h"
 #include "menus.h"
+#include "modules/video/sdlconsole.h"
+#include "modules/input/input.h"
 
 WNDPROC menus_oldProc;
 MACHINE_t* menus_useMachine = NULL;
-uint32_t menus_resetTimer;
 const uint8_t menus_ctrlaltdel[3] = { 0x1D, 0x38, 0x53 };
-uint8_t menus_resetPos = 0;
 
 MENU_t menu_file[] = {
 	{ TEXT("Soft &reset (Ctrl-Alt-Del)"), MENUS_ENABLED, MENUS_FUNCTION, (void*)menus_reset },
@@ -106,16 +106,6 @@ int menus_buildMenu(HMENU* hmenuBar, wchar_t* title, MENU_t* menu) {
 	return 0;
 }
 
-void menus_resetCallback(void* dummy) {
-	menus_useMachine->KeyState.scancode = menus_ctrlaltdel[menus_resetPos++];
-	menus_useMachine->KeyState.isNew = 1;
-	i8259_doirq(&menus_useMachine->i8259, 1);
-
-	if (menus_resetPos == 3) {
-		timing_timerDisable(menus_resetTimer);
-	}
-}
-
 int menus_init(HWND hwnd) {
 	HMENU hmenuBar;
 
@@ -135,7 +125,6 @@ int menus_init(HWND hwnd) {
 	DrawMenuBar(hwnd);
 
 	menus_oldProc = (WNDPROC)SetWindowLong(hwnd, GWL_WNDPROC, (LONG_PTR)menus_wndProc);
-	menus_resetTimer = timing_addTimer(menus_resetCallback, NULL, 10, TIMING_DISABLED);
 
 	return 0;
 }
@@ -228,44 +217,58 @@ void menus_insertHard1() {
 }
 
 void menus_setBootFloppy0() {
-	bootdrive = 0;
+	menus_useMachine->biosdisk.bootdrive = 0;
 }
 
 void menus_setBootHard0() {
-	bootdrive = 2;
+	menus_useMachine->biosdisk.bootdrive = 2;
 }
 
-void menus_reset() {
-	menus_resetPos = 0;
-	timing_timerEnable(menus_resetTimer);
+void menus_reset() { //the keyboard FIFO spaces the keys out for the guest
+	uint8_t i;
+	for (i = 0; i < 3; i++) {
+		sdlconsole_pushKey(menus_ctrlaltdel[i]);
+	}
+}
+
+//the pacer belongs to the emulation thread, so the change goes over with the input events
+void menus_setSpeed(double mhz) {
+	INPUTEVENT_t input;
+
+	input.type = INPUT_EVENT_SPEED;
+	input.code = 0;
+	input.state = 0;
+	input.xrel = (int32_t)(mhz * 1000.0 + 0.5);
+	input.yrel = 0;
+	input_push(&input);
 }
 
 void menus_speed477() {
-	setspeed(4.77);
+	menus_setSpeed(4.77);
 }
 
 void menus_speed8() {
-	setspeed(8.0);
+	menus_setSpeed(8.0);
 }
 
 void menus_speed10() {
-	setspeed(10.0);
+	menus_setSpeed(10.0);
 }
 
 void menus_speed16() {
-	setspeed(16.0);
+	menus_setSpeed(16.0);
 }
 
 void menus_speed25() {
-	setspeed(25.0);
+	menus_setSpeed(25.0);
 }
 
 void menus_speed50() {
-	setspeed(50.0);
+	menus_setSpeed(50.0);
 }
 
 void menus_speedunlimited() {
-	setspeed(0);
+	menus_setSpeed(0);
 }
 
 #endif
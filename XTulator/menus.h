@@ -39,6 +39,7 @@ void menus_insertHard1();
 void menus_setBootFloppy0();
 void menus_setBootHard0();
 void menus_reset();
+void menus_setSpeed(double mhz);
 void menus_speed477();
 void menus_speed8();
 void menus_speed10();
@@ -77,6 +77,7 @@ void blaster_writecmd(BLASTER_t* blaster, uint8_t value) {
 			blaster->dmalen++;
 			blaster->lastcmd = 0;
 			blaster->dmacount = 0;
+			blaster->fifopos = blaster->fifolen = 0;
 			blaster->silencedsp = 0;
 			blaster->autoinit = 0;
 			blaster->dorecord = (blaster->lastcmd == 0x24) ? 1 : 0;
@@ -127,13 +128,15 @@ void blaster_writecmd(BLASTER_t* blaster, uint8_t value) {
 	case 0xE2: //DMA identification write
 	{
 		int16_t val = 0xAA, i;
+		uint8_t id;
 		for (i = 0; i < 8; i++) {
 			if ((value >> i) & 0x01) {
 				val += cmd_E2_table[i];
 			}
 		}
 		val += cmd_E2_table[8];
-		i8237_write(blaster->i8237, blaster->dmachan, (uint8_t)val);
+		id = (uint8_t)val;
+		i8237_writeBlock(blaster->i8237, blaster->dmachan, &id, 1);
 		blaster->lastcmd = 0;
 		return;
 	}
@@ -153,6 +156,7 @@ void blaster_writecmd(BLASTER_t* blaster, uint8_t value) {
 	case 0x1C: //auto-initialize DMA DAC, 8-bit
 	case 0x2C:
 		blaster->dmacount = 0;
+		blaster->fifopos = blaster->fifolen = 0;
 		blaster->silencedsp = 0;
 		blaster->autoinit = 1;
 		blaster->dorecord = (value == 0x2C) ? 1 : 0;
@@ -258,11 +262,25 @@ uint8_t blaster_read(BLASTER_t* blaster, uint16_t addr) {
 void blaster_generateSample(BLASTER_t* blaster) { //for DMA mode
 	if (blaster->silencedsp == 0) {
 		if (blaster->dorecord == 0) {
-			blaster->sample = i8237_read(blaster->i8237, blaster->dmachan);
+			//read ahead through the FIFO like the real DSP does, never past the end of the block
+			if (blaster->fifopos == blaster->fifolen) {
+				uint32_t want = blaster->dmalen - blaster->dmacount;
+				if (want > BLASTER_FIFOSIZE) {
+					want = BLASTER_FIFOSIZE;
+				}
+				blaster->fifolen = (uint8_t)i8237_readBlock(blaster->i8237, blaster->dmachan, blaster->fifo, want);
+				blaster->fifopos = 0;
+			}
+			if (blaster->fifopos < blaster->fifolen) {
+				blaster->sample = blaster->fifo[blaster->fifopos++];
+			} else {
+				blaster->sample = 128; //channel masked or stopped, play silence
+			}
 			blaster->sample -= 128;
 			blaster->sample *= 256;
 		} else {
-			i8237_write(blaster->i8237, blaster->dmachan, 128); //silence
+			uint8_t silence = 128;
+			i8237_writeBlock(blaster->i8237, blaster->dmachan, &silence, 1);
 		}
 	} else {
 		blaster->sample = 0;
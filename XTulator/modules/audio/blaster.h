@@ -5,6 +5,8 @@
 #include "../../chipset/i8237.h"
 #include "../../chipset/i8259.h"
 
+#define BLASTER_FIFOSIZE	32 //bytes the DSP pulls over DMA in one go
+
 typedef struct {
 	I8237_t* i8237;
 	I8259_t* i8259;
@@ -28,6 +30,9 @@ typedef struct {
 	uint8_t silencedsp;
 	uint8_t dorecord;
 	uint8_t activedma;
+	uint8_t fifo[BLASTER_FIFOSIZE];
+	uint8_t fifopos;
+	uint8_t fifolen;
 } BLASTER_t;
 
 void blaster_write(BLASTER_t* blaster, uint16_t addr, uint8_t value);
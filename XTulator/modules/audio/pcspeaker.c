@@ -17,58 +17,159 @@
   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 */
 
+/*
+	PC speaker
+
+	Rather than sampling the speaker state at the audio rate, every change of the speaker
+	output is recorded with a timestamp (from the PIT or port 61h writes) and the audio
+	samples are synthesized from those edges using band-limited steps (BLEP). This lets
+	PWM tricks like RealSound come through without aliasing, and costs nothing while the
+	speaker is idle.
+*/
+
 #include "../../config.h"
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
+#include <math.h>
 #include "pcspeaker.h"
 #include "../../timing.h"
 
-void pcspeaker_setGateState(PCSPEAKER_t* spk, uint8_t gate, uint8_t value) {
-	spk->pcspeaker_gate[gate] = value;
+#define PC_SPEAKER_PI	3.14159265358979323846
+
+float pcspeaker_blepTable[PC_SPEAKER_BLEP_PHASES][PC_SPEAKER_BLEP_WIDTH];
+
+void pcspeaker_buildBlep() {
+	int phase, i;
+	double t, x, w, sum, half, cutoff;
+
+	half = (double)(PC_SPEAKER_BLEP_WIDTH / 2);
+	cutoff = 0.9; //fraction of Nyquist to pass, leaves some room for the window's transition band
+
+	for (phase = 0; phase < PC_SPEAKER_BLEP_PHASES; phase++) {
+		sum = 0;
+		for (i = 0; i < PC_SPEAKER_BLEP_WIDTH; i++) {
+			t = (double)i - half - ((double)phase / (double)PC_SPEAKER_BLEP_PHASES);
+			x = PC_SPEAKER_PI * cutoff * t;
+			w = (fabs(t) >= half) ? 0 : 0.42 + 0.5 * cos(PC_SPEAKER_PI * t / half) + 0.08 * cos(2.0 * PC_SPEAKER_PI * t / half); //Blackman window
+			pcspeaker_blepTable[phase][i] = (float)(((x == 0) ? 1.0 : (sin(x) / x)) * w);
+			sum += pcspeaker_blepTable[phase][i];
+		}
+		for (i = 0; i < PC_SPEAKER_BLEP_WIDTH; i++) { //normalize so each impulse integrates to exactly one full step
+			pcspeaker_blepTable[phase][i] = (float)(pcspeaker_blepTable[phase][i] / sum);
+		}
+	}
 }
 
-void pcspeaker_selectGate(PCSPEAKER_t* spk, uint8_t value) {
-	spk->pcspeaker_gateSelect = value;
+void pcspeaker_addEdge(PCSPEAKER_t* spk, uint64_t time, int16_t delta) {
+	if (((spk->edgehead + 1) & (PC_SPEAKER_EDGE_RING - 1)) == spk->edgetail) {
+		//ring is full because nobody is pulling samples right now, fold the oldest edge straight into the output
+		spk->target += spk->edge[spk->edgetail].delta;
+		spk->accum += (float)spk->edge[spk->edgetail].delta;
+		spk->edgetail = (spk->edgetail + 1) & (PC_SPEAKER_EDGE_RING - 1);
+	}
+	spk->edge[spk->edgehead].time = time;
+	spk->edge[spk->edgehead].delta = delta;
+	spk->edgehead = (spk->edgehead + 1) & (PC_SPEAKER_EDGE_RING - 1);
 }
 
-void pcspeaker_callback(PCSPEAKER_t* spk) {
+void pcspeaker_update(PCSPEAKER_t* spk, uint64_t time) {
+	uint8_t level;
+
 	if (spk->pcspeaker_gateSelect == PC_SPEAKER_USE_TIMER2) {
-		if (spk->pcspeaker_gate[PC_SPEAKER_GATE_TIMER2] && spk->pcspeaker_gate[PC_SPEAKER_GATE_DIRECT]) {
-			if (spk->pcspeaker_amplitude < 15000) {
-				spk->pcspeaker_amplitude += PC_SPEAKER_MOVEMENT;
-			}
-		}
-		else {
-			if (spk->pcspeaker_amplitude > 0) {
-				spk->pcspeaker_amplitude -= PC_SPEAKER_MOVEMENT;
-			}
-		}
-		//pcspeaker_amplitude = 0;
+		level = spk->pcspeaker_gate[PC_SPEAKER_GATE_TIMER2] && spk->pcspeaker_gate[PC_SPEAKER_GATE_DIRECT];
 	}
 	else {
-		if (spk->pcspeaker_gate[PC_SPEAKER_GATE_DIRECT]) {
-			if (spk->pcspeaker_amplitude < 15000) {
-				spk->pcspeaker_amplitude += PC_SPEAKER_MOVEMENT;
-			}
-		}
-		else {
-			if (spk->pcspeaker_amplitude > 0) {
-				spk->pcspeaker_amplitude -= PC_SPEAKER_MOVEMENT;
-			}
-		}
+		level = spk->pcspeaker_gate[PC_SPEAKER_GATE_DIRECT];
+	}
+
+	if (level == spk->level) return;
+	spk->level = level;
+	pcspeaker_addEdge(spk, time, level ? PC_SPEAKER_AMPLITUDE : -PC_SPEAKER_AMPLITUDE);
+}
+
+void pcspeaker_setGateState(PCSPEAKER_t* spk, uint8_t gate, uint8_t value, uint64_t time) {
+	spk->pcspeaker_gate[gate] = value;
+	pcspeaker_update(spk, time);
+}
+
+void pcspeaker_selectGate(PCSPEAKER_t* spk, uint8_t value, uint64_t time) {
+	spk->pcspeaker_gateSelect = value;
+	pcspeaker_update(spk, time);
+}
+
+void pcspeaker_blepAdd(PCSPEAKER_t* spk, double pos, int16_t delta) {
+	int i, phase;
+
+	phase = (int)(pos * (double)PC_SPEAKER_BLEP_PHASES);
+	if (phase < 0) phase = 0;
+	if (phase >= PC_SPEAKER_BLEP_PHASES) phase = PC_SPEAKER_BLEP_PHASES - 1;
+
+	for (i = 0; i < PC_SPEAKER_BLEP_WIDTH; i++) {
+		spk->blep[(spk->bleppos + i) & (PC_SPEAKER_BLEP_RING - 1)] += (float)delta * pcspeaker_blepTable[phase][i];
 	}
-	if (spk->pcspeaker_amplitude > 15000) spk->pcspeaker_amplitude = 15000;
-	if (spk->pcspeaker_amplitude < 0) spk->pcspeaker_amplitude = 0;
+	spk->target += delta;
+	spk->settle = 0;
 }
 
 void pcspeaker_init(PCSPEAKER_t* spk) {
 	memset(spk, 0, sizeof(PCSPEAKER_t));
 	spk->pcspeaker_gateSelect = PC_SPEAKER_GATE_DIRECT;
-	timing_addTimer(pcspeaker_callback, spk, SAMPLE_RATE, TIMING_ENABLED);
+	spk->sampleinterval = (double)timing_getFreq() / (double)SAMPLE_RATE;
+	spk->sampletime = timing_getCur();
+	pcspeaker_buildBlep();
 }
 
 int16_t pcspeaker_getSample(PCSPEAKER_t* spk) {
-	//return 0; //PC speaker is really broken, so silence for now
+	uint64_t now, start, end;
+	double pos;
+
+	now = timing_getCur();
+	//if sample generation was stalled or ran ahead for a while, jump back in sync with real time
+	if ((now > (spk->sampletime + (timing_getFreq() / 20))) || (spk->sampletime > (now + (timing_getFreq() / 20)))) {
+		spk->sampletime = now;
+		spk->samplefrac = 0;
+	}
+
+	if (spk->sync != NULL) {
+		(*spk->sync)(spk->syncudata, now);
+	}
+
+	start = spk->sampletime;
+	end = start + (uint64_t)(spk->samplefrac + spk->sampleinterval);
+
+	while (spk->edgetail != spk->edgehead) {
+		PCSPEAKER_EDGE_t* edge = &spk->edge[spk->edgetail];
+		if (edge->time >= end) break;
+		if (edge->time <= start) {
+			pos = 0;
+		}
+		else {
+			pos = ((double)(edge->time - start) - spk->samplefrac) / spk->sampleinterval;
+			if (pos < 0) pos = 0;
+		}
+		pcspeaker_blepAdd(spk, pos, edge->delta);
+		spk->edgetail = (spk->edgetail + 1) & (PC_SPEAKER_EDGE_RING - 1);
+	}
+
+	spk->accum += spk->blep[spk->bleppos];
+	spk->blep[spk->bleppos] = 0;
+	spk->bleppos = (spk->bleppos + 1) & (PC_SPEAKER_BLEP_RING - 1);
+
+	//once every deposited step has fully played out, snap to the exact level so float rounding can't drift
+	if (spk->settle < PC_SPEAKER_BLEP_WIDTH) {
+		if (++spk->settle == PC_SPEAKER_BLEP_WIDTH) {
+			spk->accum = (float)spk->target;
+		}
+	}
+
+	spk->samplefrac += spk->sampleinterval;
+	spk->sampletime += (uint64_t)spk->samplefrac;
+	spk->samplefrac -= (double)(uint64_t)spk->samplefrac;
+
+	if (spk->accum > 32767) spk->pcspeaker_amplitude = 32767;
+	else if (spk->accum < -32768) spk->pcspeaker_amplitude = -32768;
+	else spk->pcspeaker_amplitude = (int16_t)spk->accum;
+
 	return spk->pcspeaker_amplitude;
 }
@@ -9,16 +9,40 @@
 #define PC_SPEAKER_USE_DIRECT	0
 #define PC_SPEAKER_USE_TIMER2	1
 
-#define PC_SPEAKER_MOVEMENT		800
+#define PC_SPEAKER_AMPLITUDE	15000
+
+#define PC_SPEAKER_EDGE_RING	1024 //must be a power of two
+#define PC_SPEAKER_BLEP_PHASES	32
+#define PC_SPEAKER_BLEP_WIDTH	16
+#define PC_SPEAKER_BLEP_RING	32 //must be a power of two and at least PC_SPEAKER_BLEP_WIDTH
+
+typedef struct {
+	uint64_t time;
+	int16_t delta;
+} PCSPEAKER_EDGE_t;
 
 typedef struct {
 	uint8_t pcspeaker_gateSelect;
 	uint8_t pcspeaker_gate[2];
 	int16_t pcspeaker_amplitude;
+	uint8_t level;
+	PCSPEAKER_EDGE_t edge[PC_SPEAKER_EDGE_RING];
+	uint16_t edgehead;
+	uint16_t edgetail;
+	float blep[PC_SPEAKER_BLEP_RING];
+	uint8_t bleppos;
+	float accum;
+	int32_t target;
+	uint8_t settle;
+	uint64_t sampletime;
+	double samplefrac;
+	double sampleinterval;
+	void (*sync)(void*, uint64_t); //lets the timer catch up on edges before samples are taken
+	void* syncudata;
 } PCSPEAKER_t;
 
-void pcspeaker_setGateState(PCSPEAKER_t* spk, uint8_t gate, uint8_t value);
-void pcspeaker_selectGate(PCSPEAKER_t* spk, uint8_t value);
+void pcspeaker_setGateState(PCSPEAKER_t* spk, uint8_t gate, uint8_t value, uint64_t time);
+void pcspeaker_selectGate(PCSPEAKER_t* spk, uint8_t value, uint64_t time);
 int16_t pcspeaker_getSample(PCSPEAKER_t* spk);
 void pcspeaker_init(PCSPEAKER_t* spk);
 
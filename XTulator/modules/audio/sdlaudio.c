@@ -33,6 +33,7 @@
 #include "../../timing.h"
 #include "../../utility.h"
 #include "../../debuglog.h"
+#include "../../capture.h"
 #ifdef _WIN32
 #include <Windows.h>
 #include <SDL/SDL.h>
@@ -73,6 +74,7 @@ void sdlaudio_fill(void* udata, uint8_t* stream, int len) {
 	//SDL_LockMutex(sdlaudio_mutex);
 	//SDL_CondWait(sdlaudio_canFill, sdlaudio_mutex);
 
+	machine_select(sdlaudio_useMachine); //SDL's audio thread, it re-arms the sample timer
 	sdlaudio_moveBuffer((int16_t*)stream, len);
 
 	//SDL_UnlockMutex(sdlaudio_mutex);
@@ -173,20 +175,35 @@ void sdlaudio_moveBuffer(int16_t* dst, int len) {
 	sdlaudio_bufferpos -= len >> 1;
 }
 
-void sdlaudio_generateSample(void* dummy) {
+//mixes one sample from all of a machine's sound devices
+int16_t sdlaudio_mixSample(MACHINE_t* machine) {
 	int16_t val;
 
-	val = pcspeaker_getSample(&sdlaudio_useMachine->pcspeaker) / 3;
-	//val += opl2_generateSample(&sdlaudio_useMachine->OPL2) / 3;
-	if (sdlaudio_useMachine->mixOPL) {
+	val = pcspeaker_getSample(&machine->pcspeaker) / 3;
+	//val += opl2_generateSample(&machine->OPL2) / 3;
+	if (machine->mixOPL) {
 		int16_t OPLsample[2];
 		//val += sdlaudio_getOPLsample() / 2;
-		OPL3_GenerateStream(&sdlaudio_useMachine->OPL3, OPLsample, 1);
+		OPL3_GenerateStream(&machine->OPL3, OPLsample, 1);
 		val += OPLsample[0] / 2;
 	}
-	if (sdlaudio_useMachine->mixBlaster) {
-		val += blaster_getSample(&sdlaudio_useMachine->blaster) / 3;
+	if (machine->mixBlaster) {
+		val += blaster_getSample(&machine->blaster) / 3;
+	}
+
+	return val;
+}
+
+void sdlaudio_generateSample(void* dummy) {
+	if (capture_active) { //capture mixes on its own timer while it runs and passes the samples on
+		return;
 	}
+	sdlaudio_bufferSample(sdlaudio_mixSample(sdlaudio_useMachine));
+}
 
+void sdlaudio_playSample(int16_t val) {
+	if (sdlaudio_useMachine == NULL) { //audio never opened
+		return;
+	}
 	sdlaudio_bufferSample(val);
 }
@@ -12,7 +12,9 @@
 #define SDLAUDIO_TIMING_NORMAL		2
 
 int sdlaudio_init(MACHINE_t* machine);
+int16_t sdlaudio_mixSample(MACHINE_t* machine);
 void sdlaudio_generateSample(void* dummy);
+void sdlaudio_playSample(int16_t val);
 void sdlaudio_updateSampleTiming();
 
 #endif
@@ -28,73 +28,84 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 #include "biosdisk.h"
+#include "../../config.h"
 #include "../../cpu/cpu.h"
 #include "../../debuglog.h"
 
-DISK_t biosdisk[4];
-uint8_t biosdisk_sectbuf[512];
-
-uint8_t bootdrive = 0xFF;
+THREADLOCAL BIOSDISK_t* biosdisk_cur = NULL; //drives of the machine this thread is running
 
 uint8_t biosdisk_insert(CPU_t* cpu, uint8_t drivenum, char* filename) {
+	DISK_t* disk = &biosdisk_cur->disk[drivenum];
+	FILE* file;
 	debug_log(DEBUG_INFO, "[BIOSDISK] Inserting disk %u: %s\r\n", drivenum, filename);
-	if (biosdisk[drivenum].inserted) fclose(biosdisk[drivenum].diskfile);
-	biosdisk[drivenum].inserted = 1;
-	biosdisk[drivenum].diskfile = fopen(filename, "r+b");
-	if (biosdisk[drivenum].diskfile == NULL) {
-		biosdisk[drivenum].inserted = 0;
+	file = fopen(filename, "r+b");
+	if (file == NULL) {
+		if (disk->inserted) fclose(disk->diskfile);
+		disk->inserted = 0;
 		debug_log(DEBUG_INFO, "[BIOSDISK] Failed to insert disk %u: %s\r\n", drivenum, filename);
 		return 1;
 	}
-	fseek(biosdisk[drivenum].diskfile, 0L, SEEK_END);
-	biosdisk[drivenum].filesize = ftell(biosdisk[drivenum].diskfile);
-	fseek(biosdisk[drivenum].diskfile, 0L, SEEK_SET);
+	biosdisk_insertFile(cpu, drivenum, file);
+	return 0;
+}
+
+//takes over an already open image, it's closed again on eject
+void biosdisk_insertFile(CPU_t* cpu, uint8_t drivenum, FILE* file) {
+	DISK_t* disk = &biosdisk_cur->disk[drivenum];
+	if (disk->inserted) fclose(disk->diskfile);
+	disk->inserted = 1;
+	disk->diskfile = file;
+	fseek(disk->diskfile, 0L, SEEK_END);
+	disk->filesize = ftell(disk->diskfile);
+	fseek(disk->diskfile, 0L, SEEK_SET);
 	if (drivenum >= 2) { //it's a hard disk image
-		biosdisk[drivenum].sects = 63;
-		biosdisk[drivenum].heads = 16;
-		biosdisk[drivenum].cyls = biosdisk[drivenum].filesize / (biosdisk[drivenum].sects * biosdisk[drivenum].heads * 512);
+		disk->sects = 63;
+		disk->heads = 16;
+		disk->cyls = disk->filesize / (disk->sects * disk->heads * 512);
 		cpu_write(cpu, 0x475, biosdisk_gethdcount());
 	}
 	else {   //it's a floppy image
-		biosdisk[drivenum].cyls = 80;
-		biosdisk[drivenum].sects = 18;
-		biosdisk[drivenum].heads = 2;
-		if (biosdisk[drivenum].filesize <= 1228800) biosdisk[drivenum].sects = 15;
-		if (biosdisk[drivenum].filesize <= 737280) biosdisk[drivenum].sects = 9;
-		if (biosdisk[drivenum].filesize <= 368640) {
-			biosdisk[drivenum].cyls = 40;
-			biosdisk[drivenum].sects = 9;
+		disk->cyls = 80;
+		disk->sects = 18;
+		disk->heads = 2;
+		if (disk->filesize <= 1228800) disk->sects = 15;
+		if (disk->filesize <= 737280) disk->sects = 9;
+		if (disk->filesize <= 368640) {
+			disk->cyls = 40;
+			disk->sects = 9;
 		}
-		if (biosdisk[drivenum].filesize <= 163840) {
-			biosdisk[drivenum].cyls = 40;
-			biosdisk[drivenum].sects = 8;
-			biosdisk[drivenum].heads = 1;
+		if (disk->filesize <= 163840) {
+			disk->cyls = 40;
+			disk->sects = 8;
+			disk->heads = 1;
 		}
 	}
-	return 0;
 }
 
 void biosdisk_eject(CPU_t* cpu, uint8_t drivenum) {
-	biosdisk[drivenum].inserted = 0;
+	DISK_t* disk = &biosdisk_cur->disk[drivenum];
+	disk->inserted = 0;
 	if (drivenum >= 2) {
 		cpu_write(cpu, 0x475, biosdisk_gethdcount());
 	}
-	if (biosdisk[drivenum].diskfile != NULL) fclose(biosdisk[drivenum].diskfile);
+	if (disk->diskfile != NULL) fclose(disk->diskfile);
 }
 
 void biosdisk_read(CPU_t* cpu, uint8_t drivenum, uint16_t dstseg, uint16_t dstoff, uint16_t cyl, uint16_t sect, uint16_t head, uint16_t sectcount) {
+	DISK_t* disk = &biosdisk_cur->disk[drivenum];
 	uint32_t memdest, lba, fileoffset, cursect, sectoffset;
-	if (!sect || !biosdisk[drivenum].inserted) return;
-	lba = ((uint32_t)cyl * (uint32_t)biosdisk[drivenum].heads + (uint32_t)head) * (uint32_t)biosdisk[drivenum].sects + (uint32_t)sect - 1UL;
+	if (!sect || !disk->inserted) return;
+	lba = ((uint32_t)cyl * (uint32_t)disk->heads + (uint32_t)head) * (uint32_t)disk->sects + (uint32_t)sect - 1UL;
 	fileoffset = lba * 512UL;
-	if (fileoffset > biosdisk[drivenum].filesize) return;
-	fseek(biosdisk[drivenum].diskfile, fileoffset, SEEK_SET);
+	if (fileoffset > disk->filesize) return;
+	fseek(disk->diskfile, fileoffset, SEEK_SET);
 	memdest = ((uint32_t)dstseg << 4) + (uint32_t)dstoff;
 	for (cursect = 0; cursect < sectcount; cursect++) {
-		if (fread(biosdisk_sectbuf, 1, 512, biosdisk[drivenum].diskfile) < 512) break;
+		if (fread(biosdisk_cur->sectbuf, 1, 512, disk->diskfile) < 512) break;
 		for (sectoffset = 0; sectoffset < 512; sectoffset++) {
-			cpu_write(cpu, memdest++, biosdisk_sectbuf[sectoffset]);
+			cpu_write(cpu, memdest++, biosdisk_cur->sectbuf[sectoffset]);
 		}
 	}
 	cpu->regs.byteregs[regal] = cursect;
@@ -103,18 +114,19 @@ void biosdisk_read(CPU_t* cpu, uint8_t drivenum, uint16_t dstseg, uint16_t dstof
 }
 
 void biosdisk_write(CPU_t* cpu, uint8_t drivenum, uint16_t dstseg, uint16_t dstoff, uint16_t cyl, uint16_t sect, uint16_t head, uint16_t sectcount) {
+	DISK_t* disk = &biosdisk_cur->disk[drivenum];
 	uint32_t memdest, lba, fileoffset, cursect, sectoffset;
-	if (!sect || !biosdisk[drivenum].inserted) return;
-	lba = ((uint32_t)cyl * (uint32_t)biosdisk[drivenum].heads + (uint32_t)head) * (uint32_t)biosdisk[drivenum].sects + (uint32_t)sect - 1UL;
+	if (!sect || !disk->inserted) return;
+	lba = ((uint32_t)cyl * (uint32_t)disk->heads + (uint32_t)head) * (uint32_t)disk->sects + (uint32_t)sect - 1UL;
 	fileoffset = lba * 512UL;
-	if (fileoffset > biosdisk[drivenum].filesize) return;
-	fseek(biosdisk[drivenum].diskfile, fileoffset, SEEK_SET);
+	if (fileoffset > disk->filesize) return;
+	fseek(disk->diskfile, fileoffset, SEEK_SET);
 	memdest = ((uint32_t)dstseg << 4) + (uint32_t)dstoff;
 	for (cursect = 0; cursect < sectcount; cursect++) {
 		for (sectoffset = 0; sectoffset < 512; sectoffset++) {
-			biosdisk_sectbuf[sectoffset] = cpu_read(cpu, memdest++);
+			biosdisk_cur->sectbuf[sectoffset] = cpu_read(cpu, memdest++);
 		}
-		fwrite(biosdisk_sectbuf, 1, 512, biosdisk[drivenum].diskfile);
+		fwrite(biosdisk_cur->sectbuf, 1, 512, disk->diskfile);
 	}
 	cpu->regs.byteregs[regal] = (uint8_t)sectcount;
 	cpu->cf = 0;
@@ -131,14 +143,13 @@ void biosdisk_int19h(CPU_t* cpu, uint8_t intnum) {
 	cpu_write(cpu, 0x07C01, 0xEB);
 	cpu_write(cpu, 0x07C02, 0xFE);
 
-	cpu->regs.byteregs[regdl] = bootdrive;
+	cpu->regs.byteregs[regdl] = biosdisk_cur->bootdrive;
 	biosdisk_read(cpu, (cpu->regs.byteregs[regdl] & 0x80) ? cpu->regs.byteregs[regdl] - 126 : cpu->regs.byteregs[regdl], 0x0000, 0x7C00, 0, 1, 0, 1);
 	cpu->segregs[regcs] = 0x0000;
 	cpu->ip = 0x7C00;
 }
 
 void biosdisk_int13h(CPU_t* cpu, uint8_t intnum) {
-	static uint8_t lastah = 0, lastcf = 0;
 	uint8_t curdisk;
 
 	if (intnum != 0x13) return;
@@ -157,11 +168,11 @@ void biosdisk_int13h(CPU_t* cpu, uint8_t intnum) {
 		cpu->cf = 0; //useless function in an emulator. say success and return.
 		break;
 	case 1: //return last status
-		cpu->regs.byteregs[regah] = lastah;
-		cpu->cf = lastcf;
+		cpu->regs.byteregs[regah] = biosdisk_cur->lastah;
+		cpu->cf = biosdisk_cur->lastcf;
 		return;
 	case 2: //read sector(s) into memory
-		if (biosdisk[curdisk].inserted) {
+		if (biosdisk_cur->disk[curdisk].inserted) {
 			biosdisk_read(cpu, curdisk, cpu->segregs[reges], getreg16(cpu, regbx), (uint16_t)cpu->regs.byteregs[regch] + ((uint16_t)cpu->regs.byteregs[regcl] / 64) * 256, (uint16_t)cpu->regs.byteregs[regcl] & 63, (uint16_t)cpu->regs.byteregs[regdh], (uint16_t)cpu->regs.byteregs[regal]);
 			cpu->cf = 0;
 			cpu->regs.byteregs[regah] = 0;
@@ -172,7 +183,7 @@ void biosdisk_int13h(CPU_t* cpu, uint8_t intnum) {
 		}
 		break;
 	case 3: //write sector(s) from memory
-		if (biosdisk[curdisk].inserted) {
+		if (biosdisk_cur->disk[curdisk].inserted) {
 			biosdisk_write(cpu, curdisk, cpu->segregs[reges], getreg16(cpu, regbx), (uint16_t)cpu->regs.byteregs[regch] + ((uint16_t)cpu->regs.byteregs[regcl] / 64) * 256, (uint16_t)cpu->regs.byteregs[regcl] & 63, (uint16_t)cpu->regs.byteregs[regdh], (uint16_t)cpu->regs.byteregs[regal]);
 			cpu->cf = 0;
 			cpu->regs.byteregs[regah] = 0;
@@ -188,13 +199,13 @@ void biosdisk_int13h(CPU_t* cpu, uint8_t intnum) {
 		cpu->regs.byteregs[regah] = 0;
 		break;
 	case 8: //get drive parameters
-		if (biosdisk[curdisk].inserted) {
+		if (biosdisk_cur->disk[curdisk].inserted) {
 			cpu->cf = 0;
 			cpu->regs.byteregs[regah] = 0;
-			cpu->regs.byteregs[regch] = biosdisk[curdisk].cyls - 1;
-			cpu->regs.byteregs[regcl] = biosdisk[curdisk].sects & 63;
-			cpu->regs.byteregs[regcl] = cpu->regs.byteregs[regcl] + (biosdisk[curdisk].cyls / 256) * 64;
-			cpu->regs.byteregs[regdh] = biosdisk[curdisk].heads - 1;
+			cpu->regs.byteregs[regch] = biosdisk_cur->disk[curdisk].cyls - 1;
+			cpu->regs.byteregs[regcl] = biosdisk_cur->disk[curdisk].sects & 63;
+			cpu->regs.byteregs[regcl] = cpu->regs.byteregs[regcl] + (biosdisk_cur->disk[curdisk].cyls / 256) * 64;
+			cpu->regs.byteregs[regdh] = biosdisk_cur->disk[curdisk].heads - 1;
 			if (curdisk < 2) {
 				cpu->regs.byteregs[regbl] = 4; //else regs.byteregs[regbl] = 0;
 				cpu->regs.byteregs[regdl] = 2;
@@ -209,8 +220,8 @@ void biosdisk_int13h(CPU_t* cpu, uint8_t intnum) {
 	default:
 		cpu->cf = 1;
 	}
-	lastah = cpu->regs.byteregs[regah];
-	lastcf = cpu->cf;
+	biosdisk_cur->lastah = cpu->regs.byteregs[regah];
+	biosdisk_cur->lastcf = cpu->cf;
 	if (cpu->regs.byteregs[regdl] & 0x80) cpu_write(cpu, 0x474, cpu->regs.byteregs[regah]);
 }
 
@@ -218,12 +229,24 @@ uint8_t biosdisk_gethdcount() {
 	uint8_t ret = 0, i;
 
 	for (i = 2; i < 4; i++) {
-		if (biosdisk[i].inserted) ret++;
+		if (biosdisk_cur->disk[i].inserted) ret++;
 	}
 	return ret;
 }
 
 void biosdisk_init(CPU_t* cpu) {
+	if (biosdisk_cur->bootdrive == 0xFF) {
+		biosdisk_cur->bootdrive = biosdisk_cur->disk[2].inserted ? 0x80 : 0x00;
+	}
 	cpu_registerIntCallback(cpu, 0x13, biosdisk_int13h);
 	cpu_registerIntCallback(cpu, 0x19, biosdisk_int19h);
 }
+
+void biosdisk_select(BIOSDISK_t* biosdisk) {
+	biosdisk_cur = biosdisk;
+}
+
+void biosdisk_reset(BIOSDISK_t* biosdisk) {
+	memset(biosdisk, 0, sizeof(BIOSDISK_t));
+	biosdisk->bootdrive = 0xFF; //pick automatically once the drives are known
+}
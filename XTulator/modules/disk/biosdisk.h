@@ -15,14 +15,22 @@ typedef struct {
 	char* filename;
 } DISK_t;
 
+typedef struct {
+	DISK_t disk[4];
+	uint8_t sectbuf[512];
+	uint8_t bootdrive;
+	uint8_t lastah;
+	uint8_t lastcf;
+} BIOSDISK_t;
+
 uint8_t biosdisk_insert(CPU_t* cpu, uint8_t drivenum, char* filename);
+void biosdisk_insertFile(CPU_t* cpu, uint8_t drivenum, FILE* file);
 void biosdisk_eject(CPU_t* cpu, uint8_t drivenum);
 void biosdisk_int13h(CPU_t* cpu, uint8_t intnum);
 void biosdisk_int19h(CPU_t* cpu, uint8_t intnum);
 uint8_t biosdisk_gethdcount();
 void biosdisk_init(CPU_t* cpu);
-
-extern uint8_t bootdrive;
-extern DISK_t biosdisk[4];
+void biosdisk_select(BIOSDISK_t* biosdisk);
+void biosdisk_reset(BIOSDISK_t* biosdisk);
 
 #endif
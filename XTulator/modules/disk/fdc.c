@@ -88,6 +88,7 @@ void fdc_cmd(FDC_t* fdc, uint8_t value) {
 		break;
 	case FDC_CMD_SPECIFY:
 		fdc->usedma = fdc->cmd[2] & 1;
+		fdc->steptime = 16 - (fdc->cmd[1] >> 4); //SRT, in ms at the 500 kbps data rate
 		break;
 	case FDC_CMD_SENSE_DRIVE_STATUS:
 		break;
@@ -98,18 +99,31 @@ void fdc_cmd(FDC_t* fdc, uint8_t value) {
 		fdc->position[drv].wanttrack = fdc->cmd[2];
 		fdc->position[drv].head = fdc->cmd[3];
 		fdc->position[drv].sect = fdc->cmd[4];
-		fdc->position[drv].seeking = 1;
-		fdc->position[drv].reading = 0; //read flag gets set after we seek to correct track (see fdc_move function)
 		fdc->position[drv].transferring = 0;
 		fdc->busy = 1;
+		fdc_seek(fdc, drv); //the first sector is scheduled once the head gets there (see fdc_move)
 		break;
-	case FDC_CMD_RECALIBRATE:
+	case FDC_CMD_RECALIBRATE: //the controller takes new commands while the head moves, the drive shows busy in the MSR
 		drv = fdc->cmd[1] & 3;
 		fdc->position[drv].wanttrack = 0;
-		fdc->position[drv].seeking = 1;
-		fdc->busy = 1;
+		fdc_seek(fdc, drv);
 		break;
 	case FDC_CMD_SENSE_INTERRUPT:
+		for (drv = 0; drv < 4; drv++) {
+			if (fdc->position[drv].seekint) break;
+		}
+		if (drv < 4) { //finished seeks are reported one drive at a time
+			fdc->position[drv].seekint = 0;
+			fdc_fifoadd(fdc, fdc->position[drv].seekst0);
+			fdc_fifoadd(fdc, fdc->position[drv].track);
+			while (++drv < 4) {
+				if (fdc->position[drv].seekint) {
+					i8259_doirq(fdc->i8259, fdc->irq);
+					break;
+				}
+			}
+			break;
+		}
 		fdc_fifoadd(fdc, fdc->st[0]);
 		fdc_fifoadd(fdc, fdc->position[fdc->drivenum].track);
 		break;
@@ -125,8 +139,7 @@ void fdc_cmd(FDC_t* fdc, uint8_t value) {
 		drv = fdc->cmd[1] & 3;
 		fdc->position[drv].head = (fdc->cmd[1] >> 2) & 1;
 		fdc->position[drv].wanttrack = fdc->cmd[2];
-		fdc->position[drv].seeking = 1;
-		fdc->busy = 1;
+		fdc_seek(fdc, drv);
 		break;
 	default: //invalid command
 		fdc->st[0] = FDC_ST0_INT_INVALID;
@@ -238,128 +251,228 @@ void fdc_fifoclear(FDC_t* fdc) {
 	fdc->datatosend = 0;
 }
 
-void fdc_move(FDC_t* fdc) {
-	uint8_t drv;
+/*
+	The controller is driven by two one-shot timers that are only armed while a command is
+	in progress, so an idle FDC costs nothing. timerseek fires when the first of the drives
+	that are seeking gets there, each drive keeps its own due time, command and result.
+	timerread fires when the next sector has come around under the head. Each sector then
+	goes to memory in a single DMA block.
+*/
+
+uint64_t fdc_ticks(uint32_t us) {
+	return (timing_getFreq() * us) / 1000000;
+}
+
+//Arms timerseek for the drive that gets where it's going first
+void fdc_seekTimer(FDC_t* fdc) {
+	uint64_t first = 0;
+	uint8_t drv, any = 0;
 
 	for (drv = 0; drv < 4; drv++) {
-		if (fdc->position[drv].seeking) {
-			if (fdc->position[drv].track < fdc->position[drv].wanttrack) {
-				fdc->position[drv].track++;
-			}
-			else if (fdc->position[drv].track > fdc->position[drv].wanttrack) {
-				fdc->position[drv].track--;
-			}
-			else { //got to requested track
-				fdc->position[drv].seeking = 0;
-				switch (fdc->cmd[0] & 0x0F) {
-				case FDC_CMD_READ_DATA:
-					fdc->position[drv].seeking = 0;
-					fdc->position[drv].reading = 1;
-					fdc->position[drv].transferring = 0;
-					break;
-				case FDC_CMD_RECALIBRATE:
-				case FDC_CMD_SEEK:
-					fdc->busy = 0;
-					fdc->st[0] = FDC_ST0_INT_NORMAL | FDC_ST0_SE | (fdc->position[drv].head << 2) | drv;
-					i8259_doirq(fdc->i8259, fdc->irq);
-					break;
-				}
+		if (fdc->position[drv].seeking && (!any || (fdc->position[drv].seekdone < first))) {
+			first = fdc->position[drv].seekdone;
+			any = 1;
+		}
+	}
+	if (any) {
+		timing_timerSchedule(fdc->timerseek, first);
+	}
+	else {
+		timing_timerDisable(fdc->timerseek);
+	}
+}
+
+//Starts the head moving towards wanttrack, fdc_move runs when it gets there
+void fdc_seek(FDC_t* fdc, uint8_t drv) {
+	uint32_t steps;
+
+	steps = (fdc->position[drv].wanttrack > fdc->position[drv].track) ?
+		(fdc->position[drv].wanttrack - fdc->position[drv].track) :
+		(fdc->position[drv].track - fdc->position[drv].wanttrack);
+	fdc->position[drv].seeking = 1;
+	fdc->position[drv].seekcmd = fdc->cmd[0] & 0x0F;
+	fdc->position[drv].seekint = 0;
+	fdc->position[drv].seekdone = timing_getCur() + fdc_ticks(steps * fdc->steptime * 1000 + (steps ? FDC_SETTLE_US : 0));
+	fdc_seekTimer(fdc);
+}
+
+//A seek or recalibrate finished, its status waits for a sense interrupt
+void fdc_seekResult(FDC_t* fdc, uint8_t drv, uint8_t st0) {
+	fdc->position[drv].seekst0 = st0 | (fdc->position[drv].head << 2) | drv;
+	fdc->position[drv].seekint = 1;
+	fdc->st[0] = fdc->position[drv].seekst0;
+	i8259_doirq(fdc->i8259, fdc->irq);
+}
+
+//Finishes the seek of a drive started by fdc_seek
+void fdc_arrive(FDC_t* fdc, uint8_t drv) {
+	fdc->position[drv].seeking = 0;
+
+	if ((fdc->position[drv].track != fdc->position[drv].wanttrack) &&
+		((fdc->disk[drv].inserted == 0) || (fdc->position[drv].wanttrack >= fdc->disk[drv].tracks))) {
+		if (fdc->disk[drv].inserted) {
+			fdc->position[drv].track = fdc->disk[drv].tracks; //ran off the end
+		}
+		if (fdc->position[drv].seekcmd == FDC_CMD_READ_DATA) {
+			fdc->busy = 0;
+			fdc->st[0] = FDC_ST0_INT_ABNORMAL | FDC_ST0_UC | (fdc->position[drv].head << 2) | drv;
+			i8259_doirq(fdc->i8259, fdc->irq);
+		}
+		else {
+			fdc_seekResult(fdc, drv, FDC_ST0_INT_ABNORMAL | FDC_ST0_UC); //TODO: UC for no inserted disk, or use NR?
+		}
+		return;
+	}
+
+	fdc->position[drv].track = fdc->position[drv].wanttrack;
 #ifdef DEBUG_FDC
-				debug_log(DEBUG_DETAIL, "[FDC] Completed drive %u seek to track %lu\r\n", drv, fdc->position[drv].track);
+	debug_log(DEBUG_DETAIL, "[FDC] Completed drive %u seek to track %lu\r\n", drv, fdc->position[drv].track);
 #endif
-				break; //Don't allow more than one IRQ to be triggered by seeks at a time
-			}
 
-			if ((fdc->position[drv].track >= fdc->disk[drv].tracks) || (fdc->disk[drv].inserted == 0)) {
-				fdc->position[drv].seeking = 0;
-				fdc->busy = 0;
-				fdc->st[0] = FDC_ST0_INT_ABNORMAL | FDC_ST0_UC | (fdc->position[drv].head << 2) | drv; //TODO: UC for no inserted disk, or use NR?
-				i8259_doirq(fdc->i8259, fdc->irq);
-				break; //Don't allow more than one IRQ to be triggered by seeks at a time
-			}
+	switch (fdc->position[drv].seekcmd) {
+	case FDC_CMD_READ_DATA:
+		timing_timerSchedule(fdc->timerread, timing_getCur() + fdc_ticks(FDC_SECTOR_US));
+		break;
+	case FDC_CMD_RECALIBRATE:
+	case FDC_CMD_SEEK:
+		fdc_seekResult(fdc, drv, FDC_ST0_INT_NORMAL | FDC_ST0_SE);
+		break;
+	}
+}
+
+//timerseek, finishes every seek that's due and waits for the next one
+void fdc_move(FDC_t* fdc) {
+	uint64_t now = timing_getCur();
+	uint8_t drv;
+
+	for (drv = 0; drv < 4; drv++) {
+		if (fdc->position[drv].seeking && (fdc->position[drv].seekdone <= now)) {
+			fdc_arrive(fdc, drv);
 		}
 	}
+	fdc_seekTimer(fdc);
 }
 
-//TODO: is this right?
-void fdc_incrementsect(FDC_t* fdc, uint8_t drv) {
-	fdc->position[drv].sect++;
-	if (fdc->position[drv].sect > fdc->disk[drv].sectors) {
-		fdc->position[drv].sect = 1;
-		fdc->position[drv].head++;
+//Ends a read command, the C/H/R reported is the sector after the last one transferred
+void fdc_result(FDC_t* fdc, uint8_t drv, uint8_t st0, uint8_t st1) {
+	uint32_t track, head, sect;
+
+	track = fdc->position[drv].track;
+	head = fdc->position[drv].head;
+	sect = fdc->position[drv].sect;
+	if (sect < fdc->cmd[6]) {
+		sect++;
 	}
-	if (fdc->position[drv].head >= fdc->disk[drv].sides) {
-		fdc->position[drv].head = 0;
+	else if ((fdc->cmd[0] & 0x80) && (head == 0)) {
+		head = 1;
+		sect = 1;
 	}
+	else {
+		track++;
+		sect = 1;
+	}
+
+	fdc->busy = 0;
+	fdc->st[0] = st0 | (fdc->position[drv].head << 2) | drv;
+	fdc->st[1] = st1;
+	fdc->st[2] = 0;
+	fdc_fifoclear(fdc);
+	fdc_fifoadd(fdc, fdc->st[0]);
+	fdc_fifoadd(fdc, fdc->st[1]);
+	fdc_fifoadd(fdc, fdc->st[2]);
+	fdc_fifoadd(fdc, track);
+	fdc_fifoadd(fdc, head);
+	fdc_fifoadd(fdc, sect);
+	fdc_fifoadd(fdc, 2);
+	i8259_doirq(fdc->i8259, fdc->irq);
+#ifdef DEBUG_FDC
+	debug_log(DEBUG_DETAIL, "[FDC] Finished read command, raised IRQ 6\r\n");
+#endif
 }
 
+//Runs each time a sector comes around under the head during a read command
 void fdc_transfersector(FDC_t* fdc) {
-	uint8_t drv;
-	uint32_t lba, tracksize, filepos;
+	uint8_t drv, tc;
+	uint32_t lba, tracksize, moved, left;
 
-	for (drv = 0; drv < 4; drv++) {
+	drv = fdc->cmd[1] & 3;
+
+	if (fdc->position[drv].transferring) { //PIO: wait for the CPU to empty the FIFO before going on
+		if (fdc->fifopos != fdc->fifolen) {
+			timing_timerSchedule(fdc->timerread, timing_getCur() + fdc_ticks(FDC_SECTOR_US));
+			return;
+		}
+		fdc->position[drv].transferring = 0;
+		tc = 0;
+	}
+	else {
 		tracksize = fdc->disk[drv].sectors * 512;
-		if (fdc->position[drv].transferring) {
-			if (fdc->sectpos < 512) {
-				if (fdc->usedma) {
-					//printf("%c", fdc->sectbuf[fdc->sectpos]);
-					i8237_write(fdc->i8237, fdc->dma, fdc->sectbuf[fdc->sectpos++]);
-					//printf("FDC DMA write sectpos %u\r\n", fdc->sectpos);
-				}
-				else {
-					if (fdc->fifopos == fdc->fifolen) { //TODO: doing PIO mode correctly?
-						fdc_fifoclear(fdc);
-						fdc_fifoadd(fdc, fdc->sectbuf[fdc->sectpos++]);
-						i8259_doirq(fdc->i8259, fdc->irq);
-						//printf("FDC PIO write sectpos %u\r\n", fdc->sectpos);
-					}
-				}
-			}
-			else if (fdc->sectpos == 512) {
-				//fdc_incrementsect(fdc, drv);
-				filepos = ftell(fdc->disk[drv].dfile);
-
-				fdc->position[drv].transferring = 0;
-				fdc->position[drv].reading = 0;
-				fdc->busy = 0;
-				fdc->st[0] = FDC_ST0_INT_NORMAL | FDC_ST0_SE | (fdc->position[drv].head << 2) | drv;
-				fdc->st[1] = 0;
-				fdc->st[2] = 0;
-				fdc_fifoclear(fdc);
-				fdc_fifoadd(fdc, fdc->st[0]);
-				fdc_fifoadd(fdc, fdc->st[1]);
-				fdc_fifoadd(fdc, fdc->st[2]);
-				fdc_fifoadd(fdc, fdc->position[drv].track);
-				fdc_fifoadd(fdc, fdc->position[drv].head);
-				fdc_fifoadd(fdc, fdc->position[drv].sect);
-				fdc_fifoadd(fdc, 2);
-				i8259_doirq(fdc->i8259, fdc->irq);
-#ifdef DEBUG_FDC
-				debug_log(DEBUG_DETAIL, "[FDC] Finished sector transfer, raised IRQ 6\r\n");
-#endif
-				break;
+		lba = (fdc->position[drv].track * tracksize * fdc->disk[drv].sides) + (fdc->position[drv].head * tracksize) + ((fdc->position[drv].sect - 1) * 512);
+		fseek(fdc->disk[drv].dfile, lba, SEEK_SET);
+		fread(fdc->sectbuf, 1, 512, fdc->disk[drv].dfile);
+
+		if (!fdc->usedma) { //TODO: doing PIO mode correctly?
+			fdc_fifoclear(fdc);
+			for (moved = 0; moved < 512; moved++) {
+				fdc_fifoadd(fdc, fdc->sectbuf[moved]);
 			}
-		}
-		else if (fdc->position[drv].reading) {
-			//printf("Reading drive %u\r\n", drv);
-			lba = (fdc->position[drv].track * tracksize * 2) + (fdc->position[drv].head * tracksize) + ((fdc->position[drv].sect - 1) * 512);
-			//printf("LBA = %lu\r\n", lba);
-			fseek(fdc->disk[drv].dfile, SEEK_SET, lba);
-			fread(fdc->sectbuf, 1, 512, fdc->disk[drv].dfile);
 			fdc->position[drv].transferring = 1;
-			fdc->sectpos = 0;
-			fdc_fifoclear(fdc);
+			i8259_doirq(fdc->i8259, fdc->irq);
+			timing_timerSchedule(fdc->timerread, timing_getCur() + fdc_ticks(FDC_SECTOR_US));
+			return;
+		}
+
+		//nobody is taking the data, the FIFO overruns like it would on the real controller
+		if (fdc->i8237->chan[fdc->dma].masked) {
+			fdc_result(fdc, drv, FDC_ST0_INT_ABNORMAL, FDC_ST1_TO);
+			return;
 		}
+
+		//the whole sector goes over in one block. Terminal count ends the command if the
+		//channel reaches it in this sector, short of it or right on its last byte
+		left = (uint32_t)fdc->i8237->chan[fdc->dma].count + 1;
+		moved = i8237_writeBlock(fdc->i8237, fdc->dma, fdc->sectbuf, 512);
+		tc = (left <= moved) ? 1 : 0;
+	}
+
+	if (tc) {
+		fdc_result(fdc, drv, FDC_ST0_INT_NORMAL, 0);
+		return;
+	}
+
+	if (fdc->position[drv].sect < fdc->cmd[6]) { //on to the next sector, up to EOT
+		fdc->position[drv].sect++;
 	}
+	else if ((fdc->cmd[0] & 0x80) && (fdc->position[drv].head == 0) && (fdc->disk[drv].sides > 1)) { //multi-track
+		fdc->position[drv].head = 1;
+		fdc->position[drv].sect = 1;
+	}
+	else { //ran past EOT without terminal count
+		fdc_result(fdc, drv, fdc->usedma ? FDC_ST0_INT_ABNORMAL : FDC_ST0_INT_NORMAL, fdc->usedma ? FDC_ST1_EN : 0);
+		return;
+	}
+	timing_timerSchedule(fdc->timerread, timing_getCur() + fdc_ticks(FDC_SECTOR_US));
 }
 
 void fdc_reset(FDC_t* fdc) {
+	uint8_t drv;
+
 #ifdef DEBUG_FDC
 	debug_log(DEBUG_DETAIL, "[FDC] Reset controller\r\n");
 #endif
 
 	i8259_doirq(fdc->i8259, fdc->irq);
 
+	//drop whatever command was in progress
+	timing_timerDisable(fdc->timerseek);
+	timing_timerDisable(fdc->timerread);
+	for (drv = 0; drv < 4; drv++) {
+		fdc->position[drv].seeking = 0;
+		fdc->position[drv].seekint = 0;
+		fdc->position[drv].transferring = 0;
+	}
+	fdc->busy = 0;
+
 	fdc_fifoclear(fdc);
 	fdc->cmd_pos = 0;
 }
@@ -429,8 +542,10 @@ int fdc_init(FDC_t* fdc, CPU_t* cpu, I8259_t* i8259, I8237_t* i8237) {
 	fdc->irq = 6;
 	fdc->dma = 2;
 
-	fdc->timerseek = timing_addTimer(fdc_move, fdc, 50, TIMING_ENABLED);
-	fdc->timerread = timing_addTimer(fdc_transfersector, fdc, 500000 / 8, TIMING_ENABLED);
+	fdc->steptime = 8;
+
+	fdc->timerseek = timing_addTimerUsingInterval(fdc_move, fdc, 0, TIMING_DISABLED);
+	fdc->timerread = timing_addTimerUsingInterval(fdc_transfersector, fdc, 0, TIMING_DISABLED);
 	ports_cbRegister(0x3F0, 8, (void*)fdc_read, NULL, (void*)fdc_write, NULL, fdc);
 
 	return 0;
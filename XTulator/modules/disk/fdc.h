@@ -8,6 +8,8 @@
 #include "../../chipset/i8237.h"
 
 #define FDC_FIFO_LEN					1024
+#define FDC_SECTOR_US					8192 //one 512 byte sector at 500 kbps
+#define FDC_SETTLE_US					15000 //head settle time after stepping
 
 #define FDC_CMD_READ_TRACK				2
 #define FDC_CMD_SPECIFY					3
@@ -68,8 +70,11 @@ typedef struct {
 	uint32_t sect;
 	uint32_t wanttrack;
 	uint8_t seeking;
-	uint8_t reading;
-	uint8_t transferring;
+	uint8_t seekcmd; //command that started the seek, says what happens once the head gets there
+	uint64_t seekdone; //when the head gets there
+	uint8_t seekst0; //ST0 of a finished seek, waiting for a sense interrupt
+	uint8_t seekint;
+	uint8_t transferring; //PIO only, the sector is sitting in the FIFO
 } FDCPOS_t;
 
 typedef struct {
@@ -91,17 +96,18 @@ typedef struct {
 	uint8_t st[4]; //status registers
 	uint8_t usedma;
 	uint8_t busy;
-	uint32_t timerseek;
+	uint8_t steptime; //ms per track
+	uint32_t timerseek; //one-shot, armed for whichever drive's seek finishes first
 	uint32_t timerread;
 	FDCPOS_t position[4];
 	FDCDISK_t disk[4];
 	uint8_t sectbuf[512];
-	uint16_t sectpos; //where the CPU is during the sector read process
 } FDC_t;
 
 uint8_t fdc_fiforead(FDC_t* fdc);
 void fdc_fifoadd(FDC_t* fdc, uint8_t value);
 void fdc_fifoclear(FDC_t* fdc);
+void fdc_seek(FDC_t* fdc, uint8_t drv);
 void fdc_reset(FDC_t* fdc);
 int fdc_insert(FDC_t* fdc, uint8_t num, char* dfile);
 int fdc_init(FDC_t* fdc, CPU_t* cpu, I8259_t* i8259, I8237_t* i8237);
@@ -0,0 +1,100 @@
+/*
+  XTulator: A portable, open-source 80186 PC emulator.
+  Copyright (C)2020 Mike Chambers
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+	Host input queue
+
+	The UI thread pushes keyboard, mouse and debug key events here, and speed changes from the
+	menu, and the emulation thread pulls them off between instruction batches. The emulation thread never waits: it only needs
+	a barrier between seeing a new head and reading the slot. Producers (the UI thread and the
+	VNC server thread) take turns on a spin lock, they only ever hold it for a few stores.
+*/
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+#include <stdint.h>
+#include "../../timing.h"
+#include "../../debuglog.h"
+#include "input.h"
+
+#ifdef _WIN32
+#define INPUT_BARRIER()	MemoryBarrier()
+#define INPUT_LOCK()	while (InterlockedExchange(&input_lock, 1)) { }
+#define INPUT_UNLOCK()	InterlockedExchange(&input_lock, 0)
+#else
+#define INPUT_BARRIER()	__sync_synchronize()
+#define INPUT_LOCK()	while (__sync_lock_test_and_set(&input_lock, 1)) { }
+#define INPUT_UNLOCK()	__sync_lock_release(&input_lock)
+#endif
+
+INPUTEVENT_t input_queue[INPUT_QUEUE_SIZE];
+volatile uint32_t input_head = 0, input_tail = 0;
+volatile long input_lock = 0;
+
+//US layout, indexed by XT scancode
+const char input_lower[] = "\0\x1B" "1234567890-=\b\tqwertyuiop[]\n\0asdfghjkl;'`\0\\zxcvbnm,./\0*\0 ";
+const char input_upper[] = "\0\x1B" "!@#$%^&*()_+\b\tQWERTYUIOP{}\n\0ASDFGHJKL:\"~\0|ZXCVBNM<>?\0*\0 ";
+
+//any host thread, returns -1 if the emulation thread has fallen too far behind
+int input_push(INPUTEVENT_t* event) {
+	uint32_t head;
+
+	INPUT_LOCK();
+	head = input_head;
+	if ((head - input_tail) == INPUT_QUEUE_SIZE) {
+		INPUT_UNLOCK();
+		debug_log(DEBUG_DETAIL, "[INPUT] Queue full, event dropped\r\n");
+		return -1;
+	}
+	input_queue[head & (INPUT_QUEUE_SIZE - 1)] = *event;
+	input_queue[head & (INPUT_QUEUE_SIZE - 1)].time = timing_getHostCur();
+	INPUT_BARRIER();
+	input_head = head + 1;
+	INPUT_UNLOCK();
+	return 0;
+}
+
+//emulation thread only, returns 0 when there is nothing waiting
+int input_pop(INPUTEVENT_t* event) {
+	uint32_t tail = input_tail;
+
+	if (tail == input_head) {
+		return 0;
+	}
+	INPUT_BARRIER();
+	*event = input_queue[tail & (INPUT_QUEUE_SIZE - 1)];
+	INPUT_BARRIER();
+	input_tail = tail + 1;
+	return 1;
+}
+
+//finds the key that types c on a US keyboard, returns 0 if there isn't one. shift is set if it needs shift held down.
+uint8_t input_asciiScancode(char c, uint8_t* shift) {
+	uint8_t i;
+
+	if (c == 0) return 0x00;
+	for (i = 1; i < sizeof(input_lower) - 1; i++) {
+		if ((input_lower[i] == c) || (input_upper[i] == c)) {
+			*shift = (input_lower[i] != c) ? 1 : 0;
+			return i;
+		}
+	}
+	return 0x00;
+}
@@ -3,9 +3,34 @@
 
 #include <stdint.h>
 
+#define INPUT_EVENT_KEY		0
+#define INPUT_EVENT_MOUSE	1
+#define INPUT_EVENT_DEBUG	2
+#define INPUT_EVENT_SPEED	3 //xrel is the new speed in KHz, 0 for unlimited
+
+#define INPUT_QUEUE_SIZE	256 //must be a power of two
+
+#define KEY_FIFO_SIZE		16 //scancodes the keyboard holds while the guest is busy, the XT keyboard buffers about this many
+
 typedef struct {
-	uint8_t scancode;
-	uint8_t isNew;
+	uint8_t scancode; //what port 60h reads back
+	uint8_t isNew; //set while a scancode is waiting for the guest to take it
+	uint8_t fifo[KEY_FIFO_SIZE];
+	uint8_t fifohead;
+	uint8_t fifolen;
 } KEYSTATE_t;
 
+typedef struct {
+	uint64_t time; //host clock when the UI saw it
+	int32_t xrel;
+	int32_t yrel;
+	uint8_t type;
+	uint8_t code; //scancode, mouse action or debug key number
+	uint8_t state;
+} INPUTEVENT_t;
+
+int input_push(INPUTEVENT_t* event);
+int input_pop(INPUTEVENT_t* event);
+uint8_t input_asciiScancode(char c, uint8_t* shift);
+
 #endif
@@ -27,24 +27,43 @@
 #include "../../config.h"
 #include "../../debuglog.h"
 #include "../../ports.h"
+#include "../../timing.h"
 #include "../../chipset/uart.h"
 #include "mouse.h"
+#include "../../replay.h"
 
 MOUSE_t mouse_state;
 UART_t* mouse_uart = NULL;
 uint8_t mouse_buf[MOUSE_BUFFER_LEN]; //room for six events
 uint8_t mouse_bufpos = 0;
 uint8_t mouse_lasttoggle = 0;
+uint32_t mouse_timer;
+uint8_t mouse_armed = 0;
+uint8_t mouse_stalled = 0; //the UART still holds the last byte, the next one waits for the guest to read it
+uint8_t mouse_overrun = 0; //a reset's 'M' goes out whether the last byte was read or not, like a real overrun
+
+/*
+	Bytes go to the UART one at a time at the serial rate. The timer only runs while there's something
+	queued and the guest is taking it, when nobody reads the UART it stops until somebody does.
+*/
+void mouse_schedule() {
+	if (mouse_armed || mouse_stalled) return;
+	mouse_armed = 1;
+	timing_timerSchedule(mouse_timer, timing_getCur() + (timing_getFreq() * 9) / baudrate);
+}
 
 void mouse_addbuf(uint8_t value) {
 	if (mouse_bufpos == MOUSE_BUFFER_LEN) return;
 
 	mouse_buf[mouse_bufpos++] = value;
+	mouse_schedule();
 }
 
 void mouse_togglereset(void* dummy, uint8_t value) { //reset mouse, allows detection, is a callback for the UART module
 	if ((mouse_lasttoggle != 0x03) && ((value & 0x03) == 0x03)) {
 		mouse_bufpos = 0;
+		mouse_stalled = 0;
+		mouse_overrun = 1;
 		mouse_addbuf('M');
 		//printf("toggle DTR ");
 	}
@@ -52,6 +71,12 @@ void mouse_togglereset(void* dummy, uint8_t value) { //reset mouse, allows detec
 }
 
 void mouse_action(uint8_t action, uint8_t state, int32_t xrel, int32_t yrel) {
+	if (replay_mode == REPLAY_MODE_PLAY) return; //mouse input comes from the replay log
+	replay_logMouse(action, state, xrel, yrel);
+	mouse_queueAction(action, state, xrel, yrel);
+}
+
+void mouse_queueAction(uint8_t action, uint8_t state, int32_t xrel, int32_t yrel) {
 	if (mouse_uart == NULL) return;
 	switch (action) {
 	case MOUSE_ACTION_MOVE:
@@ -71,16 +96,37 @@ void mouse_action(uint8_t action, uint8_t state, int32_t xrel, int32_t yrel) {
 }
 
 void mouse_rxpoll(void* dummy) {
+	mouse_armed = 0;
 	if (mouse_uart == NULL) return;
-	if (mouse_uart->rxnew) return;
 	if (mouse_bufpos == 0) return;
 
+	if (mouse_uart->rxnew && !mouse_overrun) { //the last byte hasn't been read yet, mouse_rxread picks this up again
+		mouse_stalled = 1;
+		return;
+	}
+	mouse_overrun = 0;
 	uart_rxdata(mouse_uart, mouse_buf[0]);
 	memmove(mouse_buf, mouse_buf + 1, MOUSE_BUFFER_LEN - 1);
 	mouse_bufpos--;
+	if (mouse_bufpos > 0) {
+		mouse_schedule();
+	}
+}
+
+//the UART's receive buffer was read, so the next byte can follow a byte time from now
+void mouse_rxread(void* dummy) {
+	if (!mouse_stalled) return;
+	mouse_stalled = 0;
+	if (mouse_bufpos > 0) {
+		mouse_schedule();
+	}
 }
 
 void mouse_init(UART_t* uart) {
 	debug_log(DEBUG_INFO, "[MOUSE] Initializing Microsoft-compatible serial mouse\r\n");
 	mouse_uart = uart;
+	mouse_timer = timing_addTimerUsingInterval(mouse_rxpoll, NULL, 0, TIMING_DISABLED);
+	mouse_armed = 0;
+	mouse_stalled = 0;
+	uart_setRxReadCallback(uart, mouse_rxread, NULL);
 }
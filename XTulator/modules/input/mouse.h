@@ -21,7 +21,9 @@ typedef struct {
 
 void mouse_togglereset(void* dummy, uint8_t value);
 void mouse_action(uint8_t action, uint8_t state, int32_t xrel, int32_t yrel);
+void mouse_queueAction(uint8_t action, uint8_t state, int32_t xrel, int32_t yrel);
 void mouse_rxpoll(void* dummy);
+void mouse_rxread(void* dummy);
 void mouse_init(UART_t* uart);
 
 #endif
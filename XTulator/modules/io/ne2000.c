@@ -215,6 +215,16 @@ uint16_t ne2000_asic_read_w(NE2000_t* ne2000, uint32_t offset)
     return retval;
 }
 
+//REP INSW straight out of the data port, no port lookup per word
+void ne2000_asic_read_block(NE2000_t* ne2000, uint32_t offset, uint16_t* data, uint32_t count)
+{
+    uint32_t i;
+
+    for (i = 0; i < count; i++) {
+        data[i] = ne2000_asic_read_w(ne2000, offset);
+    }
+}
+
 void ne2000_dma_write(NE2000_t* ne2000, int io_len)
 {
     // is this right ??? asic_read uses DCR.wordsize
@@ -256,6 +266,15 @@ void ne2000_asic_write_w(NE2000_t* ne2000, uint32_t offset, uint16_t value)
     }
 }
 
+void ne2000_asic_write_block(NE2000_t* ne2000, uint32_t offset, const uint16_t* data, uint32_t count)
+{
+    uint32_t i;
+
+    for (i = 0; i < count; i++) {
+        ne2000_asic_write_w(ne2000, offset, data[i]);
+    }
+}
+
 uint8_t ne2000_asic_read_b(NE2000_t* ne2000, uint32_t offset)
 {
     if (offset & 1)
@@ -1019,32 +1038,27 @@ static int mcast_index(const void* dst)
 }
 
 /*
- * rx_frame() - called by the platform-specific code when an
- * ethernet frame has been received. The destination address
- * is tested to see if it should be accepted, and if the
- * rx ring has enough room, it is copied into it and
- * the receive process is updated
+ * rx_pages() - how many 256-byte pages of the rx ring a frame of
+ * io_len bytes takes, with runts padded out and the pkt header
+ * and CRC added on
  */
-void ne2000_rx_frame(NE2000_t* ne2000, const void* buf, int io_len)
+static int ne2000_rx_pages(int io_len)
+{
+    if (io_len < 60) io_len = 60;
+    return (io_len + 4 + 4 + 255) / 256;
+}
+
+/*
+ * rx_room() - returns 1 if a frame of io_len bytes fits in the
+ * rx ring right now. Partial receives are never attempted, the
+ * emulation to handle that condition seems particularly painful.
+ */
+static int ne2000_rx_room(NE2000_t* ne2000, int io_len)
 {
     int pages;
     int avail;
-    int idx;
-    int wrapped;
-    int nextpage;
-    uint8_t pkthdr[4];
-    uint8_t* pktbuf = (uint8_t*)buf;
-    uint8_t* startptr;
-    static uint8_t bcast_addr[6] = { 0xff,0xff,0xff,0xff,0xff,0xff };
-
-    if ((ne2000->CR.stop != 0) ||
-        (ne2000->page_start == 0)) {
-        return;
-    }
 
-    // Add the pkt header + CRC to the length, and work
-    // out how many 256-byte pages the frame would occupy
-    pages = (io_len + 4 + 4 + 255) / 256;
+    pages = ne2000_rx_pages(io_len);
 
     if (ne2000->curr_page < ne2000->bound_ptr) {
         avail = ne2000->bound_ptr - ne2000->curr_page;
@@ -1052,57 +1066,122 @@ void ne2000_rx_frame(NE2000_t* ne2000, const void* buf, int io_len)
     else {
         avail = (ne2000->page_stop - ne2000->page_start) -
             (ne2000->curr_page - ne2000->bound_ptr);
-        wrapped = 1;
     }
 
-    // Avoid getting into a buffer overflow condition by not attempting
-    // to do partial receives. The emulation to handle this condition
-    // seems particularly painful.
     if ((avail < pages)
 #if NE2K_NEVER_FULL_RING
         || (avail == pages)
 #endif
         ) {
-#ifdef DEBUG_NE2000
-        debug_log(DEBUG_DETAIL, "[NE2000] no space\n");
-#endif
-        return;
+        return 0;
     }
 
+    return 1;
+}
+
+/*
+ * rx_accept() - returns 1 if the controller takes a frame with
+ * this destination address and length, going by the receive
+ * configuration and the multicast hash
+ */
+static int ne2000_rx_accept(NE2000_t* ne2000, const void* buf, int io_len)
+{
+    const uint8_t* pktbuf = (const uint8_t*)buf;
+    int idx;
+    static uint8_t bcast_addr[6] = { 0xff,0xff,0xff,0xff,0xff,0xff };
+
     if ((io_len < 40/*60*/) && !ne2000->RCR.runts_ok) {
 #ifdef DEBUG_NE2000
         debug_log(DEBUG_DETAIL, "[NE2000] rejected small packet, length %d\n", io_len);
 #endif
-        return;
+        return 0;
     }
-    // some computers don't care...
-    if (io_len < 60) io_len = 60;
 
     // Do address filtering if not in promiscuous mode
     if (!ne2000->RCR.promisc) {
         if (!memcmp(buf, bcast_addr, 6)) {
             if (!ne2000->RCR.broadcast) {
-                return;
+                return 0;
             }
         }
         else if (pktbuf[0] & 0x01) {
             if (!ne2000->RCR.multicast) {
-                return;
+                return 0;
             }
             idx = mcast_index(buf);
             if (!(ne2000->mchash[idx >> 3] & (1 << (idx & 0x7)))) {
-                return;
+                return 0;
             }
         }
         else if (0 != memcmp(buf, ne2000->physaddr, 6)) {
-            return;
+            return 0;
         }
     }
-    else {
+
+    return 1;
+}
+
+/*
+ * rx_full() - returns 1 if the controller would take a frame of
+ * io_len bytes but it won't fit in the rx ring right now, so the
+ * caller can hold on to it and try again once the guest has drained
+ * some of the ring. A frame the address filter throws out or a
+ * stopped controller never makes it full, rx_frame just drops those.
+ */
+int ne2000_rx_full(NE2000_t* ne2000, const void* buf, int io_len)
+{
+    if ((ne2000->CR.stop != 0) ||
+        (ne2000->page_start == 0)) {
+        return 0;
+    }
+
+    if (!ne2000_rx_accept(ne2000, buf, io_len)) {
+        return 0;
+    }
+
+    return !ne2000_rx_room(ne2000, io_len);
+}
+
+/*
+ * rx_frame() - called by the platform-specific code when an
+ * ethernet frame has been received. The destination address
+ * is tested to see if it should be accepted, and if the
+ * rx ring has enough room, it is copied into it and
+ * the receive process is updated
+ */
+void ne2000_rx_frame(NE2000_t* ne2000, const void* buf, int io_len)
+{
+    int pages;
+    int nextpage;
+    uint8_t pkthdr[4];
+    uint8_t* pktbuf = (uint8_t*)buf;
+    uint8_t* startptr;
+
+    if ((ne2000->CR.stop != 0) ||
+        (ne2000->page_start == 0)) {
+        return;
+    }
+
+    if (!ne2000_rx_accept(ne2000, buf, io_len)) {
+        return;
+    }
+
+    if (!ne2000_rx_room(ne2000, io_len)) {
 #ifdef DEBUG_NE2000
-        debug_log(DEBUG_DETAIL, "[NE2000] rx_frame promiscuous receive\n");
+        debug_log(DEBUG_DETAIL, "[NE2000] no space\n");
 #endif
+        return;
+    }
+
+    // some computers don't care...
+    pages = ne2000_rx_pages(io_len);
+    if (io_len < 60) io_len = 60;
+
+#ifdef DEBUG_NE2000
+    if (ne2000->RCR.promisc) {
+        debug_log(DEBUG_DETAIL, "[NE2000] rx_frame promiscuous receive\n");
     }
+#endif
 
 #ifdef DEBUG_NE2000
     debug_log(DEBUG_DETAIL, "[NE2000] rx_frame %d to %x:%x:%x:%x:%x:%x from %x:%x:%x:%x:%x:%x\n",
@@ -1203,6 +1282,7 @@ void ne2000_init(NE2000_t* ne2000, I8259_t* i8259, uint32_t baseport, uint8_t ir
 
     ports_cbRegister(baseport, 0x10, ne2000_read, NULL, ne2000_write, NULL, ne2000);
     ports_cbRegister(baseport + 0x10, 0x10, ne2000_asic_read_b, ne2000_asic_read_w, ne2000_asic_write_b, ne2000_asic_write_w, ne2000);
+    ports_cbRegisterBlock(baseport + 0x10, 0x01, (void*)ne2000_asic_read_block, (void*)ne2000_asic_write_block);
     ports_cbRegister(baseport + 0x1F, 0x01, ne2000_reset_read, NULL, ne2000_reset_write, NULL, ne2000);
 
     ne2000_setirq(ne2000, irq);
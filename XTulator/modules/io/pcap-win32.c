@@ -29,6 +29,7 @@
 #include <string.h>
 #include <stdint.h>
 #ifdef _WIN32
+#include <Windows.h>
 #include <process.h>
 #else
 #include <pthread.h>
@@ -39,12 +40,27 @@ pthread_t pcap_dispatchThreadID;
 #include "../../utility.h"
 #include "ne2000.h"
 #include "pcap-win32.h"
+#include "../../replay.h"
 
-volatile uint8_t pcap_havePacket = 0;
-pcap_t* pcap_adhandle;
+/*
+	Received frames go from the capture thread to the emulator through a single producer,
+	single consumer ring. The capture thread only ever moves pcap_ringHead and the emulator
+	only ever moves pcap_ringTail, both free running, so neither side takes a lock or waits
+	on the other. When the ring is full the frame is dropped and counted in pcap_drops,
+	which is reported at exit.
+*/
+#ifdef _WIN32
+#define PCAP_BARRIER()	MemoryBarrier()
+#else
+#define PCAP_BARRIER()	__sync_synchronize()
+#endif
 
-volatile u_char pcap_packetData[2048];
-volatile uint32_t pcap_len = 0;
+PCAP_FRAME_t pcap_ring[PCAP_RING_SIZE];
+volatile uint32_t pcap_ringHead = 0;
+volatile uint32_t pcap_ringTail = 0;
+volatile uint32_t pcap_drops = 0;
+
+pcap_t* pcap_adhandle;
 
 NE2000_t* pcap_ne2000 = NULL;
 
@@ -104,10 +120,22 @@ int pcap_init(NE2000_t* ne2000, int dev) {
 
 	debug_log(DEBUG_INFO, "[PCAP-WIN32] Initializing pcap library using device: \"%s\"\r\n", d->description ? d->description : "No description available");
 
+	//frames are handed over as soon as they arrive, the timeout only bounds how long the
+	//capture thread sits in pcap_dispatch before it looks at "running" again
 #ifdef _WIN32
-	if ((pcap_adhandle = pcap_open(d->name, 65536, PCAP_OPENFLAG_PROMISCUOUS, 1000, NULL, errbuf)) == NULL) {
+	if ((pcap_adhandle = pcap_open(d->name, 65536, PCAP_OPENFLAG_PROMISCUOUS | PCAP_OPENFLAG_MAX_RESPONSIVENESS, PCAP_WAIT_MS, NULL, errbuf)) == NULL) {
 #else
-	if ((pcap_adhandle = pcap_open_live(d->name, 65535, 1, -1, NULL)) == NULL) {
+	pcap_adhandle = pcap_create(d->name, errbuf);
+	if ((pcap_adhandle != NULL) &&
+		((pcap_set_snaplen(pcap_adhandle, 65535) != 0) ||
+		(pcap_set_promisc(pcap_adhandle, 1) != 0) ||
+		(pcap_set_timeout(pcap_adhandle, PCAP_WAIT_MS) != 0) ||
+		(pcap_set_immediate_mode(pcap_adhandle, 1) != 0) ||
+		(pcap_activate(pcap_adhandle) < 0))) {
+		pcap_close(pcap_adhandle);
+		pcap_adhandle = NULL;
+	}
+	if (pcap_adhandle == NULL) {
 #endif
 		debug_log(DEBUG_ERROR, "\nUnable to open the adapter. %s is not supported by pcap\n", d->name);
 		pcap_freealldevs(alldevs);
@@ -128,34 +156,63 @@ int pcap_init(NE2000_t* ne2000, int dev) {
 }
 
 void pcap_dispatchThread() {
+	//blocks in pcap until frames arrive, then takes everything pcap has buffered in one go
 	while (running) {
-		pcap_dispatch(pcap_adhandle, 1, pcap_rx_handler, NULL);
-		if (pcap_havePacket == 0) {
-			utility_sleep(1);
+		if (pcap_dispatch(pcap_adhandle, -1, pcap_rx_handler, NULL) < 0) {
+			debug_log(DEBUG_ERROR, "[PCAP-WIN32] Capture failed, network receive stopped\r\n");
+			break;
 		}
 	}
 }
 
 void pcap_rx_handler(u_char* param, const struct pcap_pkthdr* header, const u_char* pkt_data) {
+	PCAP_FRAME_t* frame;
+	uint32_t head;
 	(void)(param); //unused variable
 
-	while (pcap_havePacket) {}
+	head = pcap_ringHead;
+	if ((header->caplen > PCAP_FRAME_MAX) || ((head - pcap_ringTail) == PCAP_RING_SIZE)) {
+		pcap_drops++;
+#ifdef DEBUG_NE2000
+		debug_log(DEBUG_DETAIL, "[PCAP-WIN32] Dropped a %u byte frame, %u dropped so far\r\n", header->caplen, pcap_drops);
+#endif
+		return;
+	}
 
-	pcap_len = header->caplen;
-	if (pcap_len > 2048) return;
-	memcpy((void*)pcap_packetData, pkt_data, header->caplen);
-	pcap_havePacket = 1;
-	//debug_log(DEBUG_INFO, "len:%d\n", header->len);
+	frame = &pcap_ring[head & (PCAP_RING_SIZE - 1)];
+	frame->len = header->caplen;
+	memcpy(frame->data, pkt_data, header->caplen);
+	PCAP_BARRIER(); //the frame has to be in place before the emulator can see the new head
+	pcap_ringHead = head + 1;
 }
 
+/*
+	Called from the emulator thread. Delivers queued frames for as long as the NE2000's own
+	receive ring has room for them, whatever doesn't fit stays queued for the next call.
+*/
 void pcap_rxPacket() {
-	if (pcap_havePacket) {
-		ne2000_rx_frame(pcap_ne2000, (void*)pcap_packetData, pcap_len);
-		pcap_havePacket = 0;
+	PCAP_FRAME_t* frame;
+	uint32_t tail;
+
+	tail = pcap_ringTail;
+	while (tail != pcap_ringHead) {
+		PCAP_BARRIER(); //pairs with the one in pcap_rx_handler
+		frame = &pcap_ring[tail & (PCAP_RING_SIZE - 1)];
+		if (replay_mode != REPLAY_MODE_PLAY) { //when replaying, received frames come from the log instead
+			if (ne2000_rx_full(pcap_ne2000, frame->data, (int)frame->len)) {
+				break;
+			}
+			replay_logNet(frame->data, frame->len);
+			ne2000_rx_frame(pcap_ne2000, frame->data, (int)frame->len);
+		}
+		tail++;
+		PCAP_BARRIER(); //done with the slot before the capture thread may reuse it
+		pcap_ringTail = tail;
 	}
 }
 
 void pcap_txPacket(u_char* data, int len) {
+	if (replay_mode == REPLAY_MODE_PLAY) return; //don't repeat a recorded session's traffic on the real network
 	pcap_sendpacket(pcap_adhandle, data, len);
 }
 
@@ -9,6 +9,15 @@
 #include <pcap.h>
 #include "ne2000.h"
 
+#define PCAP_RING_SIZE	64 //frames queued between the capture thread and the emulator, must be a power of 2
+#define PCAP_FRAME_MAX	2048
+#define PCAP_WAIT_MS	100
+
+typedef struct {
+	uint32_t len;
+	uint8_t data[PCAP_FRAME_MAX];
+} PCAP_FRAME_t;
+
 void pcap_rx_handler(u_char* param, const struct pcap_pkthdr* header, const u_char* pkt_data);
 void pcap_listdevs();
 int pcap_init(NE2000_t* ne2000, int dev);
@@ -16,7 +25,7 @@ void pcap_dispatchThread();
 void pcap_rxPacket();
 void pcap_txPacket(u_char* data, int len);
 
-extern volatile uint8_t pcap_havePacket;
+extern volatile uint32_t pcap_drops;
 
 #endif //USE_NE2000
 
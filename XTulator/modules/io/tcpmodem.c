@@ -248,11 +248,32 @@ void tcpmodem_parseAT(TCPMODEM_t* tcpmodem) {
 	}
 }
 
+/*
+	Arms the receive event. While there's data for the UART it runs at the serial byte
+	rate, otherwise it only comes around TCPMODEM_POLL_RATE times a second to look at the
+	sockets. Never pushes an already armed event further out.
+*/
+void tcpmodem_schedule(TCPMODEM_t* tcpmodem, uint8_t busy) {
+	uint64_t when;
+
+	when = timing_getCur() + (busy ? ((timing_getFreq() * 9) / baudrate) : (timing_getFreq() / TCPMODEM_POLL_RATE));
+	if (tcpmodem->rxarmed && (tcpmodem->rxdue <= when)) return;
+	tcpmodem->rxarmed = 1;
+	tcpmodem->rxdue = when;
+	timing_timerSchedule(tcpmodem->rxtimer, when);
+}
+
 void tcpmodem_rxpoll(TCPMODEM_t* tcpmodem) {
 	char cc;
 	int ret;
+	uint8_t busy = 0;
+
+	tcpmodem->rxarmed = 0;
 
-	if (tcpmodem->uart->rxnew) return;
+	if (tcpmodem->uart->rxnew) { //last byte not read yet
+		tcpmodem_schedule(tcpmodem, 1);
+		return;
+	}
 
 	if (tcpmodem->livesocket && !(tcpmodem->uart->mcr & 1)) { //software hung up via DTR toggle
 		tcpmodem_offline(tcpmodem);
@@ -263,6 +284,7 @@ void tcpmodem_rxpoll(TCPMODEM_t* tcpmodem) {
 		//printf("%d\r\n", ret);
 		if (ret > 0) {
 			uart_rxdata(tcpmodem->uart, (uint8_t)cc);
+			busy = 1; //probably more where that came from
 			//printf("%c", cc);
 		} else if (ret == SOCKET_ERROR) {
 			switch (WSAGetLastError()) {
@@ -283,6 +305,7 @@ void tcpmodem_rxpoll(TCPMODEM_t* tcpmodem) {
 		if (cc != 0) {
 			uart_rxdata(tcpmodem->uart, (uint8_t)cc);
 			tcpmodem->rxpos++;
+			busy = 1;
 		} else {
 			memset(tcpmodem->rxbuf, 0, 1024);
 			tcpmodem->rxpos = 0;
@@ -307,6 +330,8 @@ void tcpmodem_rxpoll(TCPMODEM_t* tcpmodem) {
 			}
 		}
 	}
+
+	tcpmodem_schedule(tcpmodem, busy);
 }
 
 void tcpmodem_tx(TCPMODEM_t* tcpmodem, uint8_t value) {
@@ -372,6 +397,10 @@ void tcpmodem_tx(TCPMODEM_t* tcpmodem, uint8_t value) {
 			}
 		}
 	}
+
+	if (tcpmodem->rxbuf[tcpmodem->rxpos] != 0) { //a response got queued
+		tcpmodem_schedule(tcpmodem, 1);
+	}
 }
 
 void tcpmodem_ringer(TCPMODEM_t* tcpmodem) {
@@ -381,6 +410,7 @@ void tcpmodem_ringer(TCPMODEM_t* tcpmodem) {
 	if (tcpmodem->ringstate) {
 		sprintf(tcpmodem->rxbuf, "RING\r\n");
 		tcpmodem->rxpos = 0;
+		tcpmodem_schedule(tcpmodem, 1);
 	}
 	tcpmodem_setringmsr(tcpmodem, tcpmodem->ringstate);
 }
@@ -397,6 +427,8 @@ int tcpmodem_init(TCPMODEM_t* tcpmodem, UART_t* uart, uint16_t port) {
 	WSAStartup(MAKEWORD(2, 2), &tcpmodem->wsa);
 	tcpmodem_listen(tcpmodem, tcpmodem->listenport);
 	tcpmodem->ringtimer = timing_addTimer(tcpmodem_ringer, tcpmodem, 1, TIMING_DISABLED);
+	tcpmodem->rxtimer = timing_addTimerUsingInterval(tcpmodem_rxpoll, tcpmodem, 0, TIMING_DISABLED);
+	tcpmodem_schedule(tcpmodem, 0);
 
 	return 0;
 }
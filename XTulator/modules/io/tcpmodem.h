@@ -11,6 +11,8 @@
 #include <WinSock2.h>
 #include <WS2tcpip.h>
 
+#define TCPMODEM_POLL_RATE	100 //socket checks per second while there's nothing to receive
+
 typedef struct {
 	uint8_t escaped;
 	uint8_t livesocket;
@@ -18,6 +20,9 @@ typedef struct {
 	uint8_t ringing;
 	uint8_t ringstate;
 	uint32_t ringtimer;
+	uint32_t rxtimer;
+	uint64_t rxdue;
+	uint8_t rxarmed;
 	uint16_t listenport;
 	uint8_t echocmd;
 	char rxbuf[1024]; //used only in offline mode
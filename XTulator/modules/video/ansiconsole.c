@@ -0,0 +1,464 @@
+/*
+  XTulator: A portable, open-source 80186 PC emulator.
+  Copyright (C)2020 Mike Chambers
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+	ANSI terminal console
+
+	Stands in for sdlconsole when there's only a terminal, e.g. over SSH. The guest's text
+	mode screen is read straight out of CGA/VGA memory ANSICONSOLE_FPS times a second and
+	compared with what was sent last time. Only cells that changed are written, as CP437
+	translated to UTF-8 with the 16 text colors mapped to ANSI ones, and the whole frame goes
+	out in one write. The machine runs headless, so no pixels get rendered at all.
+
+	Keys typed in the terminal become scancode make/break pairs for the guest. Ctrl-] quits.
+	Graphics modes aren't shown, the last text screen stays up until the guest goes back to text.
+*/
+
+#include "../../config.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <termios.h>
+#include <unistd.h>
+#include <sys/select.h>
+#endif
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ansiconsole.h"
+#include "cga.h"
+#include "vga.h"
+#include "../input/input.h"
+#include "../../machine.h"
+#include "../../timing.h"
+#include "../../debuglog.h"
+
+MACHINE_t* ansiconsole_machine = NULL;
+uint8_t ansiconsole_chars[ANSICONSOLE_MAXROWS][ANSICONSOLE_MAXCOLS], ansiconsole_attrs[ANSICONSOLE_MAXROWS][ANSICONSOLE_MAXCOLS];
+uint8_t ansiconsole_valid = 0, ansiconsole_active = 0;
+uint32_t ansiconsole_cols = 0, ansiconsole_rows = 0, ansiconsole_cursorx = 0xFFFFFFFF, ansiconsole_cursory = 0xFFFFFFFF;
+uint64_t ansiconsole_nextframe = 0;
+char ansiconsole_buf[ANSICONSOLE_BUFSIZE];
+uint32_t ansiconsole_len;
+#ifdef _WIN32
+HANDLE ansiconsole_in, ansiconsole_out;
+DWORD ansiconsole_inmode, ansiconsole_outmode;
+UINT ansiconsole_cp;
+#else
+struct termios ansiconsole_termios;
+uint8_t ansiconsole_esc[ANSICONSOLE_ESCLEN]; //start of an escape sequence the last read cut off
+uint32_t ansiconsole_esclen = 0;
+uint64_t ansiconsole_escstart;
+#endif
+
+//code page 437 glyphs that aren't plain ASCII
+const uint16_t ansiconsole_cp437low[32] = {
+	0x0020, 0x263A, 0x263B, 0x2665, 0x2666, 0x2663, 0x2660, 0x2022, 0x25D8, 0x25CB, 0x25D9, 0x2642, 0x2640, 0x266A, 0x266B, 0x263C,
+	0x25BA, 0x25C4, 0x2195, 0x203C, 0x00B6, 0x00A7, 0x25AC, 0x21A8, 0x2191, 0x2193, 0x2192, 0x2190, 0x221F, 0x2194, 0x25B2, 0x25BC
+};
+
+const uint16_t ansiconsole_cp437high[128] = {
+	0x00C7, 0x00FC, 0x00E9, 0x00E2, 0x00E4, 0x00E0, 0x00E5, 0x00E7, 0x00EA, 0x00EB, 0x00E8, 0x00EF, 0x00EE, 0x00EC, 0x00C4, 0x00C5,
+	0x00C9, 0x00E6, 0x00C6, 0x00F4, 0x00F6, 0x00F2, 0x00FB, 0x00F9, 0x00FF, 0x00D6, 0x00DC, 0x00A2, 0x00A3, 0x00A5, 0x20A7, 0x0192,
+	0x00E1, 0x00ED, 0x00F3, 0x00FA, 0x00F1, 0x00D1, 0x00AA, 0x00BA, 0x00BF, 0x2310, 0x00AC, 0x00BD, 0x00BC, 0x00A1, 0x00AB, 0x00BB,
+	0x2591, 0x2592, 0x2593, 0x2502, 0x2524, 0x2561, 0x2562, 0x2556, 0x2555, 0x2563, 0x2551, 0x2557, 0x255D, 0x255C, 0x255B, 0x2510,
+	0x2514, 0x2534, 0x252C, 0x251C, 0x2500, 0x253C, 0x255E, 0x255F, 0x255A, 0x2554, 0x2569, 0x2566, 0x2560, 0x2550, 0x256C, 0x2567,
+	0x2568, 0x2564, 0x2565, 0x2559, 0x2558, 0x2552, 0x2553, 0x256B, 0x256A, 0x2518, 0x250C, 0x2588, 0x2584, 0x258C, 0x2590, 0x2580,
+	0x03B1, 0x00DF, 0x0393, 0x03C0, 0x03A3, 0x03C3, 0x00B5, 0x03C4, 0x03A6, 0x0398, 0x03A9, 0x03B4, 0x221E, 0x03C6, 0x03B5, 0x2229,
+	0x2261, 0x00B1, 0x2265, 0x2264, 0x2320, 0x2321, 0x00F7, 0x2248, 0x00B0, 0x2219, 0x00B7, 0x221A, 0x207F, 0x00B2, 0x25A0, 0x00A0
+};
+
+//text attribute colors are IRGB with blue in bit 0, ANSI has red in bit 0
+#define ansiconsole_color(c) ((((c) & 1) << 2) | ((c) & 2) | (((c) & 4) >> 2))
+
+void ansiconsole_put(char* s) {
+	while ((*s != 0) && (ansiconsole_len < ANSICONSOLE_BUFSIZE)) {
+		ansiconsole_buf[ansiconsole_len++] = *s++;
+	}
+}
+
+void ansiconsole_putGlyph(uint8_t cc) {
+	uint16_t u;
+	char utf[4];
+
+	if ((cc >= 0x20) && (cc < 0x7F)) {
+		utf[0] = (char)cc;
+		utf[1] = 0;
+	}
+	else {
+		if (cc < 0x20) u = ansiconsole_cp437low[cc];
+		else if (cc == 0x7F) u = 0x2302;
+		else u = ansiconsole_cp437high[cc - 0x80];
+		if (u < 0x80) { //NUL maps to a plain space, anything this low has to go out as one byte
+			utf[0] = (char)u;
+			utf[1] = 0;
+		}
+		else if (u < 0x800) {
+			utf[0] = (char)(0xC0 | (u >> 6));
+			utf[1] = (char)(0x80 | (u & 0x3F));
+			utf[2] = 0;
+		}
+		else {
+			utf[0] = (char)(0xE0 | (u >> 12));
+			utf[1] = (char)(0x80 | ((u >> 6) & 0x3F));
+			utf[2] = (char)(0x80 | (u & 0x3F));
+			utf[3] = 0;
+		}
+	}
+	ansiconsole_put(utf);
+}
+
+void ansiconsole_flush() {
+	if (ansiconsole_len == 0) return;
+#ifdef _WIN32
+	{
+		DWORD written;
+		WriteFile(ansiconsole_out, ansiconsole_buf, ansiconsole_len, &written, NULL);
+	}
+#else
+	{
+		uint32_t pos = 0;
+		ssize_t ret;
+		while (pos < ansiconsole_len) {
+			ret = write(STDOUT_FILENO, ansiconsole_buf + pos, ansiconsole_len - pos);
+			if (ret <= 0) break;
+			pos += (uint32_t)ret;
+		}
+	}
+#endif
+	ansiconsole_len = 0;
+}
+
+//sends whatever changed on the guest's text screen since the last frame
+void ansiconsole_draw() {
+	uint8_t chars[ANSICONSOLE_MAXCOLS], attrs[ANSICONSOLE_MAXCOLS];
+	uint8_t lastattr = 0xFF, vga;
+	uint32_t row, col, cols = 0, atx = 0xFFFFFFFF, aty = 0xFFFFFFFF, cursorx, cursory;
+	char tmp[32];
+
+	vga = (ansiconsole_machine->videocard == VIDEO_CARD_VGA) ? 1 : 0;
+	for (row = 0; row < ANSICONSOLE_MAXROWS; row++) {
+		cols = vga ? vga_textRow(&ansiconsole_machine->vga, row, chars, attrs) : cga_textRow(&ansiconsole_machine->cga, row, chars, attrs);
+		if ((cols == 0) || (cols > ANSICONSOLE_MAXCOLS)) break;
+		if (row == 0) {
+			if (cols != ansiconsole_cols) {
+				ansiconsole_valid = 0;
+			}
+			if (!ansiconsole_valid) { //mode change, start over from a blank screen
+				ansiconsole_put("\x1B[0m\x1B[2J");
+			}
+			ansiconsole_cols = cols;
+		}
+		for (col = 0; col < cols; col++) {
+			if (ansiconsole_valid && (chars[col] == ansiconsole_chars[row][col]) && (attrs[col] == ansiconsole_attrs[row][col])) {
+				continue;
+			}
+			if ((row != aty) || (col != atx)) {
+				sprintf(tmp, "\x1B[%lu;%luH", (unsigned long)row + 1, (unsigned long)col + 1);
+				ansiconsole_put(tmp);
+			}
+			if (attrs[col] != lastattr) {
+				sprintf(tmp, "\x1B[0;%u;%um", ((attrs[col] & 8) ? 90 : 30) + ansiconsole_color(attrs[col] & 7), 40 + ansiconsole_color((attrs[col] >> 4) & 7));
+				ansiconsole_put(tmp);
+				lastattr = attrs[col];
+			}
+			ansiconsole_putGlyph(chars[col]);
+			ansiconsole_chars[row][col] = chars[col];
+			ansiconsole_attrs[row][col] = attrs[col];
+			atx = col + 1;
+			aty = row;
+		}
+	}
+	if (row == 0) { //graphics mode, leave the last text screen up
+		ansiconsole_valid = 0;
+		return;
+	}
+	if (row != ansiconsole_rows) {
+		ansiconsole_valid = 0;
+		ansiconsole_rows = row;
+	}
+	else {
+		ansiconsole_valid = 1;
+	}
+
+	if (vga) vga_textCursor(&ansiconsole_machine->vga, &cursorx, &cursory);
+	else cga_textCursor(&ansiconsole_machine->cga, &cursorx, &cursory);
+	if ((ansiconsole_len > 0) || (cursorx != ansiconsole_cursorx) || (cursory != ansiconsole_cursory)) {
+		sprintf(tmp, "\x1B[0m\x1B[%lu;%luH", (unsigned long)cursory + 1, (unsigned long)cursorx + 1);
+		ansiconsole_put(tmp);
+		ansiconsole_cursorx = cursorx;
+		ansiconsole_cursory = cursory;
+	}
+	ansiconsole_flush();
+}
+
+void ansiconsole_key(uint8_t scancode) {
+	INPUTEVENT_t input;
+
+	input.type = INPUT_EVENT_KEY;
+	input.code = scancode;
+	input.state = 0;
+	input.xrel = input.yrel = 0;
+	input_push(&input);
+}
+
+//a terminal only tells us about characters, so each becomes a press and release
+void ansiconsole_typeChar(char c) {
+	uint8_t scancode, shift, ctrl = 0;
+
+	if ((c >= 1) && (c <= 26) && (c != '\b') && (c != '\t') && (c != '\r') && (c != '\n')) {
+		ctrl = 1;
+		c += 'a' - 1;
+	}
+	if (c == '\r') c = '\n';
+	if (c == 0x7F) c = '\b';
+	scancode = input_asciiScancode(c, &shift);
+	if (scancode == 0x00) return;
+	if (ctrl) ansiconsole_key(0x1D);
+	if (shift) ansiconsole_key(0x2A);
+	ansiconsole_key(scancode);
+	ansiconsole_key(scancode | 0x80);
+	if (shift) ansiconsole_key(0xAA);
+	if (ctrl) ansiconsole_key(0x9D);
+}
+
+#ifndef _WIN32
+//a key with the xterm modifier parameter applied, 1 + 1 for Shift, 2 for Alt, 4 for Ctrl
+void ansiconsole_modKey(uint8_t scancode, uint32_t mod) {
+	mod = (mod > 1) ? mod - 1 : 0;
+	if (mod & 4) ansiconsole_key(0x1D);
+	if (mod & 2) ansiconsole_key(0x38);
+	if (mod & 1) ansiconsole_key(0x2A);
+	ansiconsole_key(scancode);
+	ansiconsole_key(scancode | 0x80);
+	if (mod & 1) ansiconsole_key(0xAA);
+	if (mod & 2) ansiconsole_key(0xB8);
+	if (mod & 4) ansiconsole_key(0x9D);
+}
+
+/*
+	VT100/xterm escape sequences for the keys that don't have a character, with the modifier
+	parameter some keys carry (ESC [ 1 ; 5 A is Ctrl+Up). Sets "used" to how many bytes the
+	sequence took, or to 0 if it runs past the end of what was read, so the caller can keep it
+	for the next read.
+*/
+void ansiconsole_escape(uint8_t* seq, uint32_t len, uint32_t* used) {
+	uint8_t scancode = 0x00;
+	uint32_t param[2] = { 0, 0 }, count = 0, i = 2;
+
+	*used = 0;
+	if ((len < 2) || ((len < 3) && ((seq[1] == '[') || (seq[1] == 'O')))) {
+		return; //can't tell yet
+	}
+	if ((seq[1] != '[') && (seq[1] != 'O')) {
+		*used = 1;
+		ansiconsole_key(0x01); //just Esc
+		ansiconsole_key(0x81);
+		return;
+	}
+	//parameters are digits split by ';', anything up to the final byte (40h to 7Eh) belongs to the sequence
+	while ((i < len) && ((seq[i] < 0x40) || (seq[i] > 0x7E))) {
+		if ((seq[i] >= '0') && (seq[i] <= '9')) {
+			if (count < 2) param[count] = param[count] * 10 + (seq[i] - '0');
+		}
+		else if (seq[i] == ';') {
+			count++;
+		}
+		i++;
+	}
+	if (i == len) return;
+	*used = i + 1;
+	switch (seq[i]) {
+	case 'A': scancode = 0x48; break;
+	case 'B': scancode = 0x50; break;
+	case 'C': scancode = 0x4D; break;
+	case 'D': scancode = 0x4B; break;
+	case 'H': scancode = 0x47; break;
+	case 'F': scancode = 0x4F; break;
+	case 'P': scancode = 0x3B; break;
+	case 'Q': scancode = 0x3C; break;
+	case 'R': scancode = 0x3D; break;
+	case 'S': scancode = 0x3E; break;
+	case '~':
+		switch (param[0]) {
+		case 1: scancode = 0x47; break;
+		case 2: scancode = 0x52; break;
+		case 3: scancode = 0x53; break;
+		case 4: scancode = 0x4F; break;
+		case 5: scancode = 0x49; break;
+		case 6: scancode = 0x51; break;
+		case 15: scancode = 0x3F; break;
+		case 17: scancode = 0x40; break;
+		case 18: scancode = 0x41; break;
+		case 19: scancode = 0x42; break;
+		case 20: scancode = 0x43; break;
+		case 21: scancode = 0x44; break;
+		}
+		break;
+	}
+	if (scancode != 0x00) {
+		ansiconsole_modKey(scancode, param[1]);
+	}
+}
+#endif
+
+//waits for terminal input until the next frame is due, then draws it
+void ansiconsole_loop() {
+	uint64_t now;
+	uint32_t waitms;
+
+	now = timing_getHostCur();
+	if (now >= ansiconsole_nextframe) {
+		ansiconsole_draw();
+		ansiconsole_nextframe = now + timing_getHostFreq() / ANSICONSOLE_FPS;
+	}
+	waitms = (uint32_t)(((ansiconsole_nextframe - now) * 1000) / timing_getHostFreq());
+
+#ifdef _WIN32
+	{
+		INPUT_RECORD rec[32];
+		DWORD count, i;
+
+		if (WaitForSingleObject(ansiconsole_in, waitms) != WAIT_OBJECT_0) return;
+		if (!ReadConsoleInput(ansiconsole_in, rec, 32, &count)) return;
+		for (i = 0; i < count; i++) {
+			if (rec[i].EventType != KEY_EVENT) continue;
+			//the console hands over real set 1 scancodes, up and down, so they go straight through
+			if (rec[i].Event.KeyEvent.bKeyDown && (rec[i].Event.KeyEvent.uChar.AsciiChar == ANSICONSOLE_QUITKEY)) {
+				running = 0;
+				return;
+			}
+			if ((rec[i].Event.KeyEvent.wVirtualScanCode == 0) || (rec[i].Event.KeyEvent.wVirtualScanCode > 0x7F)) continue;
+			ansiconsole_key((uint8_t)rec[i].Event.KeyEvent.wVirtualScanCode | (rec[i].Event.KeyEvent.bKeyDown ? 0x00 : 0x80));
+		}
+	}
+#else
+	{
+		fd_set fds;
+		struct timeval tv;
+		uint8_t buf[ANSICONSOLE_ESCLEN + 64];
+		ssize_t len;
+		uint32_t i, used, total;
+
+		if (ansiconsole_esclen > 0) { //the rest of a cut off sequence should follow right away
+			if ((now - ansiconsole_escstart) >= (timing_getHostFreq() * ANSICONSOLE_ESCWAIT) / 1000) {
+				if ((ansiconsole_esclen == 1) && (ansiconsole_esc[0] == 0x1B)) { //it was the Esc key
+					ansiconsole_key(0x01);
+					ansiconsole_key(0x81);
+				}
+				ansiconsole_esclen = 0; //anything longer never got finished, so it's dropped
+			}
+			else if (waitms > ANSICONSOLE_ESCWAIT) {
+				waitms = ANSICONSOLE_ESCWAIT;
+			}
+		}
+		FD_ZERO(&fds);
+		FD_SET(STDIN_FILENO, &fds);
+		tv.tv_sec = waitms / 1000;
+		tv.tv_usec = (waitms % 1000) * 1000;
+		if (select(STDIN_FILENO + 1, &fds, NULL, NULL, &tv) <= 0) return;
+		memcpy(buf, ansiconsole_esc, ansiconsole_esclen);
+		len = read(STDIN_FILENO, buf + ansiconsole_esclen, sizeof(buf) - ANSICONSOLE_ESCLEN);
+		if (len <= 0) return;
+		total = ansiconsole_esclen + (uint32_t)len;
+		ansiconsole_esclen = 0;
+		for (i = 0; i < total; i += used) {
+			used = 1;
+			if (buf[i] == ANSICONSOLE_QUITKEY) {
+				running = 0;
+				return;
+			}
+			if (buf[i] == 0x1B) {
+				ansiconsole_escape(&buf[i], total - i, &used);
+				if (used == 0) {
+					if ((total - i) < ANSICONSOLE_ESCLEN) { //finish it off after the next read
+						memcpy(ansiconsole_esc, &buf[i], total - i);
+						ansiconsole_esclen = total - i;
+						ansiconsole_escstart = timing_getHostCur();
+						break;
+					}
+					used = total - i; //too long to be a key, whatever it was
+				}
+			}
+			else {
+				ansiconsole_typeChar((char)buf[i]);
+			}
+		}
+	}
+#endif
+}
+
+void ansiconsole_close() {
+	if (!ansiconsole_active) return;
+	ansiconsole_active = 0;
+	ansiconsole_put("\x1B[0m\x1B[2J\x1B[H\x1B[?1049l");
+	ansiconsole_flush();
+#ifdef _WIN32
+	SetConsoleMode(ansiconsole_in, ansiconsole_inmode);
+	SetConsoleMode(ansiconsole_out, ansiconsole_outmode);
+	SetConsoleOutputCP(ansiconsole_cp);
+#else
+	tcsetattr(STDIN_FILENO, TCSANOW, &ansiconsole_termios);
+#endif
+}
+
+int ansiconsole_init(MACHINE_t* machine) {
+#ifndef _WIN32
+	struct termios raw;
+#endif
+
+	ansiconsole_machine = machine;
+
+#ifdef _WIN32
+	ansiconsole_in = GetStdHandle(STD_INPUT_HANDLE);
+	ansiconsole_out = GetStdHandle(STD_OUTPUT_HANDLE);
+	if (!GetConsoleMode(ansiconsole_in, &ansiconsole_inmode) || !GetConsoleMode(ansiconsole_out, &ansiconsole_outmode)) {
+		debug_log(DEBUG_ERROR, "[ANSI] Not running in a console\r\n");
+		return -1;
+	}
+	ansiconsole_cp = GetConsoleOutputCP();
+	SetConsoleOutputCP(CP_UTF8);
+	SetConsoleMode(ansiconsole_in, 0);
+	if (!SetConsoleMode(ansiconsole_out, ansiconsole_outmode | ENABLE_VIRTUAL_TERMINAL_PROCESSING)) {
+		debug_log(DEBUG_ERROR, "[ANSI] This console doesn't understand escape sequences\r\n");
+		return -1;
+	}
+#else
+	if (!isatty(STDIN_FILENO) || (tcgetattr(STDIN_FILENO, &ansiconsole_termios) < 0)) {
+		debug_log(DEBUG_ERROR, "[ANSI] Standard input is not a terminal\r\n");
+		return -1;
+	}
+	raw = ansiconsole_termios;
+	raw.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON);
+	raw.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+	raw.c_cflag |= CS8;
+	raw.c_cc[VMIN] = 0;
+	raw.c_cc[VTIME] = 0;
+	tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+#endif
+
+	ansiconsole_active = 1;
+	atexit(ansiconsole_close);
+	ansiconsole_put("\x1B[?1049h\x1B[0m\x1B[2J");
+	ansiconsole_flush();
+
+	return 0;
+}
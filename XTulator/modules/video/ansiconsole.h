@@ -0,0 +1,22 @@
+#ifndef _ANSICONSOLE_H_
+#define _ANSICONSOLE_H_
+
+#include <stdint.h>
+#include "../../machine.h"
+
+#define ANSICONSOLE_FPS			30
+#define ANSICONSOLE_MAXCOLS		80
+#define ANSICONSOLE_MAXROWS		64
+#define ANSICONSOLE_BUFSIZE		(ANSICONSOLE_MAXCOLS * ANSICONSOLE_MAXROWS * 32) //room for every cell to need its own move and colors
+#define ANSICONSOLE_QUITKEY		0x1D //Ctrl-], like telnet
+#define ANSICONSOLE_ESCLEN		16 //longest escape sequence kept for the next read when one gets cut off
+#define ANSICONSOLE_ESCWAIT		50 //ms an Esc on its own waits for the rest of a sequence before it counts as the key
+
+int ansiconsole_init(MACHINE_t* machine);
+void ansiconsole_close();
+void ansiconsole_loop();
+void ansiconsole_draw();
+void ansiconsole_key(uint8_t scancode);
+void ansiconsole_typeChar(char c);
+
+#endif
@@ -20,11 +20,11 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
 #ifdef _WIN32
 #include <process.h>
 #else
 #include <pthread.h>
-pthread_t cga_renderThreadID;
 #endif
 #include "cga.h"
 #include "../../config.h"
@@ -65,105 +65,100 @@ const uint8_t cga_gfxpal[2][2][4] = { //palettes for 320x200 graphics mode
 	}
 };
 
-uint8_t cga_font[4096];
-uint32_t cga_framebuffer[400][640];
-uint16_t cga_cursorloc = 0;
-uint8_t cga_indexreg = 0, cga_datareg[256], cga_regs[16];
-uint8_t cga_cursor_blink_state = 0;
-uint8_t *cga_RAM = NULL;
-
-volatile uint8_t cga_doDraw = 1;
-
-int cga_init() {
-	int x, y;
+int cga_init(CGA_t* cga, uint8_t headless) {
+#ifndef _WIN32
+	pthread_t renderThreadID;
+#endif
 
 	debug_log(DEBUG_INFO, "[CGA] Initializing CGA video device\r\n");
 
-	if (utility_loadFile(cga_font, 4096, "roms/video/cgachar.bin")) {
+	memset(cga, 0, sizeof(CGA_t));
+	cga->doDraw = 1;
+	cga->linewrite = 1;
+	cga->headless = headless;
+
+	cga->font = memory_loadROM("roms/video/cgachar.bin", 4096);
+	if (cga->font == NULL) {
 		debug_log(DEBUG_ERROR, "[CGA] Failed to load character generator ROM\r\n");
 		return -1;
 	}
 
-	for (y = 0; y < 400; y++) {
-		for (x = 0; x < 640; x++) {
-			cga_framebuffer[y][x] = cga_color(CGA_BLACK);
-		}
+	if (!headless) {
+		cga_present(cga); //framebuffer was cleared to CGA_BLACK above
 	}
-	sdlconsole_blit((uint32_t *)cga_framebuffer, 640, 400, 640 * sizeof(uint32_t));
 
-	timing_addTimer(cga_blinkCallback, NULL, 3, TIMING_ENABLED);
-	timing_addTimer(cga_scanlineCallback, NULL, 62800, TIMING_ENABLED);
-	timing_addTimer(cga_drawCallback, NULL, 60, TIMING_ENABLED);
+	timing_addTimer(cga_blinkCallback, cga, 3, TIMING_ENABLED);
+	timing_addTimer(cga_drawCallback, cga, 60, TIMING_ENABLED);
 	/*
-		NOTE: CGA scanlines are clocked at 15.7 KHz. We are breaking each scanline into
-		four parts and using the last part as a very approximate horizontal retrace period.
-		
-		15700 x 4 = 62800
-
-		See cga_scanlineCallback function for more details.
+		NOTE: There is no scanline timer. The beam position is worked out from the time since
+		the first frame started whenever it's needed, see cga_beamPosition.
 	*/
+	cga->dotratio = (double)CGA_DOTCLOCK / (double)timing_getFreq();
+	cga->frameorigin = timing_getCur();
 
-	cga_RAM = (uint8_t*)malloc(16384);
-	if (cga_RAM == NULL) {
+	cga->RAM = (uint8_t*)malloc(16384);
+	if (cga->RAM == NULL) {
 		debug_log(DEBUG_ERROR, "[CGA] Failed to allocate video memory\r\n");
 		return -1;
 	}
 
 	//TODO: error checking below
+	if (!headless) { //nothing to show a headless instance's frames on
 #ifdef _WIN32
-	_beginthread(cga_renderThread, 0, NULL);
+		_beginthread(cga_renderThread, 0, cga);
 #else
-	pthread_create(&cga_renderThreadID, NULL, cga_renderThread, NULL);
+		pthread_create(&renderThreadID, NULL, cga_renderThread, cga);
 #endif
+	}
 
-	ports_cbRegister(0x3D0, 16, (void*)cga_readport, NULL, (void*)cga_writeport, NULL, NULL);
-	memory_mapCallbackRegister(0xB8000, 0x4000, (void*)cga_readmemory, (void*)cga_writememory, NULL);
+	ports_cbRegister(0x3D0, 16, (void*)cga_readport, NULL, (void*)cga_writeport, NULL, cga);
+	ports_setTimed(0x3DA, 1); //status comes from the beam position
+	memory_mapCallbackRegister(0xB8000, 0x4000, (void*)cga_readmemory, (void*)cga_writememory, cga);
 
 	return 0;
 }
 
-void cga_update(uint32_t start_x, uint32_t start_y, uint32_t end_x, uint32_t end_y) {
+void cga_update(CGA_t* cga, uint32_t start_x, uint32_t start_y, uint32_t end_x, uint32_t end_y) {
 	uint32_t addr, startaddr, cursorloc, cursor_x, cursor_y;
 	uint32_t scx, scy, x, y;
-	uint8_t cc, attr, fontdata, blink, mode, colorset, intensity, blinkenable;
+	uint8_t cc, attr, fontdata, blink, mode, colorset, intensity, blinkenable, color, lines;
 
-	if (cga_regs[0x8] & 0x02) { //graphics modes
-		mode = (cga_regs[0x8] & 0x10) ? CGA_MODE_GRAPHICS_HI : CGA_MODE_GRAPHICS_LO;
-		intensity = (cga_regs[0x9] & 0x10) ? 1 : 0;
-		colorset = (cga_regs[0x9] & 0x20) ? 1 : 0;
+	lines = cga->linebuf;
+	if (cga->regs[0x8] & 0x02) { //graphics modes, palette is taken per scanline further down so mid-frame changes show up
+		mode = (cga->regs[0x8] & 0x10) ? CGA_MODE_GRAPHICS_HI : CGA_MODE_GRAPHICS_LO;
 	} else { //text modes
-		mode = (cga_regs[0x8] & 0x01) ? CGA_MODE_TEXT_80X25 : CGA_MODE_TEXT_40X25;
-		blinkenable = (cga_regs[0x8] & 0x20) ? 1 : 0;
+		mode = (cga->regs[0x8] & 0x01) ? CGA_MODE_TEXT_80X25 : CGA_MODE_TEXT_40X25;
+		blinkenable = (cga->regs[0x8] & 0x20) ? 1 : 0;
 	}
-	startaddr = (((uint32_t)cga_datareg[0x12] & 0x3F) << 8) | (uint32_t)cga_datareg[0x13];
-	cursorloc = (((uint32_t)cga_datareg[0xE] << 8) & 0xFF00) | (uint32_t)cga_datareg[0xF];
+	startaddr = (((uint32_t)cga->datareg[0x12] & 0x3F) << 8) | (uint32_t)cga->datareg[0x13];
+	cursorloc = (((uint32_t)cga->datareg[0xE] << 8) & 0xFF00) | (uint32_t)cga->datareg[0xF];
 
 	switch (mode) {
 	case CGA_MODE_TEXT_80X25:
 		cursor_x = cursorloc % 80;
 		cursor_y = cursorloc / 80;
 		for (scy = start_y; scy <= end_y; scy++) {
-			y = scy / (((cga_datareg[0x09] & 0x1F) + 1) * 2);
+			y = scy / (((cga->datareg[0x09] & 0x1F) + 1) * 2);
 			for (scx = start_x; scx <= end_x; scx++) {
 				x = scx / 8;
 				addr = startaddr + ((y * 80) + x) * 2;
-				cc = cga_RAM[addr];
-				attr = cga_RAM[addr + 1];
+				cc = cga->RAM[addr];
+				attr = cga->RAM[addr + 1];
 				blink = attr >> 7;
 				if (blinkenable) attr &= 0x7F; //enabling text mode blink attribute limits background color selection
-				fontdata = cga_font[2048 + (cc * 8) + ((scy % 16) / 2)];
+				fontdata = cga->font[2048 + (cc * 8) + ((scy % 16) / 2)];
 				fontdata = (fontdata >> (7 - (scx % 8))) & 1;
 				if ((y == cursor_y) && (x == cursor_x) &&
-					((uint8_t)(scy % 16) >= (cga_datareg[CGA_REG_DATA_CURSOR_BEGIN] & 31) * 2) &&
-					((uint8_t)(scy % 16) <= (cga_datareg[CGA_REG_DATA_CURSOR_END] & 31) * 2) &&
-					cga_cursor_blink_state && blinkenable) { //cursor should be displayed
-					cga_framebuffer[scy][scx] = cga_color(attr & 0x0F);
+					((uint8_t)(scy % 16) >= (cga->datareg[CGA_REG_DATA_CURSOR_BEGIN] & 31) * 2) &&
+					((uint8_t)(scy % 16) <= (cga->datareg[CGA_REG_DATA_CURSOR_END] & 31) * 2) &&
+					cga->cursor_blink_state && blinkenable) { //cursor should be displayed
+					cga->framebuffer[scy][scx] = attr & 0x0F;
 				}
 				else {
-					if (blinkenable && blink && !cga_cursor_blink_state) {
+					if (blinkenable && blink && !cga->cursor_blink_state) {
 						fontdata = 0; //all pixels in character get background color if blink attribute set and blink visible state is false
 					}
-					cga_framebuffer[scy][scx] = cga_color(fontdata ? (attr & 0x0F) : (attr >> 4));
+					cga->framebuffer[scy][scx] = fontdata ? (attr & 0x0F) : (attr >> 4);
 				}
 			}
 		}
@@ -176,25 +171,25 @@ void cga_update(uint32_t start_x, uint32_t start_y, uint32_t end_x, uint32_t end
 			for (scx = start_x; scx <= end_x; scx += 2) {
 				x = scx / 16;
 				addr = startaddr + ((y * 40) + x) * 2;
-				cc = cga_RAM[addr];
-				attr = cga_RAM[addr + 1];
+				cc = cga->RAM[addr];
+				attr = cga->RAM[addr + 1];
 				blink = attr >> 7;
 				if (blinkenable) attr &= 0x7F; //enabling text mode blink attribute limits background color selection
-				fontdata = cga_font[2048 + (cc * 8) + ((scy % 16) / 2)];
+				fontdata = cga->font[2048 + (cc * 8) + ((scy % 16) / 2)];
 				fontdata = (fontdata >> (7 - ((scx / 2) % 8))) & 1;
 				if ((y == cursor_y) && (x == cursor_x) &&
-					((uint8_t)(scy % 16) >= (cga_datareg[CGA_REG_DATA_CURSOR_BEGIN] & 31) * 2) &&
-					((uint8_t)(scy % 16) <= (cga_datareg[CGA_REG_DATA_CURSOR_END] & 31) * 2) &&
-					cga_cursor_blink_state && blinkenable) {
-					cga_framebuffer[scy][scx] = cga_color(attr & 0x0F);
+					((uint8_t)(scy % 16) >= (cga->datareg[CGA_REG_DATA_CURSOR_BEGIN] & 31) * 2) &&
+					((uint8_t)(scy % 16) <= (cga->datareg[CGA_REG_DATA_CURSOR_END] & 31) * 2) &&
+					cga->cursor_blink_state && blinkenable) {
+					cga->framebuffer[scy][scx] = attr & 0x0F;
 				}
 				else {
-					if (blinkenable && blink && !cga_cursor_blink_state) {
+					if (blinkenable && blink && !cga->cursor_blink_state) {
 						fontdata = 0;
 					}
-					cga_framebuffer[scy][scx] = cga_color(fontdata ? (attr & 0x0F) : (attr >> 4));
+					cga->framebuffer[scy][scx] = fontdata ? (attr & 0x0F) : (attr >> 4);
 				}
-				cga_framebuffer[scy][scx + 1] = cga_framebuffer[scy][scx]; //double pixels horizontally
+				cga->framebuffer[scy][scx + 1] = cga->framebuffer[scy][scx]; //double pixels horizontally
 			}
 		}
 		break;
@@ -203,15 +198,19 @@ void cga_update(uint32_t start_x, uint32_t start_y, uint32_t end_x, uint32_t end
 			uint8_t isodd;
 			isodd = scy & 2;
 			y = scy >> 2;
+			color = cga->linecolor[lines][scy >> 1];
+			intensity = (color & 0x10) ? 1 : 0;
+			colorset = (color & 0x20) ? 1 : 0;
 			for (scx = start_x; scx <= end_x; scx += 2) {
 				x = scx >> 1;
 				addr = (isodd ? 0x2000 : 0x0000) + (y * 80) + (x >> 2);
-				cc = cga_RAM[addr];
-				cc = cga_gfxpal[intensity][colorset][(cc >> ((3 - (x & 3)) << 1)) & 3];
-				cga_framebuffer[scy][scx] = cga_color(cc);
-				cga_framebuffer[scy][scx + 1] = cga_framebuffer[scy][scx];
-				cga_framebuffer[scy + 1][scx + 1] = cga_framebuffer[scy][scx];
-				cga_framebuffer[scy + 1][scx] = cga_framebuffer[scy][scx];
+				cc = cga->RAM[addr];
+				cc = (cc >> ((3 - (x & 3)) << 1)) & 3;
+				cc = cc ? cga_gfxpal[intensity][colorset][cc] : (color & 0x0F); //color 0 is the background color
+				cga->framebuffer[scy][scx] = cc;
+				cga->framebuffer[scy][scx + 1] = cga->framebuffer[scy][scx];
+				cga->framebuffer[scy + 1][scx + 1] = cga->framebuffer[scy][scx];
+				cga->framebuffer[scy + 1][scx] = cga->framebuffer[scy][scx];
 			}
 		}
 		break;
@@ -222,26 +221,41 @@ void cga_update(uint32_t start_x, uint32_t start_y, uint32_t end_x, uint32_t end
 			uint8_t isodd;
 			isodd = scy & 2;
 			y = scy >> 2;
+			color = cga->linecolor[lines][scy >> 1] & 0x0F; //foreground color
 			for (scx = start_x; scx <= end_x; scx++) {
 				x = scx;
 				addr = (isodd ? 0x2000 : 0x0000) + (y * 80) + (x >> 3);
-				cc = cga_RAM[addr];
-				cc = ((cc >> (7 - (x & 7))) & 1) * 15;
-				cga_framebuffer[scy][scx] = cga_color(cc);
-				cga_framebuffer[scy + 1][scx] = cga_framebuffer[scy][scx];
+				cc = cga->RAM[addr];
+				cc = ((cc >> (7 - (x & 7))) & 1) ? color : 0;
+				cga->framebuffer[scy][scx] = cc;
+				cga->framebuffer[scy + 1][scx] = cga->framebuffer[scy][scx];
 			}
 		}
 		break;
 	}
 
-	sdlconsole_blit((uint32_t *)cga_framebuffer, 640, 400, 640 * sizeof(uint32_t));
+	if (!cga->headless) {
+		cga_present(cga);
+	}
+}
+
+//expands the color numbers left by cga_update to RGB and hands the frame on
+void cga_present(CGA_t* cga) {
+	uint32_t lut[256], i;
+
+	for (i = 0; i < 256; i++) {
+		lut[i] = cga_color(i & 0x0F);
+	}
+	sdlconsole_blitIndexed(&cga->framebuffer[0][0], 640, 400, 640, lut);
 }
 
-void cga_renderThread(void* dummy) {
+void cga_renderThread(CGA_t* cga) {
 	while (running) {
-		if (cga_doDraw == 1) {
-			cga_update(0, 0, 639, 399);
-			cga_doDraw = 0;
+		if (cga->doDraw == 1) {
+			if (sdlconsole_wantFrame()) {
+				cga_update(cga, 0, 0, 639, 399);
+			}
+			cga->doDraw = 0;
 		}
 		else {
 			utility_sleep(1);
@@ -254,85 +268,149 @@ void cga_renderThread(void* dummy) {
 #endif
 }
 
-void cga_writeport(void* dummy, uint16_t port, uint8_t value) {
+void cga_writeport(CGA_t* cga, uint16_t port, uint8_t value) {
 #ifdef DEBUG_CGA
-	debug_log(DEBUG_DETAIL, "Write CGA port: %02X -> %03X (indexreg = %02X)\r\n", value, port, cga_indexreg);
+	debug_log(DEBUG_DETAIL, "Write CGA port: %02X -> %03X (indexreg = %02X)\r\n", value, port, cga->indexreg);
 #endif
 	switch (port) {
 	case 0x3D4:
-		cga_indexreg = value;
+		cga->indexreg = value;
 		break;
 	case 0x3D5:
-		cga_datareg[cga_indexreg] = value;
+		cga->datareg[cga->indexreg] = value;
 		break;
 	case 0x3DA:
 		break;
+	case 0x3D9:
+		cga_syncLines(cga); //lines already scanned out keep the old colors
+		cga->regs[0x9] = value;
+		break;
 	default:
-		cga_regs[port - 0x3D0] = value;
+		cga->regs[port - 0x3D0] = value;
 	}
 }
 
-uint8_t cga_readport(void* dummy, uint16_t port) {
+uint8_t cga_readport(CGA_t* cga, uint16_t port) {
 #ifdef DEBUG_CGA
-	debug_log(DEBUG_DETAIL, "Read CGA port: %03X (indexreg = %02X)\r\n", port, cga_indexreg);
+	debug_log(DEBUG_DETAIL, "Read CGA port: %03X (indexreg = %02X)\r\n", port, cga->indexreg);
 #endif
 	switch (port) {
 	case 0x3D4:
-		return cga_indexreg;
+		return cga->indexreg;
 	case 0x3D5:
-		//if ((cga_indexreg < 0x0E) || (cga_indexreg > 0x0F)) return 0xFF;
-		return cga_datareg[cga_indexreg];
+		//if ((cga->indexreg < 0x0E) || (cga->indexreg > 0x0F)) return 0xFF;
+		return cga->datareg[cga->indexreg];
 	case 0x3DA:
-		return cga_regs[0xA]; //rand() & 0xF;
+		return cga_readStatus(cga);
 	}
-	return cga_regs[port - 0x3D0]; //0xFF;
+	return cga->regs[port - 0x3D0]; //0xFF;
 }
 
-void cga_writememory(void* dummy, uint32_t addr, uint8_t value) {
+void cga_writememory(CGA_t* cga, uint32_t addr, uint8_t value) {
 	addr -= 0xB8000;
 	if (addr >= 16384) return;
 
-	cga_RAM[addr] = value;
+	cga->RAM[addr] = value;
+	if ((cga->textcb != NULL) && !(cga->regs[0x8] & 0x02)) {
+		uint32_t startaddr, cols;
+		startaddr = (((uint32_t)cga->datareg[0x12] & 0x3F) << 8) | (uint32_t)cga->datareg[0x13];
+		addr = (addr - startaddr) & 0x3FFF;
+		cols = (cga->regs[0x8] & 0x01) ? 80 : 40;
+		if (!(addr & 1) && (addr < cols * 2 * 25)) {
+			(*cga->textcb)(cga->textudata, addr / (cols * 2));
+		}
+	}
 }
 
-uint8_t cga_readmemory(void* dummy, uint32_t addr) {
+uint8_t cga_readmemory(CGA_t* cga, uint32_t addr) {
 	addr -= 0xB8000;
 	if (addr >= 16384) return 0xFF;
 
-	return cga_RAM[addr];
+	return cga->RAM[addr];
 }
 
-void cga_blinkCallback(void* dummy) {
-	cga_cursor_blink_state ^= 1;
+//copies the characters and attributes (if attrs isn't NULL) of one visible text row, returns how many there were or 0 in graphics modes
+uint32_t cga_textRow(CGA_t* cga, uint32_t row, uint8_t* chars, uint8_t* attrs) {
+	uint32_t startaddr, cols, x, addr;
+
+	if ((cga->regs[0x8] & 0x02) || (row >= 25)) return 0;
+	startaddr = (((uint32_t)cga->datareg[0x12] & 0x3F) << 8) | (uint32_t)cga->datareg[0x13];
+	cols = (cga->regs[0x8] & 0x01) ? 80 : 40;
+	for (x = 0; x < cols; x++) {
+		addr = (startaddr + ((row * cols) + x) * 2) & 0x3FFF;
+		chars[x] = cga->RAM[addr];
+		if (attrs != NULL) {
+			attrs[x] = cga->RAM[(addr + 1) & 0x3FFF];
+		}
+	}
+	return cols;
 }
 
-void cga_scanlineCallback(void* dummy) {
-	/*
-		NOTE: We are only doing very approximate CGA timing. Breaking the horizontal scan into
-		four parts and setting the display inactive bit on 3DAh on the last quarter of it. Being
-		more precise shouldn't be necessary and will take much more host CPU time.
+void cga_textCursor(CGA_t* cga, uint32_t* x, uint32_t* y) {
+	uint32_t cursorloc, cols;
 
-		TODO: Look into whether this is true? So far, things are working fine.
-	*/
-	static uint16_t scanline = 0, hpart = 0;
-
-	cga_regs[0xA] = 6; //light pen bits always high
-	cga_regs[0xA] |= (hpart == 3) ? 1 : 0;
-	cga_regs[0xA] |= (scanline >= 224) ? 8 : 0;
-	
-	hpart++;
-	if (hpart == 4) {
-		/*if (scanline < 200) {
-			cga_update(0, (scanline<<1), 639, (scanline<<1)+1);
-		}*/
-		hpart = 0;
-		scanline++;
+	cursorloc = (((uint32_t)cga->datareg[0xE] << 8) & 0xFF00) | (uint32_t)cga->datareg[0xF];
+	cols = (cga->regs[0x8] & 0x01) ? 80 : 40;
+	*x = cursorloc % cols;
+	*y = cursorloc / cols;
+}
+
+void cga_blinkCallback(CGA_t* cga) {
+	cga->cursor_blink_state ^= 1;
+}
+
+/*
+	The beam position is derived from elapsed time against CGA's fixed 14.31818 MHz dot clock,
+	912 dots per scanline (15.7 KHz) and 262 lines per frame. Nothing runs per scanline.
+*/
+void cga_beamPosition(CGA_t* cga, uint32_t* scanline, uint32_t* dot) {
+	double elapsed;
+	uint64_t frame;
+
+	elapsed = (double)(timing_getCur() - cga->frameorigin) * cga->dotratio;
+	frame = (uint64_t)(elapsed / (double)CGA_FRAMEDOTS);
+	if (frame != cga->framecount) {
+		cga_finishFrame(cga);
+		cga->framecount = frame;
 	}
-	if (scanline == 256) {
-		scanline = 0;
+	elapsed -= (double)frame * (double)CGA_FRAMEDOTS;
+	*scanline = (uint32_t)(elapsed / (double)CGA_LINEDOTS);
+	*dot = (uint32_t)(elapsed - (double)(*scanline) * (double)CGA_LINEDOTS);
+}
+
+uint8_t cga_readStatus(CGA_t* cga) {
+	uint32_t scanline, dot;
+
+	cga_beamPosition(cga, &scanline, &dot);
+	cga->regs[0xA] = 6; //light pen bits always high
+	cga->regs[0xA] |= ((dot >= CGA_DISPDOTS) || (scanline >= CGA_DISPLINES)) ? 1 : 0;
+	cga->regs[0xA] |= ((scanline >= CGA_VSYNCSTART) && (scanline < (CGA_VSYNCSTART + CGA_VSYNCLINES))) ? 8 : 0;
+	return cga->regs[0xA];
+}
+
+//fill in the scanline snapshots up to and including the line being scanned right now
+void cga_syncLines(CGA_t* cga) {
+	uint32_t scanline, dot, end;
+
+	cga_beamPosition(cga, &scanline, &dot);
+	end = scanline + 1;
+	if (end > CGA_DISPLINES) end = CGA_DISPLINES;
+	while (cga->snapline < end) {
+		cga->linecolor[cga->linewrite][cga->snapline++] = cga->regs[0x9];
+	}
+}
+
+//the beam has wrapped around, hand the finished frame's snapshots to the renderer
+void cga_finishFrame(CGA_t* cga) {
+	while (cga->snapline < CGA_DISPLINES) {
+		cga->linecolor[cga->linewrite][cga->snapline++] = cga->regs[0x9];
 	}
+	cga->linebuf = cga->linewrite;
+	cga->linewrite ^= 1;
+	cga->snapline = 0;
 }
 
-void cga_drawCallback(void* dummy) {
-	cga_doDraw = 1;
+void cga_drawCallback(CGA_t* cga) {
+	cga_syncLines(cga);
+	cga->doDraw = 1;
 }
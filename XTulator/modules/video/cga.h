@@ -4,18 +4,52 @@
 #include <stdint.h>
 #include "../../cpu/cpu.h"
 
+#define CGA_DOTCLOCK		14318180
+#define CGA_LINEDOTS		912
+#define CGA_FRAMELINES		262
+#define CGA_FRAMEDOTS		(CGA_LINEDOTS * CGA_FRAMELINES)
+#define CGA_DISPDOTS		640
+#define CGA_DISPLINES		200
+#define CGA_VSYNCSTART		224
+#define CGA_VSYNCLINES		16
+
+typedef struct {
+	uint8_t* font; //character generator ROM, shared between instances
+	uint8_t framebuffer[400][640]; //color numbers 0 to 15, cga_present expands them
+	uint16_t cursorloc;
+	uint8_t indexreg, datareg[256], regs[16];
+	uint8_t cursor_blink_state;
+	uint8_t* RAM;
+	volatile uint8_t doDraw;
+	uint64_t frameorigin, framecount;
+	double dotratio;
+	uint8_t linecolor[2][CGA_DISPLINES]; //color select register as it was when each line was scanned, double buffered
+	volatile uint8_t linebuf; //last completed frame, this is what the renderer uses
+	uint8_t linewrite;
+	uint32_t snapline;
+	uint8_t headless;
+	void (*textcb)(void* udata, uint32_t row); //told about every character written to a visible text row
+	void* textudata;
+} CGA_t;
+
 extern const uint8_t cga_palette[16][3];
 
-int cga_init();
-void cga_update(uint32_t start_x, uint32_t start_y, uint32_t end_x, uint32_t end_y);
-void cga_writeport(void* dummy, uint16_t port, uint8_t value);
-uint8_t cga_readport(void* dummy, uint16_t port);
-void cga_blinkCallback(void* dummy);
-void cga_scanlineCallback(void* dummy);
-void cga_renderThread(void* cpu);
-void cga_writememory(void* dummy, uint32_t addr, uint8_t value);
-uint8_t cga_readmemory(void* dummy, uint32_t addr);
-void cga_drawCallback(void* dummy);
+int cga_init(CGA_t* cga, uint8_t headless);
+void cga_update(CGA_t* cga, uint32_t start_x, uint32_t start_y, uint32_t end_x, uint32_t end_y);
+void cga_writeport(CGA_t* cga, uint16_t port, uint8_t value);
+uint8_t cga_readport(CGA_t* cga, uint16_t port);
+void cga_blinkCallback(CGA_t* cga);
+uint8_t cga_readStatus(CGA_t* cga);
+void cga_beamPosition(CGA_t* cga, uint32_t* scanline, uint32_t* dot);
+void cga_syncLines(CGA_t* cga);
+void cga_finishFrame(CGA_t* cga);
+void cga_present(CGA_t* cga);
+void cga_renderThread(CGA_t* cga);
+void cga_writememory(CGA_t* cga, uint32_t addr, uint8_t value);
+uint8_t cga_readmemory(CGA_t* cga, uint32_t addr);
+uint32_t cga_textRow(CGA_t* cga, uint32_t row, uint8_t* chars, uint8_t* attrs);
+void cga_textCursor(CGA_t* cga, uint32_t* x, uint32_t* y);
+void cga_drawCallback(CGA_t* cga);
 
 //#define cga_color(c) ((uint32_t)cga_palette[c][0] | ((uint32_t)cga_palette[c][1]<<8) | ((uint32_t)cga_palette[c][2]<<16))
 #define cga_color(c) ((uint32_t)cga_palette[c][2] | ((uint32_t)cga_palette[c][1]<<8) | ((uint32_t)cga_palette[c][0]<<16))
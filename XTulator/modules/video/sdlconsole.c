@@ -28,9 +28,14 @@
 #endif
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include "sdlconsole.h"
 #include "../input/sdlkeys.h"
 #include "../input/mouse.h"
+#include "../input/input.h"
+#include "vncserver.h"
+#include "shmframe.h"
+#include "../../capture.h"
 #include "../../timing.h"
 #include "../../menus.h"
 
@@ -39,16 +44,15 @@ SDL_Renderer *sdlconsole_renderer = NULL;
 SDL_Texture *sdlconsole_texture = NULL;
 
 uint64_t sdlconsole_frameTime[30];
-uint32_t sdlconsole_keyTimer;
-uint8_t sdlconsole_curkey, sdlconsole_lastKey, sdlconsole_frameIdx = 0, sdlconsole_grabbed = 0, sdlconsole_ctrl = 0, sdlconsole_alt = 0, sdlconsole_doRepeat = 0;
+uint64_t sdlconsole_repeatDue;
+uint8_t sdlconsole_lastKey = 0x00, sdlconsole_frameIdx = 0, sdlconsole_grabbed = 0, sdlconsole_ctrl = 0, sdlconsole_alt = 0;
 int sdlconsole_curw, sdlconsole_curh;
 
-char* sdlconsole_title;
+uint32_t* sdlconsole_frame = NULL; //last frame expanded by sdlconsole_blitIndexed, packed to its width
+size_t sdlconsole_frameSize = 0;
+int sdlconsole_framew = 0, sdlconsole_frameh = 0;
 
-void sdlconsole_keyRepeat(void* dummy) {
-	sdlconsole_doRepeat = 1;
-	timing_updateIntervalFreq(sdlconsole_keyTimer, 15);
-}
+char* sdlconsole_title;
 
 int sdlconsole_init(char *title) {
 #ifdef _WIN32
@@ -70,8 +74,6 @@ int sdlconsole_init(char *title) {
 		return -1;
 	}
 
-	sdlconsole_keyTimer = timing_addTimer(sdlconsole_keyRepeat, NULL, 2, TIMING_DISABLED);
-
 #ifdef _WIN32
 	SDL_VERSION(&wmInfo.version);
 	SDL_GetWindowWMInfo(sdlconsole_window, &wmInfo);
@@ -113,7 +115,14 @@ void sdlconsole_setTitle(char* title) { //appends something to the main title, d
 void sdlconsole_blit(uint32_t *pixels, int w, int h, int stride) {
 	static uint64_t lasttime = 0;
 	uint64_t curtime;
-	curtime = timing_getCur();
+	curtime = timing_getHostCur(); //this runs on a render thread, and the frame rate is a host side number anyway
+
+	vncserver_blit(pixels, w, h, stride);
+	shmframe_blit(pixels, w, h, stride);
+	capture_blit(pixels, w, h, stride);
+	if (sdlconsole_window == NULL) { //-console none or ansi, only a VNC viewer, shared memory reader or capture is looking
+		return;
+	}
 
 	if ((w != sdlconsole_curw) || (h != sdlconsole_curh)) {
 		sdlconsole_setWindow(w, h);
@@ -139,13 +148,49 @@ void sdlconsole_blit(uint32_t *pixels, int w, int h, int stride) {
 				}
 			}
 			curavg /= avgcount;
-			sprintf(tmp, "%.2f FPS", (double)((timing_getFreq() * 10) / curavg) / 10);
+			sprintf(tmp, "%.2f FPS", (double)((timing_getHostFreq() * 10) / curavg) / 10);
 			sdlconsole_setTitle(tmp);
 		}
 	}
 	lasttime = curtime;
 }
 
+/*
+	Expands a frame of palette indices through lut into the one 32-bit frame every output reads
+	from, then shows it with sdlconsole_blit. A NULL lut means neither the indices nor the palette
+	changed since the last call, so the frame expanded then is shown again as it is. Only the
+	render thread of the machine's one video card calls this.
+*/
+void sdlconsole_blitIndexed(const uint8_t* src, int w, int h, int stride, const uint32_t* lut) {
+	uint32_t* dst;
+	int x, y;
+
+	if (lut != NULL) {
+		if ((size_t)w * h > sdlconsole_frameSize) {
+			dst = (uint32_t*)realloc(sdlconsole_frame, (size_t)w * h * sizeof(uint32_t));
+			if (dst == NULL) return;
+			sdlconsole_frame = dst;
+			sdlconsole_frameSize = (size_t)w * h;
+		}
+		for (y = 0; y < h; y++) {
+			dst = sdlconsole_frame + (size_t)y * w;
+			for (x = 0; x < w; x++) {
+				dst[x] = lut[src[x]];
+			}
+			src += stride;
+		}
+		sdlconsole_framew = w;
+		sdlconsole_frameh = h;
+	}
+	if (sdlconsole_frame == NULL) return;
+	sdlconsole_blit(sdlconsole_frame, sdlconsole_framew, sdlconsole_frameh, sdlconsole_framew * sizeof(uint32_t));
+}
+
+//lets the render threads skip drawing frames nobody is going to see
+int sdlconsole_wantFrame() {
+	return (sdlconsole_window != NULL) || vncserver_connected || shmframe_active || capture_active;
+}
+
 void sdlconsole_mousegrab() {
 	sdlconsole_ctrl = sdlconsole_alt = 0;
 	if (sdlconsole_grabbed) {
@@ -157,90 +202,121 @@ void sdlconsole_mousegrab() {
 	}
 }
 
-int sdlconsole_loop() {
-	SDL_Event event;
-	int8_t xrel, yrel;
-	uint8_t action = 0;
+void sdlconsole_pushKey(uint8_t scancode) {
+	INPUTEVENT_t input;
 
-	if (sdlconsole_doRepeat) {
-		sdlconsole_doRepeat = 0;
-		sdlconsole_curkey = sdlconsole_lastKey;
-		return SDLCONSOLE_EVENT_KEY;
-	}
+	input.type = INPUT_EVENT_KEY;
+	input.code = scancode;
+	input.state = 0;
+	input.xrel = input.yrel = 0;
+	input_push(&input);
+}
+
+void sdlconsole_pushMouse(uint8_t action, uint8_t state, int32_t xrel, int32_t yrel) {
+	INPUTEVENT_t input;
+
+	input.type = INPUT_EVENT_MOUSE;
+	input.code = action;
+	input.state = state;
+	input.xrel = xrel;
+	input.yrel = yrel;
+	input_push(&input);
+}
 
-	if (!SDL_PollEvent(&event)) return SDLCONSOLE_EVENT_NONE;
-	switch (event.type) {
+void sdlconsole_event(SDL_Event* event) {
+	INPUTEVENT_t input;
+	int8_t xrel, yrel;
+	uint8_t action = 0, scancode;
+
+	switch (event->type) {
 		case SDL_KEYDOWN:
-#ifdef DEBUG_VGA
-			if (event.key.keysym.sym == SDLK_F12) {
-				vga_dumpregs();
-			}
-#endif
-			if (event.key.repeat) return SDLCONSOLE_EVENT_NONE;
-			switch (event.key.keysym.sym) {
+			if (event->key.repeat) return;
+			switch (event->key.keysym.sym) {
 			case SDLK_F11:
-				return SDLCONSOLE_EVENT_DEBUG_1;
 			case SDLK_F12:
-				return SDLCONSOLE_EVENT_DEBUG_2;
+				input.type = INPUT_EVENT_DEBUG;
+				input.code = (event->key.keysym.sym == SDLK_F11) ? 1 : 2;
+				input.state = 0;
+				input.xrel = input.yrel = 0;
+				input_push(&input);
+				return;
 			default:
-				if (event.key.keysym.sym == SDLK_LCTRL) sdlconsole_ctrl = 1;
-				if (event.key.keysym.sym == SDLK_LALT) sdlconsole_alt = 1;
+				if (event->key.keysym.sym == SDLK_LCTRL) sdlconsole_ctrl = 1;
+				if (event->key.keysym.sym == SDLK_LALT) sdlconsole_alt = 1;
 				if (sdlconsole_ctrl & sdlconsole_alt) {
 					sdlconsole_mousegrab();
 				}
-				sdlconsole_curkey = sdlconsole_translateScancode(event.key.keysym.sym);
-				if (sdlconsole_curkey == 0x00) {
-					return SDLCONSOLE_EVENT_NONE;
-				} else {
-					sdlconsole_lastKey = sdlconsole_curkey;
-					timing_updateIntervalFreq(sdlconsole_keyTimer, 2);
-					timing_timerEnable(sdlconsole_keyTimer);
-					return SDLCONSOLE_EVENT_KEY;
-				}
+				scancode = sdlconsole_translateScancode(event->key.keysym.sym);
+				if (scancode == 0x00) return;
+				sdlconsole_lastKey = scancode;
+				sdlconsole_repeatDue = timing_getHostCur() + timing_getHostFreq() / 2;
+				sdlconsole_pushKey(scancode);
+				return;
 			}
 		case SDL_KEYUP:
-			if (event.key.repeat) return SDLCONSOLE_EVENT_NONE;
-			if (event.key.keysym.sym == SDLK_LCTRL) sdlconsole_ctrl = 0;
-			if (event.key.keysym.sym == SDLK_LALT) sdlconsole_alt = 0;
-			sdlconsole_curkey = sdlconsole_translateScancode(event.key.keysym.sym) | 0x80;
-			if ((sdlconsole_curkey & 0x7F) == sdlconsole_lastKey) {
-				timing_timerDisable(sdlconsole_keyTimer);
+			if (event->key.repeat) return;
+			if (event->key.keysym.sym == SDLK_LCTRL) sdlconsole_ctrl = 0;
+			if (event->key.keysym.sym == SDLK_LALT) sdlconsole_alt = 0;
+			scancode = sdlconsole_translateScancode(event->key.keysym.sym);
+			if (scancode == 0x00) return;
+			if (scancode == sdlconsole_lastKey) {
+				sdlconsole_lastKey = 0x00;
 			}
-			return (sdlconsole_curkey == 0x80) ? SDLCONSOLE_EVENT_NONE : SDLCONSOLE_EVENT_KEY;
+			sdlconsole_pushKey(scancode | 0x80);
+			return;
 		case SDL_MOUSEMOTION:
-			xrel = (event.motion.xrel < -128) ? -128 : (int8_t)event.motion.xrel;
-			xrel = (event.motion.xrel > 127) ? 127 : (int8_t)event.motion.xrel;
-			yrel = (event.motion.yrel < -128) ? -128 : (int8_t)event.motion.yrel;
-			yrel = (event.motion.yrel > 127) ? 127 : (int8_t)event.motion.yrel;
+			xrel = (event->motion.xrel < -128) ? -128 : (int8_t)event->motion.xrel;
+			xrel = (event->motion.xrel > 127) ? 127 : (int8_t)event->motion.xrel;
+			yrel = (event->motion.yrel < -128) ? -128 : (int8_t)event->motion.yrel;
+			yrel = (event->motion.yrel > 127) ? 127 : (int8_t)event->motion.yrel;
 			if (sdlconsole_grabbed) {
-				mouse_action(MOUSE_ACTION_MOVE, MOUSE_NEITHER, xrel, yrel);
+				sdlconsole_pushMouse(MOUSE_ACTION_MOVE, MOUSE_NEITHER, xrel, yrel);
 			}
-			return SDLCONSOLE_EVENT_NONE;
+			return;
 		case SDL_MOUSEBUTTONDOWN:
 		case SDL_MOUSEBUTTONUP:
-			if (event.button.button == SDL_BUTTON_LEFT) {
+			if (event->button.button == SDL_BUTTON_LEFT) {
 				action = MOUSE_ACTION_LEFT;
 				if (!sdlconsole_grabbed) {
 					sdlconsole_mousegrab();
-					break;
+					return;
 				}
 			}
-			else if (event.button.button == SDL_BUTTON_RIGHT) {
+			else if (event->button.button == SDL_BUTTON_RIGHT) {
 				action = MOUSE_ACTION_RIGHT;
 			}
 			if (sdlconsole_grabbed) {
-				mouse_action(action, (event.button.state == SDL_PRESSED) ? MOUSE_PRESSED : MOUSE_UNPRESSED, 0, 0);
+				sdlconsole_pushMouse(action, (event->button.state == SDL_PRESSED) ? MOUSE_PRESSED : MOUSE_UNPRESSED, 0, 0);
 			}
-			return SDLCONSOLE_EVENT_NONE;
+			return;
 		case SDL_QUIT:
-			return SDLCONSOLE_EVENT_QUIT;
+			running = 0;
+			return;
 	}
-	return SDLCONSOLE_EVENT_NONE;
 }
 
-uint8_t sdlconsole_getScancode() {
-	//debug_log(DEBUG_DETAIL, "curkey: %02X\r\n", sdlconsole_curkey);
-	return sdlconsole_curkey;
+/*
+	Runs on the main thread, apart from the emulation. Waits a little while for host events,
+	turns them into input events for the emulation thread and handles typematic repeat on
+	the host clock: the held key repeats after half a second, then 15 times a second.
+*/
+void sdlconsole_loop() {
+	SDL_Event event;
+	uint64_t now;
+
+	if (SDL_WaitEventTimeout(&event, SDLCONSOLE_WAIT_MS)) {
+		do {
+			sdlconsole_event(&event);
+		} while (SDL_PollEvent(&event));
+	}
+
+	if (sdlconsole_lastKey != 0x00) {
+		now = timing_getHostCur();
+		if (now >= sdlconsole_repeatDue) {
+			sdlconsole_pushKey(sdlconsole_lastKey);
+			sdlconsole_repeatDue = now + timing_getHostFreq() / 15;
+		}
+	}
 }
 
 uint8_t sdlconsole_translateScancode(SDL_Keycode keyval) {
@@ -7,16 +7,16 @@
 #include <SDL.h>
 #endif
 
-#define SDLCONSOLE_EVENT_NONE		0
-#define SDLCONSOLE_EVENT_KEY		1
-#define SDLCONSOLE_EVENT_QUIT		2
-#define SDLCONSOLE_EVENT_DEBUG_1	3
-#define SDLCONSOLE_EVENT_DEBUG_2	4
+#define SDLCONSOLE_WAIT_MS		10 //longest the UI thread waits for a host event before checking key repeat
 
 int sdlconsole_init(char *title);
 void sdlconsole_blit(uint32_t* pixels, int w, int h, int stride);
-int sdlconsole_loop();
-uint8_t sdlconsole_getScancode();
+void sdlconsole_blitIndexed(const uint8_t* src, int w, int h, int stride, const uint32_t* lut);
+int sdlconsole_wantFrame();
+void sdlconsole_pushKey(uint8_t scancode);
+void sdlconsole_pushMouse(uint8_t action, uint8_t state, int32_t xrel, int32_t yrel);
+void sdlconsole_event(SDL_Event* event);
+void sdlconsole_loop();
 uint8_t sdlconsole_translateScancode(SDL_Keycode keyval);
 int sdlconsole_setWindow(int w, int h);
 void sdlconsole_setTitle(char* title);
@@ -0,0 +1,173 @@
+/*
+  XTulator: A portable, open-source 80186 PC emulator.
+  Copyright (C)2020 Mike Chambers
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+	Shared memory framebuffer
+
+	Publishes every finished frame into a named shared memory block, so recorders, test
+	oracles and the like can read the screen without the emulator encoding anything. On
+	POSIX it's shm_open("/<name>"), on Windows a named file mapping "Local\<name>".
+
+	The block starts with SHMFRAME_HEADER_t, followed by a ring of SHMFRAME_SLOTS frames.
+	Each slot is guarded by its own sequence lock. A reader does:
+
+	  1. n = frames, give up if it's 0, slot = slot[(n - 1) % slots]
+	  2. s = slot.seq, try again if it's odd
+	  3. read width, height, stride and the pixels
+	  4. if slot.seq != s the frame changed underneath, throw it away and try again
+
+	A reader that only looks at the pixels in place instead of copying them out can do step 4
+	after it's done with them.
+*/
+
+#include "../../config.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "shmframe.h"
+#include "../../debuglog.h"
+
+#ifdef _WIN32
+#define SHMFRAME_BARRIER()	MemoryBarrier()
+#else
+#define SHMFRAME_BARRIER()	__sync_synchronize()
+#endif
+
+char* shmframe_name = NULL;
+volatile uint8_t shmframe_active = 0;
+
+SHMFRAME_HEADER_t* shmframe_header = NULL;
+#ifdef _WIN32
+HANDLE shmframe_handle = NULL;
+#else
+char shmframe_path[256];
+#endif
+
+//called from the render thread, which is the only writer
+void shmframe_blit(uint32_t* pixels, int w, int h, int stride) {
+	SHMFRAME_SLOT_t* slot;
+	uint8_t* dst;
+	uint64_t frame;
+	int y;
+
+	if (!shmframe_active) return;
+	if (w > SHMFRAME_MAXW) w = SHMFRAME_MAXW;
+	if (h > SHMFRAME_MAXH) h = SHMFRAME_MAXH;
+
+	frame = shmframe_header->frames;
+	slot = &shmframe_header->slot[frame % SHMFRAME_SLOTS];
+	dst = (uint8_t*)shmframe_header + slot->offset;
+
+	slot->seq++;
+	SHMFRAME_BARRIER();
+	for (y = 0; y < h; y++) {
+		memcpy(dst + (size_t)y * w * 4, (uint8_t*)pixels + (size_t)y * stride, (size_t)w * 4);
+	}
+	slot->width = (uint32_t)w;
+	slot->height = (uint32_t)h;
+	slot->stride = (uint32_t)w * 4;
+	slot->frame = frame;
+	SHMFRAME_BARRIER();
+	slot->seq++;
+	SHMFRAME_BARRIER();
+	shmframe_header->frames = frame + 1;
+}
+
+int shmframe_init(char* name) {
+	uint32_t i;
+
+#ifdef _WIN32
+	char path[256];
+
+	snprintf(path, sizeof(path), "Local\\%s", name);
+	shmframe_handle = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, SHMFRAME_SIZE, path);
+	if (shmframe_handle == NULL) {
+		debug_log(DEBUG_ERROR, "[SHMFRAME] Unable to create file mapping %s\r\n", path);
+		return -1;
+	}
+	shmframe_header = (SHMFRAME_HEADER_t*)MapViewOfFile(shmframe_handle, FILE_MAP_ALL_ACCESS, 0, 0, SHMFRAME_SIZE);
+	if (shmframe_header == NULL) {
+		debug_log(DEBUG_ERROR, "[SHMFRAME] Unable to map %s\r\n", path);
+		CloseHandle(shmframe_handle);
+		return -1;
+	}
+#else
+	int fd;
+	void* map;
+
+	snprintf(shmframe_path, sizeof(shmframe_path), "/%s", name);
+	fd = shm_open(shmframe_path, O_CREAT | O_RDWR, 0600);
+	if (fd < 0) {
+		debug_log(DEBUG_ERROR, "[SHMFRAME] Unable to open shared memory %s\r\n", shmframe_path);
+		return -1;
+	}
+	if (ftruncate(fd, SHMFRAME_SIZE) != 0) {
+		debug_log(DEBUG_ERROR, "[SHMFRAME] Unable to size shared memory %s\r\n", shmframe_path);
+		close(fd);
+		shm_unlink(shmframe_path);
+		return -1;
+	}
+	map = mmap(NULL, SHMFRAME_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		debug_log(DEBUG_ERROR, "[SHMFRAME] Unable to map %s\r\n", shmframe_path);
+		shm_unlink(shmframe_path);
+		return -1;
+	}
+	shmframe_header = (SHMFRAME_HEADER_t*)map;
+#endif
+
+	//a reader left over from a previous run sees the magic disappear while this is set up
+	shmframe_header->magic = 0;
+	SHMFRAME_BARRIER();
+	shmframe_header->version = SHMFRAME_VERSION;
+	shmframe_header->slots = SHMFRAME_SLOTS;
+	shmframe_header->headersize = SHMFRAME_HEADERSIZE;
+	shmframe_header->frames = 0;
+	for (i = 0; i < SHMFRAME_SLOTS; i++) {
+		memset(&shmframe_header->slot[i], 0, sizeof(SHMFRAME_SLOT_t));
+		shmframe_header->slot[i].offset = SHMFRAME_HEADERSIZE + (uint64_t)i * SHMFRAME_SLOTSIZE;
+	}
+	SHMFRAME_BARRIER();
+	shmframe_header->magic = SHMFRAME_MAGIC;
+
+	shmframe_active = 1;
+	debug_log(DEBUG_INFO, "[SHMFRAME] Publishing frames to shared memory %s\r\n", name);
+	return 0;
+}
+
+//the mapping itself stays until the process exits, a render thread may still be in shmframe_blit
+void shmframe_close() {
+	if (!shmframe_active) return;
+	shmframe_active = 0;
+	shmframe_header->magic = 0;
+#ifndef _WIN32
+	shm_unlink(shmframe_path);
+#endif
+}
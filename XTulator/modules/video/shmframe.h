@@ -0,0 +1,40 @@
+#ifndef _SHMFRAME_H_
+#define _SHMFRAME_H_
+
+#include <stdint.h>
+
+#define SHMFRAME_MAGIC			0x42465458 //"XTFB"
+#define SHMFRAME_VERSION		1
+#define SHMFRAME_SLOTS			3 //a reader has two whole frames to finish with a slot before it comes around again
+#define SHMFRAME_MAXW			1024
+#define SHMFRAME_MAXH			1024
+#define SHMFRAME_HEADERSIZE		4096 //pixels start page aligned
+#define SHMFRAME_SLOTSIZE		(SHMFRAME_MAXW * SHMFRAME_MAXH * 4)
+#define SHMFRAME_SIZE			(SHMFRAME_HEADERSIZE + SHMFRAME_SLOTS * SHMFRAME_SLOTSIZE)
+
+typedef struct {
+	volatile uint32_t seq; //odd while the emulator is writing the slot
+	uint32_t width;
+	uint32_t height;
+	uint32_t stride; //bytes per row
+	uint64_t frame; //frame number held in the slot
+	uint64_t offset; //from the start of the mapping to the slot's pixels, 0x00RRGGBB in host byte order
+} SHMFRAME_SLOT_t;
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t slots;
+	uint32_t headersize;
+	volatile uint64_t frames; //frames published so far, the newest is in slot[(frames - 1) % slots]
+	SHMFRAME_SLOT_t slot[SHMFRAME_SLOTS];
+} SHMFRAME_HEADER_t;
+
+int shmframe_init(char* name);
+void shmframe_blit(uint32_t* pixels, int w, int h, int stride);
+void shmframe_close();
+
+extern char* shmframe_name;
+extern volatile uint8_t shmframe_active;
+
+#endif
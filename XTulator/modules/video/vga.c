@@ -25,7 +25,6 @@
 #include <process.h>
 #else
 #include <pthread.h>
-pthread_t vga_renderThreadID;
 #endif
 #include "vga.h"
 #include "../../config.h"
@@ -36,10 +35,6 @@ pthread_t vga_renderThreadID;
 #include "../../debuglog.h"
 #include "sdlconsole.h"
 
-uint8_t VBIOS[32768];
-
-uint8_t vga_palette[256][3]; //R, G, B
-
 const uint8_t vga_gfxpal[2][2][4] = { //palettes for 320x200 graphics mode 2bpp
 	{
 		{ 0, 2, 4, 6 }, //normal palettes
@@ -53,143 +48,135 @@ const uint8_t vga_gfxpal[2][2][4] = { //palettes for 320x200 graphics mode 2bpp
 
 const uint32_t vga_fontbases[8] = { 0x0000, 0x4000, 0x8000, 0xC000, 0x2000, 0x6000, 0xA000, 0xE000 };
 
-VGADAC_t vga_DAC;
-uint32_t vga_framebuffer[1024][1024], vga_dots = 8;
-volatile uint32_t vga_w = 640, vga_h = 400;
-uint32_t vga_membase, vga_memmask;
-uint16_t vga_cursorloc = 0;
-uint8_t vga_dbl = 0;
-uint8_t vga_crtci = 0, vga_crtcd[0x19];
-uint8_t vga_attri = 0, vga_attrd[0x15], vga_attrflipflop = 0, vga_attrpal = 0x20;
-uint8_t vga_gfxi = 0, vga_gfxd[0x09];
-uint8_t vga_seqi = 0, vga_seqd[0x05];
-uint8_t vga_misc, vga_status0, vga_status1;
-uint8_t vga_cursor_blink_state = 0;
-volatile uint8_t vga_wmode, vga_rmode, vga_shiftmode, vga_rotate, vga_logicop, vga_enableplane, vga_readmap, vga_scandbl, vga_hdbl, vga_bpp, vga_latch[4];
-uint8_t* vga_RAM[4]; //4 planes
-
-volatile uint64_t vga_hblankstart, vga_hblankend, vga_hblanklen, vga_dispinterval, vga_hblankinterval, vga_htotal;
-volatile uint64_t vga_vblankstart, vga_vblankend, vga_vblanklen, vga_vblankinterval, vga_frameinterval;
-volatile uint8_t vga_doRender = 0, vga_doBlit = 0;
-volatile double vga_targetFPS = 60, vga_lockFPS = 0;
-
-volatile uint32_t vga_hblankTimer, vga_hblankEndTimer, vga_drawTimer;
-volatile uint16_t vga_curScanline = 0;
-
-int vga_init() {
-	int x, y, i;
+//4 bits, one per plane, to a byte of all 0s or all 1s in each plane's lane
+const uint32_t vga_lanes[16] = {
+	0x00000000, 0x000000FF, 0x0000FF00, 0x0000FFFF, 0x00FF0000, 0x00FF00FF, 0x00FFFF00, 0x00FFFFFF,
+	0xFF000000, 0xFF0000FF, 0xFF00FF00, 0xFF00FFFF, 0xFFFF0000, 0xFFFF00FF, 0xFFFFFF00, 0xFFFFFFFF
+};
+
+volatile double vga_lockFPS = 0;
+
+int vga_init(VGA_t* vga, uint8_t headless) {
+#ifndef _WIN32
+	pthread_t renderThreadID;
+#endif
 
 	debug_log(DEBUG_INFO, "[VGA] Initializing VGA video device\r\n");
 
-	for (y = 0; y < 400; y++) {
-		for (x = 0; x < 640; x++) {
-			vga_framebuffer[y][x] = vga_color(0);
-		}
+	memset(vga, 0, sizeof(VGA_t));
+	vga->dots = 8;
+	vga->w = 640;
+	vga->h = 400;
+	vga->attrpal = 0x20;
+	vga->linepixels = 800;
+	vga->framepixels = 800 * 449;
+	vga->pixelratio = 25.175;
+	vga->targetFPS = 60;
+	vga->headless = headless;
+
+	vga->VBIOS = memory_loadROM("roms/video/et4000.bin", 32768);
+	if (vga->VBIOS == NULL) {
+		return -1;
+	}
+
+	vga->dirty = 1;
+	if (!headless) {
+		vga->expand = 1;
+		vga_present(vga); //framebuffer was cleared to color 0 above
 	}
-	sdlconsole_blit((uint32_t*)vga_framebuffer, 640, 400, 1024 * sizeof(uint32_t));
 
 	if (vga_lockFPS >= 1) {
-		vga_targetFPS = vga_lockFPS;
+		vga->targetFPS = vga_lockFPS;
 	}
 
-	timing_addTimer(vga_blinkCallback, NULL, 3.75, TIMING_ENABLED);
-	vga_drawTimer = timing_addTimer(vga_drawCallback, NULL, vga_targetFPS, TIMING_ENABLED);
-	vga_hblankTimer = timing_addTimer(vga_hblankCallback, NULL, 10000, TIMING_ENABLED); //nonsense frequency values to begin with is fine
-	vga_hblankEndTimer = timing_addTimer(vga_hblankEndCallback, NULL, 100, TIMING_ENABLED); //same here
-	vga_curScanline = 0;
+	timing_addTimer(vga_blinkCallback, vga, 3.75, TIMING_ENABLED);
+	vga->drawTimer = timing_addTimer(vga_drawCallback, vga, vga->targetFPS, TIMING_ENABLED);
+	vga->framestart = timing_getCur();
 
-	for (i = 0; i < 4; i++) { //4 planes of 64 KB (It's actually 64K addresses on a 32-bit data bus on real VGA hardware)
-		vga_RAM[i] = (uint8_t*)malloc(65536);
-		if (vga_RAM[i] == NULL) break;
-	}
-	if (i < 4) { //If there was an allocation error
-		for (; i >= 0; i--) { //step back through any successfully allocated chunks
-			free((void*)vga_RAM[i]); //and free them
-		}
+	vga->VRAM = (uint32_t*)malloc(65536 * sizeof(uint32_t)); //64K addresses on a 32-bit data bus, like real VGA hardware
+	if (vga->VRAM == NULL) {
 		return -1;
 	}
+	vga_updateMasks(vga);
 
 	//TODO: error checking below
+	if (!headless) { //nothing to show a headless instance's frames on
 #ifdef _WIN32
-	_beginthread(vga_renderThread, 0, NULL);
+		_beginthread(vga_renderThread, 0, vga);
 #else
-	pthread_create(&vga_renderThreadID, NULL, vga_renderThread, NULL);
+		pthread_create(&renderThreadID, NULL, vga_renderThread, vga);
 #endif
-
-	ports_cbRegister(0x3B4, 39, (void*)vga_readport, NULL, (void*)vga_writeport, NULL, NULL);
-	memory_mapCallbackRegister(0xA0000, 0x20000, (void*)vga_readmemory, (void*)vga_writememory, NULL);
-
-	if (utility_loadFile(VBIOS, 32768, "roms/video/et4000.bin")) {
-		return -1;
 	}
-	memory_mapRegister(0xC0000, 32768, VBIOS, NULL);
+
+	ports_cbRegister(0x3B4, 39, (void*)vga_readport, NULL, (void*)vga_writeport, NULL, vga);
+	ports_setTimed(0x3DA, 1); //retrace status comes from the frame start time
+	memory_mapCallbackRegister(0xA0000, 0x20000, (void*)vga_readmemory, (void*)vga_writememory, vga);
+	memory_mapRegister(0xC0000, 32768, vga->VBIOS, NULL);
 
 	return 0;
 }
 
-void vga_updateScanlineTiming() {
-	double pixelclock;
-	static uint32_t lastw = 0, lasth = 0;
-	static double lastFPS = 0;
+void vga_updateScanlineTiming(VGA_t* vga) {
+	double pixelclock, linepixels;
 
-	if (vga_misc & 0x04) { //pixel clock select
+	if (vga->misc & 0x04) { //pixel clock select
 		pixelclock = 28322000.0;
 	}
 	else {
 		pixelclock = 25175000.0;
 	}
 
-	vga_hblankstart = (uint64_t)vga_crtcd[0x02] * (uint64_t)vga_dots;
-	vga_hblankend = ((uint64_t)vga_crtcd[0x02] * (uint64_t)vga_dots) + (((uint64_t)vga_crtcd[0x03] & 0x1F) + 1) * (uint64_t)vga_dots;
-	vga_hblanklen = vga_hblankend - vga_hblankstart;
-	vga_vblankstart = (uint64_t)vga_crtcd[0x10] | ((uint64_t)(vga_crtcd[0x07] & 0x04) << 6) | ((uint64_t)(vga_crtcd[0x07] & 0x80) << 2);
-	vga_vblankend = (uint64_t)vga_crtcd[0x06] | ((uint64_t)(vga_crtcd[0x07] & 0x01) << 8) | ((uint64_t)(vga_crtcd[0x07] & 0x20) << 4);
-	vga_vblanklen = vga_vblankend - vga_vblankstart;
-	vga_htotal = (uint64_t)vga_crtcd[0x00];
-	vga_targetFPS = pixelclock / ((double)(vga_htotal + 5) * (double)vga_dots * (double)vga_vblankend);
-
-	pixelclock = (double)timing_getFreq() / pixelclock; //get ratio of pixel clock vs our timer frequency for interval calculations
-	vga_dispinterval = (uint64_t)((double)(vga_htotal + 5) * (double)vga_dots * pixelclock);
-	vga_hblankinterval = (uint64_t)((double)vga_hblanklen * pixelclock);
-	vga_vblankinterval = (uint64_t)((double)vga_hblankend * (double)vga_vblanklen * pixelclock);
-	vga_frameinterval = (uint64_t)((double)vga_hblankend * (double)vga_vblankend * pixelclock);
-	/*printf("hblank start = %llu, hblank end = %llu, hblank len = %llu, disp interval = %llu, hblank interval = %llu, freq = %llu\r\n",
-		vga_hblankstart, vga_hblankend, vga_hblanklen, vga_dispinterval, vga_hblankinterval, timing_freq);
-	printf("vblank start = %llu, vblank end = %llu, vblank len = %llu, vblank interval = %llu, frameinterval = %llu\r\n",
-		vga_vblankstart, vga_vblankend, vga_vblanklen, vga_vblankinterval, vga_frameinterval);*/
-	if ((lastw != vga_w) || (lasth != vga_h) || (lastFPS != vga_targetFPS)) {
-		debug_log(DEBUG_DETAIL, "[VGA] Mode switch: %lux%lu (%.02f Hz)\r\n", vga_w, vga_h, vga_targetFPS);
-		lastw = vga_w;
-		lasth = vga_h;
-		lastFPS = vga_targetFPS;
-	}
-
-	timing_updateInterval(vga_hblankTimer, vga_dispinterval);
-	timing_updateInterval(vga_hblankEndTimer, vga_hblankinterval);
-	timing_timerEnable(vga_hblankTimer);
-	timing_timerDisable(vga_hblankEndTimer);
+	vga->hblankstart = (uint64_t)vga->crtcd[0x02] * (uint64_t)vga->dots;
+	vga->hblankend = ((uint64_t)vga->crtcd[0x02] * (uint64_t)vga->dots) + (((uint64_t)vga->crtcd[0x03] & 0x1F) + 1) * (uint64_t)vga->dots;
+	vga->hblanklen = vga->hblankend - vga->hblankstart;
+	vga->vblankstart = (uint64_t)vga->crtcd[0x10] | ((uint64_t)(vga->crtcd[0x07] & 0x04) << 6) | ((uint64_t)(vga->crtcd[0x07] & 0x80) << 2);
+	vga->vblankend = (uint64_t)vga->crtcd[0x06] | ((uint64_t)(vga->crtcd[0x07] & 0x01) << 8) | ((uint64_t)(vga->crtcd[0x07] & 0x20) << 4);
+	vga->vblanklen = vga->vblankend - vga->vblankstart;
+	vga->htotal = (uint64_t)vga->crtcd[0x00];
+	vga->targetFPS = pixelclock / ((double)(vga->htotal + 5) * (double)vga->dots * (double)vga->vblankend);
+
+	linepixels = (double)(vga->htotal + 5) * (double)vga->dots;
+	pixelclock /= (double)timing_getFreq(); //pixel clocks per tick of our timer, for working out the beam position
+	if ((linepixels != vga->linepixels) || ((linepixels * (double)vga->vblankend) != vga->framepixels) || (pixelclock != vga->pixelratio)) {
+		//only restart the frame when the timing actually changed, this is called on every CRTC write
+		vga->pixelratio = pixelclock;
+		vga->linepixels = linepixels;
+		vga->framepixels = linepixels * (double)vga->vblankend;
+		vga->framestart = timing_getCur();
+	}
+	/*printf("hblank start = %llu, hblank end = %llu, hblank len = %llu, line pixels = %f, freq = %llu\r\n",
+		vga->hblankstart, vga->hblankend, vga->hblanklen, vga->linepixels, timing_getFreq());
+	printf("vblank start = %llu, vblank end = %llu, vblank len = %llu, frame pixels = %f\r\n",
+		vga->vblankstart, vga->vblankend, vga->vblanklen, vga->framepixels);*/
+	if ((vga->lastw != vga->w) || (vga->lasth != vga->h) || (vga->lastFPS != vga->targetFPS)) {
+		debug_log(DEBUG_DETAIL, "[VGA] Mode switch: %lux%lu (%.02f Hz)\r\n", vga->w, vga->h, vga->targetFPS);
+		vga->lastw = vga->w;
+		vga->lasth = vga->h;
+		vga->lastFPS = vga->targetFPS;
+	}
+
 	if (vga_lockFPS == 0) {
-		timing_updateIntervalFreq(vga_drawTimer, vga_targetFPS);
+		timing_updateIntervalFreq(vga->drawTimer, vga->targetFPS);
 	}
 }
 
-void vga_update(uint32_t start_x, uint32_t start_y, uint32_t end_x, uint32_t end_y) {
-	uint32_t addr, startaddr, cursorloc, cursor_x, cursor_y, fontbase, color32;
-	uint32_t scx, scy, x, y, hchars, divx, yscanpixels, xscanpixels, xstride, bpp, pixelsperbyte, shift;
-	uint8_t cc, attr, fontdata, blink, mode, colorset, intensity, blinkenable, cursorenable, dup9;
+void vga_update(VGA_t* vga, uint32_t start_x, uint32_t start_y, uint32_t end_x, uint32_t end_y) {
+	uint32_t addr, startaddr, cursorloc, cursor_x, cursor_y, fontbase;
+	uint32_t scx, scy, x, y, hchars, divx, yscanpixels, xscanpixels, xstride, bpp, pixelsperbyte, shift, planes;
+	uint8_t cc, attr, fontdata, blink, mode, colorset, intensity, blinkenable, cursorenable, dup9, color;
 
-	//debug_log(DEBUG_DETAIL, "Width: %u\r\n", vga_crtcd[0x01] - ((vga_crtcd[0x05] & 0x60) >> 5));
-	if (vga_attrd[0x10] & 1) { //graphics mode enable
-		if (vga_shiftmode & 0x02) {
+	//debug_log(DEBUG_DETAIL, "Width: %u\r\n", vga->crtcd[0x01] - ((vga->crtcd[0x05] & 0x60) >> 5));
+	if (vga->attrd[0x10] & 1) { //graphics mode enable
+		if (vga->shiftmode & 0x02) {
 			xscanpixels = 2;
-			yscanpixels = (vga_crtcd[0x09] & 0x1F) + 1;
+			yscanpixels = (vga->crtcd[0x09] & 0x1F) + 1;
 		} else {
-			xscanpixels = (vga_seqd[0x01] & 0x08) ? 2 : 1;
-			yscanpixels = (vga_crtcd[0x09] & 0x80) ? 2 : 1;
+			xscanpixels = (vga->seqd[0x01] & 0x08) ? 2 : 1;
+			yscanpixels = (vga->crtcd[0x09] & 0x80) ? 2 : 1;
 		}
-		switch (vga_shiftmode) {
+		switch (vga->shiftmode) {
 		case 0x00:
-			if ((vga_attrd[0x12] & 0x0F) == 0x01) { //TODO: is this the right way to detect 1bpp mode?
+			if ((vga->attrd[0x12] & 0x0F) == 0x01) { //TODO: is this the right way to detect 1bpp mode?
 				bpp = 1;
 				pixelsperbyte = 8;
 				mode = VGA_MODE_GRAPHICS_1BPP;
@@ -211,29 +198,30 @@ void vga_update(uint32_t start_x, uint32_t start_y, uint32_t end_x, uint32_t end
 			mode = VGA_MODE_GRAPHICS_8BPP;
 			break;
 		}
-		xstride = (vga_w / xscanpixels) / pixelsperbyte;
+		xstride = (vga->w / xscanpixels) / pixelsperbyte;
 #ifdef DEBUG_VGA
 		debug_log(DEBUG_DETAIL, "[VGA] Resolution: %lux%lu %lu bpp (X stride: %lu, V lines per pixel: %lu, H lines per pixel = %lu)\r\n",
-			vga_w, vga_h, bpp, xstride, yscanpixels, xscanpixels);
+			vga->w, vga->h, bpp, xstride, yscanpixels, xscanpixels);
 #endif
 	} else { //text mode enable
 		mode = VGA_MODE_TEXT;
-		hchars = vga_dbl ? 40 : 80;
-		divx = vga_dbl ? vga_dots * 2 : vga_dots;
-		cursorenable = (vga_crtcd[0x0A] & 0x20) ? 0 : 1; //TODO: fix this
+		hchars = vga->dbl ? 40 : 80;
+		divx = vga->dbl ? vga->dots * 2 : vga->dots;
+		cursorenable = (vga->crtcd[0x0A] & 0x20) ? 0 : 1; //TODO: fix this
 		blinkenable = 0;
-		fontbase = vga_fontbases[vga_seqd[0x03]];
-		dup9 = (vga_attrd[0x10] & 0x04) ? 0 : 1;
-		vga_scandbl = 0;
+		fontbase = vga_fontbases[vga->seqd[0x03]];
+		dup9 = (vga->attrd[0x10] & 0x04) ? 0 : 1;
+		vga->scandbl = 0;
 #ifdef DEBUG_VGA
 		debug_log(DEBUG_DETAIL, "[VGA] Resolution: %lux%lu (text mode)\r\n",
-			vga_w, vga_h);
+			vga->w, vga->h);
 #endif
 	}
 	intensity = 0;
 	colorset = 0;
-	startaddr = ((uint32_t)vga_crtcd[0xC] << 8) | (uint32_t)vga_crtcd[0xD];
-	cursorloc = ((uint32_t)vga_crtcd[0xE] << 8) | (uint32_t)vga_crtcd[0xF];
+	vga->mono = (mode == VGA_MODE_GRAPHICS_1BPP) ? 1 : 0;
+	startaddr = ((uint32_t)vga->crtcd[0xC] << 8) | (uint32_t)vga->crtcd[0xD];
+	cursorloc = ((uint32_t)vga->crtcd[0xE] << 8) | (uint32_t)vga->crtcd[0xF];
 
 	switch (mode) {
 	case VGA_MODE_TEXT:
@@ -241,44 +229,42 @@ void vga_update(uint32_t start_x, uint32_t start_y, uint32_t end_x, uint32_t end
 		cursor_x = cursorloc % hchars;
 		cursor_y = cursorloc / hchars;
 		for (scy = start_y; scy <= end_y; scy++) {
-			uint32_t maxscan = ((vga_crtcd[0x09] & 0x1F) + 1);
+			uint32_t maxscan = ((vga->crtcd[0x09] & 0x1F) + 1);
 			y = scy / maxscan;
 			for (scx = start_x; scx <= end_x; scx++) {
 				uint32_t charcolumn;
 				x = scx / divx;
 				addr = startaddr + (y * hchars) + x;
-				cc = vga_RAM[0][addr];
-				attr = vga_RAM[1][addr];
+				cc = vga_plane(vga, 0, addr & 0xFFFF);
+				attr = vga_plane(vga, 1, addr & 0xFFFF);
 				blink = attr >> 7;
 				if (blinkenable) attr &= 0x7F; //enabling text mode blink attribute limits background color selection
-				fontdata = vga_RAM[2][fontbase + ((uint32_t)cc * 32) + (scy % maxscan)];
-				charcolumn = ((scx >> (vga_dbl ? 1 : 0)) % vga_dots);
+				fontdata = vga_plane(vga, 2, fontbase + ((uint32_t)cc * 32) + (scy % maxscan));
+				charcolumn = ((scx >> (vga->dbl ? 1 : 0)) % vga->dots);
 				if (dup9 && (charcolumn == 0) && (cc >= 0xC0) && (cc <= 0xDF)) {
 					charcolumn = 1;
 				}
-				fontdata = (fontdata >> ((vga_dots - 1) - charcolumn)) & 1;
+				fontdata = (fontdata >> ((vga->dots - 1) - charcolumn)) & 1;
 				if ((y == cursor_y) && (x == cursor_x) &&
-					((uint8_t)(scy % 16) >= (vga_crtcd[VGA_REG_DATA_CURSOR_BEGIN] & 31)) &&
-					((uint8_t)(scy % 16) <= (vga_crtcd[VGA_REG_DATA_CURSOR_END] & 31)) &&
-					vga_cursor_blink_state && cursorenable) { //cursor should be displayed
-					color32 = vga_attrd[attr & 0x0F] | (vga_attrd[0x14] << 4);
-					if (vga_attrd[0x10] & 0x80) { //P5, P4 replace
-						color32 = (color32 & 0xCF) | ((vga_attrd[0x14] & 3) << 4);
+					((uint8_t)(scy % 16) >= (vga->crtcd[VGA_REG_DATA_CURSOR_BEGIN] & 31)) &&
+					((uint8_t)(scy % 16) <= (vga->crtcd[VGA_REG_DATA_CURSOR_END] & 31)) &&
+					vga->cursor_blink_state && cursorenable) { //cursor should be displayed
+					color = vga->attrd[attr & 0x0F] | (vga->attrd[0x14] << 4);
+					if (vga->attrd[0x10] & 0x80) { //P5, P4 replace
+						color = (color & 0xCF) | ((vga->attrd[0x14] & 3) << 4);
 					}
-					color32 = vga_color(color32);
-					vga_framebuffer[scy][scx] = color32;
+					vga->framebuffer[scy][scx] = color;
 				}
 				else {
-					if (blinkenable && blink && !vga_cursor_blink_state) {
+					if (blinkenable && blink && !vga->cursor_blink_state) {
 						fontdata = 0; //all pixels in character get background color if blink attribute set and blink visible state is false
 					}
 					//determine index into actual DAC palette
-					color32 = vga_attrd[fontdata ? (attr & 0x0F) : (attr >> 4)] | (vga_attrd[0x14] << 4);
-					if (vga_attrd[0x10] & 0x80) { //P5, P4 replace
-						color32 = (color32 & 0xCF) | ((vga_attrd[0x14] & 3) << 4);
+					color = vga->attrd[fontdata ? (attr & 0x0F) : (attr >> 4)] | (vga->attrd[0x14] << 4);
+					if (vga->attrd[0x10] & 0x80) { //P5, P4 replace
+						color = (color & 0xCF) | ((vga->attrd[0x14] & 3) << 4);
 					}
-					color32 = vga_color(color32);
-					vga_framebuffer[scy][scx] = color32;
+					vga->framebuffer[scy][scx] = color;
 				}
 			}
 		}
@@ -288,17 +274,16 @@ void vga_update(uint32_t start_x, uint32_t start_y, uint32_t end_x, uint32_t end
 			y = scy / yscanpixels;
 			for (scx = start_x; scx <= end_x; scx += xscanpixels) {
 				uint8_t plane;
-				uint32_t yadd, xadd, color32;
+				uint32_t yadd, xadd;
 				x = scx / xscanpixels;
-				//x += vga_attrd[0x13] & 0x0F;
+				//x += vga->attrd[0x13] & 0x0F;
 				addr = ((y * xstride) + x) & 0xFFFF;
 				plane = addr & 3;
 				addr = (addr >> 2) + startaddr;
-				cc = vga_RAM[plane][addr & 0xFFFF];
-				color32 = vga_color(cc);
+				cc = vga_plane(vga, plane, addr & 0xFFFF);
 				for (yadd = 0; yadd < yscanpixels; yadd++) {
 					for (xadd = 0; xadd < xscanpixels; xadd++) {
-						vga_framebuffer[scy + yadd][scx + xadd] = color32;
+						vga->framebuffer[scy + yadd][scx + xadd] = cc;
 					}
 				}
 			}
@@ -310,23 +295,20 @@ void vga_update(uint32_t start_x, uint32_t start_y, uint32_t end_x, uint32_t end
 			for (scx = start_x; scx <= end_x; scx += xscanpixels) {
 				uint32_t yadd, xadd;
 				x = scx / xscanpixels;
-				//x += vga_attrd[0x13] & 0x0F;
+				//x += vga->attrd[0x13] & 0x0F;
 				addr = ((y * xstride) + (x / 8)) & 0xFFFF;
 				addr = addr + startaddr;
 				shift = 7 - (x & 7);
-				cc = (vga_RAM[0][addr & 0xFFFF] >> shift) & 1;
-				cc |= ((vga_RAM[1][addr & 0xFFFF] >> shift) & 1) << 1;
-				cc |= ((vga_RAM[2][addr & 0xFFFF] >> shift) & 1) << 2;
-				cc |= ((vga_RAM[3][addr & 0xFFFF] >> shift) & 1) << 3;
+				planes = vga->VRAM[addr & 0xFFFF] >> shift; //all four planes in one read
+				cc = (planes & 1) | ((planes >> 7) & 2) | ((planes >> 14) & 4) | ((planes >> 21) & 8);
 				//determine index into actual DAC palette
-				color32 = vga_attrd[cc] | (vga_attrd[0x14] << 4);
-				if (vga_attrd[0x10] & 0x80) { //P5, P4 replace
-					color32 = (color32 & 0xCF) | ((vga_attrd[0x14] & 3) << 4);
+				color = vga->attrd[cc] | (vga->attrd[0x14] << 4);
+				if (vga->attrd[0x10] & 0x80) { //P5, P4 replace
+					color = (color & 0xCF) | ((vga->attrd[0x14] & 3) << 4);
 				}
-				color32 = vga_color(color32);
 				for (yadd = 0; yadd < yscanpixels; yadd++) {
 					for (xadd = 0; xadd < xscanpixels; xadd++) {
-						vga_framebuffer[scy + yadd][scx + xadd] = color32;
+						vga->framebuffer[scy + yadd][scx + xadd] = color;
 					}
 				}
 			}
@@ -341,20 +323,19 @@ void vga_update(uint32_t start_x, uint32_t start_y, uint32_t end_x, uint32_t end
 			for (scx = start_x; scx <= end_x; scx += xscanpixels) {
 				uint32_t yadd, xadd;
 				x = scx / xscanpixels;
-				//x += vga_attrd[0x13] & 0x0F;
+				//x += vga->attrd[0x13] & 0x0F;
 				addr = ((8192 * isodd) + (y * xstride) + (x / pixelsperbyte)) & 0xFFFF;
 				addr = addr + startaddr;
 				shift = (3 - (x & 3)) << 1;
-				cc = (vga_RAM[addr & 1][addr >> 1] >> shift) & 3;
+				cc = (vga_plane(vga, addr & 1, addr >> 1) >> shift) & 3;
 				//determine index into actual DAC palette
-				color32 = vga_attrd[cc] | (vga_attrd[0x14] << 4);
-				if (vga_attrd[0x10] & 0x80) { //P5, P4 replace
-					color32 = (color32 & 0xCF) | ((vga_attrd[0x14] & 3) << 4);
+				color = vga->attrd[cc] | (vga->attrd[0x14] << 4);
+				if (vga->attrd[0x10] & 0x80) { //P5, P4 replace
+					color = (color & 0xCF) | ((vga->attrd[0x14] & 3) << 4);
 				}
-				color32 = vga_color(color32);
 				for (yadd = 0; yadd < yscanpixels; yadd++) {
 					for (xadd = 0; xadd < xscanpixels; xadd++) {
-						vga_framebuffer[scy + yadd][scx + xadd] = color32;
+						vga->framebuffer[scy + yadd][scx + xadd] = color;
 					}
 				}
 			}
@@ -369,15 +350,14 @@ void vga_update(uint32_t start_x, uint32_t start_y, uint32_t end_x, uint32_t end
 			for (scx = start_x; scx <= end_x; scx += xscanpixels) {
 				uint32_t yadd, xadd;
 				x = scx / xscanpixels;
-				//x += vga_attrd[0x13] & 0x0F;
+				//x += vga->attrd[0x13] & 0x0F;
 				addr = ((8192 * isodd) + (y * xstride) + (x / pixelsperbyte)) & 0xFFFF;
 				addr = addr + startaddr;
 				shift = 7 - (x & 7);
-				cc = (vga_RAM[0][addr] >> shift) & 1;
-				color32 = cc ? 0xFFFFFFFF : 0x00000000;
+				cc = (vga_plane(vga, 0, addr & 0xFFFF) >> shift) & 1;
 				for (yadd = 0; yadd < yscanpixels; yadd++) {
 					for (xadd = 0; xadd < xscanpixels; xadd++) {
-						vga_framebuffer[scy + yadd][scx + xadd] = color32;
+						vga->framebuffer[scy + yadd][scx + xadd] = cc;
 					}
 				}
 			}
@@ -387,16 +367,54 @@ void vga_update(uint32_t start_x, uint32_t start_y, uint32_t end_x, uint32_t end
 	}
 }
 
-void vga_renderThread(void* dummy) {
-	while (running) {
-		if (vga_doRender == 1) {
-			vga_update(0, 0, vga_w - 1, vga_h - 1);
-			vga_doRender = 0;
+/*
+	Expands the palette indices left by vga_update through the DAC as it is right now and hands
+	the frame on. When nothing was rendered and the DAC wasn't written since last time, the frame
+	expanded then is handed on again.
+*/
+void vga_present(VGA_t* vga) {
+	uint32_t lut[256], x, w, h;
+
+	if (!vga->expand && !vga->dacdirty) {
+		sdlconsole_blitIndexed(NULL, 0, 0, 0, NULL);
+		return;
+	}
+	vga->expand = 0;
+	vga->dacdirty = 0; //cleared before the palette is read, so a write from here on is picked up next frame
+	w = vga->w;
+	h = vga->h;
+	if (w > 1024) w = 1024;
+	if (h > 1024) h = 1024;
+	for (x = 0; x < 256; x++) {
+		if (vga->mono) { //1bpp is shown black and white, whatever the palette says
+			lut[x] = x ? 0xFFFFFFFF : 0x00000000;
+		} else {
+			lut[x] = vga_color(vga, x);
 		}
+	}
+	sdlconsole_blitIndexed(&vga->framebuffer[0][0], (int)w, (int)h, 1024, lut);
+}
 
-		if (vga_doBlit == 1) {
-			sdlconsole_blit((uint32_t*)vga_framebuffer, (int)vga_w, (int)vga_h, 1024 * sizeof(uint32_t));
-			vga_doBlit = 0;
+/*
+	Every frame gets presented, so the outputs keep a steady frame rate, but it's only rendered
+	again when the guest changed something since the last one, and only once somebody wants it.
+*/
+void vga_renderThread(VGA_t* vga) {
+	while (running) {
+		if (vga->doBlit == 1) {
+			if (vga->doRender == 1) {
+				vga->stale = 1;
+				vga->doRender = 0;
+			}
+			if (sdlconsole_wantFrame()) {
+				if (vga->stale) {
+					vga_update(vga, 0, 0, vga->w - 1, vga->h - 1);
+					vga->stale = 0;
+					vga->expand = 1;
+				}
+				vga_present(vga);
+			}
+			vga->doBlit = 0;
 		}
 		else {
 			utility_sleep(1);
@@ -409,261 +427,279 @@ void vga_renderThread(void* dummy) {
 #endif
 }
 
-void vga_calcmemorymap() {
-	switch (vga_gfxd[0x06] & 0x0C) {
+void vga_calcmemorymap(VGA_t* vga) {
+	switch (vga->gfxd[0x06] & 0x0C) {
 	case 0x00: //0xA0000 - 0xBFFFF (128 KB)
-		vga_membase = 0x00000;
-		vga_memmask = 0xFFFF;
+		vga->membase = 0x00000;
+		vga->memmask = 0xFFFF;
 		break;
 	case 0x04: //0xA0000 - 0xAFFFF (64 KB)
-		vga_membase = 0x00000;
-		vga_memmask = 0xFFFF;
+		vga->membase = 0x00000;
+		vga->memmask = 0xFFFF;
 		break;
 	case 0x08: //0xB0000 - 0xB7FFF (32 KB)
-		vga_membase = 0x10000;
-		vga_memmask = 0x7FFF;
+		vga->membase = 0x10000;
+		vga->memmask = 0x7FFF;
 		break;
 	case 0x0C: //0xB8000 - 0xBFFFF (32 KB)
-		vga_membase = 0x18000;
-		vga_memmask = 0x7FFF;
+		vga->membase = 0x18000;
+		vga->memmask = 0x7FFF;
 		break;
 	}
-	//debug_log(DEBUG_DETAIL, "vga_membase = %05X, vga_memmask = %04X\r\n", vga_membase, vga_memmask);
+	//debug_log(DEBUG_DETAIL, "vga->membase = %05X, vga->memmask = %04X\r\n", vga->membase, vga->memmask);
 }
 
-void vga_calcscreensize() {
-	vga_w = (1 + vga_crtcd[0x01] - ((vga_crtcd[0x05] & 0x60) >> 5)) * vga_dots;
-	vga_h = 1 + vga_crtcd[0x12] | ((vga_crtcd[0x07] & 2) ? 0x100 : 0) | ((vga_crtcd[0x07] & 64) ? 0x200 : 0);
+void vga_calcscreensize(VGA_t* vga) {
+	vga->w = (1 + vga->crtcd[0x01] - ((vga->crtcd[0x05] & 0x60) >> 5)) * vga->dots;
+	vga->h = 1 + vga->crtcd[0x12] | ((vga->crtcd[0x07] & 2) ? 0x100 : 0) | ((vga->crtcd[0x07] & 64) ? 0x200 : 0);
 
-	if (((vga_shiftmode & 0x20) == 0) && (vga_seqd[0x01] & 0x08)) {
-		vga_w <<= 1;
+	if (((vga->shiftmode & 0x20) == 0) && (vga->seqd[0x01] & 0x08)) {
+		vga->w <<= 1;
 	}
 
-	vga_updateScanlineTiming();
+	vga_updateScanlineTiming(vga);
 
-	//debug_log(DEBUG_DETAIL, "video size: %lux%lu\r\n", vga_w, vga_h);
+	//debug_log(DEBUG_DETAIL, "video size: %lux%lu\r\n", vga->w, vga->h);
 }
 
-uint8_t vga_readcrtci() {
-	return vga_crtci;
+uint8_t vga_readcrtci(VGA_t* vga) {
+	return vga->crtci;
 }
 
-uint8_t vga_readcrtcd() {
-	if (vga_crtci < 0x19) {
-		return vga_crtcd[vga_crtci];
+uint8_t vga_readcrtcd(VGA_t* vga) {
+	if (vga->crtci < 0x19) {
+		return vga->crtcd[vga->crtci];
 	}
 	return 0xFF;
 }
 
-void vga_writecrtci(uint8_t value) {
-	vga_crtci = value & 0x1F;
+void vga_writecrtci(VGA_t* vga, uint8_t value) {
+	vga->crtci = value & 0x1F;
 }
 
-void vga_writecrtcd(uint8_t value) {
-	if (vga_crtci > 0x18) return;
+void vga_writecrtcd(VGA_t* vga, uint8_t value) {
+	if (vga->crtci > 0x18) return;
 
-	vga_crtcd[vga_crtci] = value;
-	//debug_log(DEBUG_DETAIL, "VGA CRTC index %02X = %u\r\n", vga_crtci, value);
-	switch (vga_crtci) {
+	vga->crtcd[vga->crtci] = value;
+	//debug_log(DEBUG_DETAIL, "VGA CRTC index %02X = %u\r\n", vga->crtci, value);
+	switch (vga->crtci) {
 	case 0x01:
 	case 0x12:
 	case 0x07:
-		vga_calcscreensize();
+		vga_calcscreensize(vga);
 		break;
 	//case 0x09:
-		//vga_scandbl = value & 0x1F; //(value & 0x80) ? 1 : 0;
-		//vga_calcscreensize();
+		//vga->scandbl = value & 0x1F; //(value & 0x80) ? 1 : 0;
+		//vga_calcscreensize(vga);
 		//break;
 	}
 }
 
-void vga_writeport(void* dummy, uint16_t port, uint8_t value) {
+void vga_writeport(VGA_t* vga, uint16_t port, uint8_t value) {
 #ifdef DEBUG_VGA
 	debug_log(DEBUG_DETAIL, "Write VGA port: %02X -> %03X\r\n", value, port);
 #endif
+	if ((port < 0x3C7) || (port > 0x3C9)) { //the DAC only changes what the indices expand to
+		vga->dirty = 1;
+	}
 	switch (port) {
 	case 0x3B4:
-		if ((vga_misc & 1) == 0) {
-			vga_writecrtci(value);
+		if ((vga->misc & 1) == 0) {
+			vga_writecrtci(vga, value);
 		}
 		break;
 	case 0x3B5:
-		if ((vga_misc & 1) == 0) {
-			vga_writecrtcd(value);
+		if ((vga->misc & 1) == 0) {
+			vga_writecrtcd(vga, value);
 		}
 		break;
 	case 0x3C0:
 	case 0x3C1:
-		if (vga_attrflipflop == 0) {
-			vga_attri = value & 0x1F;
-			vga_attrpal = value & 0x20;
+		if (vga->attrflipflop == 0) {
+			vga->attri = value & 0x1F;
+			vga->attrpal = value & 0x20;
 		}
 		else {
-			if (vga_attri < 0x15) {
-				vga_attrd[vga_attri] = value;
+			if (vga->attri < 0x15) {
+				vga->attrd[vga->attri] = value;
 			}
 		}
-		vga_attrflipflop ^= 1;
+		vga->attrflipflop ^= 1;
 		break;
 	case 0x3C7:
-		vga_DAC.state = VGA_DAC_MODE_READ;
-		vga_DAC.index = value;
-		vga_DAC.step = 0;
+		vga->DAC.state = VGA_DAC_MODE_READ;
+		vga->DAC.index = value;
+		vga->DAC.step = 0;
 		break;
 	case 0x3C8:
-		vga_DAC.state = VGA_DAC_MODE_WRITE;
-		vga_DAC.index = value;
-		vga_DAC.step = 0;
+		vga->DAC.state = VGA_DAC_MODE_WRITE;
+		vga->DAC.index = value;
+		vga->DAC.step = 0;
 		break;
 	case 0x3C9:
-		//debug_log(DEBUG_DETAIL, "write pal %u = %02X\r\n", vga_DAC.index, value & 0x3F);
-		vga_DAC.pal[vga_DAC.index][vga_DAC.step++] = value & 0x3F;
-		if (vga_DAC.step == 3) {
-			vga_palette[vga_DAC.index][0] = vga_DAC.pal[vga_DAC.index][0] << 2;
-			vga_palette[vga_DAC.index][1] = vga_DAC.pal[vga_DAC.index][1] << 2;
-			vga_palette[vga_DAC.index][2] = vga_DAC.pal[vga_DAC.index][2] << 2;
-			vga_DAC.step = 0;
-			vga_DAC.index++;
+		//debug_log(DEBUG_DETAIL, "write pal %u = %02X\r\n", vga->DAC.index, value & 0x3F);
+		vga->DAC.pal[vga->DAC.index][vga->DAC.step++] = value & 0x3F;
+		if (vga->DAC.step == 3) {
+			vga->palette[vga->DAC.index][0] = vga->DAC.pal[vga->DAC.index][0] << 2;
+			vga->palette[vga->DAC.index][1] = vga->DAC.pal[vga->DAC.index][1] << 2;
+			vga->palette[vga->DAC.index][2] = vga->DAC.pal[vga->DAC.index][2] << 2;
+			vga->dacdirty = 1;
+			vga->DAC.step = 0;
+			vga->DAC.index++;
 		}
 		break;
 	case 0x3C2:
-		vga_misc = value;
+		vga->misc = value;
 		break;
 	case 0x3C4:
-		vga_seqi = value & 0x1F;
+		vga->seqi = value & 0x1F;
 		break;
 	case 0x3C5:
-		if (vga_seqi < 0x05) {
-			vga_seqd[vga_seqi] = value;
-			switch (vga_seqi) {
+		if (vga->seqi < 0x05) {
+			vga->seqd[vga->seqi] = value;
+			switch (vga->seqi) {
 			case 0x01:
-				vga_dots = (value & 0x01) ? 8 : 9;
-				vga_dbl = (value & 0x08) ? 1 : 0;
-				vga_calcscreensize();
+				vga->dots = (value & 0x01) ? 8 : 9;
+				vga->dbl = (value & 0x08) ? 1 : 0;
+				vga_calcscreensize(vga);
 				break;
 			case 0x02:
-				vga_enableplane = value & 0x0F;
+				vga->enableplane = value & 0x0F;
+				vga_updateMasks(vga);
 				break;
 			}
 		}
 		break;
 	case 0x3CE:
-		vga_gfxi = value & 0x1F;
+		vga->gfxi = value & 0x1F;
 		break;
 	case 0x3CF:
-		if (vga_gfxi < 0x09) {
-			vga_gfxd[vga_gfxi] = value;
-			switch (vga_gfxi) {
+		if (vga->gfxi < 0x09) {
+			vga->gfxd[vga->gfxi] = value;
+			switch (vga->gfxi) {
+			case 0x00:
+			case 0x01:
+			case 0x08:
+				vga_updateMasks(vga);
+				break;
 			case 0x03:
-				vga_rotate = value & 7;
-				vga_logicop = (value >> 3) & 3;
+				vga->rotate = value & 7;
+				vga->logicop = (value >> 3) & 3;
 				break;
 			case 0x04:
-				vga_readmap = value & 3;
+				vga->readmap = value & 3;
 				break;
 			case 0x05:
-				vga_wmode = value & 3;
-				vga_rmode = (value >> 3) & 1;
-				vga_shiftmode = (value >> 5) & 3;
-				//debug_log(DEBUG_DETAIL, "wmode = %u\r\n", vga_wmode);
-				//debug_log(DEBUG_DETAIL, "rmode = %u\r\n", vga_rmode);
+				vga->wmode = value & 3;
+				vga->rmode = (value >> 3) & 1;
+				vga->shiftmode = (value >> 5) & 3;
+				//debug_log(DEBUG_DETAIL, "wmode = %u\r\n", vga->wmode);
+				//debug_log(DEBUG_DETAIL, "rmode = %u\r\n", vga->rmode);
 				break;
 			case 0x06:
-				vga_calcmemorymap();
+				vga_calcmemorymap(vga);
 				break;
 			}
 		}
 		break;
 	case 0x3D4:
-		if ((vga_misc & 1) == 1) {
-			vga_writecrtci(value);
+		if ((vga->misc & 1) == 1) {
+			vga_writecrtci(vga, value);
 		}
 		break;
 	case 0x3D5:
-		if ((vga_misc & 1) == 1) {
-			vga_writecrtcd(value);
+		if ((vga->misc & 1) == 1) {
+			vga_writecrtcd(vga, value);
 		}
 		break;
 	}
 }
 
-uint8_t vga_readport(void* dummy, uint16_t port) {
+uint8_t vga_readport(VGA_t* vga, uint16_t port) {
 	uint8_t ret = 0xFF;
 #ifdef DEBUG_VGA
 	debug_log(DEBUG_DETAIL, "Read VGA port: %03X\r\n", port);
 #endif
 	switch (port) {
 	case 0x3B4:
-		if ((vga_misc & 1) == 0) {
-			return vga_readcrtci();
+		if ((vga->misc & 1) == 0) {
+			return vga_readcrtci(vga);
 		}
 		break;
 	case 0x3B5:
-		if ((vga_misc & 1) == 0) {
-			return vga_readcrtcd();
+		if ((vga->misc & 1) == 0) {
+			return vga_readcrtcd(vga);
 		}
 		break;
 	case 0x3C0:
-		if (vga_attrflipflop == 0) {
-			ret = vga_attri | vga_attrpal;
+		if (vga->attrflipflop == 0) {
+			ret = vga->attri | vga->attrpal;
 		}
 		else {
-			if (vga_attri < 0x15) {
-				ret = vga_attrd[vga_attri];
+			if (vga->attri < 0x15) {
+				ret = vga->attrd[vga->attri];
 			}
 		}
 		break;
 	case 0x3C1:
-		if (vga_attri < 0x15) {
-			return vga_attrd[vga_attri];
+		if (vga->attri < 0x15) {
+			return vga->attrd[vga->attri];
 		}
 		break;
 	case 0x3C4:
-		return vga_seqi;
+		return vga->seqi;
 	case 0x3C5:
-		if (vga_seqi < 0x05) {
-			return vga_seqd[vga_seqi];
+		if (vga->seqi < 0x05) {
+			return vga->seqd[vga->seqi];
 		}
 		break;
 	case 0x3C7:
-		return vga_DAC.state;
+		return vga->DAC.state;
 	case 0x3C8:
-		return vga_DAC.index;
+		return vga->DAC.index;
 	case 0x3C9:
-		ret = vga_DAC.pal[vga_DAC.index][vga_DAC.step++];
-		if (vga_DAC.step == 3) {
-			vga_DAC.step = 0;
-			vga_DAC.index++;
+		ret = vga->DAC.pal[vga->DAC.index][vga->DAC.step++];
+		if (vga->DAC.step == 3) {
+			vga->DAC.step = 0;
+			vga->DAC.index++;
 		}
 		break;
 	case 0x3CC:
-		return vga_misc;
+		return vga->misc;
 	case 0x3CE:
-		return vga_gfxi;
+		return vga->gfxi;
 	case 0x3CF:
-		if (vga_gfxi < 0x09) {
-			return vga_gfxd[vga_gfxi];
+		if (vga->gfxi < 0x09) {
+			return vga->gfxd[vga->gfxi];
 		}
 		break;
 	case 0x3D4:
-		if ((vga_misc & 1) == 1) {
-			return vga_readcrtci();
+		if ((vga->misc & 1) == 1) {
+			return vga_readcrtci(vga);
 		}
 		break;
 	case 0x3D5:
-		if ((vga_misc & 1) == 1) {
-			return vga_readcrtcd();
+		if ((vga->misc & 1) == 1) {
+			return vga_readcrtcd(vga);
 		}
 		break;
 	case 0x3DA:
-		vga_attrflipflop = 0; //because VGA is weird
-		return vga_status1;
+		vga->attrflipflop = 0; //because VGA is weird
+		return vga_readStatus1(vga);
 	}
 	return ret;
 }
 
-uint8_t vga_dologic(uint8_t value, uint8_t latch) {
-	switch (vga_logicop) {
+//rebuilt whenever a register they come from is written, so the write modes below do all four planes at once
+void vga_updateMasks(VGA_t* vga) {
+	vga->setreset = vga_lanes[vga->gfxd[0x00] & 0x0F];
+	vga->enablesr = vga_lanes[vga->gfxd[0x01] & 0x0F];
+	vga->bitmask = vga_spread(vga->gfxd[0x08]);
+	vga->planemask = vga_lanes[vga->enableplane & 0x0F];
+}
+
+uint32_t vga_dologic(VGA_t* vga, uint32_t value, uint32_t latch) {
+	switch (vga->logicop) {
 	case 0:
 		return value;
 	case 1:
@@ -675,95 +711,78 @@ uint8_t vga_dologic(uint8_t value, uint8_t latch) {
 	}
 }
 
-void vga_writememory(void* dummy, uint32_t addr, uint8_t value) {
-	uint8_t temp, plane;
-	if ((vga_misc & 0x02) == 0) return; //RAM writes are disabled
+void vga_writememory(VGA_t* vga, uint32_t addr, uint8_t value) {
+	uint32_t temp;
+	if ((vga->misc & 0x02) == 0) return; //RAM writes are disabled
+	vga->dirty = 1;
 	addr -= 0xA0000;
-	addr = (addr - vga_membase) & vga_memmask; //TODO: Is this right?
-
-	if (vga_gfxd[0x05] & 0x10) { //host odd/even mode (text)
-		vga_RAM[addr & 1][addr >> 1] = value;
+	addr = (addr - vga->membase) & vga->memmask; //TODO: Is this right?
+
+	if (vga->gfxd[0x05] & 0x10) { //host odd/even mode (text)
+		vga_plane(vga, addr & 1, addr >> 1) = value;
+		if ((vga->textcb != NULL) && !(addr & 1) && !(vga->attrd[0x10] & 1)) {
+			uint32_t startaddr, hchars, rows;
+			startaddr = ((uint32_t)vga->crtcd[0xC] << 8) | (uint32_t)vga->crtcd[0xD];
+			hchars = vga->dbl ? 40 : 80;
+			rows = vga->h / ((vga->crtcd[0x09] & 0x1F) + 1);
+			addr = ((addr >> 1) - startaddr) & 0xFFFF;
+			if (addr < hchars * rows) {
+				(*vga->textcb)(vga->textudata, addr / hchars);
+			}
+		}
 		return;
 	}
 
-	if (vga_seqd[0x04] & 0x08) { //chain-4
-		vga_RAM[addr & 3][addr >> 2] = value;
+	if (vga->seqd[0x04] & 0x08) { //chain-4
+		vga_plane(vga, addr & 3, addr >> 2) = value;
 		return;
 	}
 
-	switch (vga_wmode) {
+	switch (vga->wmode) {
 	case 0:
-		for (plane = 0; plane < 4; plane++) {
-			if (vga_enableplane & (1 << plane)) { //are we allowed to write to this plane?
-				if (vga_gfxd[0x01] & (1 << plane)) { //test enable set/reset bit for plane
-					temp = (vga_gfxd[0x00] & (1 << plane)) ? 0xFF : 0x00; //set/reset expansion as source data
-				} else { //host data as source
-					temp = vga_dorotate(value);
-				}
-				temp = vga_dologic(temp, vga_latch[plane]);
-				temp = (temp & vga_gfxd[0x08]) | (vga_latch[plane] & (~vga_gfxd[0x08]));
-				vga_RAM[plane][addr] = temp;
-				//debug_log(DEBUG_DETAIL, "mode 0 write plane %u\r\n", plane);
-			}
-		}
+		temp = vga_spread(vga_dorotate(vga, value));
+		temp = (temp & ~vga->enablesr) | (vga->setreset & vga->enablesr); //set/reset expansion replaces host data where enabled
+		temp = vga_dologic(vga, temp, vga->latch);
+		temp = (temp & vga->bitmask) | (vga->latch & ~vga->bitmask);
 		break;
 	case 1:
-		for (plane = 0; plane < 4; plane++) {
-			if (vga_enableplane & (1 << plane)) {
-				vga_RAM[plane][addr] = vga_latch[plane];
-				//debug_log(DEBUG_DETAIL, "mode 1 write plane %u\r\n", plane);
-			}
-		}
+		temp = vga->latch;
 		break;
 	case 2:
-		for (plane = 0; plane < 4; plane++) {
-			if (vga_enableplane & (1 << plane)) {
-				temp = (value & (1 << plane)) ? 0xFF : 0x00;
-				temp = vga_dologic(temp, vga_latch[plane]);
-				temp = (temp & vga_gfxd[0x08]) | (vga_latch[plane] & (~vga_gfxd[0x08]));
-				vga_RAM[plane][addr] = temp;
-			}
-		}
+		temp = vga_dologic(vga, vga_lanes[value & 0x0F], vga->latch);
+		temp = (temp & vga->bitmask) | (vga->latch & ~vga->bitmask);
 		break;
-	case 3:
-		for (plane = 0; plane < 4; plane++) {
-			if (vga_enableplane & (1 << plane)) {
-				temp = (vga_gfxd[0x00] & (1 << plane)) ? 0xFF : 0x00;
-				temp = (vga_dorotate(value) & vga_gfxd[0x08]) | (temp & (~vga_gfxd[0x08])); //bit mask logic
-				vga_RAM[plane][addr] = temp;
-			}
-		}
+	default: //3
+		temp = (vga_spread(vga_dorotate(vga, value)) & vga->bitmask) | (vga->setreset & ~vga->bitmask); //bit mask logic
 		break;
 	}
+	vga->VRAM[addr] = (vga->VRAM[addr] & ~vga->planemask) | (temp & vga->planemask); //only the planes we're allowed to write to
 }
 
-uint8_t vga_readmemory(void* dummy, uint32_t addr) {
+uint8_t vga_readmemory(VGA_t* vga, uint32_t addr) {
 	uint8_t plane, ret;
 
 	addr -= 0xA0000;
-	addr = (addr - vga_membase) & vga_memmask; //TODO: Is this right?
+	addr = (addr - vga->membase) & vga->memmask; //TODO: Is this right?
 
-	if (vga_gfxd[0x05] & 0x10) { //host odd/even mode (text)
-		return vga_RAM[addr & 1][addr >> 1];
+	if (vga->gfxd[0x05] & 0x10) { //host odd/even mode (text)
+		return vga_plane(vga, addr & 1, addr >> 1);
 	}
 
-	if (vga_seqd[0x04] & 0x08) { //chain-4
-		return vga_RAM[addr & 3][addr >> 2];
+	if (vga->seqd[0x04] & 0x08) { //chain-4
+		return vga_plane(vga, addr & 3, addr >> 2);
 	}
 
-	vga_latch[0] = vga_RAM[0][addr];
-	vga_latch[1] = vga_RAM[1][addr];
-	vga_latch[2] = vga_RAM[2][addr];
-	vga_latch[3] = vga_RAM[3][addr];
+	vga->latch = vga->VRAM[addr];
 
-	if (vga_rmode == 0) {
-		return vga_RAM[vga_readmap][addr];
+	if (vga->rmode == 0) {
+		return (uint8_t)(vga->latch >> (vga->readmap << 3));
 	} else {
 		//TODO: Is this correct?
 		ret = 0;
 		for (plane = 0; plane < 4; plane++) {
-			if (vga_gfxd[0x07] & (1 << plane)) { //color don't care bit check
-				if ((vga_RAM[plane][addr] & 0x0F) == (vga_gfxd[0x02] & 0x0F)) { //compare RAM value with color compare register
+			if (vga->gfxd[0x07] & (1 << plane)) { //color don't care bit check
+				if (((vga->latch >> (plane << 3)) & 0x0F) == (vga->gfxd[0x02] & 0x0F)) { //compare RAM value with color compare register
 					ret |= 1 << plane; //set bit if true
 				}
 			}
@@ -772,59 +791,104 @@ uint8_t vga_readmemory(void* dummy, uint32_t addr) {
 	}
 }
 
-void vga_drawCallback(void* dummy) {
-	vga_doRender = 1;
-	vga_doBlit = 1;
+//copies the characters and attributes (if attrs isn't NULL) of one visible text row, returns how many there were or 0 in graphics modes
+uint32_t vga_textRow(VGA_t* vga, uint32_t row, uint8_t* chars, uint8_t* attrs) {
+	uint32_t startaddr, hchars, x, addr;
+
+	if ((vga->attrd[0x10] & 1) || (row >= vga->h / ((vga->crtcd[0x09] & 0x1F) + 1))) return 0;
+	startaddr = ((uint32_t)vga->crtcd[0xC] << 8) | (uint32_t)vga->crtcd[0xD];
+	hchars = vga->dbl ? 40 : 80;
+	for (x = 0; x < hchars; x++) {
+		addr = (startaddr + (row * hchars) + x) & 0xFFFF;
+		chars[x] = vga_plane(vga, 0, addr);
+		if (attrs != NULL) {
+			attrs[x] = vga_plane(vga, 1, addr);
+		}
+	}
+	return hchars;
 }
 
-void vga_blinkCallback(void* dummy) {
-	vga_cursor_blink_state ^= 1;
+void vga_textCursor(VGA_t* vga, uint32_t* x, uint32_t* y) {
+	uint32_t cursorloc, hchars;
+
+	cursorloc = ((uint32_t)vga->crtcd[0xE] << 8) | (uint32_t)vga->crtcd[0xF];
+	hchars = vga->dbl ? 40 : 80;
+	*x = cursorloc % hchars;
+	*y = cursorloc / hchars;
 }
 
-void vga_hblankCallback(void* dummy) {
-	timing_timerEnable(vga_hblankEndTimer);
-	vga_status1 |= 0x01;
-	vga_curScanline++;
-	if (vga_curScanline == vga_vblankstart) {
-		vga_status1 |= 0x08;
-	}
-	else if (vga_curScanline == vga_vblankend) {
-		vga_curScanline = 0;
-		vga_status1 &= 0xF7;
+void vga_drawCallback(VGA_t* vga) {
+	if (vga->dirty) {
+		vga->dirty = 0;
+		vga->doRender = 1;
 	}
+	vga->doBlit = 1;
+}
+
+void vga_blinkCallback(VGA_t* vga) {
+	vga->cursor_blink_state ^= 1;
+	vga->dirty = 1;
 }
 
-void vga_hblankEndCallback(void* dummy) {
-	timing_timerDisable(vga_hblankEndTimer);
-	vga_status1 &= 0xFE;
+/*
+	The beam position isn't tracked by a timer, it's worked out from how long it's been
+	since the start of the frame whenever the status register is actually read.
+*/
+uint8_t vga_readStatus1(VGA_t* vga) {
+	uint64_t now, frames;
+	double elapsed, x;
+	uint32_t scanline;
+
+	vga->status1 &= 0xF6;
+	if ((vga->framepixels < 1) || (vga->linepixels < 1)) return vga->status1;
+
+	now = timing_getCur();
+	elapsed = (double)(now - vga->framestart) * vga->pixelratio;
+	if (elapsed >= vga->framepixels) { //move the frame start up so the numbers stay small
+		frames = (uint64_t)(elapsed / vga->framepixels);
+		vga->framestart += (uint64_t)((double)frames * vga->framepixels / vga->pixelratio);
+		elapsed = (double)(now - vga->framestart) * vga->pixelratio;
+		if (elapsed < 0) elapsed = 0;
+	}
+
+	scanline = (uint32_t)(elapsed / vga->linepixels);
+	x = elapsed - (double)scanline * vga->linepixels;
+
+	if (scanline >= vga->vblankstart) {
+		vga->status1 |= 0x09; //vertical retrace, display is disabled too
+	}
+	else if ((x >= (double)vga->hblankstart) && (x < (double)vga->hblankend)) {
+		vga->status1 |= 0x01;
+	}
+	return vga->status1;
 }
 
-void vga_dumpregs() {
+void vga_dumpregs(VGA_t* vga) {
 #ifdef DEBUG_VGA
 	int i;
 	debug_log(DEBUG_DETAIL, "VGA registers:\r\n");
 	for (i = 0; i < 0x15; i++) {
 		debug_log(DEBUG_DETAIL, "  ATTR[0x%02X] = %u%u%u%u%u%u%u%u\r\n", i,
-			(vga_attrd[i] >> 7) & 1, (vga_attrd[i] >> 6) & 1, (vga_attrd[i] >> 5) & 1, (vga_attrd[i] >> 4) & 1,
-			(vga_attrd[i] >> 3) & 1, (vga_attrd[i] >> 2) & 1, (vga_attrd[i] >> 1) & 1, (vga_attrd[i] >> 0) & 1);
+			(vga->attrd[i] >> 7) & 1, (vga->attrd[i] >> 6) & 1, (vga->attrd[i] >> 5) & 1, (vga->attrd[i] >> 4) & 1,
+			(vga->attrd[i] >> 3) & 1, (vga->attrd[i] >> 2) & 1, (vga->attrd[i] >> 1) & 1, (vga->attrd[i] >> 0) & 1);
 	}
 	debug_log(DEBUG_DETAIL, "\r\n");
 	for (i = 0; i < 0x05; i++) {
 		debug_log(DEBUG_DETAIL, "  SEQ[0x%02X] = %u%u%u%u%u%u%u%u\r\n", i,
-			(vga_seqd[i] >> 7) & 1, (vga_seqd[i] >> 6) & 1, (vga_seqd[i] >> 5) & 1, (vga_seqd[i] >> 4) & 1,
-			(vga_seqd[i] >> 3) & 1, (vga_seqd[i] >> 2) & 1, (vga_seqd[i] >> 1) & 1, (vga_seqd[i] >> 0) & 1);
+			(vga->seqd[i] >> 7) & 1, (vga->seqd[i] >> 6) & 1, (vga->seqd[i] >> 5) & 1, (vga->seqd[i] >> 4) & 1,
+			(vga->seqd[i] >> 3) & 1, (vga->seqd[i] >> 2) & 1, (vga->seqd[i] >> 1) & 1, (vga->seqd[i] >> 0) & 1);
 	}
 	debug_log(DEBUG_DETAIL, "\r\n");
 	for (i = 0; i < 0x09; i++) {
 		debug_log(DEBUG_DETAIL, "  GFX[0x%02X] = %u%u%u%u%u%u%u%u\r\n", i,
-			(vga_gfxd[i] >> 7) & 1, (vga_gfxd[i] >> 6) & 1, (vga_gfxd[i] >> 5) & 1, (vga_gfxd[i] >> 4) & 1,
-			(vga_gfxd[i] >> 3) & 1, (vga_gfxd[i] >> 2) & 1, (vga_gfxd[i] >> 1) & 1, (vga_gfxd[i] >> 0) & 1);
+			(vga->gfxd[i] >> 7) & 1, (vga->gfxd[i] >> 6) & 1, (vga->gfxd[i] >> 5) & 1, (vga->gfxd[i] >> 4) & 1,
+			(vga->gfxd[i] >> 3) & 1, (vga->gfxd[i] >> 2) & 1, (vga->gfxd[i] >> 1) & 1, (vga->gfxd[i] >> 0) & 1);
 	}
 	debug_log(DEBUG_DETAIL, "\r\n");
 	for (i = 0; i < 0x19; i++) {
 		debug_log(DEBUG_DETAIL, "  CRTC[0x%02X] = %u%u%u%u%u%u%u%u\r\n", i,
-			(vga_crtcd[i] >> 7) & 1, (vga_crtcd[i] >> 6) & 1, (vga_crtcd[i] >> 5) & 1, (vga_crtcd[i] >> 4) & 1,
-			(vga_crtcd[i] >> 3) & 1, (vga_crtcd[i] >> 2) & 1, (vga_crtcd[i] >> 1) & 1, (vga_crtcd[i] >> 0) & 1);
+			(vga->crtcd[i] >> 7) & 1, (vga->crtcd[i] >> 6) & 1, (vga->crtcd[i] >> 5) & 1, (vga->crtcd[i] >> 4) & 1,
+			(vga->crtcd[i] >> 3) & 1, (vga->crtcd[i] >> 2) & 1, (vga->crtcd[i] >> 1) & 1, (vga->crtcd[i] >> 0) & 1);
 	}
 	debug_log(DEBUG_DETAIL, "\r\n");
 #endif
@@ -11,27 +11,76 @@ typedef struct {
 	uint8_t pal[256][3];
 } VGADAC_t;
 
-extern uint8_t vga_palette[256][3];
+typedef struct {
+	uint8_t* VBIOS; //shared between instances, see memory_loadROM
+	uint8_t palette[256][3]; //R, G, B
+	VGADAC_t DAC;
+	uint8_t framebuffer[1024][1024]; //DAC palette indices, vga_present expands them
+	uint32_t dots;
+	volatile uint32_t w, h;
+	uint32_t membase, memmask;
+	uint16_t cursorloc;
+	uint8_t dbl;
+	uint8_t crtci, crtcd[0x19];
+	uint8_t attri, attrd[0x15], attrflipflop, attrpal;
+	uint8_t gfxi, gfxd[0x09];
+	uint8_t seqi, seqd[0x05];
+	uint8_t misc, status0, status1;
+	uint8_t cursor_blink_state;
+	volatile uint8_t wmode, rmode, shiftmode, rotate, logicop, enableplane, readmap, scandbl, hdbl, bpp;
+	uint32_t* VRAM; //64K addresses, the four planes are the four byte lanes of each word
+	uint32_t latch; //all four plane latches, same layout as VRAM
+	uint32_t setreset, enablesr, bitmask, planemask; //GC/sequencer registers spread over the lanes, see vga_updateMasks
+	volatile uint64_t hblankstart, hblankend, hblanklen, htotal;
+	volatile uint64_t vblankstart, vblankend, vblanklen;
+	uint64_t framestart;
+	double linepixels, framepixels, pixelratio;
+	volatile uint8_t doRender, doBlit;
+	volatile uint8_t dirty; //VRAM or a register the renderer looks at was written since the last frame
+	volatile uint8_t dacdirty; //the DAC was written, the frame only needs expanding again
+	uint8_t stale, expand; //render thread only, see vga_renderThread
+	volatile double targetFPS;
+	volatile uint32_t drawTimer;
+	uint32_t lastw, lasth; //last mode that was logged
+	double lastFPS;
+	uint8_t headless;
+	uint8_t mono; //last frame was 1bpp
+	void (*textcb)(void* udata, uint32_t row); //told about every character written to a visible text row
+	void* textudata;
+} VGA_t;
+
 extern volatile double vga_lockFPS;
 
-int vga_init();
-void vga_updateScanlineTiming();
-void vga_update(uint32_t start_x, uint32_t start_y, uint32_t end_x, uint32_t end_y);
-void vga_writeport(void* dummy, uint16_t port, uint8_t value);
-uint8_t vga_readport(void* dummy, uint16_t port);
-void vga_blinkCallback(void* dummy);
-void vga_hblankCallback(void* dummy);
-void vga_hblankEndCallback(void* dummy);
-void vga_drawCallback(void* dummy);
-void vga_renderThread(void* cpu);
-void vga_writememory(void* dummy, uint32_t addr, uint8_t value);
-uint8_t vga_readmemory(void* dummy, uint32_t addr);
-void vga_dumpregs();
+int vga_init(VGA_t* vga, uint8_t headless);
+void vga_updateScanlineTiming(VGA_t* vga);
+void vga_update(VGA_t* vga, uint32_t start_x, uint32_t start_y, uint32_t end_x, uint32_t end_y);
+void vga_writeport(VGA_t* vga, uint16_t port, uint8_t value);
+uint8_t vga_readport(VGA_t* vga, uint16_t port);
+void vga_blinkCallback(VGA_t* vga);
+uint8_t vga_readStatus1(VGA_t* vga);
+void vga_drawCallback(VGA_t* vga);
+void vga_present(VGA_t* vga);
+void vga_renderThread(VGA_t* vga);
+void vga_updateMasks(VGA_t* vga);
+void vga_writememory(VGA_t* vga, uint32_t addr, uint8_t value);
+uint8_t vga_readmemory(VGA_t* vga, uint32_t addr);
+uint32_t vga_textRow(VGA_t* vga, uint32_t row, uint8_t* chars, uint8_t* attrs);
+void vga_textCursor(VGA_t* vga, uint32_t* x, uint32_t* y);
+void vga_dumpregs(VGA_t* vga);
 
 //#define cga_color(c) ((uint32_t)cga_palette[c][0] | ((uint32_t)cga_palette[c][1]<<8) | ((uint32_t)cga_palette[c][2]<<16))
-#define vga_color(c) ((uint32_t)vga_palette[c][2] | ((uint32_t)vga_palette[c][1]<<8) | ((uint32_t)vga_palette[c][0]<<16))
+#define vga_color(vga, c) ((uint32_t)(vga)->palette[c][2] | ((uint32_t)(vga)->palette[c][1]<<8) | ((uint32_t)(vga)->palette[c][0]<<16))
 
-#define vga_dorotate(v) ((uint8_t)((v >> vga_rotate) | (v << (8 - vga_rotate))))
+#define vga_dorotate(vga, v) ((uint8_t)((v >> (vga)->rotate) | (v << (8 - (vga)->rotate))))
+
+//plane p is bits 8p to 8p+7 of a VRAM word, wherever that lands in memory
+#ifdef __BIG_ENDIAN__
+#define VGA_LANE(p)		(3 - (p))
+#else
+#define VGA_LANE(p)		(p)
+#endif
+#define vga_plane(vga, p, a)	(((uint8_t*)(vga)->VRAM)[((uint32_t)(a) << 2) | VGA_LANE(p)])
+#define vga_spread(v)			((uint32_t)(v) * 0x01010101) //one byte copied to all four lanes
 
 #define VGA_DAC_MODE_READ	0x00
 #define VGA_DAC_MODE_WRITE	0x03
@@ -0,0 +1,642 @@
+/*
+  XTulator: A portable, open-source 80186 PC emulator.
+  Copyright (C)2020 Mike Chambers
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+	RFB (VNC) server
+
+	Serves the emulated screen to one VNC viewer at a time, on the loopback interface only
+	since there's no authentication. The video render threads hand every finished frame to
+	vncserver_blit, which just copies it under a lock. Everything else happens on the server's
+	own thread: the frame is split into 16x16 tiles, each compared with what the viewer already
+	has, and only the tiles that changed are sent. Viewers that understand hextile get tiles of
+	one solid color as a single pixel, anything else goes raw. Keys and the mouse from the
+	viewer are fed into the same input queue the SDL window uses.
+
+	While nobody is connected, vncserver_blit returns straight away and the render threads
+	skip drawing altogether (see sdlconsole_wantFrame), so an idle server costs nothing.
+*/
+
+#include "../../config.h"
+
+#ifdef _WIN32
+#include <WinSock2.h>
+#include <WS2tcpip.h>
+#include <Windows.h>
+#include <process.h>
+#include <SDL/SDL.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <SDL.h>
+#define SOCKET			int
+#define INVALID_SOCKET	-1
+#define closesocket		close
+#endif
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vncserver.h"
+#include "../input/input.h"
+#include "../input/mouse.h"
+#include "../../debuglog.h"
+
+#ifdef MSG_NOSIGNAL
+#define VNCSERVER_SENDFLAGS	MSG_NOSIGNAL //a viewer hanging up shouldn't SIGPIPE the whole emulator
+#else
+#define VNCSERVER_SENDFLAGS	0
+#endif
+
+uint16_t vncserver_port = 0;
+volatile uint8_t vncserver_connected = 0;
+
+SOCKET vncserver_listen = INVALID_SOCKET, vncserver_client = INVALID_SOCKET;
+SDL_mutex* vncserver_mutex = NULL;
+
+//latest frame from the render thread, guarded by vncserver_mutex
+uint32_t* vncserver_shared = NULL;
+uint32_t vncserver_sharedw = 0, vncserver_sharedh = 0, vncserver_seq = 0;
+
+//server thread only from here on
+uint32_t *vncserver_cur = NULL, *vncserver_prev = NULL; //latest frame and what the viewer has, both at the viewer's size
+uint32_t vncserver_w, vncserver_h, vncserver_lastseq;
+uint8_t* vncserver_out = NULL;
+uint32_t vncserver_outlen;
+VNCFORMAT_t vncserver_format;
+uint8_t vncserver_native, vncserver_hextile, vncserver_desktopsize, vncserver_requested, vncserver_full;
+uint8_t vncserver_buttons, vncserver_mouseknown;
+uint16_t vncserver_mousex, vncserver_mousey;
+
+void vncserver_blit(uint32_t* pixels, int w, int h, int stride) {
+	int y;
+
+	if (!vncserver_connected) return;
+	if (w > VNCSERVER_MAXW) w = VNCSERVER_MAXW;
+	if (h > VNCSERVER_MAXH) h = VNCSERVER_MAXH;
+
+	SDL_LockMutex(vncserver_mutex);
+	for (y = 0; y < h; y++) {
+		memcpy(vncserver_shared + (y * w), (uint8_t*)pixels + (y * stride), (size_t)w * 4);
+	}
+	vncserver_sharedw = (uint32_t)w;
+	vncserver_sharedh = (uint32_t)h;
+	vncserver_seq++;
+	SDL_UnlockMutex(vncserver_mutex);
+}
+
+int vncserver_send(uint8_t* buf, uint32_t len) {
+	int ret;
+
+	while (len > 0) {
+		ret = send(vncserver_client, (char*)buf, (int)len, VNCSERVER_SENDFLAGS);
+		if (ret <= 0) return -1;
+		buf += ret;
+		len -= (uint32_t)ret;
+	}
+	return 0;
+}
+
+int vncserver_recv(uint8_t* buf, uint32_t len) {
+	int ret;
+
+	while (len > 0) {
+		ret = recv(vncserver_client, (char*)buf, (int)len, 0);
+		if (ret <= 0) return -1;
+		buf += ret;
+		len -= (uint32_t)ret;
+	}
+	return 0;
+}
+
+void vncserver_put8(uint8_t value) {
+	vncserver_out[vncserver_outlen++] = value;
+}
+
+void vncserver_put16(uint16_t value) {
+	vncserver_out[vncserver_outlen++] = (uint8_t)(value >> 8);
+	vncserver_out[vncserver_outlen++] = (uint8_t)value;
+}
+
+void vncserver_put32(uint32_t value) {
+	vncserver_put16((uint16_t)(value >> 16));
+	vncserver_put16((uint16_t)value);
+}
+
+//converts a 0x00RRGGBB pixel to whatever the viewer asked for
+void vncserver_putPixel(uint32_t rgb) {
+	uint32_t value;
+	uint8_t i, bytes;
+
+	if (vncserver_native) {
+		memcpy(vncserver_out + vncserver_outlen, &rgb, 4); //XTulator's own layout is what ServerInit offers, little endian hosts only
+		vncserver_outlen += 4;
+		return;
+	}
+	value = ((((rgb >> 16) & 0xFF) * vncserver_format.rmax + 127) / 255) << vncserver_format.rshift;
+	value |= ((((rgb >> 8) & 0xFF) * vncserver_format.gmax + 127) / 255) << vncserver_format.gshift;
+	value |= (((rgb & 0xFF) * vncserver_format.bmax + 127) / 255) << vncserver_format.bshift;
+	bytes = vncserver_format.bpp / 8;
+	for (i = 0; i < bytes; i++) {
+		if (vncserver_format.bigendian) {
+			vncserver_out[vncserver_outlen++] = (uint8_t)(value >> ((bytes - 1 - i) * 8));
+		}
+		else {
+			vncserver_out[vncserver_outlen++] = (uint8_t)(value >> (i * 8));
+		}
+	}
+}
+
+void vncserver_setNative() {
+	uint16_t one = 1;
+
+	vncserver_native = (vncserver_format.bpp == 32) && (vncserver_format.rmax == 255) && (vncserver_format.gmax == 255) &&
+		(vncserver_format.bmax == 255) && (vncserver_format.rshift == 16) && (vncserver_format.gshift == 8) &&
+		(vncserver_format.bshift == 0) && (vncserver_format.bigendian == 0) && (*(uint8_t*)&one == 1);
+}
+
+void vncserver_key(uint8_t scancode) {
+	INPUTEVENT_t input;
+
+	input.type = INPUT_EVENT_KEY;
+	input.code = scancode;
+	input.state = 0;
+	input.xrel = input.yrel = 0;
+	input_push(&input);
+}
+
+void vncserver_mouse(uint8_t action, uint8_t state, int32_t xrel, int32_t yrel) {
+	INPUTEVENT_t input;
+
+	input.type = INPUT_EVENT_MOUSE;
+	input.code = action;
+	input.state = state;
+	input.xrel = xrel;
+	input.yrel = yrel;
+	input_push(&input);
+}
+
+//X11 keysym to XT scancode, 0 if the XT keyboard doesn't have it
+uint8_t vncserver_keysym(uint32_t keysym) {
+	uint8_t shift;
+
+	if ((keysym >= 0x20) && (keysym <= 0x7E)) {
+		return input_asciiScancode((char)keysym, &shift); //the viewer sends shift on its own
+	}
+	if ((keysym >= 0xFFBE) && (keysym <= 0xFFC7)) { //F1 to F10
+		return (uint8_t)(0x3B + (keysym - 0xFFBE));
+	}
+	switch (keysym) {
+	case 0xFF08: return 0x0E; //backspace
+	case 0xFF09: return 0x0F; //tab
+	case 0xFF0D: return 0x1C; //return
+	case 0xFF1B: return 0x01; //escape
+	case 0xFF50: return 0x47; //home
+	case 0xFF51: return 0x4B; //left
+	case 0xFF52: return 0x48; //up
+	case 0xFF53: return 0x4D; //right
+	case 0xFF54: return 0x50; //down
+	case 0xFF55: return 0x49; //page up
+	case 0xFF56: return 0x51; //page down
+	case 0xFF57: return 0x4F; //end
+	case 0xFF63: return 0x52; //insert
+	case 0xFFFF: return 0x53; //delete
+	case 0xFF7F: return 0x45; //num lock
+	case 0xFF14: return 0x46; //scroll lock
+	case 0xFFE5: return 0x3A; //caps lock
+	case 0xFFE1: return 0x2A; //left shift
+	case 0xFFE2: return 0x36; //right shift
+	case 0xFFE3: case 0xFFE4: return 0x1D; //ctrl
+	case 0xFFE9: case 0xFFEA: case 0xFFE7: case 0xFFE8: return 0x38; //alt, meta
+	}
+	return 0x00;
+}
+
+void vncserver_pointer(uint8_t buttons, uint16_t x, uint16_t y) {
+	int32_t xrel, yrel;
+
+	//the viewer sends absolute positions, the serial mouse only knows about movement
+	if (vncserver_mouseknown) {
+		xrel = (int32_t)x - (int32_t)vncserver_mousex;
+		yrel = (int32_t)y - (int32_t)vncserver_mousey;
+		if (xrel < -128) xrel = -128;
+		if (xrel > 127) xrel = 127;
+		if (yrel < -128) yrel = -128;
+		if (yrel > 127) yrel = 127;
+		if ((xrel != 0) || (yrel != 0)) {
+			vncserver_mouse(MOUSE_ACTION_MOVE, MOUSE_NEITHER, xrel, yrel);
+		}
+	}
+	vncserver_mousex = x;
+	vncserver_mousey = y;
+	vncserver_mouseknown = 1;
+
+	if ((buttons ^ vncserver_buttons) & 0x01) {
+		vncserver_mouse(MOUSE_ACTION_LEFT, (buttons & 0x01) ? MOUSE_PRESSED : MOUSE_UNPRESSED, 0, 0);
+	}
+	if ((buttons ^ vncserver_buttons) & 0x04) {
+		vncserver_mouse(MOUSE_ACTION_RIGHT, (buttons & 0x04) ? MOUSE_PRESSED : MOUSE_UNPRESSED, 0, 0);
+	}
+	vncserver_buttons = buttons;
+}
+
+//handles one message from the viewer, returns -1 if it should be dropped
+int vncserver_message() {
+	uint8_t buf[20];
+	uint32_t count, len;
+	int32_t encoding;
+
+	if (vncserver_recv(buf, 1)) return -1;
+	switch (buf[0]) {
+	case 0: //SetPixelFormat
+		if (vncserver_recv(buf, 19)) return -1;
+		vncserver_format.bpp = buf[3];
+		vncserver_format.depth = buf[4];
+		vncserver_format.bigendian = buf[5];
+		vncserver_format.truecolor = buf[6];
+		vncserver_format.rmax = ((uint16_t)buf[7] << 8) | buf[8];
+		vncserver_format.gmax = ((uint16_t)buf[9] << 8) | buf[10];
+		vncserver_format.bmax = ((uint16_t)buf[11] << 8) | buf[12];
+		vncserver_format.rshift = buf[13];
+		vncserver_format.gshift = buf[14];
+		vncserver_format.bshift = buf[15];
+		if (!vncserver_format.truecolor || ((vncserver_format.bpp != 8) && (vncserver_format.bpp != 16) && (vncserver_format.bpp != 32))) {
+			debug_log(DEBUG_ERROR, "[VNC] Viewer wants a pixel format that isn't supported\r\n");
+			return -1;
+		}
+		vncserver_setNative();
+		vncserver_full = 1;
+		return 0;
+	case 2: //SetEncodings
+		if (vncserver_recv(buf, 3)) return -1;
+		count = ((uint32_t)buf[1] << 8) | buf[2];
+		vncserver_hextile = vncserver_desktopsize = 0;
+		while (count--) {
+			if (vncserver_recv(buf, 4)) return -1;
+			encoding = (int32_t)(((uint32_t)buf[0] << 24) | ((uint32_t)buf[1] << 16) | ((uint32_t)buf[2] << 8) | buf[3]);
+			if (encoding == VNCSERVER_ENC_HEXTILE) vncserver_hextile = 1;
+			if (encoding == VNCSERVER_ENC_DESKTOPSIZE) vncserver_desktopsize = 1;
+		}
+		return 0;
+	case 3: //FramebufferUpdateRequest, always treated as the whole screen
+		if (vncserver_recv(buf, 9)) return -1;
+		if (!buf[0]) vncserver_full = 1;
+		vncserver_requested = 1;
+		return 0;
+	case 4: //KeyEvent
+		if (vncserver_recv(buf, 7)) return -1;
+		len = vncserver_keysym(((uint32_t)buf[3] << 24) | ((uint32_t)buf[4] << 16) | ((uint32_t)buf[5] << 8) | buf[6]);
+		if (len != 0x00) {
+			vncserver_key((uint8_t)len | (buf[0] ? 0x00 : 0x80));
+		}
+		return 0;
+	case 5: //PointerEvent
+		if (vncserver_recv(buf, 5)) return -1;
+		vncserver_pointer(buf[0], ((uint16_t)buf[1] << 8) | buf[2], ((uint16_t)buf[3] << 8) | buf[4]);
+		return 0;
+	case 6: //ClientCutText, nothing to paste it into
+		if (vncserver_recv(buf, 7)) return -1;
+		len = ((uint32_t)buf[3] << 24) | ((uint32_t)buf[4] << 16) | ((uint32_t)buf[5] << 8) | buf[6];
+		while (len > 0) {
+			count = (len > sizeof(buf)) ? sizeof(buf) : len;
+			if (vncserver_recv(buf, count)) return -1;
+			len -= count;
+		}
+		return 0;
+	}
+	debug_log(DEBUG_ERROR, "[VNC] Unknown message type %u from viewer\r\n", buf[0]);
+	return -1;
+}
+
+void vncserver_putTiles(uint32_t x, uint32_t y, uint32_t w, uint32_t h) {
+	uint32_t tx, ty, i;
+	uint32_t* row;
+	uint8_t solid;
+
+	vncserver_put16((uint16_t)x);
+	vncserver_put16((uint16_t)y);
+	vncserver_put16((uint16_t)w);
+	vncserver_put16((uint16_t)h);
+	if (!vncserver_hextile) {
+		vncserver_put32(VNCSERVER_ENC_RAW);
+		for (ty = y; ty < y + h; ty++) {
+			row = vncserver_cur + ty * vncserver_w;
+			for (tx = x; tx < x + w; tx++) {
+				vncserver_putPixel(row[tx]);
+			}
+		}
+		return;
+	}
+
+	vncserver_put32(VNCSERVER_ENC_HEXTILE);
+	for (tx = x; tx < x + w; tx += VNCSERVER_TILE) {
+		uint32_t tw = ((x + w - tx) < VNCSERVER_TILE) ? (x + w - tx) : VNCSERVER_TILE;
+		solid = 1;
+		for (ty = y; solid && (ty < y + h); ty++) {
+			row = vncserver_cur + ty * vncserver_w + tx;
+			for (i = 0; i < tw; i++) {
+				if (row[i] != vncserver_cur[y * vncserver_w + tx]) {
+					solid = 0;
+					break;
+				}
+			}
+		}
+		if (solid) {
+			vncserver_put8(0x02); //BackgroundSpecified and no subrectangles
+			vncserver_putPixel(vncserver_cur[y * vncserver_w + tx]);
+		}
+		else {
+			vncserver_put8(0x01); //Raw
+			for (ty = y; ty < y + h; ty++) {
+				row = vncserver_cur + ty * vncserver_w + tx;
+				for (i = 0; i < tw; i++) {
+					vncserver_putPixel(row[i]);
+				}
+			}
+		}
+	}
+}
+
+//picks up the newest frame and sends the viewer whatever changed, returns -1 if the send failed
+int vncserver_update() {
+	uint32_t w, h, y, copyw, copyh, tx, ty, run, tilesw, tilesh, th, rects = 0;
+	uint8_t resized = 0, dirty;
+
+	SDL_LockMutex(vncserver_mutex);
+	if (vncserver_seq != vncserver_lastseq) {
+		vncserver_lastseq = vncserver_seq;
+		w = vncserver_sharedw;
+		h = vncserver_sharedh;
+		if (((w != vncserver_w) || (h != vncserver_h)) && vncserver_desktopsize) {
+			vncserver_w = w;
+			vncserver_h = h;
+			resized = 1;
+			vncserver_full = 1;
+		}
+		//a viewer that can't be resized gets the frame clipped or padded to the size it has
+		copyw = (w < vncserver_w) ? w : vncserver_w;
+		copyh = (h < vncserver_h) ? h : vncserver_h;
+		for (y = 0; y < vncserver_h; y++) {
+			if (y < copyh) {
+				memcpy(vncserver_cur + y * vncserver_w, vncserver_shared + y * w, (size_t)copyw * 4);
+				memset(vncserver_cur + y * vncserver_w + copyw, 0, (size_t)(vncserver_w - copyw) * 4);
+			}
+			else {
+				memset(vncserver_cur + y * vncserver_w, 0, (size_t)vncserver_w * 4);
+			}
+		}
+	}
+	else if (!vncserver_full) {
+		SDL_UnlockMutex(vncserver_mutex);
+		return 0;
+	}
+	SDL_UnlockMutex(vncserver_mutex);
+
+	vncserver_outlen = 0;
+	vncserver_put8(0); //FramebufferUpdate
+	vncserver_put8(0);
+	vncserver_put16(0); //number of rectangles, filled in at the end
+	if (resized) {
+		vncserver_put16(0);
+		vncserver_put16(0);
+		vncserver_put16((uint16_t)vncserver_w);
+		vncserver_put16((uint16_t)vncserver_h);
+		vncserver_put32((uint32_t)VNCSERVER_ENC_DESKTOPSIZE);
+		rects++;
+	}
+
+	//runs of changed tiles along each tile row go out as one rectangle
+	tilesw = (vncserver_w + VNCSERVER_TILE - 1) / VNCSERVER_TILE;
+	tilesh = (vncserver_h + VNCSERVER_TILE - 1) / VNCSERVER_TILE;
+	for (ty = 0; ty < tilesh; ty++) {
+		th = ((vncserver_h - ty * VNCSERVER_TILE) < VNCSERVER_TILE) ? (vncserver_h - ty * VNCSERVER_TILE) : VNCSERVER_TILE;
+		run = 0;
+		for (tx = 0; tx <= tilesw; tx++) {
+			dirty = 0;
+			if (tx < tilesw) {
+				uint32_t tw = ((vncserver_w - tx * VNCSERVER_TILE) < VNCSERVER_TILE) ? (vncserver_w - tx * VNCSERVER_TILE) : VNCSERVER_TILE;
+				uint32_t offset = ty * VNCSERVER_TILE * vncserver_w + tx * VNCSERVER_TILE;
+				dirty = vncserver_full;
+				for (y = 0; !dirty && (y < th); y++) {
+					dirty = memcmp(vncserver_cur + offset + y * vncserver_w, vncserver_prev + offset + y * vncserver_w, (size_t)tw * 4) ? 1 : 0;
+				}
+				if (dirty) {
+					for (y = 0; y < th; y++) {
+						memcpy(vncserver_prev + offset + y * vncserver_w, vncserver_cur + offset + y * vncserver_w, (size_t)tw * 4);
+					}
+					run++;
+					continue;
+				}
+			}
+			if (run > 0) {
+				uint32_t x = (tx - run) * VNCSERVER_TILE;
+				uint32_t rw = ((tx * VNCSERVER_TILE) > vncserver_w) ? (vncserver_w - x) : (run * VNCSERVER_TILE);
+				vncserver_putTiles(x, ty * VNCSERVER_TILE, rw, th);
+				rects++;
+				run = 0;
+			}
+		}
+	}
+	vncserver_full = 0;
+
+	if (rects == 0) { //nothing actually changed, keep the request open for the next frame
+		return 0;
+	}
+	vncserver_out[2] = (uint8_t)(rects >> 8);
+	vncserver_out[3] = (uint8_t)rects;
+	vncserver_requested = 0;
+	return vncserver_send(vncserver_out, vncserver_outlen);
+}
+
+//RFB 3.3, 3.7 and 3.8 handshakes without authentication, returns -1 on failure
+int vncserver_handshake() {
+	uint8_t buf[24];
+	char version[13];
+	uint32_t minor = 3;
+	const char* name = STR_TITLE;
+
+	if (vncserver_send((uint8_t*)"RFB 003.008\n", 12) || vncserver_recv((uint8_t*)version, 12)) return -1;
+	version[12] = 0;
+	if (strncmp(version, "RFB 003.", 8) != 0) {
+		debug_log(DEBUG_ERROR, "[VNC] Viewer isn't speaking RFB\r\n");
+		return -1;
+	}
+	minor = (uint32_t)atoi(&version[8]);
+	if (minor >= 7) {
+		buf[0] = 1; //one security type...
+		buf[1] = 1; //...None
+		if (vncserver_send(buf, 2) || vncserver_recv(buf, 1) || (buf[0] != 1)) return -1;
+		if (minor >= 8) {
+			memset(buf, 0, 4); //SecurityResult OK
+			if (vncserver_send(buf, 4)) return -1;
+		}
+	}
+	else {
+		buf[0] = buf[1] = buf[2] = 0;
+		buf[3] = 1;
+		if (vncserver_send(buf, 4)) return -1;
+	}
+	if (vncserver_recv(buf, 1)) return -1; //ClientInit, shared flag doesn't matter with one viewer
+
+	SDL_LockMutex(vncserver_mutex);
+	vncserver_w = vncserver_sharedw ? vncserver_sharedw : 640;
+	vncserver_h = vncserver_sharedh ? vncserver_sharedh : 400;
+	SDL_UnlockMutex(vncserver_mutex);
+
+	vncserver_format.bpp = 32;
+	vncserver_format.depth = 24;
+	vncserver_format.bigendian = 0;
+	vncserver_format.truecolor = 1;
+	vncserver_format.rmax = vncserver_format.gmax = vncserver_format.bmax = 255;
+	vncserver_format.rshift = 16;
+	vncserver_format.gshift = 8;
+	vncserver_format.bshift = 0;
+	vncserver_setNative();
+
+	vncserver_outlen = 0;
+	vncserver_put16((uint16_t)vncserver_w);
+	vncserver_put16((uint16_t)vncserver_h);
+	vncserver_put8(vncserver_format.bpp);
+	vncserver_put8(vncserver_format.depth);
+	vncserver_put8(vncserver_format.bigendian);
+	vncserver_put8(vncserver_format.truecolor);
+	vncserver_put16(vncserver_format.rmax);
+	vncserver_put16(vncserver_format.gmax);
+	vncserver_put16(vncserver_format.bmax);
+	vncserver_put8(vncserver_format.rshift);
+	vncserver_put8(vncserver_format.gshift);
+	vncserver_put8(vncserver_format.bshift);
+	vncserver_put8(0);
+	vncserver_put16(0);
+	vncserver_put32((uint32_t)strlen(name));
+	memcpy(vncserver_out + vncserver_outlen, name, strlen(name));
+	vncserver_outlen += (uint32_t)strlen(name);
+	return vncserver_send(vncserver_out, vncserver_outlen);
+}
+
+void vncserver_disconnect() {
+	vncserver_connected = 0;
+	closesocket(vncserver_client);
+	vncserver_client = INVALID_SOCKET;
+	debug_log(DEBUG_INFO, "[VNC] Viewer disconnected\r\n");
+}
+
+void vncserver_thread(void* dummy) {
+	fd_set fds;
+	struct timeval tv;
+	SOCKET sock;
+	int nodelay = 1;
+
+	while (running) {
+		if (vncserver_client == INVALID_SOCKET) {
+			FD_ZERO(&fds);
+			FD_SET(vncserver_listen, &fds);
+			tv.tv_sec = 0;
+			tv.tv_usec = 100000;
+			if (select((int)vncserver_listen + 1, &fds, NULL, NULL, &tv) <= 0) continue;
+			sock = accept(vncserver_listen, NULL, NULL);
+			if (sock == INVALID_SOCKET) continue;
+			setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (char*)&nodelay, sizeof(nodelay));
+			vncserver_client = sock;
+			vncserver_hextile = vncserver_desktopsize = vncserver_requested = vncserver_buttons = vncserver_mouseknown = 0;
+			vncserver_full = 1;
+			vncserver_lastseq = vncserver_seq - 1;
+			vncserver_connected = 1; //frames start coming in from here on
+			if (vncserver_handshake()) {
+				vncserver_disconnect();
+				continue;
+			}
+			debug_log(DEBUG_INFO, "[VNC] Viewer connected\r\n");
+			continue;
+		}
+
+		FD_ZERO(&fds);
+		FD_SET(vncserver_client, &fds);
+		tv.tv_sec = 0;
+		tv.tv_usec = VNCSERVER_POLL_MS * 1000;
+		if (select((int)vncserver_client + 1, &fds, NULL, NULL, &tv) > 0) {
+			if (vncserver_message()) {
+				vncserver_disconnect();
+				continue;
+			}
+		}
+		if (vncserver_requested && vncserver_update()) {
+			vncserver_disconnect();
+		}
+	}
+#ifdef _WIN32
+	_endthread();
+#else
+	pthread_exit(NULL);
+#endif
+}
+
+int vncserver_init(uint16_t port) {
+#ifdef _WIN32
+	WSADATA wsa;
+#else
+	pthread_t threadID;
+#endif
+	struct sockaddr_in addr;
+	int reuse = 1;
+
+#ifdef _WIN32
+	WSAStartup(MAKEWORD(2, 2), &wsa);
+#endif
+
+	vncserver_shared = (uint32_t*)malloc(VNCSERVER_MAXW * VNCSERVER_MAXH * 4);
+	vncserver_cur = (uint32_t*)calloc(VNCSERVER_MAXW * VNCSERVER_MAXH, 4);
+	vncserver_prev = (uint32_t*)calloc(VNCSERVER_MAXW * VNCSERVER_MAXH, 4);
+	vncserver_out = (uint8_t*)malloc(VNCSERVER_OUTSIZE);
+	vncserver_mutex = SDL_CreateMutex();
+	if ((vncserver_shared == NULL) || (vncserver_cur == NULL) || (vncserver_prev == NULL) || (vncserver_out == NULL) || (vncserver_mutex == NULL)) {
+		debug_log(DEBUG_ERROR, "[VNC] Unable to allocate buffers\r\n");
+		return -1;
+	}
+
+	vncserver_listen = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (vncserver_listen == INVALID_SOCKET) {
+		debug_log(DEBUG_ERROR, "[VNC] Unable to create socket\r\n");
+		return -1;
+	}
+	setsockopt(vncserver_listen, SOL_SOCKET, SO_REUSEADDR, (char*)&reuse, sizeof(reuse));
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+	if ((bind(vncserver_listen, (struct sockaddr*)&addr, sizeof(addr)) != 0) || (listen(vncserver_listen, 1) != 0)) {
+		debug_log(DEBUG_ERROR, "[VNC] Unable to listen on port %u\r\n", port);
+		closesocket(vncserver_listen);
+		return -1;
+	}
+
+#ifdef _WIN32
+	_beginthread(vncserver_thread, 0, NULL);
+#else
+	pthread_create(&threadID, NULL, (void*)vncserver_thread, NULL);
+#endif
+
+	debug_log(DEBUG_INFO, "[VNC] Listening on 127.0.0.1:%u\r\n", port);
+	return 0;
+}
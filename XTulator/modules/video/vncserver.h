@@ -0,0 +1,33 @@
+#ifndef _VNCSERVER_H_
+#define _VNCSERVER_H_
+
+#include <stdint.h>
+
+#define VNCSERVER_MAXW			1024
+#define VNCSERVER_MAXH			1024
+#define VNCSERVER_TILE			16 //same as the hextile tile size, so a dirty tile goes out as one hextile tile
+#define VNCSERVER_TILESW		(VNCSERVER_MAXW / VNCSERVER_TILE)
+#define VNCSERVER_TILESH		(VNCSERVER_MAXH / VNCSERVER_TILE)
+#define VNCSERVER_OUTSIZE		(VNCSERVER_MAXW * VNCSERVER_MAXH * 4 + VNCSERVER_TILESW * VNCSERVER_TILESH * 16 + 64)
+#define VNCSERVER_POLL_MS		10 //longest the server thread waits on the client before looking for a new frame
+
+#define VNCSERVER_ENC_RAW			0
+#define VNCSERVER_ENC_HEXTILE		5
+#define VNCSERVER_ENC_DESKTOPSIZE	-223
+
+typedef struct {
+	uint8_t bpp;
+	uint8_t depth;
+	uint8_t bigendian;
+	uint8_t truecolor;
+	uint16_t rmax, gmax, bmax;
+	uint8_t rshift, gshift, bshift;
+} VNCFORMAT_t;
+
+int vncserver_init(uint16_t port);
+void vncserver_blit(uint32_t* pixels, int w, int h, int stride);
+
+extern uint16_t vncserver_port;
+extern volatile uint8_t vncserver_connected;
+
+#endif
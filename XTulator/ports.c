@@ -34,35 +34,32 @@
 #include "modules/video/cga.h"
 #include "modules/video/vga.h"
 
-uint8_t (*ports_cbReadB[PORTS_COUNT])(void* udata, uint32_t portnum);
-uint16_t (*ports_cbReadW[PORTS_COUNT])(void* udata, uint32_t portnum);
-void (*ports_cbWriteB[PORTS_COUNT])(void* udata, uint32_t portnum, uint8_t value);
-void (*ports_cbWriteW[PORTS_COUNT])(void* udata, uint32_t portnum, uint16_t value);
-void* ports_udata[PORTS_COUNT];
-
-extern MACHINE_t machine;
+THREADLOCAL PORTS_t* ports_cur = NULL; //handler tables of the machine this thread is running
 
 void port_write(CPU_t* cpu, uint16_t portnum, uint8_t value) {
+	PORTHANDLER_t* handler;
 #ifdef DEBUG_PORTS
 	debug_log(DEBUG_DETAIL, "port_write @ %03X <- %02X\r\n", portnum, value);
 #endif
 	portnum &= 0x0FFF;
-	if (portnum == 0x80) {
-		debug_log(DEBUG_DETAIL, "Diagnostic port out: %02X\r\n", value);
+	handler = &ports_cur->handler[portnum];
+	if (handler->trace != NULL) {
+		(*handler->trace)(ports_cur->traceudata[portnum], portnum, value, PORTS_TRACE_WRITE);
 	}
-	if (ports_cbWriteB[portnum] != NULL) {
-		(*ports_cbWriteB[portnum])(ports_udata[portnum], portnum, value);
-		return;
+	if (handler->writeb != NULL) {
+		(*handler->writeb)(handler->udata, portnum, value);
 	}
 }
 
 void port_writew(CPU_t* cpu, uint16_t portnum, uint16_t value) {
+	PORTHANDLER_t* handler;
 	portnum &= 0x0FFF;
-	if (portnum == 0x80) {
-		debug_log(DEBUG_DETAIL, "Diagnostic port out: %04X\r\n", value);
-	}
-	if (ports_cbWriteW[portnum] != NULL) {
-		(*ports_cbWriteW[portnum])(ports_udata[portnum], portnum, value);
+	handler = &ports_cur->handler[portnum];
+	if (handler->writew != NULL) {
+		if (handler->trace != NULL) {
+			(*handler->trace)(ports_cur->traceudata[portnum], portnum, value, PORTS_TRACE_WRITE | PORTS_TRACE_WORD);
+		}
+		(*handler->writew)(handler->udata, portnum, value);
 		return;
 	}
 	port_write(cpu, portnum, (uint8_t)value);
@@ -70,49 +67,143 @@ void port_writew(CPU_t* cpu, uint16_t portnum, uint16_t value) {
 }
 
 uint8_t port_read(CPU_t* cpu, uint16_t portnum) {
+	PORTHANDLER_t* handler;
+	uint8_t ret = 0xFF;
 #ifdef DEBUG_PORTS
 	debug_log(DEBUG_DETAIL, "port_read @ %03X\r\n", portnum);
 #endif
 	portnum &= 0x0FFF;
-	if (ports_cbReadB[portnum] != NULL) {
-		return (*ports_cbReadB[portnum])(ports_udata[portnum], portnum);
+	handler = &ports_cur->handler[portnum];
+	if (handler->readb != NULL) {
+		ret = (*handler->readb)(handler->udata, portnum);
 	}
-
-	return 0xFF;
+	if (handler->trace != NULL) {
+		(*handler->trace)(ports_cur->traceudata[portnum], portnum, ret, PORTS_TRACE_READ);
+	}
+	return ret;
 }
 
 uint16_t port_readw(CPU_t* cpu, uint16_t portnum) {
+	PORTHANDLER_t* handler;
 	uint16_t ret;
 	portnum &= 0x0FFF;
-	if (ports_cbReadW[portnum] != NULL) {
-		return (*ports_cbReadW[portnum])(ports_udata[portnum], portnum);
+	handler = &ports_cur->handler[portnum];
+	if (handler->readw != NULL) {
+		ret = (*handler->readw)(handler->udata, portnum);
+		if (handler->trace != NULL) {
+			(*handler->trace)(ports_cur->traceudata[portnum], portnum, ret, PORTS_TRACE_READ | PORTS_TRACE_WORD);
+		}
+		return ret;
 	}
 	ret = port_read(cpu, portnum);
 	ret |= (uint16_t)port_read(cpu, portnum + 1) << 8;
 	return ret;
 }
 
+//Reads "count" words from one port, in a single call if the device can take them that way
+void port_readsw(CPU_t* cpu, uint16_t portnum, uint16_t* data, uint32_t count) {
+	PORTHANDLER_t* handler;
+	uint32_t i;
+	portnum &= 0x0FFF;
+	handler = &ports_cur->handler[portnum];
+	if ((handler->readsw != NULL) && (handler->trace == NULL)) {
+		(*handler->readsw)(handler->udata, portnum, data, count);
+		return;
+	}
+	for (i = 0; i < count; i++) {
+		data[i] = port_readw(cpu, portnum);
+	}
+}
+
+void port_writesw(CPU_t* cpu, uint16_t portnum, const uint16_t* data, uint32_t count) {
+	PORTHANDLER_t* handler;
+	uint32_t i;
+	portnum &= 0x0FFF;
+	handler = &ports_cur->handler[portnum];
+	if ((handler->writesw != NULL) && (handler->trace == NULL)) {
+		(*handler->writesw)(handler->udata, portnum, data, count);
+		return;
+	}
+	for (i = 0; i < count; i++) {
+		port_writew(cpu, portnum, data[i]);
+	}
+}
+
 void ports_cbRegister(uint32_t start, uint32_t count, uint8_t (*readb)(void*, uint32_t), uint16_t (*readw)(void*, uint32_t), void (*writeb)(void*, uint32_t, uint8_t), void (*writew)(void*, uint32_t, uint16_t), void* udata) {
 	uint32_t i;
 	for (i = 0; i < count; i++) {
 		if ((start + i) >= PORTS_COUNT) {
 			break;
 		}
-		ports_cbReadB[start + i] = readb;
-		ports_cbReadW[start + i] = readw;
-		ports_cbWriteB[start + i] = writeb;
-		ports_cbWriteW[start + i] = writew;
-		ports_udata[start + i] = udata;
+		ports_cur->handler[start + i].readb = readb;
+		ports_cur->handler[start + i].readw = readw;
+		ports_cur->handler[start + i].writeb = writeb;
+		ports_cur->handler[start + i].writew = writew;
+		ports_cur->handler[start + i].readsw = NULL;
+		ports_cur->handler[start + i].writesw = NULL;
+		ports_cur->handler[start + i].udata = udata;
+	}
+}
+
+//Adds block handlers to ports already registered with ports_cbRegister, they get the same udata
+void ports_cbRegisterBlock(uint32_t start, uint32_t count, void (*readsw)(void*, uint32_t, uint16_t*, uint32_t), void (*writesw)(void*, uint32_t, const uint16_t*, uint32_t)) {
+	uint32_t i;
+	for (i = 0; i < count; i++) {
+		if ((start + i) >= PORTS_COUNT) {
+			break;
+		}
+		ports_cur->handler[start + i].readsw = readsw;
+		ports_cur->handler[start + i].writesw = writesw;
+	}
+}
+
+/*
+	Marks ports whose value is worked out from the current time instead of changing on timer
+	events or writes, like retrace status or the refresh bit. A guest reading the same value
+	from one of them over and over is waiting for an edge that comes without a timer event,
+	so it isn't counted as idle polling, see cpu_pollCheck.
+*/
+void ports_setTimed(uint32_t start, uint32_t count) {
+	uint32_t i;
+	for (i = 0; i < count; i++) {
+		if ((start + i) >= PORTS_COUNT) {
+			break;
+		}
+		ports_cur->timed[start + i] = 1;
 	}
 }
 
-void ports_init() {
+uint8_t ports_isTimed(uint16_t portnum) {
+	return ports_cur->timed[portnum & 0x0FFF];
+}
+
+//Hooks every access to a range of ports, on top of whatever device owns them. NULL unhooks them again.
+void ports_setTrace(uint32_t start, uint32_t count, void (*trace)(void*, uint32_t, uint16_t, uint8_t), void* udata) {
 	uint32_t i;
-	for (i = 0; i < PORTS_COUNT; i++) {
-		ports_cbReadB[i] = NULL;
-		ports_cbReadW[i] = NULL;
-		ports_cbWriteB[i] = NULL;
-		ports_cbWriteW[i] = NULL;
-		ports_udata[i] = NULL;
+	for (i = 0; i < count; i++) {
+		if ((start + i) >= PORTS_COUNT) {
+			break;
+		}
+		ports_cur->handler[start + i].trace = trace;
+		ports_cur->traceudata[start + i] = udata;
+	}
+}
+
+//Logs BIOS POST codes written to the diagnostic port, see -postcodes
+void ports_tracePOST(void* dummy, uint32_t portnum, uint16_t value, uint8_t flags) {
+	if (!(flags & PORTS_TRACE_WRITE)) return;
+	if (flags & PORTS_TRACE_WORD) {
+		debug_log(DEBUG_INFO, "Diagnostic port out: %04X\r\n", value);
 	}
+	else {
+		debug_log(DEBUG_INFO, "Diagnostic port out: %02X\r\n", value);
+	}
+}
+
+void ports_select(PORTS_t* ports) {
+	ports_cur = ports;
+}
+
+void ports_init(PORTS_t* ports) {
+	memset(ports, 0, sizeof(PORTS_t));
 }
@@ -5,13 +5,35 @@
 
 #define PORTS_COUNT 0x1000
 
-extern uint8_t(*ports_cbReadB[PORTS_COUNT])(void* udata, uint32_t portnum);
-extern uint16_t(*ports_cbReadW[PORTS_COUNT])(void* udata, uint32_t portnum);
-extern void (*ports_cbWriteB[PORTS_COUNT])(void* udata, uint32_t portnum, uint8_t value);
-extern void (*ports_cbWriteW[PORTS_COUNT])(void* udata, uint32_t portnum, uint16_t value);
-extern void* ports_udata[PORTS_COUNT];
+#define PORTS_TRACE_READ	0x00
+#define PORTS_TRACE_WRITE	0x01
+#define PORTS_TRACE_WORD	0x02
+
+//Everything a port lookup needs sits in one entry, 64 bytes with 64-bit pointers
+typedef struct {
+	uint8_t (*readb)(void* udata, uint32_t portnum);
+	uint16_t (*readw)(void* udata, uint32_t portnum);
+	void (*writeb)(void* udata, uint32_t portnum, uint8_t value);
+	void (*writew)(void* udata, uint32_t portnum, uint16_t value);
+	void (*readsw)(void* udata, uint32_t portnum, uint16_t* data, uint32_t count); //optional, whole REP INSW blocks at once
+	void (*writesw)(void* udata, uint32_t portnum, const uint16_t* data, uint32_t count); //optional, whole REP OUTSW blocks at once
+	void* udata;
+	void (*trace)(void* udata, uint32_t portnum, uint16_t value, uint8_t flags); //optional, sees every access, gets the port's traceudata
+} PORTHANDLER_t;
+
+typedef struct {
+	PORTHANDLER_t handler[PORTS_COUNT];
+	void* traceudata[PORTS_COUNT]; //kept out of PORTHANDLER_t, only looked at when a trace is set
+	uint8_t timed[PORTS_COUNT]; //value follows the clock between timer events, see ports_setTimed
+} PORTS_t;
 
 void ports_cbRegister(uint32_t start, uint32_t count, uint8_t(*readb)(void*, uint32_t), uint16_t(*readw)(void*, uint32_t), void (*writeb)(void*, uint32_t, uint8_t), void (*writew)(void*, uint32_t, uint16_t), void* udata);
-void ports_init();
+void ports_cbRegisterBlock(uint32_t start, uint32_t count, void (*readsw)(void*, uint32_t, uint16_t*, uint32_t), void (*writesw)(void*, uint32_t, const uint16_t*, uint32_t));
+void ports_setTimed(uint32_t start, uint32_t count);
+uint8_t ports_isTimed(uint16_t portnum);
+void ports_setTrace(uint32_t start, uint32_t count, void (*trace)(void*, uint32_t, uint16_t, uint8_t), void* udata);
+void ports_tracePOST(void* dummy, uint32_t portnum, uint16_t value, uint8_t flags);
+void ports_select(PORTS_t* ports);
+void ports_init(PORTS_t* ports);
 
 #endif
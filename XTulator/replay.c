@@ -0,0 +1,380 @@
+/*
+  XTulator: A portable, open-source 80186 PC emulator.
+  Copyright (C)2020 Mike Chambers
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+	Deterministic record/replay
+
+	While recording or replaying, the timing module runs off the guest instruction count
+	instead of the host clock, so every timer fires at the same point in guest execution
+	on every run. What's left that can differ between runs is outside input: keyboard,
+	mouse, network frames and RTC reads. Those get written to the log, stamped with the
+	instruction count they were delivered at, and fed back in at the same count on replay.
+
+	Log layout, all integers are LEB128 varints (signed ones zigzag encoded):
+
+	  "XTRP" version ips instructionsperloop videocard ramsize machine-id
+	  4 x disk: inserted [size hash64]
+	  events: delta-count type payload ...
+
+	The header is followed by a stream of events until an END event or end of file.
+	Each event's count is stored as a delta from the previous event.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "config.h"
+#include "timing.h"
+#include "machine.h"
+#include "replay.h"
+#include "debuglog.h"
+#include "chipset/i8255.h"
+#include "modules/input/mouse.h"
+#include "modules/disk/biosdisk.h"
+
+uint8_t replay_mode = REPLAY_MODE_OFF;
+
+FILE* replay_file = NULL;
+uint8_t replay_buf[REPLAY_BUFFER];
+uint32_t replay_bufpos = 0, replay_buflen = 0;
+volatile uint64_t* replay_counter = NULL;
+uint64_t replay_last = 0, replay_ips = REPLAY_DEFAULT_IPS;
+uint64_t replay_nextcount = 0;
+uint8_t replay_nexttype = REPLAY_EVENT_END;
+uint32_t replay_flushTimer;
+
+void replay_flush() {
+	if (replay_bufpos > 0) {
+		fwrite(replay_buf, 1, replay_bufpos, replay_file);
+		replay_bufpos = 0;
+	}
+	fflush(replay_file);
+}
+
+void replay_flushCallback(void* dummy) {
+	replay_flush();
+}
+
+void replay_putByte(uint8_t value) {
+	if (replay_bufpos == REPLAY_BUFFER) {
+		fwrite(replay_buf, 1, REPLAY_BUFFER, replay_file);
+		replay_bufpos = 0;
+	}
+	replay_buf[replay_bufpos++] = value;
+}
+
+void replay_putVarint(uint64_t value) {
+	while (value >= 0x80) {
+		replay_putByte((uint8_t)value | 0x80);
+		value >>= 7;
+	}
+	replay_putByte((uint8_t)value);
+}
+
+void replay_putSigned(int64_t value) {
+	replay_putVarint(((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+int replay_getByte() {
+	if (replay_bufpos == replay_buflen) {
+		replay_buflen = (uint32_t)fread(replay_buf, 1, REPLAY_BUFFER, replay_file);
+		replay_bufpos = 0;
+		if (replay_buflen == 0) return -1;
+	}
+	return replay_buf[replay_bufpos++];
+}
+
+uint64_t replay_getVarint() {
+	uint64_t ret = 0;
+	uint8_t shift = 0;
+	int value;
+
+	do {
+		value = replay_getByte();
+		if (value < 0) return 0;
+		ret |= (uint64_t)(value & 0x7F) << shift;
+		shift += 7;
+	} while ((value & 0x80) && (shift < 64));
+	return ret;
+}
+
+int64_t replay_getSigned() {
+	uint64_t value;
+	value = replay_getVarint();
+	return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+//FNV-1a over the whole image, so a replay can tell if it's been handed different disk contents
+uint64_t replay_hashDisk(FILE* file) {
+	uint8_t chunk[4096];
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	size_t len, i;
+	long pos;
+
+	pos = ftell(file);
+	fseek(file, 0L, SEEK_SET);
+	while ((len = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+		for (i = 0; i < len; i++) {
+			hash = (hash ^ chunk[i]) * 0x100000001B3ULL;
+		}
+	}
+	fseek(file, pos, SEEK_SET);
+	return hash;
+}
+
+void replay_startEvent(uint8_t type) {
+	uint64_t count;
+
+	count = *replay_counter;
+	replay_putVarint(count - replay_last);
+	replay_putByte(type);
+	replay_last = count;
+}
+
+void replay_fetch() {
+	int type;
+
+	replay_nextcount = replay_last + replay_getVarint();
+	type = replay_getByte();
+	replay_nexttype = (type < 0) ? REPLAY_EVENT_END : (uint8_t)type;
+	replay_last = replay_nextcount;
+}
+
+void replay_stop(char* reason) {
+	debug_log(DEBUG_INFO, "[REPLAY] %s, live input takes over from here\r\n", reason);
+	replay_mode = REPLAY_MODE_OFF;
+	fclose(replay_file);
+	replay_file = NULL;
+	timing_timerDisable(replay_flushTimer);
+	timing_paceStart(replay_counter, replay_ips); //live from here on, so run in real time
+}
+
+/*
+	Called while parsing the command line, before any devices are initialized, so that
+	everything is set up against the instruction count clock right from the start.
+*/
+int replay_open(MACHINE_t* machine, uint8_t mode, char* filename) {
+	replay_file = fopen(filename, (mode == REPLAY_MODE_RECORD) ? "wb" : "rb");
+	if (replay_file == NULL) {
+		debug_log(DEBUG_ERROR, "[REPLAY] Unable to open %s\r\n", filename);
+		return -1;
+	}
+	debug_log(DEBUG_INFO, "[REPLAY] %s %s\r\n", (mode == REPLAY_MODE_RECORD) ? "Recording to" : "Replaying from", filename);
+
+	replay_mode = mode;
+	replay_counter = &machine->CPU.clock;
+	timing_setInstructionClock(replay_counter);
+	replay_flushTimer = timing_addTimer(replay_flushCallback, NULL, 1, (mode == REPLAY_MODE_RECORD) ? TIMING_ENABLED : TIMING_DISABLED);
+	return 0;
+}
+
+/*
+	Called once the machine is fully set up. Writes or checks the header, then pins the
+	number of instructions per loop since interrupts are only checked between loops.
+*/
+int replay_begin(MACHINE_t* machine, uint32_t* instructionsperloop) {
+	char magic[4], id[64];
+	uint64_t len, size, hash, j;
+	uint8_t i, inserted;
+
+	if (replay_mode == REPLAY_MODE_RECORD) {
+		if (speed > 0) {
+			replay_ips = (uint64_t)(*instructionsperloop) * 10000;
+		}
+		fwrite(REPLAY_MAGIC, 1, 4, replay_file);
+		replay_putVarint(REPLAY_VERSION);
+		replay_putVarint(replay_ips);
+		replay_putVarint(*instructionsperloop);
+		replay_putByte(machine->videocard);
+		replay_putVarint(ramsize);
+		len = strlen(usemachine);
+		replay_putVarint(len);
+		for (j = 0; j < len; j++) {
+			replay_putByte((uint8_t)usemachine[j]);
+		}
+		for (i = 0; i < 4; i++) {
+			replay_putByte(machine->biosdisk.disk[i].inserted);
+			if (machine->biosdisk.disk[i].inserted) {
+				replay_putVarint(machine->biosdisk.disk[i].filesize);
+				hash = replay_hashDisk(machine->biosdisk.disk[i].diskfile);
+				for (j = 0; j < 8; j++) {
+					replay_putByte((uint8_t)(hash >> (j * 8)));
+				}
+			}
+		}
+		replay_flush();
+	}
+	else {
+		if ((fread(magic, 1, 4, replay_file) != 4) || memcmp(magic, REPLAY_MAGIC, 4)) {
+			debug_log(DEBUG_ERROR, "[REPLAY] This is not a replay log\r\n");
+			return -1;
+		}
+		if (replay_getVarint() != REPLAY_VERSION) {
+			debug_log(DEBUG_ERROR, "[REPLAY] Unsupported replay log version\r\n");
+			return -1;
+		}
+		replay_ips = replay_getVarint();
+		*instructionsperloop = (uint32_t)replay_getVarint();
+		if (((uint8_t)replay_getByte() != machine->videocard) || (replay_getVarint() != ramsize)) {
+			debug_log(DEBUG_ERROR, "[REPLAY] Log was recorded with a different video card or memory size\r\n");
+			return -1;
+		}
+		len = replay_getVarint();
+		for (j = 0; j < len; j++) {
+			id[(j < 63) ? j : 63] = (char)replay_getByte();
+		}
+		id[(len < 63) ? len : 63] = 0;
+		if (strcmp(id, usemachine)) {
+			debug_log(DEBUG_ERROR, "[REPLAY] Log was recorded on machine %s\r\n", id);
+			return -1;
+		}
+		for (i = 0; i < 4; i++) {
+			inserted = (uint8_t)replay_getByte();
+			if (inserted != machine->biosdisk.disk[i].inserted) {
+				debug_log(DEBUG_ERROR, "[REPLAY] Log was recorded with a different set of disks\r\n");
+				return -1;
+			}
+			if (inserted) {
+				size = replay_getVarint();
+				hash = 0;
+				for (j = 0; j < 8; j++) {
+					hash |= (uint64_t)replay_getByte() << (j * 8);
+				}
+				if ((size != machine->biosdisk.disk[i].filesize) || (hash != replay_hashDisk(machine->biosdisk.disk[i].diskfile))) {
+					debug_log(DEBUG_ERROR, "[REPLAY] Disk %u image contents differ from the recording\r\n", i);
+					return -1;
+				}
+			}
+		}
+		replay_fetch();
+	}
+
+	timing_setInstructionRate(replay_ips);
+	timing_paceStart(replay_counter, (replay_mode == REPLAY_MODE_RECORD) ? replay_ips : 0); //a recording session runs at the guest's virtual speed, a replay flat out
+	debug_log(DEBUG_INFO, "[REPLAY] Guest time runs at %llu instructions per second, %lu per loop\r\n", replay_ips, *instructionsperloop);
+	return 0;
+}
+
+void replay_close() {
+	if (replay_file == NULL) return;
+	if (replay_mode == REPLAY_MODE_RECORD) {
+		replay_startEvent(REPLAY_EVENT_END);
+		replay_flush();
+	}
+	fclose(replay_file);
+	replay_file = NULL;
+	replay_mode = REPLAY_MODE_OFF;
+}
+
+//Delivers every logged input that is due at the current instruction count
+void replay_poll(MACHINE_t* machine) {
+	uint8_t data[2048];
+	uint64_t len, i;
+	uint8_t action, state;
+	int32_t xrel, yrel;
+
+	while ((replay_mode == REPLAY_MODE_PLAY) && (replay_nextcount <= *replay_counter)) {
+		if (replay_nextcount != *replay_counter) {
+			replay_stop("Replay went out of sync");
+			return;
+		}
+		switch (replay_nexttype) {
+		case REPLAY_EVENT_KEY:
+			i8255_keyPush(&machine->i8255, (uint8_t)replay_getByte());
+			break;
+		case REPLAY_EVENT_MOUSE:
+			action = (uint8_t)replay_getByte();
+			state = (uint8_t)replay_getByte();
+			xrel = (int32_t)replay_getSigned();
+			yrel = (int32_t)replay_getSigned();
+			mouse_queueAction(action, state, xrel, yrel);
+			break;
+		case REPLAY_EVENT_NET:
+			len = replay_getVarint();
+			for (i = 0; i < len; i++) {
+				data[(i < sizeof(data)) ? i : (sizeof(data) - 1)] = (uint8_t)replay_getByte();
+			}
+#ifdef USE_NE2000
+			if (machine->hwflags & MACHINE_HW_NE2000) {
+				ne2000_rx_frame(&machine->ne2000, data, (int)((len < sizeof(data)) ? len : sizeof(data)));
+			}
+#endif
+			break;
+		case REPLAY_EVENT_RTC: //these are consumed by replay_rtc, hitting one here means the guest didn't read it
+			replay_stop("Replay went out of sync");
+			return;
+		default:
+			replay_stop("End of replay log");
+			return;
+		}
+		replay_fetch();
+	}
+}
+
+//Instruction count of the next logged event, an idle guest mustn't be skipped past it
+uint64_t replay_nextEvent() {
+	if ((replay_mode != REPLAY_MODE_PLAY) || (replay_nexttype == REPLAY_EVENT_END)) {
+		return 0xFFFFFFFFFFFFFFFFULL;
+	}
+	return replay_nextcount;
+}
+
+void replay_logKey(uint8_t scancode) {
+	if (replay_mode != REPLAY_MODE_RECORD) return;
+	replay_startEvent(REPLAY_EVENT_KEY);
+	replay_putByte(scancode);
+}
+
+void replay_logMouse(uint8_t action, uint8_t state, int32_t xrel, int32_t yrel) {
+	if (replay_mode != REPLAY_MODE_RECORD) return;
+	replay_startEvent(REPLAY_EVENT_MOUSE);
+	replay_putByte(action);
+	replay_putByte(state);
+	replay_putSigned(xrel);
+	replay_putSigned(yrel);
+}
+
+void replay_logNet(const uint8_t* data, uint32_t len) {
+	uint32_t i;
+
+	if (replay_mode != REPLAY_MODE_RECORD) return;
+	replay_startEvent(REPLAY_EVENT_NET);
+	replay_putVarint(len);
+	for (i = 0; i < len; i++) {
+		replay_putByte(data[i]);
+	}
+}
+
+//Passes an RTC read through the log: records the host's answer, or substitutes the recorded one
+uint8_t replay_rtc(uint8_t addr, uint8_t value) {
+	if (replay_mode == REPLAY_MODE_RECORD) {
+		replay_startEvent(REPLAY_EVENT_RTC);
+		replay_putByte(addr);
+		replay_putByte(value);
+	}
+	else if (replay_mode == REPLAY_MODE_PLAY) {
+		if ((replay_nexttype != REPLAY_EVENT_RTC) || (replay_nextcount != *replay_counter) || ((uint8_t)replay_getByte() != addr)) {
+			replay_stop("Replay went out of sync");
+			return value;
+		}
+		value = (uint8_t)replay_getByte();
+		replay_fetch();
+	}
+	return value;
+}
@@ -0,0 +1,34 @@
+#ifndef _REPLAY_H_
+#define _REPLAY_H_
+
+#include <stdint.h>
+#include "machine.h"
+
+#define REPLAY_MODE_OFF		0
+#define REPLAY_MODE_RECORD	1
+#define REPLAY_MODE_PLAY	2
+
+#define REPLAY_EVENT_END	0
+#define REPLAY_EVENT_KEY	1
+#define REPLAY_EVENT_MOUSE	2
+#define REPLAY_EVENT_NET	3
+#define REPLAY_EVENT_RTC	4
+
+#define REPLAY_MAGIC		"XTRP"
+#define REPLAY_VERSION		3
+#define REPLAY_BUFFER		65536
+#define REPLAY_DEFAULT_IPS	10000000 //virtual instructions per second when no -speed is given
+
+int replay_open(MACHINE_t* machine, uint8_t mode, char* filename);
+int replay_begin(MACHINE_t* machine, uint32_t* instructionsperloop);
+void replay_close();
+void replay_poll(MACHINE_t* machine);
+uint64_t replay_nextEvent();
+void replay_logKey(uint8_t scancode);
+void replay_logMouse(uint8_t action, uint8_t state, int32_t xrel, int32_t yrel);
+void replay_logNet(const uint8_t* data, uint32_t len);
+uint8_t replay_rtc(uint8_t addr, uint8_t value);
+
+extern uint8_t replay_mode;
+
+#endif
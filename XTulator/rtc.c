@@ -27,12 +27,13 @@
 #include "config.h"
 #include "ports.h"
 #include "debuglog.h"
+#include "replay.h"
 
 #ifdef _WIN32
 
 #include <Windows.h>
 
-uint8_t rtc_read(void* dummy, uint16_t addr) {
+uint8_t rtc_readHost(uint16_t addr) {
 	uint8_t ret = 0xFF;
 	SYSTEMTIME tdata;
 
@@ -80,7 +81,7 @@ uint8_t rtc_read(void* dummy, uint16_t addr) {
 
 #include <time.h>
 
-uint8_t rtc_read(void* dummy, uint16_t addr) {
+uint8_t rtc_readHost(uint16_t addr) {
 	uint8_t ret = 0xFF;
 	struct tm tdata;
 
@@ -126,6 +127,16 @@ uint8_t rtc_read(void* dummy, uint16_t addr) {
 
 #endif
 
+uint8_t rtc_read(void* dummy, uint16_t addr) {
+	uint8_t ret;
+
+	ret = rtc_readHost(addr);
+	if (replay_mode != REPLAY_MODE_OFF) {
+		ret = replay_rtc((uint8_t)(addr & 0x1F), ret);
+	}
+	return ret;
+}
+
 void rtc_write(void* dummy, uint16_t addr, uint8_t value) {
 
 }
@@ -0,0 +1,414 @@
+/*
+  XTulator: A portable, open-source 80186 PC emulator.
+  Copyright (C)2020 Mike Chambers
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+	Automation scripts
+
+	Drives the guest from a text file instead of a person at the keyboard. One command per line,
+	blank lines and anything after a # at the start of a line are ignored:
+
+	  type <text>               Type <text> as it's written. \n is Enter, \t is Tab, \\ is a backslash.
+	  key <name>[+<name>...]    Press a chord and let go in reverse order, e.g. key ctrl+alt+del
+	  wait <seconds> <text>     Wait until <text> shows up on the text mode screen. Gives up and
+	                            fails the script after <seconds> of guest time.
+	  sleep <ms>                Let <ms> milliseconds of guest time go by.
+	  quit                      Stop the emulator. Reaching the end of the script does the same.
+
+	Keys go in through the keyboard FIFO on the 8255, each one as soon as the last has been taken
+	and the BIOS type-ahead buffer has room for it, so typing is as quick as the guest can cope with.
+
+	Waits don't scan the screen over and over. The video card reports which text rows get
+	written, and only those rows are searched again. Text that a wait is looking for has to fit
+	on one row. Rows that already held the text when the wait started don't count, even if they
+	scroll, for as long as everything up to the end of the text stays the same. Only text that
+	shows up after that does, so wait for something the command you typed doesn't say itself.
+
+	Everything runs off guest timers on the emulation thread, so on the instruction count clock
+	(-record/-replay) a script does the same thing on every run.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "args.h"
+#include "machine.h"
+#include "memory.h"
+#include "timing.h"
+#include "script.h"
+#include "debuglog.h"
+#include "chipset/i8255.h"
+#include "modules/input/input.h"
+#include "modules/video/cga.h"
+#include "modules/video/vga.h"
+
+char* script_file = NULL;
+int script_result = 0;
+
+MACHINE_t* script_machine = NULL;
+char** script_lines = NULL;
+uint32_t script_count = 0, script_pos = 0, script_timer;
+uint8_t script_state = SCRIPT_STATE_RUN;
+uint64_t script_deadline, script_dirty = 0;
+char* script_needle;
+char script_seen[SCRIPT_ROWS][SCRIPT_ROWLEN]; //each row's text up to the end of an old match
+uint64_t script_old = 0; //rows whose script_seen entry is still on screen
+
+uint8_t script_keys[SCRIPT_KEYQUEUE];
+uint32_t script_keyhead = 0, script_keylen = 0;
+
+const SCRIPTKEY_t script_keynames[] = {
+	{ "esc", 0x01 }, { "backspace", 0x0E }, { "tab", 0x0F }, { "enter", 0x1C }, { "ctrl", 0x1D },
+	{ "shift", 0x2A }, { "rshift", 0x36 }, { "alt", 0x38 }, { "space", 0x39 }, { "capslock", 0x3A },
+	{ "f1", 0x3B }, { "f2", 0x3C }, { "f3", 0x3D }, { "f4", 0x3E }, { "f5", 0x3F },
+	{ "f6", 0x40 }, { "f7", 0x41 }, { "f8", 0x42 }, { "f9", 0x43 }, { "f10", 0x44 },
+	{ "numlock", 0x45 }, { "scrolllock", 0x46 }, { "home", 0x47 }, { "up", 0x48 }, { "pgup", 0x49 },
+	{ "left", 0x4B }, { "right", 0x4D }, { "end", 0x4F }, { "down", 0x50 }, { "pgdn", 0x51 },
+	{ "ins", 0x52 }, { "del", 0x53 },
+	{ NULL, 0x00 }
+};
+
+void script_finish(int result) {
+	script_state = SCRIPT_STATE_DONE;
+	script_result = result;
+	running = 0;
+}
+
+int script_queueKey(uint8_t scancode) {
+	if (script_keylen == SCRIPT_KEYQUEUE) {
+		debug_log(DEBUG_ERROR, "[SCRIPT] Line %lu: too many keys queued at once\r\n", script_pos);
+		return -1;
+	}
+	script_keys[(script_keyhead + script_keylen) % SCRIPT_KEYQUEUE] = scancode;
+	script_keylen++;
+	return 0;
+}
+
+int script_typeChar(char c) {
+	uint8_t scancode, shift;
+
+	scancode = input_asciiScancode(c, &shift);
+	if (scancode == 0x00) {
+		debug_log(DEBUG_ERROR, "[SCRIPT] Line %lu: don't know how to type '%c'\r\n", script_pos, c);
+		return -1;
+	}
+	if (shift && script_queueKey(0x2A)) return -1;
+	if (script_queueKey(scancode) || script_queueKey(scancode | 0x80)) return -1;
+	if (shift && script_queueKey(0xAA)) return -1;
+	return 0;
+}
+
+int script_type(char* text) {
+	char c;
+
+	while (*text != 0) {
+		c = *text++;
+		if ((c == '\\') && (*text != 0)) {
+			c = *text++;
+			if (c == 'n') c = '\n';
+			else if (c == 't') c = '\t';
+		}
+		if (script_typeChar(c)) return -1;
+	}
+	return 0;
+}
+
+uint8_t script_findKey(char* name) {
+	uint32_t i;
+	uint8_t shift;
+
+	for (i = 0; script_keynames[i].name != NULL; i++) {
+		if (args_isMatch(name, script_keynames[i].name)) {
+			return script_keynames[i].scancode;
+		}
+	}
+	if (strlen(name) == 1) {
+		return input_asciiScancode(name[0], &shift);
+	}
+	return 0x00;
+}
+
+int script_chord(char* names) {
+	uint8_t chord[8];
+	uint8_t count = 0;
+	char* name;
+
+	for (name = strtok(names, "+"); name != NULL; name = strtok(NULL, "+")) {
+		if (count == sizeof(chord)) {
+			debug_log(DEBUG_ERROR, "[SCRIPT] Line %lu: chord has too many keys\r\n", script_pos);
+			return -1;
+		}
+		chord[count] = script_findKey(name);
+		if (chord[count] == 0x00) {
+			debug_log(DEBUG_ERROR, "[SCRIPT] Line %lu: unknown key %s\r\n", script_pos, name);
+			return -1;
+		}
+		if (script_queueKey(chord[count++])) return -1;
+	}
+	while (count > 0) {
+		if (script_queueKey(chord[--count] | 0x80)) return -1;
+	}
+	return 0;
+}
+
+//keystrokes still sitting in the BIOS type-ahead buffer, fixed at 40:1Eh to 40:3Dh on the XT
+uint8_t script_biosPending() {
+	uint8_t bda[4];
+	uint16_t head, tail;
+
+	memory_readBlock(0x41A, bda, 4);
+	head = (uint16_t)bda[0] | ((uint16_t)bda[1] << 8);
+	tail = (uint16_t)bda[2] | ((uint16_t)bda[3] << 8);
+	return (uint8_t)(((tail + 32 - head) % 32) / 2);
+}
+
+uint32_t script_textRow(uint32_t row, char* dst) {
+	uint32_t i, len;
+
+	if (script_machine->videocard == VIDEO_CARD_CGA) {
+		len = cga_textRow(&script_machine->cga, row, (uint8_t*)dst, NULL);
+	}
+	else {
+		len = vga_textRow(&script_machine->vga, row, (uint8_t*)dst, NULL);
+	}
+	for (i = 0; i < len; i++) {
+		if (dst[i] == 0) dst[i] = ' ';
+	}
+	dst[len] = 0;
+	return len;
+}
+
+//called by the video card whenever a character in a visible text row is written
+void script_textWrite(void* udata, uint32_t row) {
+	if (row < SCRIPT_ROWS) {
+		script_dirty |= (uint64_t)1 << row;
+	}
+}
+
+//how much of a row holding the text has to stay the same for it to still be old, 0 if it doesn't hold it
+uint32_t script_textPrefix(char* text) {
+	char* match;
+
+	match = strstr(text, script_needle);
+	if (match == NULL) return 0;
+	return (uint32_t)(match - text) + (uint32_t)strlen(script_needle);
+}
+
+//remembers every row that holds the text already, so a wait only ends on text that's new
+void script_textArm() {
+	char text[SCRIPT_ROWLEN];
+	uint32_t row, len;
+
+	script_old = 0;
+	for (row = 0; (row < SCRIPT_ROWS) && script_textRow(row, text); row++) {
+		len = script_textPrefix(text);
+		if (len > 0) {
+			memcpy(script_seen[row], text, len);
+			script_seen[row][len] = 0;
+			script_old |= (uint64_t)1 << row;
+		}
+	}
+	script_dirty = 0;
+}
+
+/*
+	Looks through the rows written since the last call. An old row that was written gives up what
+	it held, then every written row holding the text takes back one of those that still matches up
+	to the end of the text, wherever scrolling has moved it to. A written row that can't is new.
+	Whatever isn't taken back has gone from the screen and is forgotten.
+*/
+uint8_t script_textFound() {
+	char text[SCRIPT_ROWLEN];
+	char freed[SCRIPT_ROWS][SCRIPT_ROWLEN];
+	uint64_t dirty;
+	uint32_t row, i, len, count = 0;
+	uint8_t found = 0;
+
+	if (script_dirty == 0) return 0;
+	dirty = script_dirty;
+	script_dirty = 0;
+	for (row = 0; row < SCRIPT_ROWS; row++) {
+		if ((dirty & script_old) & ((uint64_t)1 << row)) {
+			strcpy(freed[count++], script_seen[row]);
+		}
+	}
+	script_old &= ~dirty;
+	for (row = 0; row < SCRIPT_ROWS; row++) {
+		if (!(dirty & ((uint64_t)1 << row)) || !script_textRow(row, text)) continue;
+		len = script_textPrefix(text);
+		if (len == 0) continue;
+		text[len] = 0;
+		for (i = 0; i < count; i++) {
+			if (strcmp(text, freed[i]) == 0) break;
+		}
+		if (i == count) {
+			found = 1;
+			continue;
+		}
+		strcpy(script_seen[row], text);
+		script_old |= (uint64_t)1 << row;
+		if (i != --count) memcpy(freed[i], freed[count], SCRIPT_ROWLEN); //taken, nobody else gets it
+	}
+	return found;
+}
+
+//runs the next command, returns -1 if the script can't go on
+int script_command() {
+	char *line, *cmd, *arg;
+	double seconds;
+
+	line = script_lines[script_pos++];
+	while ((*line == ' ') || (*line == '\t')) line++;
+	if ((*line == 0) || (*line == '#')) {
+		return 0;
+	}
+	cmd = line;
+	while ((*line != 0) && (*line != ' ') && (*line != '\t')) line++;
+	if (*line != 0) *line++ = 0;
+	arg = line;
+
+	if (args_isMatch(cmd, "type")) {
+		return script_type(arg);
+	}
+	else if (args_isMatch(cmd, "key")) {
+		return script_chord(arg);
+	}
+	else if (args_isMatch(cmd, "wait")) {
+		seconds = strtod(arg, &script_needle);
+		while (*script_needle == ' ') script_needle++;
+		if ((seconds <= 0) || (*script_needle == 0)) {
+			debug_log(DEBUG_ERROR, "[SCRIPT] Line %lu: expected wait <seconds> <text>\r\n", script_pos);
+			return -1;
+		}
+		script_deadline = timing_getCur() + (uint64_t)(seconds * (double)timing_getFreq());
+		script_state = SCRIPT_STATE_WAIT;
+		script_textArm();
+		return 0;
+	}
+	else if (args_isMatch(cmd, "sleep")) {
+		script_deadline = timing_getCur() + (strtoull(arg, NULL, 10) * timing_getFreq()) / 1000;
+		script_state = SCRIPT_STATE_SLEEP;
+		return 0;
+	}
+	else if (args_isMatch(cmd, "quit")) {
+		script_finish(0);
+		return 0;
+	}
+	debug_log(DEBUG_ERROR, "[SCRIPT] Line %lu: unknown command %s\r\n", script_pos, cmd);
+	return -1;
+}
+
+void script_step(void* dummy) {
+	KEYSTATE_t* keystate = &script_machine->KeyState;
+	uint64_t now;
+
+	while (script_state != SCRIPT_STATE_DONE) {
+		now = timing_getCur();
+		if (script_keylen > 0) {
+			//one at a time, and only once the last has gone through and the BIOS has somewhere to put it
+			if ((keystate->fifolen == 0) && !keystate->isNew &&
+				((script_keys[script_keyhead] & 0x80) || (script_biosPending() < SCRIPT_BIOSBUF - 1))) {
+				i8255_keyPush(&script_machine->i8255, script_keys[script_keyhead]);
+				script_keyhead = (script_keyhead + 1) % SCRIPT_KEYQUEUE;
+				script_keylen--;
+			}
+			timing_timerSchedule(script_timer, now + timing_getFreq() / I8255_KEY_RATE);
+			return;
+		}
+
+		switch (script_state) {
+		case SCRIPT_STATE_WAIT:
+			if (script_textFound()) {
+				debug_log(DEBUG_INFO, "[SCRIPT] Found \"%s\"\r\n", script_needle);
+				script_state = SCRIPT_STATE_RUN;
+				continue;
+			}
+			if (now >= script_deadline) {
+				debug_log(DEBUG_ERROR, "[SCRIPT] Line %lu: timed out waiting for \"%s\"\r\n", script_pos, script_needle);
+				script_finish(-1);
+				return;
+			}
+			timing_timerSchedule(script_timer, now + timing_getFreq() / SCRIPT_POLL_RATE);
+			return;
+		case SCRIPT_STATE_SLEEP:
+			if (now < script_deadline) {
+				timing_timerSchedule(script_timer, script_deadline);
+				return;
+			}
+			script_state = SCRIPT_STATE_RUN;
+			continue;
+		}
+
+		if (script_pos == script_count) {
+			debug_log(DEBUG_INFO, "[SCRIPT] Finished\r\n");
+			script_finish(0);
+			return;
+		}
+		if (script_command()) {
+			script_finish(-1);
+			return;
+		}
+	}
+}
+
+int script_begin(MACHINE_t* machine, char* filename) {
+	FILE* file;
+	char line[SCRIPT_LINELEN], **temp;
+	size_t len;
+
+	file = fopen(filename, "r");
+	if (file == NULL) {
+		debug_log(DEBUG_ERROR, "[SCRIPT] Unable to open script %s\r\n", filename);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), file) != NULL) {
+		len = strlen(line);
+		while ((len > 0) && ((line[len - 1] == '\r') || (line[len - 1] == '\n'))) {
+			line[--len] = 0;
+		}
+		temp = (char**)realloc(script_lines, sizeof(char*) * ((size_t)script_count + 1));
+		if (temp == NULL) {
+			debug_log(DEBUG_ERROR, "[SCRIPT] Out of memory reading script\r\n");
+			fclose(file);
+			return -1;
+		}
+		script_lines = temp;
+		script_lines[script_count] = (char*)malloc(len + 1);
+		if (script_lines[script_count] == NULL) {
+			debug_log(DEBUG_ERROR, "[SCRIPT] Out of memory reading script\r\n");
+			fclose(file);
+			return -1;
+		}
+		strcpy(script_lines[script_count++], line);
+	}
+	fclose(file);
+
+	script_machine = machine;
+	machine->cga.textcb = script_textWrite;
+	machine->vga.textcb = script_textWrite;
+	script_timer = timing_addTimerUsingInterval(script_step, NULL, 0, TIMING_DISABLED);
+	if (script_timer == TIMING_ERROR) {
+		return -1;
+	}
+	timing_timerSchedule(script_timer, timing_getCur());
+
+	debug_log(DEBUG_INFO, "[SCRIPT] Running %lu line script %s\r\n", script_count, filename);
+	return 0;
+}
@@ -0,0 +1,30 @@
+#ifndef _SCRIPT_H_
+#define _SCRIPT_H_
+
+#include <stdint.h>
+#include "machine.h"
+
+#define SCRIPT_LINELEN		1024
+#define SCRIPT_KEYQUEUE		1024 //scancodes waiting to be typed
+#define SCRIPT_POLL_RATE	100 //times a second the screen is checked while waiting for text, only if it changed
+#define SCRIPT_BIOSBUF		15 //keystrokes the BIOS type-ahead buffer at 40:1Eh holds
+#define SCRIPT_ROWS			64 //most text rows a wait looks at, one bit each in script_dirty
+#define SCRIPT_ROWLEN		256
+
+#define SCRIPT_STATE_RUN	0
+#define SCRIPT_STATE_WAIT	1
+#define SCRIPT_STATE_SLEEP	2
+#define SCRIPT_STATE_DONE	3
+
+typedef struct {
+	char* name;
+	uint8_t scancode;
+} SCRIPTKEY_t;
+
+int script_begin(MACHINE_t* machine, char* filename);
+void script_textWrite(void* udata, uint32_t row);
+
+extern char* script_file;
+extern int script_result;
+
+#endif
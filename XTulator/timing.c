@@ -20,53 +20,60 @@
 #ifdef _WIN32
 #include <Windows.h>
 #else
-#include <sys/time.h>
+#include <time.h>
+#include <errno.h>
+#include <sched.h>
 #endif
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include "config.h"
 #include "timing.h"
 #include "debuglog.h"
 
-uint64_t timing_cur;
-uint64_t timing_freq;
-TIMER* timers = NULL;
-uint32_t timers_count = 0;
+uint64_t timing_hostfreq = 0;
+THREADLOCAL TIMING_t* timing_cur = NULL; //timers and time base of the machine this thread is running
 
-int timing_init() {
+int timing_init(TIMING_t* timing) {
 #ifdef _WIN32
 	LARGE_INTEGER freq;
 	//TODO: error handling
 	QueryPerformanceFrequency(&freq);
-	timing_freq = (uint64_t)freq.QuadPart;
+	timing_hostfreq = (uint64_t)freq.QuadPart;
 #else
-	timing_freq = 1000000;
+	timing_hostfreq = 1000000000;
 #endif
+	memset(timing, 0, sizeof(TIMING_t));
+	timing->freq = timing_hostfreq;
+	timing->instrRate = 1;
 	return 0;
 }
 
+void timing_select(TIMING_t* timing) {
+	timing_cur = timing;
+}
+
 void timing_loop() {
+	uint64_t cur;
 	uint32_t i;
-#ifdef _WIN32
-	LARGE_INTEGER cur;
-	//TODO: error handling
-	QueryPerformanceCounter(&cur);
-	timing_cur = (uint64_t)cur.QuadPart;
-#else
-	struct timeval tv;
-	gettimeofday(&tv, NULL);
-	timing_cur = (uint64_t)tv.tv_sec * 1000000 + (uint64_t)tv.tv_usec;
-#endif
-	for (i = 0; i < timers_count; i++) {
-		if (timing_cur >= (timers[i].previous + timers[i].interval)) {
-			if (timers[i].enabled != TIMING_DISABLED) {
-				if (timers[i].callback != NULL) {
-					(*timers[i].callback)(timers[i].data);
+
+	cur = timing_getCur();
+	for (i = 0; i < timing_cur->count; i++) {
+		if (cur >= (timing_cur->timers[i].previous + timing_cur->timers[i].interval)) {
+			if (timing_cur->timers[i].enabled == TIMING_ONESHOT) {
+				timing_cur->timers[i].enabled = TIMING_DISABLED; //disarm first so the callback is free to schedule it again
+				if (timing_cur->timers[i].callback != NULL) {
+					(*timing_cur->timers[i].callback)(timing_cur->timers[i].data);
+				}
+			}
+			else if (timing_cur->timers[i].enabled != TIMING_DISABLED) {
+				if (timing_cur->timers[i].callback != NULL) {
+					(*timing_cur->timers[i].callback)(timing_cur->timers[i].data);
 				}
-				timers[i].previous += timers[i].interval;
-				if ((timing_cur - timers[i].previous) >= (timers[i].interval * 100)) {
-					timers[i].previous = timing_cur;
+				timing_cur->timers[i].previous += timing_cur->timers[i].interval;
+				if ((cur - timing_cur->timers[i].previous) >= (timing_cur->timers[i].interval * 100)) {
+					timing_cur->timers[i].previous = cur;
 				}
 			}
 		}
@@ -76,7 +83,7 @@ void timing_loop() {
 //Just some code for performance testing
 void timing_speedTest() {
 #ifdef _WIN32
-	uint64_t start, i;
+	uint64_t start, now, i;
 	LARGE_INTEGER cur;
 	//TODO: error handling
 	QueryPerformanceCounter(&cur);
@@ -85,9 +92,9 @@ void timing_speedTest() {
 	i = 0;
 	while (1) {
 		QueryPerformanceCounter(&cur);
-		timing_cur = (uint64_t)cur.QuadPart;
+		now = (uint64_t)cur.QuadPart;
 		i++;
-		if ((timing_cur - start) >= timing_freq) break;
+		if ((now - start) >= timing_hostfreq) break;
 	}
 	printf("%llu calls to QPC in 1 second\r\n", i);
 #endif
@@ -96,89 +103,330 @@ void timing_speedTest() {
 uint32_t timing_addTimerUsingInterval(void* callback, void* data, uint64_t interval, uint8_t enabled) {
 	TIMER* temp;
 	uint32_t ret;
-#ifdef _WIN32
-	LARGE_INTEGER cur;
 
-	//TODO: error handling
-	QueryPerformanceCounter(&cur);
-	timing_cur = (uint64_t)cur.QuadPart;
-#else
-	struct timeval tv;
-	gettimeofday(&tv, NULL);
-	timing_cur = (uint64_t)tv.tv_sec * 1000000 + (uint64_t)tv.tv_usec;
-#endif
-	temp = (TIMER*)realloc(timers, (size_t)sizeof(TIMER) * (timers_count + 1));
+	timing_getCur();
+	temp = (TIMER*)realloc(timing_cur->timers, (size_t)sizeof(TIMER) * (timing_cur->count + 1));
 	if (temp == NULL) {
 		//TODO: error handling
 		return TIMING_ERROR; //NULL;
 	}
-	timers = temp;
-
-	timers[timers_count].previous = timing_cur;
-	timers[timers_count].interval = interval;
-	timers[timers_count].callback = callback;
-	timers[timers_count].data = data;
-	timers[timers_count].enabled = enabled;
+	timing_cur->timers = temp;
 
-	ret = timers_count;
-	timers_count++;
+	ret = timing_cur->count;
+	temp[ret].previous = timing_cur->cur;
+	temp[ret].interval = interval;
+	temp[ret].callback = callback;
+	temp[ret].data = data;
+	temp[ret].enabled = enabled;
+	timing_cur->count++;
 
 	return ret;
 }
 
 uint32_t timing_addTimer(void* callback, void* data, double frequency, uint8_t enabled) {
-	return timing_addTimerUsingInterval(callback, data, (uint64_t)((double)timing_freq / frequency), enabled);
+	return timing_addTimerUsingInterval(callback, data, (uint64_t)((double)timing_cur->freq / frequency), enabled);
 }
 
 void timing_updateInterval(uint32_t tnum, uint64_t interval) {
-	if (tnum >= timers_count) {
+	if (tnum >= timing_cur->count) {
 		debug_log(DEBUG_ERROR, "[ERROR] timing_updateInterval() asked to operate on invalid timer\r\n");
 		return;
 	}
-	timers[tnum].interval = interval;
+	timing_cur->timers[tnum].interval = interval;
 }
 
 void timing_updateIntervalFreq(uint32_t tnum, double frequency) {
-	if (tnum >= timers_count) {
+	if (tnum >= timing_cur->count) {
 		debug_log(DEBUG_ERROR, "[ERROR] timing_updateIntervalFreq() asked to operate on invalid timer\r\n");
 		return;
 	}
-	timers[tnum].interval = (uint64_t)((double)timing_freq / frequency);
+	timing_cur->timers[tnum].interval = (uint64_t)((double)timing_cur->freq / frequency);
 }
 
 void timing_timerEnable(uint32_t tnum) {
-	if (tnum >= timers_count) {
+	if (tnum >= timing_cur->count) {
 		debug_log(DEBUG_ERROR, "[ERROR] timing_timerEnable() asked to operate on invalid timer\r\n");
 		return;
 	}
-	timers[tnum].enabled = TIMING_ENABLED;
-	timers[tnum].previous = timing_getCur();
+	timing_cur->timers[tnum].enabled = TIMING_ENABLED;
+	timing_cur->timers[tnum].previous = timing_getCur();
 }
 
 void timing_timerDisable(uint32_t tnum) {
-	if (tnum >= timers_count) {
+	if (tnum >= timing_cur->count) {
 		debug_log(DEBUG_ERROR, "[ERROR] timing_timerDisable() asked to operate on invalid timer\r\n");
 		return;
 	}
-	timers[tnum].enabled = TIMING_DISABLED;
+	timing_cur->timers[tnum].enabled = TIMING_DISABLED;
+}
+
+//Arms a timer to fire exactly once, as soon as timing_cur reaches the absolute time "when"
+void timing_timerSchedule(uint32_t tnum, uint64_t when) {
+	if (tnum >= timing_cur->count) {
+		debug_log(DEBUG_ERROR, "[ERROR] timing_timerSchedule() asked to operate on invalid timer\r\n");
+		return;
+	}
+	timing_cur->timers[tnum].previous = when;
+	timing_cur->timers[tnum].interval = 0;
+	timing_cur->timers[tnum].enabled = TIMING_ONESHOT;
 }
 
 uint64_t timing_getFreq() {
-	return timing_freq;
+	return timing_cur->freq;
 }
 
-uint64_t timing_getCur() {
+uint64_t timing_getHostCur() {
 #ifdef _WIN32
 	LARGE_INTEGER cur;
 
 	//TODO: error handling
 	QueryPerformanceCounter(&cur);
-	timing_cur = (uint64_t)cur.QuadPart;
+	return (uint64_t)cur.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts); //monotonic, so pacing deadlines can be handed straight to clock_nanosleep
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+uint64_t timing_getHostFreq() {
+	return timing_hostfreq;
+}
+
+uint64_t timing_getCur() {
+	uint64_t count;
+
+	if (timing_cur->instrCounter != NULL) {
+		count = *timing_cur->instrCounter;
+		timing_cur->cur = (count / timing_cur->instrRate) * timing_cur->freq + ((count % timing_cur->instrRate) * timing_cur->freq) / timing_cur->instrRate;
+	}
+	else {
+		timing_cur->cur = timing_getHostCur();
+	}
+
+	return timing_cur->cur;
+}
+
+/*
+	Switches the time base over to a guest instruction counter, so that every timer fires
+	at exactly the same point in guest execution on every run. Used by record/replay.
+	Timers that already exist are rescaled to the new fixed frequency and restarted at zero.
+*/
+void timing_setInstructionClock(volatile uint64_t* counter) {
+	uint32_t i;
+
+	for (i = 0; i < timing_cur->count; i++) {
+		timing_cur->timers[i].interval = (uint64_t)((double)timing_cur->timers[i].interval * (double)TIMING_VIRTUAL_FREQ / (double)timing_cur->freq);
+		timing_cur->timers[i].previous = 0;
+	}
+	timing_cur->freq = TIMING_VIRTUAL_FREQ;
+	timing_cur->instrCounter = counter;
+}
+
+//Guest instructions per second of virtual time, only meaningful after timing_setInstructionClock
+void timing_setInstructionRate(uint64_t rate) {
+	if (rate == 0) rate = 1;
+	timing_cur->instrRate = rate;
+}
+
+//Absolute time at which the next enabled timer is due, or all ones if nothing is pending
+uint64_t timing_nextDue() {
+	uint64_t due = 0xFFFFFFFFFFFFFFFFULL, when;
+	uint32_t i;
+
+	for (i = 0; i < timing_cur->count; i++) {
+		if (timing_cur->timers[i].enabled == TIMING_DISABLED) continue;
+		when = timing_cur->timers[i].previous + timing_cur->timers[i].interval;
+		if (when < due) {
+			due = when;
+		}
+	}
+	return due;
+}
+
+//On the instruction clock, the instruction count at which time "when" is reached, rounded up so it really is
+uint64_t timing_countAt(uint64_t when) {
+	uint64_t rate = timing_cur->instrRate;
+	return (when / timing_cur->freq) * rate + ((when % timing_cur->freq) * rate + timing_cur->freq - 1) / timing_cur->freq;
+}
+
+/*
+	How many instructions the CPU can run before the next timer is due, from 1 up to "max",
+	so each cpu_exec call ends right where timing_loop has work to do. Exact on the
+	instruction clock. On the host clock it's worked out from the pace rate, and if the guest
+	isn't paced there's nothing to go on so it's just "max".
+*/
+uint32_t timing_budget(uint32_t max) {
+	uint64_t due, now, count;
+
+	due = timing_nextDue();
+	if (due == 0xFFFFFFFFFFFFFFFFULL) {
+		return max;
+	}
+
+	if (timing_cur->instrCounter != NULL) {
+		count = timing_countAt(due);
+		now = *timing_cur->instrCounter;
+		count = (count > now) ? (count - now) : 1;
+	}
+	else {
+		if (timing_cur->paceRate == 0) {
+			return max;
+		}
+		now = timing_getCur();
+		if (due <= now) {
+			return 1;
+		}
+		due -= now;
+		if (due >= timing_cur->freq) {
+			return max;
+		}
+		count = (due * timing_cur->paceRate + timing_cur->freq - 1) / timing_cur->freq;
+	}
+
+	if (count > max) {
+		count = max;
+	}
+	return (count == 0) ? 1 : (uint32_t)count;
+}
+
+/*
+	Called when the guest has nothing to do until the next timer event (see cpu_idle).
+	On the instruction clock the counter just jumps ahead to that event, though never past
+	"limit" so a replay or batch job can stop exactly where it has to. Jumping is as good
+	as spinning there, and since it only depends on guest state it replays identically.
+	On the host clock, time can't be skipped, so the thread sleeps through it instead. A
+	host sleep can't be trusted to come back much sooner than TIMING_IDLE_MINSLEEP though, so
+	when the next timer is due before that (the audio timer always is), the thread only gives
+	up the rest of its time slice and the caller keeps spinning until it's due.
+	Returns 1 if any time went by.
+*/
+uint8_t timing_idle(uint64_t limit) {
+	uint64_t due, now, count;
+
+	due = timing_nextDue();
+	now = timing_getCur();
+	if (due <= now) {
+		return 0; //there's still a timer to catch up on
+	}
+
+	if (timing_cur->instrCounter != NULL) {
+		if (due == 0xFFFFFFFFFFFFFFFFULL) {
+			count = limit;
+		}
+		else {
+			count = timing_countAt(due);
+		}
+		if (count > limit) {
+			count = limit;
+		}
+		if (count <= *timing_cur->instrCounter) {
+			return 0;
+		}
+		*timing_cur->instrCounter = count;
+		return 1;
+	}
+
+	due -= now;
+	if (due < (TIMING_IDLE_MINSLEEP * timing_hostfreq) / 1000000) {
+		timing_hostYield();
+		return 0;
+	}
+	else if (due > (TIMING_IDLE_MAXSLEEP * timing_hostfreq) / 1000000) {
+		due = (TIMING_IDLE_MAXSLEEP * timing_hostfreq) / 1000000;
+	}
+	timing_hostSleep(due);
+	timing_paceReset(); //the guest had nothing to do, so it isn't behind
+	return 1;
+}
+
+//Lets other threads run without sleeping for any set time
+void timing_hostYield() {
+#ifdef _WIN32
+	SwitchToThread();
+#else
+	sched_yield();
+#endif
+}
+
+//Puts the calling thread to sleep for about "ticks" of the host clock
+void timing_hostSleep(uint64_t ticks) {
+	timing_hostSleepUntil(timing_getHostCur() + ticks);
+}
+
+//Sleeps until the host clock reads "when". An absolute deadline doesn't drift by however late each wakeup is
+void timing_hostSleepUntil(uint64_t when) {
+#ifdef _WIN32
+	uint64_t now;
+
+	now = timing_getHostCur();
+	if (when > now) {
+		Sleep((DWORD)(((when - now) * 1000) / timing_hostfreq));
+	}
 #else
-	struct timeval tv;
-	gettimeofday(&tv, NULL);
-	timing_cur = (uint64_t)tv.tv_sec * 1000000 + (uint64_t)tv.tv_usec;
+	struct timespec ts;
+	int res;
+
+	ts.tv_sec = (time_t)(when / 1000000000);
+	ts.tv_nsec = (long)(when % 1000000000);
+	do {
+		res = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+	} while (res == EINTR);
 #endif
+}
+
+/*
+	Pacing keeps an instruction counter in step with the host clock at "rate" instructions
+	per second, by sleeping whenever the guest gets more than TIMING_PACE_SLACK ahead. That's
+	what -speed and recording use instead of spinning on the clock. A rate of 0 stops it.
+*/
+void timing_paceStart(volatile uint64_t* counter, uint64_t rate) {
+	timing_cur->paceCounter = (rate > 0) ? counter : NULL;
+	timing_cur->paceRate = rate;
+	timing_paceReset();
+}
+
+//Starts measuring from here, for when the guest was idle or had to be let go for a while
+void timing_paceReset() {
+	if (timing_cur->paceCounter == NULL) return;
+	timing_cur->paceHost = timing_getHostCur();
+	timing_cur->paceBase = *timing_cur->paceCounter;
+}
+
+//Returns 1 if it slept
+uint8_t timing_pace() {
+	uint64_t count, target, now;
+	uint32_t i;
+
+	if (timing_cur->paceCounter == NULL) return 0;
+
+	count = *timing_cur->paceCounter - timing_cur->paceBase;
+	target = timing_cur->paceHost + (count / timing_cur->paceRate) * timing_hostfreq + ((count % timing_cur->paceRate) * timing_hostfreq) / timing_cur->paceRate;
+	now = timing_getHostCur();
+
+	if ((now > target) && ((now - target) > (TIMING_PACE_MAXLAG * timing_hostfreq) / 1000000)) {
+		timing_paceReset(); //the host can't keep up, don't try to make it all back at once
+		return 0;
+	}
+	if ((target <= now) || ((target - now) < (TIMING_PACE_SLACK * timing_hostfreq) / 1000000)) {
+		return 0;
+	}
+
+	timing_hostSleepUntil(target);
+
+	//on the host clock, timers fell due while we slept, fire them all before the guest runs on
+	for (i = 0; (i < TIMING_CATCHUP_MAX) && (timing_nextDue() <= timing_getCur()); i++) {
+		timing_loop();
+	}
+	return 1;
+}
+
+//Guest speed as a fraction of the pace rate, since pacing was last started or reset
+double timing_paceRatio() {
+	uint64_t host;
 
-	return timing_cur;
+	if (timing_cur->paceCounter == NULL) return 0;
+	host = timing_getHostCur() - timing_cur->paceHost;
+	if (host == 0) return 1;
+	return ((double)(*timing_cur->paceCounter - timing_cur->paceBase) / (double)timing_cur->paceRate) / ((double)host / (double)timing_hostfreq);
 }
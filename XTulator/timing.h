@@ -11,24 +11,62 @@ typedef struct TIMER_s {
 	void* data;
 } TIMER;
 
+typedef struct {
+	uint64_t cur;
+	uint64_t freq;
+	volatile uint64_t* instrCounter; //when set, time is derived from this instruction count instead of the host clock
+	uint64_t instrRate;
+	volatile uint64_t* paceCounter; //instructions kept in step with the host clock, NULL when not pacing
+	uint64_t paceRate;
+	uint64_t paceHost; //host time and count that pacing is measured from
+	uint64_t paceBase;
+	TIMER* timers;
+	uint32_t count;
+} TIMING_t;
+
 #define TIMING_ENABLED	1
 #define TIMING_DISABLED	0
+#define TIMING_ONESHOT	2
 #define TIMING_ERROR 0xFFFFFFFF
 
 #define TIMING_RINGSIZE	1024
 
-int timing_init();
+#define TIMING_VIRTUAL_FREQ	10000000 //ticks per second of the instruction-count clock
+
+#define TIMING_IDLE_MINSLEEP	1000 //microseconds, shortest host nap for an idle guest, it only yields before a sooner timer
+#define TIMING_IDLE_MAXSLEEP	10000 //microseconds, longest, so the UI is still polled often enough
+#define TIMING_PACE_SLACK		1000 //microseconds a paced guest may run ahead before sleeping
+#define TIMING_PACE_MAXLAG		100000 //microseconds a paced guest may fall behind before it's let off
+#define TIMING_CATCHUP_MAX		1000 //most timer passes to catch up on after a sleep
+#define TIMING_BATCH_MAX		10000 //most instructions per cpu_exec call, see timing_budget
+
+int timing_init(TIMING_t* timing);
+void timing_select(TIMING_t* timing);
 void timing_loop();
 uint32_t timing_addTimer(void* callback, void* data, double frequency, uint8_t enabled);
+uint32_t timing_addTimerUsingInterval(void* callback, void* data, uint64_t interval, uint8_t enabled);
 void timing_updateIntervalFreq(uint32_t tnum, double frequency);
 void timing_updateInterval(uint32_t tnum, uint64_t interval);
 void timing_speedTest();
 void timing_timerEnable(uint32_t tnum);
 void timing_timerDisable(uint32_t tnum);
+void timing_timerSchedule(uint32_t tnum, uint64_t when);
 uint64_t timing_getFreq();
 uint64_t timing_getCur();
-
-extern uint64_t timing_cur;
-extern uint64_t timing_freq;
+uint64_t timing_getHostCur();
+uint64_t timing_getHostFreq();
+void timing_setInstructionClock(volatile uint64_t* counter);
+void timing_setInstructionRate(uint64_t rate);
+uint64_t timing_nextDue();
+uint64_t timing_countAt(uint64_t when);
+uint32_t timing_budget(uint32_t max);
+uint8_t timing_idle(uint64_t limit);
+void timing_hostYield();
+void timing_hostSleep(uint64_t ticks);
+void timing_hostSleepUntil(uint64_t when);
+void timing_paceStart(volatile uint64_t* counter, uint64_t rate);
+void timing_paceReset();
+uint8_t timing_pace();
+double timing_paceRatio();
 
 #endif
@@ -56,8 +56,8 @@ void utility_sleep(uint32_t ms) {
 #else
 	int res;
 	struct timespec ts;
-	ts.tv_sec = 0;
-	ts.tv_nsec = (long)ms * 1000;
+	ts.tv_sec = (time_t)(ms / 1000);
+	ts.tv_nsec = (long)(ms % 1000) * 1000000;
 	do {
 		res = nanosleep(&ts, &ts);
 	} while (res && errno == EINTR);
@@ -0,0 +1,9 @@
+#!/bin/sh
+# Builds an optimized binary and runs the throughput benchmark. Results are written as JSON to the
+# file given as the first argument (default bench.json), any other arguments go to the emulator.
+# Run it from a directory with the ROMs in it, same as the emulator itself.
+OUT=${1:-bench.json}
+[ $# -gt 0 ] && shift
+mkdir -p bin
+gcc -O2 -o bin/xtulator-bench XTulator/*.c XTulator/chipset/*.c XTulator/cpu/*.c XTulator/modules/audio/*.c XTulator/modules/disk/*.c XTulator/modules/input/*.c XTulator/modules/io/*.c XTulator/modules/video/*.c -lm -lpthread -lrt `pcap-config --cflags --libs` `sdl2-config --cflags --libs` || exit 1
+bin/xtulator-bench -bench "$OUT" "$@" && cat "$OUT"